@@ -0,0 +1,150 @@
+// encode_bench.c
+// Compares upload encoders (JSON vs MessagePack) on the three analyser
+// payload shapes: encode time per record and bytes on the wire.
+//
+// Build (from repo root):
+//   gcc -O2 -Ilibanalyser -o bench/encode_bench bench/encode_bench.c libanalyser/*.c -lcurl
+// Run:
+//   ./bench/encode_bench [iterations]
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "analyser_record.h"
+#include "record_encoder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <time.h>
+#endif
+
+static double now_ns(void) {
+#ifdef _WIN32
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER t;
+  if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&t);
+  return (double)t.QuadPart * 1e9 / (double)freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+// ===================== Payload shapes =====================
+// Same keys and typical values as analyser_1/2/3 produce.
+
+static void build_cbc(AnalyserRecord* rec) {
+  static const char* rows[22][6] = {
+    {"6690-2","WBC","7.52","10*9/L","4.00-10.00","N"},
+    {"704-7","BAS#","0.03","10*9/L","0.00-0.10","N"},
+    {"706-2","BAS%","0.4","%","0.0-1.0","N"},
+    {"751-8","NEU#","4.81","10*9/L","2.00-7.00","N"},
+    {"770-8","NEU%","64.0","%","50.0-70.0",""},
+    {"711-2","EOS#","0.12","10*9/L","0.02-0.50",""},
+    {"713-8","EOS%","1.6","%","0.5-5.0",""},
+    {"731-0","LYM#","2.10","10*9/L","0.80-4.00",""},
+    {"736-9","LYM%","27.9","%","20.0-40.0",""},
+    {"742-7","MON#","0.46","10*9/L","0.12-1.20",""},
+    {"744-3","MON%","6.1","%","3.0-12.0",""},
+    {"789-8","RBC","4.12","10*12/L","3.50-5.50",""},
+    {"718-7","HGB","9.8","g/dL","11.0-16.0","L"},
+    {"787-2","MCV","88.3","fL","80.0-100.0",""},
+    {"785-6","MCH","29.1","pg","27.0-34.0",""},
+    {"786-4","MCHC","33.0","g/dL","32.0-36.0",""},
+    {"788-0","RDW-CV","13.2","%","11.0-16.0",""},
+    {"21000-5","RDW-SD","44.1","fL","35.0-56.0",""},
+    {"4544-3","HCT","36.4","%","37.0-54.0","L"},
+    {"777-3","PLT","452","10*9/L","100-300","H"},
+    {"32623-1","MPV","9.4","fL","6.5-12.0",""},
+    {"32207-3","PDW","15.9","","9.0-17.0",""},
+  };
+
+  record_init(rec, ANALYSER_KIND_CBC);
+  record_set_identity(rec, "MC0003", "00:11:22:33:44:55");
+  for (int i = 0; i < 22; i++) {
+    record_begin_item(rec);
+    record_add_field(rec, "test_code", rows[i][0]);
+    record_add_field(rec, "name", rows[i][1]);
+    record_add_field(rec, "system", "LN");
+    record_add_field(rec, "result", rows[i][2]);
+    record_add_field(rec, "units", rows[i][3]);
+    record_add_field(rec, "normal_range", rows[i][4]);
+    record_add_field(rec, "flag", rows[i][5]);
+  }
+}
+
+static void build_results(AnalyserRecord* rec) {
+  record_init(rec, ANALYSER_KIND_RESULTS);
+  record_set_identity(rec, "MC0003", "00:11:22:33:44:55");
+  record_begin_item(rec);
+  record_add_field(rec, "test_code", "14749-6");
+  record_add_field(rec, "test_name", "GLU");
+  record_add_field(rec, "system", "LN");
+  record_add_field(rec, "result", "5.6");
+  record_add_field(rec, "units", "mmol/L");
+  record_add_field(rec, "units_system", "SI");
+}
+
+static void build_urine(AnalyserRecord* rec) {
+  static const char* kv[10][2] = {
+    {"BLD","Neg"},{"LEU","Neg"},{"BIL","Neg"},{"UBG","Normal"},{"KET","Neg"},
+    {"GLU","+-5.5"},{"PRO","1+30"},{"pH","6.0"},{"NIT","Neg"},{"SG","1.020"},
+  };
+
+  record_init(rec, ANALYSER_KIND_URINE);
+  record_set_identity(rec, "MC0003", "00:11:22:33:44:55");
+  record_begin_item(rec);
+  for (int i = 0; i < 10; i++) record_add_field(rec, kv[i][0], kv[i][1]);
+}
+
+// ===================== Runner =====================
+
+static void run_case(const char* shape, const AnalyserRecord* rec,
+                     const RecordEncoder* enc, int iters) {
+  ByteBuf out = {0};
+  size_t bytes = 0;
+
+  // warm-up so the buffer has grown to its steady-state size
+  enc->encode(rec, &out);
+  bytes = out.len;
+
+  double t0 = now_ns();
+  for (int i = 0; i < iters; i++) {
+    out.len = 0;
+    enc->encode(rec, &out);
+  }
+  double t1 = now_ns();
+
+  printf("%-8s %-8s %10.1f %8zu\n", shape, enc->name, (t1 - t0) / iters, bytes);
+  bytebuf_free(&out);
+}
+
+int main(int argc, char* argv[]) {
+  int iters = (argc > 1) ? atoi(argv[1]) : 200000;
+  if (iters <= 0) iters = 1;
+
+  AnalyserRecord cbc, results, urine;
+  build_cbc(&cbc);
+  build_results(&results);
+  build_urine(&urine);
+
+  const RecordEncoder* encoders[2] = { record_encoder_json(), record_encoder_msgpack() };
+
+  printf("%-8s %-8s %10s %8s\n", "shape", "encoder", "ns/record", "bytes");
+  for (int e = 0; e < 2; e++) {
+    run_case("cbc",     &cbc,     encoders[e], iters);
+    run_case("results", &results, encoders[e], iters);
+    run_case("urine",   &urine,   encoders[e], iters);
+  }
+
+  record_free(&cbc);
+  record_free(&results);
+  record_free(&urine);
+  return 0;
+}
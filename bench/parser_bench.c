@@ -0,0 +1,410 @@
+// parser_bench.c
+// Microbenchmarks for the per-file hot path: format detection, parsing
+// (record splitting, field/component tokenising and value extraction) and
+// the two wire encoders, on real-looking and synthetic files of each
+// analyser format.
+//
+// For every fixture and stage it reports time per record (one record = one
+// result file), arena allocations per record, system allocations per record
+// in the steady state (should stay 0) and throughput: input bytes for
+// classify/parse, output bytes for the encoders.
+//
+// Build (from repo root):
+//   gcc -O2 -Ilibanalyser -o bench/parser_bench bench/parser_bench.c libanalyser/*.c -lcurl
+// Run:
+//   ./bench/parser_bench [--iters N] [--format table|csv|json] [--only SUBSTRING]
+//
+// The csv and json outputs keep their column names and order; --only keeps
+// the rows whose "fixture/stage" contains SUBSTRING. Exit status is 1 when
+// a fixture no longer parses.
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "analyser.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <time.h>
+#endif
+
+static double now_ns(void) {
+#ifdef _WIN32
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER t;
+  if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&t);
+  return (double)t.QuadPart * 1e9 / (double)freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+// ===================== Fixtures =====================
+// Real-looking: what the instruments send, framing bytes included.
+// Synthetic: generated from a fixed seed, with the awkward parts the field
+// produces (reordered and unknown rows, marker asterisks, quotes and
+// backslashes that need escaping, long captures of which only the first
+// rows are read).
+
+static const char CBC_REAL[] =
+  "[02001^Take Mode^99MRC|O,02002^Blood Mode^99MRC|WB,02003^Test Mode^99MRC|CBC+DIFF,"
+  "01002^Ref Group^99MRC|General,PID|1||S-1001,OBR|1||S-1001,"
+  "6690-2^WBC^LN|7.52|10*9/L||4.00-10.00|N,704-7^BAS#^LN|0.03|10*9/L||0.00-0.10|N,"
+  "706-2^BAS%^LN|0.4|%||0.0-1.0|N,751-8^NEU#^LN|4.81|10*9/L||2.00-7.00|N,"
+  "OBX|5|NM|770-8^NEU%^LN|64.0|%||50.0-70.0|,OBX|6|NM|711-2^EOS#^LN|0.12|10*9/L||0.02-0.50|,"
+  "OBX|7|NM|713-8^EOS%^LN|1.6|%||0.5-5.0|,OBX|8|NM|731-0^LYM#^LN|2.10|10*9/L||0.80-4.00|,"
+  "OBX|9|NM|736-9^LYM%^LN|27.9|%||20.0-40.0|,OBX|10|NM|742-7^MON#^LN|0.46|10*9/L||0.12-1.20|,"
+  "OBX|11|NM|744-3^MON%^LN|6.1|%||3.0-12.0|,OBX|12|NM|789-8^RBC^LN|4.12|10*12/L||3.50-5.50|,"
+  "OBX|13|NM|718-7^HGB^LN|9.8|g/dL||11.0-16.0|L,OBX|14|NM|787-2^MCV^LN|88.3|fL||80.0-100.0|,"
+  "OBX|15|NM|785-6^MCH^LN|29.1|pg||27.0-34.0|,OBX|16|NM|786-4^MCHC^LN|33.0|g/dL||32.0-36.0|,"
+  "OBX|17|NM|788-0^RDW-CV^LN|13.2|%||11.0-16.0|,OBX|18|NM|21000-5^RDW-SD^LN|44.1|fL||35.0-56.0|,"
+  "OBX|19|NM|4544-3^HCT^LN|36.4|%||37.0-54.0|L,OBX|20|NM|777-3^PLT^LN|452|10*9/L||100-300|H,"
+  "OBX|21|NM|32623-1^MPV^LN|9.4|fL||6.5-12.0|,OBX|22|NM|32207-3^PDW^LN|15.9|||9.0-17.0|]\n";
+
+static const char RESULTS_REAL[] = "[14749-6^GLU^LN|NM|5.6|mmol/L^^SI|3.9-6.1|N]\n";
+
+static const char URINE_REAL[] =
+  "\002\\\\SCAN\nNo.0001\nDate:2026-01-01\nID: 000123\nName\nSex\nAge\nResult OK\n"
+  "........................\n"
+  "BLD   Neg\nLEU   Neg\nBIL   Neg\nUBG   Normal\nKET   Neg\nGLU   +-  5.5 mg/dl\n"
+  "*PRO  1+  30 mg/dl\npH    6.0\nNIT   Neg\nSG    1.020\n"
+  "------------------------\nend\n\003\r";
+
+static const char *const CBC_ROWS[22][3] = {
+  {"6690-2","WBC","10*9/L"},  {"704-7","BAS#","10*9/L"},  {"706-2","BAS%","%"},
+  {"751-8","NEU#","10*9/L"},  {"770-8","NEU%","%"},       {"711-2","EOS#","10*9/L"},
+  {"713-8","EOS%","%"},       {"731-0","LYM#","10*9/L"},  {"736-9","LYM%","%"},
+  {"742-7","MON#","10*9/L"},  {"744-3","MON%","%"},       {"789-8","RBC","10*12/L"},
+  {"718-7","HGB","g/dL"},     {"787-2","MCV","fL"},       {"785-6","MCH","pg"},
+  {"786-4","MCHC","g/dL"},    {"788-0","RDW-CV","%"},     {"21000-5","RDW-SD","fL"},
+  {"4544-3","HCT","%"},       {"777-3","PLT","10*9/L"},   {"32623-1","MPV","fL"},
+  {"32207-3","PDW",""},
+};
+
+static const char *const URINE_ROWS[10][2] = {
+  {"BLD","Neg"},  {"LEU","+- 15"},       {"BIL","Neg"},      {"UBG","Normal"},
+  {"KET","1+ 15"},{"GLU","+-  5.5 mg/dl"},{"PRO","1+  30 mg/dl"},{"pH","6.5"},
+  {"NIT","Pos"},  {"SG","1.025"},
+};
+
+typedef struct {
+  char*  data;
+  size_t len, cap;
+} Text;
+
+static unsigned g_seed = 12345u;
+
+static unsigned rnd(unsigned n) {
+  g_seed = g_seed * 1103515245u + 12345u;
+  return (g_seed >> 16) % n;
+}
+
+static void text_add(Text* t, const char* fmt, ...) {
+  va_list ap;
+  for (;;) {
+    size_t room = t->cap - t->len;
+    va_start(ap, fmt);
+    int n = vsnprintf(t->data ? t->data + t->len : NULL, room, fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if ((size_t)n < room) {
+      t->len += (size_t)n;
+      return;
+    }
+    size_t cap = t->cap ? t->cap * 2 : 4096;
+    while (cap - t->len <= (size_t)n) cap *= 2;
+    char* p = (char*)realloc(t->data, cap);
+    if (!p) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+    t->data = p;
+    t->cap = cap;
+  }
+}
+
+// F200 capture with random values and 200 trailing OBX rows the parser
+// must not walk; a few names and units carry characters JSON escapes.
+static void synth_cbc(Text* t) {
+  text_add(t, "[02001^Take Mode^99MRC|O,02002^Blood Mode^99MRC|WB,02003^Test Mode^99MRC|CBC+DIFF,"
+              "01002^Ref Group^99MRC|\"Adult\\Male\",PID|1||S-%05u,OBR|1||S-%05u", rnd(100000), rnd(100000));
+  for (int i = 0; i < 22 + 200; i++) {
+    const char* const* r = CBC_ROWS[i % 22];
+    unsigned v = rnd(100000);
+    const char* flag = v % 7 == 0 ? "H" : v % 11 == 0 ? "L" : "";
+    const char* units = i % 9 == 4 ? "10\"9/L" : r[2];
+    if (i < 4) {
+      text_add(t, ",%s^%s^LN|%u.%02u|%s||%u.00-%u.00|%s", r[0], r[1], v / 100, v % 100, units,
+               v % 5, 10 + v % 90, flag);
+    } else {
+      text_add(t, ",OBX|%d|NM|%s^%s^LN|%u.%02u|%s||%u.00-%u.00|%s", i + 1, r[0], r[1], v / 100, v % 100,
+               units, v % 5, 10 + v % 90, flag);
+    }
+  }
+  text_add(t, "]\n");
+}
+
+static void synth_results(Text* t) {
+  text_add(t, "[2345-7^GLUCOSE \\\"FASTING\\\" PLASMA^LN|NM|%u.%u|mg/dL^^CONVENTIONAL|70-99|%s]\n",
+           50 + rnd(300), rnd(10), rnd(2) ? "H" : "N");
+}
+
+// Report with the rows shuffled and unknown ones in between.
+static void synth_urine(Text* t) {
+  int order[10];
+  for (int i = 0; i < 10; i++) order[i] = i;
+  for (int i = 9; i > 0; i--) {
+    int j = (int)rnd((unsigned)i + 1), tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+
+  text_add(t, "\002\\\\SCAN\nNo.%04u\nDate:2026-03-14 09:26\nID: %06u\nName  J. Doe\nSex  F\n"
+              "Age  41\nResult OK\n\n........................\n", rnd(10000), rnd(1000000));
+  for (int i = 0; i < 10; i++) {
+    const char* const* r = URINE_ROWS[order[i]];
+    text_add(t, "%s%-5s %s\n", i % 3 == 0 ? "*" : "", r[0], r[1]);
+    if (i % 4 == 1) text_add(t, "VC    %u mg/dl\n", rnd(50));
+  }
+  text_add(t, "------------------------\nOperator: lab-2\nend\n\003\r");
+}
+
+typedef struct {
+  const char*  name;
+  AnalyserKind kind;
+  const char*  text;
+  size_t       len;
+} Fixture;
+
+// ===================== Stages =====================
+
+typedef struct {
+  const char* fixture;
+  const char* stage;
+  size_t      bytes;        // per record: input for classify/parse, output for encoders
+  double      nsPerRecord;
+  double      allocs;       // arena allocations per record
+  double      mallocs;      // system allocations per record, steady state
+} Result;
+
+typedef enum { OUT_TABLE, OUT_CSV, OUT_JSON } OutFormat;
+
+static OutFormat   g_out = OUT_TABLE;
+static const char* g_only;
+static int         g_rows;
+static volatile size_t g_sink;   // keeps results observable
+
+static int wanted(const char* fixture, const char* stage) {
+  if (!g_only) return 1;
+  char key[96];
+  snprintf(key, sizeof(key), "%s/%s", fixture, stage);
+  return strstr(key, g_only) != NULL;
+}
+
+static void print_header(void) {
+  if (g_out == OUT_TABLE) {
+    printf("%-14s %-9s %8s %11s %8s %8s %10s\n", "fixture", "stage", "bytes", "ns/record",
+           "allocs", "mallocs", "MB/s");
+  } else if (g_out == OUT_CSV) {
+    printf("fixture,stage,bytes,ns_per_record,allocs_per_record,mallocs_per_record,bytes_per_s\n");
+  } else {
+    printf("[");
+  }
+}
+
+static void print_result(const Result* r) {
+  double bps = r->nsPerRecord > 0 ? (double)r->bytes * 1e9 / r->nsPerRecord : 0;
+  if (g_out == OUT_TABLE) {
+    printf("%-14s %-9s %8zu %11.1f %8.2f %8.3f %10.1f\n", r->fixture, r->stage, r->bytes,
+           r->nsPerRecord, r->allocs, r->mallocs, bps / 1e6);
+  } else if (g_out == OUT_CSV) {
+    printf("%s,%s,%zu,%.1f,%.2f,%.3f,%.0f\n", r->fixture, r->stage, r->bytes, r->nsPerRecord,
+           r->allocs, r->mallocs, bps);
+  } else {
+    printf("%s\n  {\"fixture\":\"%s\",\"stage\":\"%s\",\"bytes\":%zu,\"ns_per_record\":%.1f,"
+           "\"allocs_per_record\":%.2f,\"mallocs_per_record\":%.3f,\"bytes_per_s\":%.0f}",
+           g_rows ? "," : "", r->fixture, r->stage, r->bytes, r->nsPerRecord, r->allocs,
+           r->mallocs, bps);
+  }
+  g_rows++;
+}
+
+static void print_footer(void) {
+  if (g_out == OUT_JSON) printf("%s]\n", g_rows ? "\n" : "");
+}
+
+static size_t mallocs_of(const Arena* a) {
+  ArenaStats st;
+  arena_stats(a, &st);
+  return st.mallocs;
+}
+
+static size_t allocs_of(const Arena* a) {
+  ArenaStats st;
+  arena_stats(a, &st);
+  return st.allocs;
+}
+
+static void bench_classify(const Fixture* fx, int iters) {
+  if (!wanted(fx->name, "classify")) return;
+
+  double t0 = now_ns();
+  for (int i = 0; i < iters; i++) {
+    g_sink += (size_t)format_classify(fx->text, fx->len)->kind;
+  }
+  double t1 = now_ns();
+
+  Result r = { fx->name, "classify", fx->len, (t1 - t0) / iters, 0, 0 };
+  print_result(&r);
+}
+
+// Record splitting, field/component tokenising and value extraction into
+// the worker's arena, as a scan worker does per file.
+static int bench_parse(const Fixture* fx, Arena* arena, int iters) {
+  const AnalyserFormat* fmt = format_classify(fx->text, fx->len);
+  AnalyserRecord rec;
+  char detail[128];
+
+  if (fmt->kind != fx->kind) {
+    fprintf(stderr, "%s: classified as %s\n", fx->name, fmt->label);
+    return 0;
+  }
+
+  arena_reset(arena);
+  record_init_in(&rec, fmt->kind, arena);
+  FormatStatus st = format_parse(fmt, fx->text, fx->len, &rec, detail, sizeof(detail));
+  if (st != FORMAT_OK) {
+    fprintf(stderr, "%s: %s (%s)\n", fx->name, format_status_text(st), detail);
+    return 0;
+  }
+  size_t allocs = allocs_of(arena);
+  if (!wanted(fx->name, "parse")) return 1;
+
+  size_t m0 = mallocs_of(arena);
+  double t0 = now_ns();
+  for (int i = 0; i < iters; i++) {
+    arena_reset(arena);
+    record_init_in(&rec, fmt->kind, arena);
+    format_parse(fmt, fx->text, fx->len, &rec, detail, sizeof(detail));
+    g_sink += (size_t)rec.nfields;
+  }
+  double t1 = now_ns();
+
+  Result r = { fx->name, "parse", fx->len, (t1 - t0) / iters, (double)allocs,
+               (double)(mallocs_of(arena) - m0) / iters };
+  print_result(&r);
+  return 1;
+}
+
+// Serialisation of an already parsed record into an arena-backed buffer.
+static void bench_encode(const Fixture* fx, const RecordEncoder* enc, Arena* parsed,
+                         Arena* arena, int iters) {
+  if (!wanted(fx->name, enc->name)) return;
+
+  AnalyserRecord rec;
+  arena_reset(parsed);
+  analyser_parse_buffer_in(parsed, fx->text, fx->len, &rec, NULL, NULL, 0);
+  record_set_identity(&rec, "MC0003", "00:11:22:33:44:55");
+
+  arena_reset(arena);
+  ByteBuf out = { NULL, 0, 0, arena };
+  enc->encode(&rec, &out);
+  size_t bytes = out.len;
+  size_t allocs = allocs_of(arena);
+
+  size_t m0 = mallocs_of(arena);
+  double t0 = now_ns();
+  for (int i = 0; i < iters; i++) {
+    arena_reset(arena);
+    out.data = NULL;
+    out.len = out.cap = 0;
+    enc->encode(&rec, &out);
+    g_sink += out.len;
+  }
+  double t1 = now_ns();
+
+  Result r = { fx->name, enc->name, bytes, (t1 - t0) / iters, (double)allocs,
+               (double)(mallocs_of(arena) - m0) / iters };
+  print_result(&r);
+}
+
+// ===================== Runner =====================
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "usage: %s [--iters N] [--format table|csv|json] [--only SUBSTRING]\n", argv0);
+}
+
+int main(int argc, char* argv[]) {
+  int iters = 100000;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--iters") && i + 1 < argc) {
+      iters = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--format") && i + 1 < argc) {
+      const char* f = argv[++i];
+      if (!strcmp(f, "table")) g_out = OUT_TABLE;
+      else if (!strcmp(f, "csv")) g_out = OUT_CSV;
+      else if (!strcmp(f, "json")) g_out = OUT_JSON;
+      else {
+        usage(argv[0]);
+        return 2;
+      }
+    } else if (!strcmp(argv[i], "--only") && i + 1 < argc) {
+      g_only = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (iters <= 0) iters = 1;
+
+  Text cbc = {0}, results = {0}, urine = {0};
+  synth_cbc(&cbc);
+  synth_results(&results);
+  synth_urine(&urine);
+
+  const Fixture fixtures[6] = {
+    { "cbc",           ANALYSER_KIND_CBC,     CBC_REAL,     sizeof(CBC_REAL) - 1 },
+    { "cbc-synth",     ANALYSER_KIND_CBC,     cbc.data,     cbc.len },
+    { "results",       ANALYSER_KIND_RESULTS, RESULTS_REAL, sizeof(RESULTS_REAL) - 1 },
+    { "results-synth", ANALYSER_KIND_RESULTS, results.data, results.len },
+    { "urine",         ANALYSER_KIND_URINE,   URINE_REAL,   sizeof(URINE_REAL) - 1 },
+    { "urine-synth",   ANALYSER_KIND_URINE,   urine.data,   urine.len },
+  };
+  const RecordEncoder* encoders[2] = { record_encoder_json(), record_encoder_msgpack() };
+
+  format_registry_init();
+  Arena* parsed = arena_create(0);
+  Arena* arena = arena_create(0);
+  if (!parsed || !arena) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  int failed = 0;
+  print_header();
+  for (int f = 0; f < 6; f++) {
+    bench_classify(&fixtures[f], iters);
+    if (!bench_parse(&fixtures[f], arena, iters)) {
+      failed = 1;
+      continue;
+    }
+    for (int e = 0; e < 2; e++) bench_encode(&fixtures[f], encoders[e], parsed, arena, iters);
+  }
+  print_footer();
+
+  arena_destroy(parsed);
+  arena_destroy(arena);
+  free(cbc.data);
+  free(results.data);
+  free(urine.data);
+  return failed;
+}
@@ -0,0 +1,905 @@
+// pipeline_bench.c
+// End-to-end throughput of a real combain process against local stand-ins:
+//
+//   - mock F200 / H360 analysers on 127.0.0.1 that combain dials
+//     ([listener] client mode, at most 16),
+//   - mock analysers that dial combain's LIS-host listener (server mode),
+//   - fake serial devices (ptys) sending urine \\SCAN reports,
+//   - an HTTP API stand-in that acknowledges uploads after a configurable
+//     latency and refuses a configurable share of them.
+//
+// Every instrument sends one result per interval (+-20 % jitter). Each
+// result carries a tag ("T<instrument>.<seq>" in a text field the upload
+// passes through), so the API side knows which result an upload is and
+// when its first byte left the instrument. After the run and a drain the
+// harness stops combain and reports results per second, arrival-to-ack
+// latency percentiles (overall and per format) and combain's CPU time and
+// resident memory.
+//
+// POSIX only (ptys, fork/exec); CPU and RSS come from /proc (Linux).
+//
+// Build (from repo root):
+//   gcc -O2 -o bench/pipeline_bench bench/pipeline_bench.c
+//   gcc -O2 -Ilibanalyser -o combain/combain combain/*.c libanalyser/*.c -lcurl -lpthread -lz
+// Run:
+//   ./bench/pipeline_bench [options]        (--help lists them)
+//   e.g. a 30-instrument lab:
+//   ./bench/pipeline_bench --tcp 14 --dial 14 --serial 2 --interval-ms 3000 --duration 120
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _GNU_SOURCE
+
+#ifdef _WIN32
+
+#include <stdio.h>
+
+int main(void) {
+  fprintf(stderr, "pipeline_bench needs ptys and fork/exec; run it on Linux or macOS.\n");
+  return 1;
+}
+
+#else
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#define MAX_TCP     16        // CONFIG_MAX_LISTENERS
+#define MAX_DIAL    256       // max_peers
+#define MAX_SERIAL  4         // CONFIG_MAX_SERIALS
+#define MAX_MOCKS   (MAX_TCP + MAX_DIAL + MAX_SERIAL)
+#define MAX_CONNS   64
+#define REQ_MAX     (64 * 1024)
+#define OUT_MAX     2048
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static unsigned g_seed = 12345u;
+
+static double rnd01(void) {
+  g_seed = g_seed * 1103515245u + 12345u;
+  return (double)((g_seed >> 8) & 0xFFFFFF) / (double)0x1000000;
+}
+
+static int set_nonblocking(int fd) {
+  return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0;
+}
+
+// ===================== Options =====================
+
+typedef struct {
+  const char* combain;
+  const char* workdir;
+  int    tcp, dial, serial;
+  int    intervalMs;
+  int    durationS, drainS;
+  int    apiLatencyMs;
+  double apiErrorRate;
+  int    idleMs;
+  int    rescanMs;
+  int    portBase;
+  int    json;
+} Options;
+
+static Options g_opt = {
+  "./combain/combain", "./pipeline_bench.run",
+  4, 0, 1,
+  5000,
+  30, 10,
+  20, 0.0,
+  200, 2000,
+  50100,
+  0,
+};
+
+static int lis_port(void) { return g_opt.portBase + MAX_TCP; }
+static int api_port(void) { return g_opt.portBase + MAX_TCP + 1; }
+
+// ===================== Results =====================
+
+enum { KIND_CBC, KIND_H360, KIND_URINE, KINDS };
+static const char* const KIND_NAMES[KINDS] = { "cbc", "h360", "urine" };
+
+typedef struct {
+  double* v;
+  size_t  n, cap;
+} Series;
+
+static void push(Series* s, double v) {
+  if (s->n == s->cap) {
+    size_t cap = s->cap ? s->cap * 2 : 1024;
+    double* p = (double*)realloc(s->v, cap * sizeof(*p));
+    if (!p) return;
+    s->v = p;
+    s->cap = cap;
+  }
+  s->v[s->n++] = v;
+}
+
+static int cmp_double(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static double at(const Series* s, double q) {
+  size_t rank = (size_t)(q * (double)s->n + 0.999999);
+  if (rank < 1) rank = 1;
+  return s->v[rank - 1];
+}
+
+static Series g_latency[KINDS + 1];      // last one: every kind
+static unsigned long long g_requests, g_refused, g_untagged, g_acked, g_dups, g_sent, g_behind;
+static double g_runStart, g_runEnd;
+static unsigned long long g_ackedInRun;
+
+// ===================== Mock instruments =====================
+
+enum { VIA_TCP, VIA_DIAL, VIA_SERIAL };
+
+typedef struct {
+  int    kind, via, index;
+  int    listenFd;       // VIA_TCP: combain dials this
+  int    fd;             // connection / pty master, -1 = none
+  int    slaveFd;        // VIA_SERIAL: held open so the pty never hangs up
+  char   device[64];
+  int    port;
+  double nextMs;
+  double retryMs;        // VIA_DIAL: next connect attempt
+  char   out[OUT_MAX];
+  size_t outLen, outOff;
+  unsigned seq;          // results sent
+  double*  sentMs;       // first byte of result i left at sentMs[i]
+  unsigned char* acked;
+  size_t cap;
+} Mock;
+
+static Mock g_mocks[MAX_MOCKS];
+static int  g_nmocks;
+
+static const char CBC_HEAD[] =
+  "[02001^Take Mode^99MRC|O,02002^Blood Mode^99MRC|WB,02003^Test Mode^99MRC|CBC+DIFF,"
+  "01002^Ref Group^99MRC|General,PID|1||S-%u,OBR|1||S-%u";
+
+static const char* const CBC_ROWS[22][4] = {
+  {"6690-2","WBC","7.52","10*9/L"}, {"704-7","BAS#","0.03","10*9/L"}, {"706-2","BAS%","0.4","%"},
+  {"751-8","NEU#","4.81","10*9/L"}, {"770-8","NEU%","64.0","%"},      {"711-2","EOS#","0.12","10*9/L"},
+  {"713-8","EOS%","1.6","%"},       {"731-0","LYM#","2.10","10*9/L"}, {"736-9","LYM%","27.9","%"},
+  {"742-7","MON#","0.46","10*9/L"}, {"744-3","MON%","6.1","%"},       {"789-8","RBC","4.12","10*12/L"},
+  {"718-7","HGB","9.8","g/dL"},     {"787-2","MCV","88.3","fL"},      {"785-6","MCH","29.1","pg"},
+  {"786-4","MCHC","33.0","g/dL"},   {"788-0","RDW-CV","13.2","%"},    {"21000-5","RDW-SD","44.1","fL"},
+  {"4544-3","HCT","36.4","%"},      {"777-3","PLT","452","10*9/L"},   {"32623-1","MPV","9.4","fL"},
+  {"32207-3","PDW","15.9",""},
+};
+
+static void out_add(Mock* m, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(m->out + m->outLen, sizeof(m->out) - m->outLen, fmt, ap);
+  va_end(ap);
+  if (n > 0) m->outLen += (size_t)n < sizeof(m->out) - m->outLen ? (size_t)n : sizeof(m->out) - m->outLen - 1;
+}
+
+// One result in the instrument's format, tagged T<index>.<seq> where the
+// upload passes text through: the CBC/H360 "system" component, urine UBG.
+// Urine ends in a full line: the serial reader only forwards whole lines.
+static void build_result(Mock* m) {
+  m->outLen = m->outOff = 0;
+  unsigned id = (unsigned)m->index * 1000000u + m->seq;
+
+  if (m->kind == KIND_CBC) {
+    out_add(m, CBC_HEAD, id, id);
+    for (int i = 0; i < 22; i++) {
+      const char* const* r = CBC_ROWS[i];
+      if (i < 4) out_add(m, ",%s^%s^T%d.%u|%s|%s||0-100|", r[0], r[1], m->index, m->seq, r[2], r[3]);
+      else out_add(m, ",OBX|%d|NM|%s^%s^T%d.%u|%s|%s||0-100|", i + 1, r[0], r[1], m->index, m->seq, r[2], r[3]);
+    }
+    out_add(m, "]\n");
+  } else if (m->kind == KIND_H360) {
+    out_add(m, "[14749-6^GLU^T%d.%u|NM|%.1f|mmol/L^^SI|3.9-6.1|N]\n", m->index, m->seq, 4.0 + rnd01() * 4);
+  } else {
+    out_add(m, "\002\\\\SCAN\nNo.%04u\nDate:2026-01-01\nID: %u\nName\nSex\nAge\nResult OK\n"
+               "........................\n"
+               "BLD   Neg\nLEU   Neg\nBIL   Neg\nUBG   T%d.%u\nKET   Neg\nGLU   +-  5.5 mg/dl\n"
+               "*PRO  1+  30 mg/dl\npH    6.0\nNIT   Neg\nSG    1.020\n"
+               "------------------------\nend\n\003\r\n", m->seq % 10000, id, m->index, m->seq);
+  }
+}
+
+static int remember_sent(Mock* m, double t) {
+  if (m->seq >= m->cap) {
+    size_t cap = m->cap ? m->cap * 2 : 256;
+    double* s = (double*)realloc(m->sentMs, cap * sizeof(*s));
+    if (!s) return 0;
+    m->sentMs = s;
+    unsigned char* a = (unsigned char*)realloc(m->acked, cap);
+    if (!a) return 0;
+    memset(a + m->cap, 0, cap - m->cap);
+    m->acked = a;
+    m->cap = cap;
+  }
+  m->sentMs[m->seq] = t;
+  return 1;
+}
+
+static void mock_close(Mock* m) {
+  if (m->fd >= 0 && m->via != VIA_SERIAL) close(m->fd);
+  if (m->via != VIA_SERIAL) m->fd = -1;
+  m->outLen = m->outOff = 0;
+}
+
+static void mock_flush(Mock* m) {
+  while (m->fd >= 0 && m->outOff < m->outLen) {
+    ssize_t n = write(m->fd, m->out + m->outOff, m->outLen - m->outOff);
+    if (n > 0) {
+      m->outOff += (size_t)n;
+    } else {
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+      if (n < 0 && errno == EINTR) continue;
+      mock_close(m);
+      return;
+    }
+  }
+}
+
+static void mock_tick(Mock* m, double now, int sending) {
+  if (m->via == VIA_DIAL && m->fd < 0 && now >= m->retryMs) {
+    m->retryMs = now + 200;
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons((unsigned short)lis_port());
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (s >= 0 && connect(s, (struct sockaddr*)&a, sizeof(a)) == 0 && set_nonblocking(s)) {
+      m->fd = s;
+    } else if (s >= 0) {
+      close(s);
+    }
+  }
+
+  if (!sending || m->fd < 0 || now < m->nextMs) return;
+  m->nextMs += g_opt.intervalMs * (0.8 + 0.4 * rnd01());
+  if (m->nextMs < now) m->nextMs = now;
+
+  if (m->outOff < m->outLen) {
+    g_behind++;   // the previous result has not left yet
+    return;
+  }
+  if (!remember_sent(m, now)) return;
+  build_result(m);
+  m->seq++;
+  g_sent++;
+  mock_flush(m);
+}
+
+static int listen_on(int port) {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  if (s < 0) return -1;
+  int one = 1;
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_port = htons((unsigned short)port);
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(s, (struct sockaddr*)&a, sizeof(a)) != 0 || listen(s, 64) != 0 || !set_nonblocking(s)) {
+    fprintf(stderr, "cannot listen on 127.0.0.1:%d: %s\n", port, strerror(errno));
+    close(s);
+    return -1;
+  }
+  return s;
+}
+
+static int open_pty(Mock* m) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    fprintf(stderr, "cannot open a pty: %s\n", strerror(errno));
+    return 0;
+  }
+  snprintf(m->device, sizeof(m->device), "%s", ptsname(master));
+
+  // Raw from the start, so nothing is echoed back before combain opens it.
+  m->slaveFd = open(m->device, O_RDWR | O_NOCTTY);
+  struct termios tty;
+  if (m->slaveFd < 0 || tcgetattr(m->slaveFd, &tty) != 0) {
+    fprintf(stderr, "cannot open %s: %s\n", m->device, strerror(errno));
+    return 0;
+  }
+  cfmakeraw(&tty);
+  tcsetattr(m->slaveFd, TCSANOW, &tty);
+  set_nonblocking(master);
+  m->fd = master;
+  return 1;
+}
+
+static int setup_mocks(void) {
+  for (int i = 0; i < g_opt.tcp + g_opt.dial + g_opt.serial; i++) {
+    Mock* m = &g_mocks[g_nmocks];
+    memset(m, 0, sizeof(*m));
+    m->index = g_nmocks++;
+    m->fd = m->listenFd = m->slaveFd = -1;
+
+    if (i < g_opt.tcp) {
+      m->via = VIA_TCP;
+      m->kind = i % 2 ? KIND_H360 : KIND_CBC;
+      m->port = g_opt.portBase + i;
+      m->listenFd = listen_on(m->port);
+      if (m->listenFd < 0) return 0;
+    } else if (i < g_opt.tcp + g_opt.dial) {
+      m->via = VIA_DIAL;
+      m->kind = (i - g_opt.tcp) % 2 ? KIND_H360 : KIND_CBC;
+    } else {
+      m->via = VIA_SERIAL;
+      m->kind = KIND_URINE;
+      if (!open_pty(m)) return 0;
+    }
+  }
+  return 1;
+}
+
+static int mocks_connected(void) {
+  for (int i = 0; i < g_nmocks; i++) {
+    if (g_mocks[i].fd < 0) return 0;
+  }
+  return 1;
+}
+
+// ===================== API stand-in =====================
+
+typedef struct {
+  int    fd;
+  char   in[REQ_MAX];
+  size_t inLen;
+  size_t headLen, bodyLen;   // known once the headers are complete
+  int    continued;          // 100 Continue sent
+  double respondAt;          // > 0: request complete, answer due
+  int    status;
+  int    kind;               // tagged result, -1 if none
+  int    mock;
+  unsigned seq;
+} Conn;
+
+static Conn g_conns[MAX_CONNS];
+static int  g_apiFd = -1;
+
+static void conn_close(Conn* c) {
+  close(c->fd);
+  c->fd = -1;
+}
+
+static void write_all(int fd, const char* s, size_t n) {
+  while (n > 0) {
+    ssize_t w = write(fd, s, n);
+    if (w > 0) {
+      s += w;
+      n -= (size_t)w;
+    } else if (w < 0 && (errno == EAGAIN || errno == EINTR)) {
+      struct pollfd p = { fd, POLLOUT, 0 };
+      poll(&p, 1, 100);
+    } else {
+      return;
+    }
+  }
+}
+
+// "T<mock>.<seq>" inside a JSON string.
+static int find_tag(const char* body, size_t n, int* mock, unsigned* seq) {
+  for (size_t i = 0; i + 4 < n; i++) {
+    if (body[i] != '"' || body[i + 1] != 'T') continue;
+    char* end;
+    long m = strtol(body + i + 2, &end, 10);
+    if (end == body + i + 2 || *end != '.') continue;
+    unsigned long s = strtoul(end + 1, &end, 10);
+    if (*end != '"' || m < 0 || m >= g_nmocks) continue;
+    *mock = (int)m;
+    *seq = (unsigned)s;
+    return 1;
+  }
+  return 0;
+}
+
+static void request_complete(Conn* c, double now) {
+  g_requests++;
+  const char* body = c->in + c->headLen;
+  c->mock = -1;
+  if (!find_tag(body, c->bodyLen, &c->mock, &c->seq)) g_untagged++;
+  c->status = rnd01() < g_opt.apiErrorRate ? 503 : 200;
+  c->respondAt = now + g_opt.apiLatencyMs;
+}
+
+static void note_ack(const Conn* c, double now) {
+  if (c->mock < 0) return;
+  Mock* m = &g_mocks[c->mock];
+  if (c->seq >= m->seq) return;
+  if (m->acked[c->seq]) {
+    g_dups++;
+    return;
+  }
+  m->acked[c->seq] = 1;
+  g_acked++;
+  if (now <= g_runEnd || g_runEnd == 0) g_ackedInRun++;
+  double lat = now - m->sentMs[c->seq];
+  push(&g_latency[m->kind], lat);
+  push(&g_latency[KINDS], lat);
+}
+
+static void respond(Conn* c, double now) {
+  char head[160];
+  int n = snprintf(head, sizeof(head),
+                   "HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: 2\r\n\r\n%s",
+                   c->status, c->status == 200 ? "OK" : "Service Unavailable",
+                   c->status == 200 ? "ok" : "no");
+  write_all(c->fd, head, (size_t)n);
+  if (c->status == 200) note_ack(c, now);
+  else g_refused++;
+
+  // Keep-alive: the next request may already be buffered.
+  size_t used = c->headLen + c->bodyLen;
+  memmove(c->in, c->in + used, c->inLen - used);
+  c->inLen -= used;
+  c->headLen = c->bodyLen = 0;
+  c->continued = 0;
+  c->respondAt = 0;
+}
+
+// Parse what has arrived; 0 if the connection must go.
+static int conn_parse(Conn* c, double now) {
+  if (c->respondAt > 0) return 1;
+  if (!c->headLen) {
+    char* end = NULL;
+    for (size_t i = 3; i < c->inLen; i++) {
+      if (!memcmp(c->in + i - 3, "\r\n\r\n", 4)) {
+        end = c->in + i + 1;
+        break;
+      }
+    }
+    if (!end) return c->inLen < sizeof(c->in);
+    c->headLen = (size_t)(end - c->in);
+
+    int expect = 0;
+    for (char* line = c->in; line < end; ) {
+      char* eol = memchr(line, '\n', (size_t)(end - line));
+      if (!eol) break;
+      if (!strncasecmp(line, "Content-Length:", 15)) c->bodyLen = strtoul(line + 15, NULL, 10);
+      if (!strncasecmp(line, "Expect:", 7) && strstr(line, "100")) expect = 1;
+      line = eol + 1;
+    }
+    if (c->headLen + c->bodyLen > sizeof(c->in)) return 0;
+    if (expect && c->inLen < c->headLen + c->bodyLen && !c->continued) {
+      write_all(c->fd, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+      c->continued = 1;
+    }
+  }
+  if (c->inLen >= c->headLen + c->bodyLen) request_complete(c, now);
+  return 1;
+}
+
+static void api_accept(void) {
+  for (;;) {
+    int s = accept(g_apiFd, NULL, NULL);
+    if (s < 0) return;
+    Conn* c = NULL;
+    for (int i = 0; i < MAX_CONNS && !c; i++) {
+      if (g_conns[i].fd < 0) c = &g_conns[i];
+    }
+    if (!c || !set_nonblocking(s)) {
+      close(s);
+      continue;
+    }
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    memset(c, 0, sizeof(*c));
+    c->fd = s;
+  }
+}
+
+static void conn_read(Conn* c, double now) {
+  for (;;) {
+    if (c->inLen == sizeof(c->in)) {
+      conn_close(c);
+      return;
+    }
+    ssize_t n = read(c->fd, c->in + c->inLen, sizeof(c->in) - c->inLen);
+    if (n > 0) {
+      c->inLen += (size_t)n;
+      continue;
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+      conn_close(c);
+      return;
+    }
+    break;
+  }
+  if (!conn_parse(c, now)) conn_close(c);
+}
+
+// ===================== combain process =====================
+
+static pid_t g_child = -1;
+
+static int write_config(const char* path) {
+  FILE* fp = fopen(path, "w");
+  if (!fp) return 0;
+  fprintf(fp, "; written by pipeline_bench\n[general]\nscan_dir = ss\nmachine_id = BENCH\n"
+              "upload_encoding = json\nsink_idle_ms = %d\nrescan_interval_ms = %d\n"
+              "metrics_port = 0\nlog_file = combain.log\nlog_console = no\n\n",
+          g_opt.idleMs, g_opt.rescanMs);
+  fprintf(fp, "[endpoints]\ncbc = http://127.0.0.1:%d/cbc\nresults = http://127.0.0.1:%d/results\n"
+              "urine = http://127.0.0.1:%d/urine\n\n", api_port(), api_port(), api_port());
+
+  for (int i = 0; i < g_nmocks; i++) {
+    const Mock* m = &g_mocks[i];
+    if (m->via == VIA_TCP) {
+      fprintf(fp, "[listener mock%d]\nhost = 127.0.0.1\nport = %d\nout = ss/out_mock%d.txt\n\n",
+              m->index, m->port, m->index);
+    } else if (m->via == VIA_SERIAL) {
+      fprintf(fp, "[serial mock%d]\ndevice = %s\nbaud = 9600\nout = ss/serial_mock%d.txt\n\n",
+              m->index, m->device, m->index);
+    }
+  }
+  if (g_opt.dial) {
+    fprintf(fp, "[listener lis]\nmode = server\nhost = 127.0.0.1\nport = %d\nout = ss/out_lis.txt\n"
+                "max_peers = %d\n\n", lis_port(), g_opt.dial);
+  }
+  // Declaring one (disabled) section keeps the built-in instruments away.
+  if (!g_opt.tcp && !g_opt.dial) fprintf(fp, "[listener none]\nport = 1\nenabled = no\n\n");
+  if (!g_opt.serial) fprintf(fp, "[serial none]\ndevice = /dev/null\nenabled = no\n");
+  return fclose(fp) == 0;
+}
+
+static void clear_scan_dir(const char* dir) {
+  DIR* d = opendir(dir);
+  if (!d) return;
+  struct dirent* e;
+  char path[1024];
+  while ((e = readdir(d)) != NULL) {
+    size_t n = strlen(e->d_name);
+    if (n > 4 && !strcmp(e->d_name + n - 4, ".txt")) {
+      snprintf(path, sizeof(path), "%.512s/%.255s", dir, e->d_name);
+      unlink(path);
+    }
+  }
+  closedir(d);
+}
+
+static int start_combain(void) {
+  char path[1024];
+  mkdir(g_opt.workdir, 0755);
+  snprintf(path, sizeof(path), "%s/ss", g_opt.workdir);
+  mkdir(path, 0755);
+  clear_scan_dir(path);
+  snprintf(path, sizeof(path), "%s/combain.ini", g_opt.workdir);
+  if (!write_config(path)) {
+    fprintf(stderr, "cannot write %s\n", path);
+    return 0;
+  }
+
+  char exe[1024];
+  if (!realpath(g_opt.combain, exe)) {
+    fprintf(stderr, "%s: %s\n", g_opt.combain, strerror(errno));
+    return 0;
+  }
+
+  g_child = fork();
+  if (g_child < 0) return 0;
+  if (g_child == 0) {
+    if (chdir(g_opt.workdir) != 0) _exit(127);
+    int out = open("combain.out", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out >= 0) {
+      dup2(out, 1);
+      dup2(out, 2);
+    }
+    setenv("COMBAIN_CONFIG", "combain.ini", 1);
+    execl(exe, exe, (char*)NULL);
+    _exit(127);
+  }
+  return 1;
+}
+
+static void stop_combain(void) {
+  if (g_child <= 0) return;
+  kill(g_child, SIGINT);
+  for (int i = 0; i < 100; i++) {
+    if (waitpid(g_child, NULL, WNOHANG) == g_child) return;
+    usleep(100000);
+  }
+  kill(g_child, SIGKILL);
+  waitpid(g_child, NULL, 0);
+}
+
+typedef struct {
+  double cpuS;
+  long   rssKb, peakKb;
+} Usage;
+
+static void sample_usage(Usage* u) {
+  memset(u, 0, sizeof(*u));
+  char path[64], buf[1024];
+  snprintf(path, sizeof(path), "/proc/%d/stat", (int)g_child);
+  FILE* fp = fopen(path, "r");
+  if (fp) {
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+    buf[n] = '\0';
+    fclose(fp);
+    char* p = strrchr(buf, ')');
+    unsigned long long ut = 0, st = 0;
+    if (p && sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &ut, &st) == 2) {
+      u->cpuS = (double)(ut + st) / (double)sysconf(_SC_CLK_TCK);
+    }
+  }
+  snprintf(path, sizeof(path), "/proc/%d/status", (int)g_child);
+  fp = fopen(path, "r");
+  if (fp) {
+    while (fgets(buf, sizeof(buf), fp)) {
+      if (!strncmp(buf, "VmRSS:", 6)) u->rssKb = atol(buf + 6);
+      if (!strncmp(buf, "VmHWM:", 6)) u->peakKb = atol(buf + 6);
+    }
+    fclose(fp);
+  }
+}
+
+// ===================== Event loop =====================
+
+static volatile sig_atomic_t g_interrupted;
+
+enum { POLL_API, POLL_CONN, POLL_DIALLED, POLL_MOCK };
+
+static void on_signal(int sig) {
+  (void)sig;
+  g_interrupted = 1;
+}
+
+// Runs until 'untilMs' (or, with 'drain', until every result is acked).
+static void run_loop(double untilMs, int sending, int waitConnect, int drain) {
+  struct pollfd pfd[1 + MAX_MOCKS * 2 + MAX_CONNS];
+  struct { int what, index; } who[1 + MAX_MOCKS * 2 + MAX_CONNS];
+
+  while (!g_interrupted) {
+    double now = now_ms();
+    if (now >= untilMs) return;
+    if (waitConnect && mocks_connected()) return;
+    if (drain && g_acked == g_sent) return;
+
+    double wake = untilMs;
+    for (int i = 0; i < g_nmocks; i++) {
+      Mock* m = &g_mocks[i];
+      mock_tick(m, now, sending);
+      if (sending && m->nextMs < wake) wake = m->nextMs;
+      if (m->via == VIA_DIAL && m->fd < 0 && m->retryMs < wake) wake = m->retryMs;
+    }
+    for (int i = 0; i < MAX_CONNS; i++) {
+      Conn* c = &g_conns[i];
+      if (c->fd < 0 || c->respondAt <= 0) continue;
+      if (c->respondAt <= now) {
+        respond(c, now);
+        if (!conn_parse(c, now)) conn_close(c);
+      }
+      if (c->fd >= 0 && c->respondAt > 0 && c->respondAt < wake) wake = c->respondAt;
+    }
+
+    int n = 0;
+    pfd[n].fd = g_apiFd;
+    pfd[n].events = POLLIN;
+    who[n].what = POLL_API;
+    who[n++].index = 0;
+    for (int i = 0; i < g_nmocks; i++) {
+      Mock* m = &g_mocks[i];
+      if (m->listenFd >= 0) {
+        pfd[n].fd = m->listenFd;
+        pfd[n].events = POLLIN;
+        who[n].what = POLL_DIALLED;
+        who[n++].index = i;
+      }
+      if (m->fd >= 0) {
+        pfd[n].fd = m->fd;
+        pfd[n].events = (short)((m->via == VIA_SERIAL ? 0 : POLLIN) | (m->outOff < m->outLen ? POLLOUT : 0));
+        who[n].what = POLL_MOCK;
+        who[n++].index = i;
+      }
+    }
+    for (int i = 0; i < MAX_CONNS; i++) {
+      if (g_conns[i].fd < 0) continue;
+      pfd[n].fd = g_conns[i].fd;
+      pfd[n].events = g_conns[i].respondAt > 0 ? 0 : POLLIN;
+      who[n].what = POLL_CONN;
+      who[n++].index = i;
+    }
+
+    int timeout = (int)(wake - now_ms());
+    if (timeout < 0) timeout = 0;
+    if (timeout > 100) timeout = 100;
+    if (poll(pfd, (nfds_t)n, timeout) <= 0) continue;
+
+    now = now_ms();
+    for (int i = 0; i < n; i++) {
+      if (!pfd[i].revents) continue;
+      Mock* m = &g_mocks[who[i].index];
+
+      if (who[i].what == POLL_API) {
+        api_accept();
+      } else if (who[i].what == POLL_CONN) {
+        Conn* c = &g_conns[who[i].index];
+        if (c->fd >= 0) conn_read(c, now);
+      } else if (who[i].what == POLL_DIALLED) {
+        // combain (re)dialled this instrument
+        int s = accept(m->listenFd, NULL, NULL);
+        if (s < 0) continue;
+        if (m->fd >= 0) mock_close(m);
+        set_nonblocking(s);
+        m->fd = s;
+      } else if (m->fd >= 0) {
+        if (pfd[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+          char junk[4096];
+          ssize_t r = read(m->fd, junk, sizeof(junk));
+          if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR)) {
+            mock_close(m);
+            continue;
+          }
+        }
+        if (pfd[i].revents & POLLOUT) mock_flush(m);
+      }
+    }
+  }
+}
+
+// ===================== Report =====================
+
+static void report(const Usage* u0, const Usage* u1) {
+  double runS = (g_runEnd - g_runStart) / 1e3;
+  double cpu = u1->cpuS - u0->cpuS;
+  unsigned long long missing = g_sent - g_acked;
+  for (int k = 0; k <= KINDS; k++) {
+    if (g_latency[k].n) qsort(g_latency[k].v, g_latency[k].n, sizeof(double), cmp_double);
+  }
+
+  if (g_opt.json) {
+    printf("{\"instruments\":{\"tcp\":%d,\"dial\":%d,\"serial\":%d},\"interval_ms\":%d,\"duration_s\":%.1f,"
+           "\"api_latency_ms\":%d,\"api_error_rate\":%.3f,\"sent\":%llu,\"acked\":%llu,"
+           "\"acked_per_s\":%.2f,\"sent_per_s\":%.2f,\"duplicates\":%llu,\"missing\":%llu,\"behind\":%llu,"
+           "\"requests\":%llu,\"refused\":%llu,\"untagged\":%llu,\"latency_ms\":{",
+           g_opt.tcp, g_opt.dial, g_opt.serial, g_opt.intervalMs, runS, g_opt.apiLatencyMs,
+           g_opt.apiErrorRate, g_sent, g_acked, (double)g_ackedInRun / runS, (double)g_sent / runS,
+           g_dups, missing, g_behind, g_requests, g_refused, g_untagged);
+    int first = 1;
+    for (int k = KINDS; k >= 0; k--) {
+      const Series* s = &g_latency[k];
+      if (!s->n) continue;
+      printf("%s\"%s\":{\"n\":%zu,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"max\":%.1f}", first ? "" : ",",
+             k == KINDS ? "all" : KIND_NAMES[k], s->n, at(s, 0.5), at(s, 0.9), at(s, 0.99), s->v[s->n - 1]);
+      first = 0;
+    }
+    printf("},\"cpu_s\":%.2f,\"cpu_pct\":%.1f,\"rss_kb\":%ld,\"peak_rss_kb\":%ld}\n", cpu,
+           runS > 0 ? cpu / runS * 100 : 0, u1->rssKb, u1->peakKb);
+    return;
+  }
+
+  printf("instruments  %d dialled, %d dialling in, %d serial; a result every %d ms each\n",
+         g_opt.tcp, g_opt.dial, g_opt.serial, g_opt.intervalMs);
+  printf("run          %.1f s, API latency %d ms, %.1f %% refused\n", runS, g_opt.apiLatencyMs,
+         g_opt.apiErrorRate * 100);
+  printf("sent         %llu results (%.2f/s), %llu skipped while the previous one was still sending\n",
+         g_sent, (double)g_sent / runS, g_behind);
+  printf("acked        %llu results (%.2f/s during the run), %llu missing, %llu duplicate\n",
+         g_acked, (double)g_ackedInRun / runS, missing, g_dups);
+  printf("api          %llu requests, %llu refused, %llu without a tag\n", g_requests, g_refused, g_untagged);
+  printf("combain      cpu %.2f s (%.1f %%), rss %.1f MB, peak %.1f MB\n", cpu,
+         runS > 0 ? cpu / runS * 100 : 0, u1->rssKb / 1024.0, u1->peakKb / 1024.0);
+  printf("\n  %-6s %8s %10s %10s %10s %10s   (ms, first byte sent -> API ack)\n",
+         "format", "n", "p50", "p90", "p99", "max");
+  for (int k = KINDS; k >= 0; k--) {
+    const Series* s = &g_latency[k];
+    if (!s->n) continue;
+    printf("  %-6s %8zu %10.1f %10.1f %10.1f %10.1f\n", k == KINDS ? "all" : KIND_NAMES[k], s->n,
+           at(s, 0.5), at(s, 0.9), at(s, 0.99), s->v[s->n - 1]);
+  }
+}
+
+// ===================== Main =====================
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --combain PATH        combain executable (./combain/combain)\n"
+          "  --workdir DIR         its working directory, config and logs (./pipeline_bench.run)\n"
+          "  --tcp N               mock analysers combain dials, 0-%d (4)\n"
+          "  --dial N              mock analysers dialling combain's LIS-host listener, 0-%d (0)\n"
+          "  --serial N            fake serial devices sending urine reports, 0-%d (1)\n"
+          "  --interval-ms N       time between results per instrument, +-20 %% (5000)\n"
+          "  --duration S          sending time (30)\n"
+          "  --drain S             extra time for outstanding results (10)\n"
+          "  --api-latency-ms N    delay before the API answers (20)\n"
+          "  --api-error-rate F    share of uploads answered 503, 0-1 (0)\n"
+          "  --idle-ms N           combain sink_idle_ms (200)\n"
+          "  --rescan-ms N         combain rescan_interval_ms, the retry delay (2000)\n"
+          "  --port-base N         first mock port; +%d LIS-host, +%d API (50100)\n"
+          "  --seed N              jitter and error injection seed\n"
+          "  --json                one JSON object instead of the table\n",
+          argv0, MAX_TCP, MAX_DIAL, MAX_SERIAL, MAX_TCP, MAX_TCP + 1);
+}
+
+static int parse_args(int argc, char* argv[]) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : NULL;
+    if (!strcmp(a, "--json")) { g_opt.json = 1; continue; }
+    if (!v) return 0;
+    i++;
+    if (!strcmp(a, "--combain")) g_opt.combain = v;
+    else if (!strcmp(a, "--workdir")) g_opt.workdir = v;
+    else if (!strcmp(a, "--tcp")) g_opt.tcp = atoi(v);
+    else if (!strcmp(a, "--dial")) g_opt.dial = atoi(v);
+    else if (!strcmp(a, "--serial")) g_opt.serial = atoi(v);
+    else if (!strcmp(a, "--interval-ms")) g_opt.intervalMs = atoi(v);
+    else if (!strcmp(a, "--duration")) g_opt.durationS = atoi(v);
+    else if (!strcmp(a, "--drain")) g_opt.drainS = atoi(v);
+    else if (!strcmp(a, "--api-latency-ms")) g_opt.apiLatencyMs = atoi(v);
+    else if (!strcmp(a, "--api-error-rate")) g_opt.apiErrorRate = atof(v);
+    else if (!strcmp(a, "--idle-ms")) g_opt.idleMs = atoi(v);
+    else if (!strcmp(a, "--rescan-ms")) g_opt.rescanMs = atoi(v);
+    else if (!strcmp(a, "--port-base")) g_opt.portBase = atoi(v);
+    else if (!strcmp(a, "--seed")) g_seed = (unsigned)strtoul(v, NULL, 10);
+    else return 0;
+  }
+  return g_opt.tcp >= 0 && g_opt.tcp <= MAX_TCP && g_opt.dial >= 0 && g_opt.dial <= MAX_DIAL &&
+         g_opt.serial >= 0 && g_opt.serial <= MAX_SERIAL && g_opt.tcp + g_opt.dial + g_opt.serial > 0 &&
+         g_opt.intervalMs > 0 && g_opt.durationS > 0 && g_opt.drainS >= 0 && g_opt.apiLatencyMs >= 0 &&
+         g_opt.idleMs > 0 && g_opt.rescanMs > 0 && g_opt.portBase > 0 && g_opt.portBase < 65000;
+}
+
+int main(int argc, char* argv[]) {
+  if (!parse_args(argc, argv)) {
+    usage(argv[0]);
+    return 2;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  for (int i = 0; i < MAX_CONNS; i++) g_conns[i].fd = -1;
+
+  g_apiFd = listen_on(api_port());
+  if (g_apiFd < 0 || !setup_mocks() || !start_combain()) {
+    stop_combain();
+    return 1;
+  }
+
+  // Until every instrument is connected (a serial device counts at once).
+  run_loop(now_ms() + 10000, 0, 1, 0);
+  if (!mocks_connected()) fprintf(stderr, "warning: not every instrument connected within 10 s\n");
+
+  double t = now_ms();
+  for (int i = 0; i < g_nmocks; i++) g_mocks[i].nextMs = t + rnd01() * g_opt.intervalMs;
+
+  Usage u0, u1;
+  sample_usage(&u0);
+  g_runStart = t;
+  run_loop(t + g_opt.durationS * 1000.0, 1, 0, 0);
+  g_runEnd = now_ms();
+  run_loop(g_runEnd + g_opt.drainS * 1000.0, 0, 0, 1);
+  sample_usage(&u1);
+  stop_combain();
+
+  report(&u0, &u1);
+  return 0;
+}
+
+#endif
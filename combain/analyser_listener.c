@@ -1,41 +1,131 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "analyser_listener.h"
+#include "logger.h"
+#include "monotime.h"
+#include "capture_sink.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <stdatomic.h>
 
 #ifdef _WIN32
   #include <winsock2.h>
   #include <ws2tcpip.h>
-  #include <process.h>
+  #include <mstcpip.h>
   #pragma comment(lib, "ws2_32.lib")
 #else
   #include <unistd.h>
-  #include <pthread.h>
+  #include <fcntl.h>
   #include <sys/types.h>
   #include <sys/socket.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
   #include <arpa/inet.h>
+  #include <time.h>
 #endif
 
+#define RECONNECT_MS   3000
+#define BACKOFF_MS     10     // re-check a full capture queue
+#define DRAIN_MAX      (1024 * 1024)   // bytes read at stop, at most
+#define FIRST_MAX      512    // server: bytes kept to name a peer
+#define CLASSIFY_MS    2000   // server: wait this long for the first message
+#define MAX_RULES      16
+
 // ===============================================================
 //  Per-instance state
 // ===============================================================
 
+typedef enum {
+    LS_WAITING = 0,   // reconnect timer armed
+    LS_CONNECTING,    // non-blocking connect in progress
+    LS_CONNECTED,
+    LS_PAUSED         // connected, reading paused: capture queue full
+} ListenerState;
+
+typedef enum {
+    PS_NAMING = 0,    // waiting for the first message
+    PS_STREAMING,
+    PS_PAUSED         // capture queue full
+} PeerState;
+
+// Server mode: one accepted analyser connection.
+typedef struct Peer {
+    struct AnalyserListenerHandle *h;
+    PeerState state;
+    char addr[16];     // dotted IPv4
+    int  port;
+    char name[32];
+
+    EvSocket sock;
+    EvIo    *io;
+    EvTimer *timer;    // naming deadline, or capture-queue backoff
+    EvTimer *watchdog; // idle timeout
+    unsigned long long lastRxMs;
+    CaptureSource *capture;
+    FILE    *fp;
+
+    char   first[FIRST_MAX];
+    size_t nfirst;
+
+    struct Peer *prev, *next;
+} Peer;
+
+typedef struct {
+    char name[32];
+    char address[64];
+    char signature[128];
+} PeerRule;
+
+// Written by the loop thread only, read by get_analyser_listener_stats()
+// from anywhere.
+typedef struct {
+    atomic_int    state;      // AnalyserLinkState
+    atomic_int    peers;
+    atomic_long   backoffMs;
+    atomic_ullong bytes, reads, connects, reconnects, connectUs, connectMaxUs;
+    atomic_ullong lastActivityMs;
+    atomic_ullong writes, writeUs, writeLastUs, writeMaxUs;
+    atomic_ullong flushes, flushUs, flushLastUs, flushMaxUs;
+    atomic_ullong deadPeers, lastDetectMs, maxDetectMs;
+} ListenerStats;
+
 struct AnalyserListenerHandle {
-    volatile int running;       // 1 = keep running, 0 = stop
+    EventLoop *loop;
+    ListenerState state;
 
     char ip[64];
     int  port;
     char outPath[512];
+    CaptureSource *capture;
 
-#ifdef _WIN32
-    HANDLE thread;
-#else
-    pthread_t thread;
-#endif
+    EvSocket sock;
+    EvIo    *io;
+    EvTimer *timer;    // reconnect, or capture-queue backoff
+    FILE    *fp;       // direct-write mode, while connected
+
+    // dead-peer detection
+    AnalyserLiveness live;
+    EvTimer *watchdog; // connect deadline, then idle timeout
+    unsigned long long lastRxMs;
+
+    ListenerStats stats;
+    unsigned long long startedMs;
+    unsigned long long connectStartUs;
+
+    // server mode
+    int      server;
+    char     name[32];
+    CaptureSink *sink;
+    size_t   queue;
+    AnalyserPeerQueueFn onPeerQueue;
+    void    *peerCtx;
+    int      maxPeers, npeers;
+    PeerRule rules[MAX_RULES];
+    int      nrules;
+    Peer    *peers;
 };
 
 // ===============================================================
@@ -44,51 +134,261 @@ struct AnalyserListenerHandle {
 
 #ifdef _WIN32
 
-static int socket_init(void) {
-    WSADATA wsa;
-    return WSAStartup(MAKEWORD(2, 2), &wsa);
+#define BAD_SOCKET ((EvSocket)INVALID_SOCKET)
+
+static void close_socket(EvSocket s) {
+    closesocket((SOCKET)s);
 }
 
-static void socket_cleanup(void) {
-    WSACleanup();
+static int set_nonblocking(EvSocket s) {
+    u_long nb = 1;
+    return ioctlsocket((SOCKET)s, FIONBIO, &nb) == 0;
 }
 
-static void sleep_ms(unsigned int ms) {
-    Sleep(ms);
+static int sock_errno(void) {
+    return WSAGetLastError();
+}
+
+static int would_block(int err) {
+    return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS;
+}
+
+static const char *sock_strerror(int err) {
+    static char buf[32];
+    snprintf(buf, sizeof(buf), "error %d", err);
+    return buf;
 }
 
 #else // POSIX
 
-static int socket_init(void) { return 0; }
-static void socket_cleanup(void) { /* no-op */ }
+#define BAD_SOCKET (-1)
 
-static void sleep_ms(unsigned int ms) {
-    usleep(ms * 1000);
+static void close_socket(EvSocket s) {
+    close(s);
 }
 
-#endif
+static int set_nonblocking(EvSocket s) {
+    int fl = fcntl(s, F_GETFL, 0);
+    return fl >= 0 && fcntl(s, F_SETFL, fl | O_NONBLOCK) == 0;
+}
 
-// ===============================================================
-//  Core worker logic (per instance)
-// ===============================================================
+static int sock_errno(void) {
+    return errno;
+}
+
+static int would_block(int err) {
+    return err == EINPROGRESS || err == EAGAIN || err == EWOULDBLOCK || err == EINTR;
+}
+
+static const char *sock_strerror(int err) {
+    return strerror(err);
+}
+
+#endif
 
-static int connect_to_analyser(struct AnalyserListenerHandle *h) {
-    int sockfd = -1;
 
+static int recv_some(EvSocket s, char *buf, size_t cap, int *err) {
 #ifdef _WIN32
-    sockfd = (int)socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd == INVALID_SOCKET) {
-        fprintf(stderr, "[listener %s:%d] socket() failed: %d\n",
-                h->ip, h->port, WSAGetLastError());
+    int n = recv((SOCKET)s, buf, (int)cap, 0);
+    if (n == SOCKET_ERROR) {
+#else
+    int n = (int)recv(s, buf, cap, 0);
+    if (n < 0) {
+#endif
+        *err = sock_errno();
         return -1;
     }
+    return n;
+}
+
+// Dead-peer detection in the kernel: keepalive probes on a quiet link and
+// a bound on unacknowledged data. Best effort: an option the platform
+// lacks is skipped.
+static void apply_liveness(const AnalyserLiveness *lv, EvSocket s) {
+    if (!lv->keepalive) {
+#ifdef TCP_USER_TIMEOUT
+        if (lv->userTimeoutMs > 0) {
+            unsigned int ut = (unsigned int)lv->userTimeoutMs;
+            setsockopt(s, IPPROTO_TCP, TCP_USER_TIMEOUT, &ut, sizeof(ut));
+        }
+#endif
+        return;
+    }
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, (const char *)&one, sizeof(one));
+#ifdef _WIN32
+    if (lv->keepIdleS > 0 || lv->keepIntervalS > 0) {
+        // probe count is fixed by Windows (10)
+        struct tcp_keepalive ka;
+        DWORD out = 0;
+        ka.onoff             = 1;
+        ka.keepalivetime     = (ULONG)(lv->keepIdleS > 0 ? lv->keepIdleS : 7200) * 1000;
+        ka.keepaliveinterval = (ULONG)(lv->keepIntervalS > 0 ? lv->keepIntervalS : 1) * 1000;
+        WSAIoctl((SOCKET)s, SIO_KEEPALIVE_VALS, &ka, sizeof(ka), NULL, 0, &out, NULL, NULL);
+    }
 #else
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-        perror("[listener] socket");
-        return -1;
+  #if defined(TCP_KEEPIDLE)
+    if (lv->keepIdleS > 0) setsockopt(s, IPPROTO_TCP, TCP_KEEPIDLE, &lv->keepIdleS, sizeof(int));
+  #elif defined(TCP_KEEPALIVE)   // macOS
+    if (lv->keepIdleS > 0) setsockopt(s, IPPROTO_TCP, TCP_KEEPALIVE, &lv->keepIdleS, sizeof(int));
+  #endif
+  #ifdef TCP_KEEPINTVL
+    if (lv->keepIntervalS > 0) setsockopt(s, IPPROTO_TCP, TCP_KEEPINTVL, &lv->keepIntervalS, sizeof(int));
+  #endif
+  #ifdef TCP_KEEPCNT
+    if (lv->keepCount > 0) setsockopt(s, IPPROTO_TCP, TCP_KEEPCNT, &lv->keepCount, sizeof(int));
+  #endif
+  #ifdef TCP_USER_TIMEOUT
+    if (lv->userTimeoutMs > 0) {
+        unsigned int ut = (unsigned int)lv->userTimeoutMs;
+        setsockopt(s, IPPROTO_TCP, TCP_USER_TIMEOUT, &ut, sizeof(ut));
     }
+  #endif
+#endif
+}
+
+// recv() error meaning the kernel gave up on the peer (keepalive or
+// user timeout), as opposed to a reset or a close.
+static int timed_out(int err) {
+#ifdef _WIN32
+    return err == WSAETIMEDOUT;
+#else
+    return err == ETIMEDOUT;
 #endif
+}
+
+// ===============================================================
+//  Statistics (single writer: the loop thread)
+// ===============================================================
+
+static unsigned long long stat_get(const atomic_ullong *a) {
+    return atomic_load_explicit((atomic_ullong *)a, memory_order_relaxed);
+}
+
+static void stat_set(atomic_ullong *a, unsigned long long v) {
+    atomic_store_explicit(a, v, memory_order_relaxed);
+}
+
+static void stat_add(atomic_ullong *a, unsigned long long v) {
+    stat_set(a, stat_get(a) + v);
+}
+
+static void stat_sample(atomic_ullong *total, atomic_ullong *last, atomic_ullong *max,
+                        unsigned long long v) {
+    if (total) stat_add(total, v);
+    if (last) stat_set(last, v);
+    if (v > stat_get(max)) stat_set(max, v);
+}
+
+static void set_state(struct AnalyserListenerHandle *h, ListenerState state) {
+    static const AnalyserLinkState link[] = {
+        ANALYSER_LINK_WAITING, ANALYSER_LINK_CONNECTING, ANALYSER_LINK_CONNECTED, ANALYSER_LINK_PAUSED
+    };
+    h->state = state;
+    atomic_store_explicit(&h->stats.state, (int)link[state], memory_order_relaxed);
+}
+
+static void set_backoff(struct AnalyserListenerHandle *h, long ms) {
+    atomic_store_explicit(&h->stats.backoffMs, ms, memory_order_relaxed);
+}
+
+static void set_peers(struct AnalyserListenerHandle *h, int n) {
+    h->npeers = n;
+    atomic_store_explicit(&h->stats.peers, n, memory_order_relaxed);
+}
+
+// One recv() returned 'n' bytes; returns the time, for note_write().
+static unsigned long long note_read(struct AnalyserListenerHandle *h, size_t n) {
+    unsigned long long t = monotime_us();
+    stat_add(&h->stats.bytes, n);
+    stat_add(&h->stats.reads, 1);
+    stat_set(&h->stats.lastActivityMs, t / 1000);
+    return t;
+}
+
+// Data was handed on in 't0'..now.
+static void note_write(struct AnalyserListenerHandle *h, unsigned long long t0) {
+    stat_add(&h->stats.writes, 1);
+    stat_sample(&h->stats.writeUs, &h->stats.writeLastUs, &h->stats.writeMaxUs, monotime_us() - t0);
+}
+
+static void note_flush(struct AnalyserListenerHandle *h, unsigned long long t0) {
+    ListenerStats *st = &h->stats;
+    stat_add(&st->flushes, 1);
+    stat_sample(&st->flushUs, &st->flushLastUs, &st->flushMaxUs, monotime_us() - t0);
+}
+
+static void note_dead(struct AnalyserListenerHandle *h, const char *who, unsigned long long lastRxMs,
+                      const char *why) {
+    unsigned long long now = event_loop_now_ms(h->loop);
+    unsigned long long ms = now > lastRxMs ? now - lastRxMs : 0;
+    stat_add(&h->stats.deadPeers, 1);
+    stat_sample(NULL, &h->stats.lastDetectMs, &h->stats.maxDetectMs, ms);
+    log_msg(LOG_WARN, "listener", "[listener %s:%d] %s declared dead (%s), %.1f s after its last data.",
+            h->ip, h->port, who, why, ms / 1000.0);
+}
+
+// ===============================================================
+//  Core logic (per instance, on the loop thread)
+// ===============================================================
+
+static void on_io(void *ctx, int revents);
+
+static void schedule_reconnect(struct AnalyserListenerHandle *h) {
+    log_msg(LOG_INFO, "listener", "[listener %s:%d] Reconnect in 3s...", h->ip, h->port);
+    set_state(h, LS_WAITING);
+    set_backoff(h, RECONNECT_MS);
+    stat_add(&h->stats.reconnects, 1);
+    ev_timer_start(h->timer, RECONNECT_MS, 0);
+}
+
+static void drop_connection(struct AnalyserListenerHandle *h) {
+    ev_io_remove(h->io);
+    h->io = NULL;
+    if (h->sock != BAD_SOCKET) close_socket(h->sock);
+    h->sock = BAD_SOCKET;
+    if (h->fp) fclose(h->fp);
+    h->fp = NULL;
+    ev_timer_stop(h->timer);
+    ev_timer_stop(h->watchdog);
+}
+
+static void on_connected(struct AnalyserListenerHandle *h) {
+    log_msg(LOG_INFO, "listener", "[listener %s:%d] Connected.", h->ip, h->port);
+
+    if (h->capture) {
+        log_msg(LOG_INFO, "listener", "[listener %s:%d] Publishing to capture queue %s ...",
+                h->ip, h->port, capture_source_name(h->capture));
+    } else {
+        h->fp = fopen(h->outPath, "ab");  // append binary
+        if (!h->fp) {
+            log_msg(LOG_ERROR, "listener", "❌ Cannot open %s: %s", h->outPath, strerror(errno));
+            drop_connection(h);
+            schedule_reconnect(h);
+            return;
+        }
+        log_msg(LOG_INFO, "listener", "[listener %s:%d] Writing to %s ...",
+                h->ip, h->port, h->outPath);
+    }
+
+    set_state(h, LS_CONNECTED);
+    set_backoff(h, 0);
+    stat_add(&h->stats.connects, 1);
+    stat_sample(NULL, &h->stats.connectUs, &h->stats.connectMaxUs, monotime_us() - h->connectStartUs);
+    ev_io_set(h->io, EV_READ);
+    h->lastRxMs = event_loop_now_ms(h->loop);
+    if (h->live.idleTimeoutMs > 0) ev_timer_start(h->watchdog, h->live.idleTimeoutMs, 0);
+    else ev_timer_stop(h->watchdog);
+}
+
+static void start_connect(struct AnalyserListenerHandle *h) {
+    EvSocket s = (EvSocket)socket(AF_INET, SOCK_STREAM, 0);
+    if (s == BAD_SOCKET) {
+        log_msg(LOG_ERROR, "listener", "[listener %s:%d] socket() failed: %s",
+                h->ip, h->port, sock_strerror(sock_errno()));
+        schedule_reconnect(h);
+        return;
+    }
 
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
@@ -96,136 +396,521 @@ static int connect_to_analyser(struct AnalyserListenerHandle *h) {
     addr.sin_port   = htons((unsigned short)h->port);
 
     if (inet_pton(AF_INET, h->ip, &addr.sin_addr) <= 0) {
-        fprintf(stderr, "[listener %s:%d] inet_pton failed\n", h->ip, h->port);
-#ifdef _WIN32
-        closesocket(sockfd);
-#else
-        close(sockfd);
-#endif
-        return -1;
+        log_msg(LOG_ERROR, "listener", "[listener %s:%d] inet_pton failed", h->ip, h->port);
+        close_socket(s);
+        schedule_reconnect(h);
+        return;
+    }
+    if (!set_nonblocking(s)) {
+        log_msg(LOG_ERROR, "listener", "[listener %s:%d] cannot make socket non-blocking", h->ip, h->port);
+        close_socket(s);
+        schedule_reconnect(h);
+        return;
     }
+    apply_liveness(&h->live, s);
 
-    fprintf(stderr, "[listener %s:%d] Connecting...\n", h->ip, h->port);
+    log_msg(LOG_INFO, "listener", "[listener %s:%d] Connecting...", h->ip, h->port);
 
-    if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-#ifdef _WIN32
-        fprintf(stderr, "[listener %s:%d] connect() failed: %d\n",
-                h->ip, h->port, WSAGetLastError());
-        closesocket(sockfd);
-#else
-        perror("[listener] connect");
-        close(sockfd);
-#endif
-        return -1;
+    h->sock = s;
+    h->connectStartUs = monotime_us();
+    int rc = connect(s, (struct sockaddr *)&addr, sizeof(addr));
+    int err = rc == 0 ? 0 : sock_errno();
+    if (rc != 0 && !would_block(err)) {
+        log_msg(LOG_ERROR, "listener", "[listener %s:%d] connect() failed: %s",
+                h->ip, h->port, sock_strerror(err));
+        drop_connection(h);
+        schedule_reconnect(h);
+        return;
     }
 
-    fprintf(stderr, "[listener %s:%d] Connected.\n", h->ip, h->port);
-    return sockfd;
+    h->io = ev_io_add(h->loop, s, rc == 0 ? 0 : EV_WRITE, on_io, h);
+    if (!h->io) {
+        drop_connection(h);
+        schedule_reconnect(h);
+        return;
+    }
+    if (rc == 0) {
+        on_connected(h);
+    } else {
+        set_state(h, LS_CONNECTING);
+        if (h->live.connectTimeoutMs > 0) ev_timer_start(h->watchdog, h->live.connectTimeoutMs, 0);
+    }
 }
 
-static void read_loop(struct AnalyserListenerHandle *h, int sockfd) {
-    FILE *fp = fopen(h->outPath, "ab");  // append binary
-    if (!fp) {
-        perror("[listener] fopen outPath");
+static void finish_connect(struct AnalyserListenerHandle *h) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(h->sock, SOL_SOCKET, SO_ERROR, (char *)&err, &len) != 0) err = sock_errno();
+    if (err != 0) {
+        log_msg(LOG_ERROR, "listener", "[listener %s:%d] connect() failed: %s",
+                h->ip, h->port, sock_strerror(err));
+        drop_connection(h);
+        schedule_reconnect(h);
         return;
     }
+    on_connected(h);
+}
 
-    fprintf(stderr, "[listener %s:%d] Writing to %s ...\n",
-            h->ip, h->port, h->outPath);
+static void pause_if_full(struct AnalyserListenerHandle *h) {
+    if (!h->capture || !capture_source_full(h->capture)) return;
+    // Stop reading until the sink catches up: the analyser sees TCP
+    // backpressure and the loop never blocks on the queue.
+    set_state(h, LS_PAUSED);
+    set_backoff(h, BACKOFF_MS);
+    ev_io_set(h->io, 0);
+    ev_timer_start(h->timer, BACKOFF_MS, 0);
+}
 
+// Returns 1 if data was read and stored, 0 if there was nothing to read,
+// -1 if the connection was dropped.
+static int read_some(struct AnalyserListenerHandle *h) {
     char buf[4096];
+    int err = 0;
 
-    while (h->running) {
-#ifdef _WIN32
-        int n = recv(sockfd, buf, sizeof(buf), 0);
-        if (n == SOCKET_ERROR) {
-            fprintf(stderr, "[listener %s:%d] recv() failed: %d\n",
-                    h->ip, h->port, WSAGetLastError());
-            break;
+    int n = recv_some(h->sock, buf, sizeof(buf), &err);
+    if (n < 0) {
+        if (would_block(err)) return 0;
+        if (timed_out(err)) {
+            note_dead(h, "Analyser", h->lastRxMs, "keepalive");
+        } else {
+            log_msg(LOG_ERROR, "listener", "[listener %s:%d] recv() failed: %s",
+                    h->ip, h->port, sock_strerror(err));
         }
-#else
-        ssize_t n = recv(sockfd, buf, sizeof(buf), 0);
-        if (n < 0) {
-            perror("[listener] recv");
-            break;
-        }
-#endif
-        if (n == 0) {
-            fprintf(stderr, "[listener %s:%d] Connection closed by remote.\n",
-                    h->ip, h->port);
-            break;
+        drop_connection(h);
+        schedule_reconnect(h);
+        return -1;
+    }
+    if (n == 0) {
+        log_msg(LOG_WARN, "listener", "[listener %s:%d] Connection closed by remote.",
+                h->ip, h->port);
+        drop_connection(h);
+        schedule_reconnect(h);
+        return -1;
+    }
+    h->lastRxMs = event_loop_now_ms(h->loop);
+    unsigned long long t0 = note_read(h, (size_t)n);
+
+    if (h->capture) {
+        if (!capture_publish(h->capture, buf, (size_t)n)) {
+            log_msg(LOG_WARN, "listener", "[listener %s:%d] capture queue lost %d bytes",
+                    h->ip, h->port, n);
         }
+        note_write(h, t0);
+        pause_if_full(h);
+        return n;
+    }
+
+    size_t written = fwrite(buf, 1, (size_t)n, h->fp);
+    if (written != (size_t)n) {
+        log_msg(LOG_ERROR, "listener", "❌ Cannot write capture: %s", strerror(errno));
+        drop_connection(h);
+        schedule_reconnect(h);
+        return -1;
+    }
+    note_write(h, t0);
+    t0 = monotime_us();
+    fflush(h->fp); // let other processes see data
+    note_flush(h, t0);
+    return n;
+}
+
+static void on_io(void *ctx, int revents) {
+    struct AnalyserListenerHandle *h = (struct AnalyserListenerHandle *)ctx;
+    (void)revents;   // errors surface through SO_ERROR / recv()
+
+    if (h->state == LS_CONNECTING) finish_connect(h);
+    else if (h->state == LS_CONNECTED) read_some(h);
+}
+
+static void on_timer(void *ctx) {
+    struct AnalyserListenerHandle *h = (struct AnalyserListenerHandle *)ctx;
 
-        size_t written = fwrite(buf, 1, (size_t)n, fp);
-        if (written != (size_t)n) {
-            perror("[listener] fwrite");
-            break;
+    if (h->state == LS_WAITING) {
+        start_connect(h);
+    } else if (h->state == LS_PAUSED) {
+        if (capture_source_full(h->capture)) {
+            ev_timer_start(h->timer, BACKOFF_MS, 0);
+        } else {
+            set_state(h, LS_CONNECTED);
+            set_backoff(h, 0);
+            ev_io_set(h->io, EV_READ);
+            h->lastRxMs = event_loop_now_ms(h->loop);   // the pause was ours
         }
+    }
+}
 
-        fflush(fp); // let other processes see data
+// Connect deadline, then the idle timeout. Reads only stamp lastRxMs; the
+// timer re-arms itself for the remainder.
+static void on_watchdog(void *ctx) {
+    struct AnalyserListenerHandle *h = (struct AnalyserListenerHandle *)ctx;
+
+    if (h->state == LS_CONNECTING) {
+        log_msg(LOG_WARN, "listener", "[listener %s:%d] connect() timed out after %d ms",
+                h->ip, h->port, h->live.connectTimeoutMs);
+        drop_connection(h);
+        schedule_reconnect(h);
+        return;
     }
+    if (h->state == LS_PAUSED) {
+        ev_timer_start(h->watchdog, h->live.idleTimeoutMs, 0);
+        return;
+    }
+    if (h->state != LS_CONNECTED) return;
 
-    fclose(fp);
-    fprintf(stderr, "[listener %s:%d] read_loop finished.\n", h->ip, h->port);
+    unsigned long long idle = event_loop_now_ms(h->loop) - h->lastRxMs;
+    if (idle < (unsigned long long)h->live.idleTimeoutMs) {
+        ev_timer_start(h->watchdog, (long)(h->live.idleTimeoutMs - idle), 0);
+        return;
+    }
+    note_dead(h, "Analyser", h->lastRxMs, "idle timeout");
+    drop_connection(h);
+    schedule_reconnect(h);
 }
 
 // ===============================================================
-//  Thread entry (per instance)
+//  Server mode: accept analysers that dial in
 // ===============================================================
 
-#ifdef _WIN32
-static unsigned __stdcall listener_thread(void *arg)
-#else
-static void *listener_thread(void *arg)
-#endif
-{
-    struct AnalyserListenerHandle *h = (struct AnalyserListenerHandle *)arg;
+static void close_peer(Peer *p) {
+    struct AnalyserListenerHandle *h = p->h;
+    if (p->prev) p->prev->next = p->next; else h->peers = p->next;
+    if (p->next) p->next->prev = p->prev;
+    set_peers(h, h->npeers - 1);
 
-    if (socket_init() != 0) {
-        fprintf(stderr, "[listener %s:%d] socket_init failed.\n",
-                h->ip, h->port);
-#ifdef _WIN32
+    ev_io_remove(p->io);
+    ev_timer_free(p->timer);
+    ev_timer_free(p->watchdog);
+    close_socket(p->sock);
+    if (p->fp) fclose(p->fp);
+    if (p->capture && h->onPeerQueue) h->onPeerQueue(h->peerCtx, p->capture, 0);
+    capture_source_retire(p->capture);
+    free(p);
+}
+
+static Peer *find_named(struct AnalyserListenerHandle *h, const Peer *self, const char *name) {
+    for (Peer *q = h->peers; q; q = q->next) {
+        if (q != self && q->state != PS_NAMING && strcmp(q->name, name) == 0) return q;
+    }
+    return NULL;
+}
+
+static void drop_peer(Peer *p);
+
+// Pick the peer's name and open its output. Returns 0 if it cannot be
+// captured (the caller drops the connection).
+static int name_peer(Peer *p, const char *name) {
+    struct AnalyserListenerHandle *h = p->h;
+
+    if (name) {
+        snprintf(p->name, sizeof(p->name), "%s", name);
+        Peer *stale = find_named(h, p, p->name);
+        if (stale) {
+            // A configured analyser only dials again once its old
+            // connection is gone (reboot, pulled cable), so that one is
+            // half-open: the new one takes over its name, and with it its
+            // file and identity.
+            log_msg(LOG_WARN, "listener", "[listener %s:%d] %s reconnected from %s:%d, closing its old connection (port %d)",
+                    h->ip, h->port, p->name, p->addr, p->port, stale->port);
+            drop_peer(stale);
+        }
+    } else {
+        // Unknown instrument: named after its address. Several can share
+        // one (a gateway, NAT, a second socket), so never take over a live
+        // connection; the later ones get "-2", "-3", ...
+        char base[sizeof(p->name)];
+        snprintf(base, sizeof(base), "%s", p->addr);
+        for (char *c = base; *c; c++) {
+            if (*c == '.' || *c == ':') *c = '-';
+        }
+        snprintf(p->name, sizeof(p->name), "%s", base);
+        for (int k = 2; find_named(h, p, p->name); k++) {
+            char suffix[12];
+            int n = snprintf(suffix, sizeof(suffix), "-%d", k);
+            snprintf(p->name, sizeof(p->name), "%.*s%s", (int)sizeof(p->name) - 1 - n, base, suffix);
+        }
+    }
+
+    char out[600];
+    size_t n = strlen(h->outPath);
+    if (n >= 4 && strcmp(h->outPath + n - 4, ".txt") == 0) n -= 4;
+    snprintf(out, sizeof(out), "%.*s_%s.txt", (int)n, h->outPath, p->name);
+
+    if (h->sink) {
+        char src[64];
+        snprintf(src, sizeof(src), "%s/%s", h->name, p->name);
+        p->capture = capture_sink_add(h->sink, src, out, SPSC_BLOCK, h->queue);
+        if (p->capture && h->onPeerQueue) h->onPeerQueue(h->peerCtx, p->capture, 1);
+    }
+    if (!p->capture) {
+        p->fp = fopen(out, "ab");
+        if (!p->fp) {
+            log_msg(LOG_ERROR, "listener", "❌ Cannot open %s: %s", out, strerror(errno));
+            return 0;
+        }
+    }
+
+    log_msg(LOG_INFO, "listener", "[listener %s:%d] Peer %s:%d is %s, writing to %s",
+            h->ip, h->port, p->addr, p->port, p->name, out);
+    p->state = PS_STREAMING;
+    ev_timer_stop(p->timer);
+    return 1;
+}
+
+static const char *match_signature(struct AnalyserListenerHandle *h, const Peer *p) {
+    for (int i = 0; i < h->nrules; i++) {
+        const char *sig = h->rules[i].signature;
+        size_t n = strlen(sig);
+        if (!n || n > p->nfirst) continue;
+        for (size_t k = 0; k + n <= p->nfirst; k++) {
+            if (memcmp(p->first + k, sig, n) == 0) return h->rules[i].name;
+        }
+    }
+    return NULL;
+}
+
+// Returns 0 if the peer had to be dropped.
+static int peer_write(Peer *p, const char *data, size_t len) {
+    if (len == 0) return 1;
+    unsigned long long t0 = monotime_us();
+    if (p->capture) {
+        if (!capture_publish(p->capture, data, len)) {
+            log_msg(LOG_WARN, "listener", "[listener %s:%d] capture queue of %s lost %zu bytes",
+                    p->h->ip, p->h->port, p->name, len);
+        }
+        note_write(p->h, t0);
+        if (capture_source_full(p->capture)) {
+            p->state = PS_PAUSED;
+            ev_io_set(p->io, 0);
+            ev_timer_start(p->timer, BACKOFF_MS, 0);
+        }
+        return 1;
+    }
+    if (fwrite(data, 1, len, p->fp) != len) {
+        log_msg(LOG_ERROR, "listener", "❌ Cannot write peer capture: %s", strerror(errno));
         return 0;
-#else
-        return NULL;
-#endif
     }
+    note_write(p->h, t0);
+    t0 = monotime_us();
+    fflush(p->fp);
+    note_flush(p->h, t0);
+    return 1;
+}
+
+// Stop naming: signature match, or the address once nothing arrives.
+static int finish_naming(Peer *p) {
+    if (!name_peer(p, match_signature(p->h, p))) return 0;
+    int ok = peer_write(p, p->first, p->nfirst);
+    p->nfirst = 0;
+    return ok;
+}
+
+// First bytes are held back until the peer is named, then everything is
+// streamed to its own output.
+static int peer_data(Peer *p, const char *buf, size_t n) {
+    if (p->state != PS_NAMING) return peer_write(p, buf, n);
 
-    while (h->running) {
-        int sockfd = connect_to_analyser(h);
-        if (sockfd < 0) {
-            // wait and retry
-            if (!h->running) break;
-            fprintf(stderr, "[listener %s:%d] Reconnect in 3s...\n",
-                    h->ip, h->port);
-            sleep_ms(3000);
-            continue;
+    size_t take = n < FIRST_MAX - p->nfirst ? n : FIRST_MAX - p->nfirst;
+    memcpy(p->first + p->nfirst, buf, take);
+    p->nfirst += take;
+
+    int complete = p->nfirst == FIRST_MAX ||
+                   memchr(p->first, '\n', p->nfirst) || memchr(p->first, '\r', p->nfirst);
+    if (!complete) return 1;
+    if (!finish_naming(p)) return 0;
+    return peer_write(p, buf + take, n - take);
+}
+
+// Returns bytes read, 0 if nothing was ready, -1 if the peer is gone
+// (and freed).
+static int peer_read(Peer *p) {
+    char buf[4096];
+    int err = 0;
+    int n = recv_some(p->sock, buf, sizeof(buf), &err);
+    if (n < 0 && would_block(err)) return 0;
+
+    if (n <= 0) {
+        if (n < 0 && timed_out(err)) {
+            note_dead(p->h, p->state == PS_NAMING ? p->addr : p->name, p->lastRxMs, "keepalive");
+        } else if (n < 0) {
+            log_msg(LOG_ERROR, "listener", "[listener %s:%d] recv() from %s failed: %s",
+                    p->h->ip, p->h->port, p->addr, sock_strerror(err));
+        } else {
+            log_msg(LOG_INFO, "listener", "[listener %s:%d] Peer %s (%s:%d) disconnected.",
+                    p->h->ip, p->h->port, p->state == PS_NAMING ? "?" : p->name, p->addr, p->port);
         }
+        if (p->state == PS_NAMING && p->nfirst > 0) finish_naming(p);   // keep what it sent
+        close_peer(p);
+        return -1;
+    }
+    p->lastRxMs = event_loop_now_ms(p->h->loop);
+    note_read(p->h, (size_t)n);
+    if (!peer_data(p, buf, (size_t)n)) {
+        close_peer(p);
+        return -1;
+    }
+    return n;
+}
 
-        read_loop(h, sockfd);
+static void on_peer_io(void *ctx, int revents) {
+    (void)revents;
+    peer_read((Peer *)ctx);
+}
 
-#ifdef _WIN32
-        closesocket(sockfd);
-#else
-        close(sockfd);
-#endif
+static void on_peer_timer(void *ctx) {
+    Peer *p = (Peer *)ctx;
+    if (p->state == PS_NAMING) {
+        if (!finish_naming(p)) close_peer(p);
+    } else if (p->state == PS_PAUSED) {
+        if (capture_source_full(p->capture)) {
+            ev_timer_start(p->timer, BACKOFF_MS, 0);
+        } else {
+            p->state = PS_STREAMING;
+            ev_io_set(p->io, EV_READ);
+            p->lastRxMs = event_loop_now_ms(p->h->loop);
+        }
+    }
+}
 
-        if (!h->running) break;
+// A peer that stays quiet past the idle timeout is closed; the analyser
+// dials again once it is back.
+static void on_peer_watchdog(void *ctx) {
+    Peer *p = (Peer *)ctx;
+    int limit = p->h->live.idleTimeoutMs;
+    unsigned long long idle = event_loop_now_ms(p->h->loop) - p->lastRxMs;
+    if (p->state == PS_PAUSED) {
+        ev_timer_start(p->watchdog, limit, 0);
+    } else if (idle < (unsigned long long)limit) {
+        ev_timer_start(p->watchdog, (long)(limit - idle), 0);
+    } else {
+        note_dead(p->h, p->state == PS_NAMING ? p->addr : p->name, p->lastRxMs, "idle timeout");
+        if (p->state == PS_NAMING && p->nfirst > 0) finish_naming(p);
+        close_peer(p);
+    }
+}
 
-        fprintf(stderr, "[listener %s:%d] Reconnect in 3s...\n",
-                h->ip, h->port);
-        sleep_ms(3000);
+static void add_peer(struct AnalyserListenerHandle *h, EvSocket s, const struct sockaddr_in *from) {
+    if (h->npeers >= h->maxPeers) {
+        log_msg(LOG_WARN, "listener", "[listener %s:%d] %d peers connected, refusing another.",
+                h->ip, h->port, h->npeers);
+        close_socket(s);
+        return;
     }
 
-    socket_cleanup();
+    Peer *p = (Peer *)calloc(1, sizeof(Peer));
+    if (!p || !set_nonblocking(s)) {
+        free(p);
+        close_socket(s);
+        return;
+    }
+    apply_liveness(&h->live, s);
+    p->h = h;
+    p->sock = s;
+    p->port = ntohs(from->sin_port);
+    inet_ntop(AF_INET, &from->sin_addr, p->addr, sizeof(p->addr));
+    p->io = ev_io_add(h->loop, s, EV_READ, on_peer_io, p);
+    p->timer = ev_timer_new(h->loop, on_peer_timer, p);
+    p->watchdog = ev_timer_new(h->loop, on_peer_watchdog, p);
+    p->lastRxMs = event_loop_now_ms(h->loop);
+    p->next = h->peers;
+    if (h->peers) h->peers->prev = p;
+    h->peers = p;
+    set_peers(h, h->npeers + 1);
+    stat_add(&h->stats.connects, 1);
+    if (!p->io || !p->timer || !p->watchdog) {
+        close_peer(p);
+        return;
+    }
+    if (h->live.idleTimeoutMs > 0) ev_timer_start(p->watchdog, h->live.idleTimeoutMs, 0);
 
-    fprintf(stderr, "[listener %s:%d] Thread exiting.\n", h->ip, h->port);
+    log_msg(LOG_INFO, "listener", "[listener %s:%d] Peer %s:%d connected.", h->ip, h->port, p->addr, p->port);
 
-#ifdef _WIN32
-    return 0;
-#else
-    return NULL;
-#endif
+    for (int i = 0; i < h->nrules; i++) {
+        if (h->rules[i].address[0] && strcmp(h->rules[i].address, p->addr) == 0) {
+            if (!name_peer(p, h->rules[i].name)) close_peer(p);
+            return;
+        }
+    }
+    ev_timer_start(p->timer, CLASSIFY_MS, 0);
+}
+
+static void on_accept(void *ctx, int revents) {
+    struct AnalyserListenerHandle *h = (struct AnalyserListenerHandle *)ctx;
+    (void)revents;
+
+    for (;;) {
+        struct sockaddr_in from;
+        socklen_t len = sizeof(from);
+        EvSocket s = (EvSocket)accept(h->sock, (struct sockaddr *)&from, &len);
+        if (s == BAD_SOCKET) {
+            int err = sock_errno();
+            if (!would_block(err)) {
+                log_msg(LOG_ERROR, "listener", "[listener %s:%d] accept() failed: %s",
+                        h->ip, h->port, sock_strerror(err));
+            }
+            return;
+        }
+        add_peer(h, s, &from);
+    }
+}
+
+static int start_server(struct AnalyserListenerHandle *h) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons((unsigned short)h->port);
+    if (inet_pton(AF_INET, h->ip, &addr.sin_addr) <= 0) {
+        log_msg(LOG_ERROR, "listener", "[listener %s:%d] inet_pton failed", h->ip, h->port);
+        return 0;
+    }
+
+    EvSocket s = (EvSocket)socket(AF_INET, SOCK_STREAM, 0);
+    if (s == BAD_SOCKET) {
+        log_msg(LOG_ERROR, "listener", "[listener %s:%d] socket() failed: %s",
+                h->ip, h->port, sock_strerror(sock_errno()));
+        return 0;
+    }
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *)&one, sizeof(one));
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s, 16) != 0 ||
+        !set_nonblocking(s)) {
+        log_msg(LOG_ERROR, "listener", "[listener %s:%d] cannot listen: %s",
+                h->ip, h->port, sock_strerror(sock_errno()));
+        close_socket(s);
+        return 0;
+    }
+
+    h->sock = s;
+    h->io = ev_io_add(h->loop, s, EV_READ, on_accept, h);
+    if (!h->io) {
+        close_socket(s);
+        h->sock = BAD_SOCKET;
+        return 0;
+    }
+    atomic_store(&h->stats.state, ANALYSER_LINK_LISTENING);
+    log_msg(LOG_INFO, "listener", "[listener %s:%d] Accepting analysers (at most %d), output: %s",
+            h->ip, h->port, h->maxPeers, h->outPath);
+    return 1;
+}
+
+// Close a peer, keeping what it has already sent, as in client mode.
+static void drop_peer(Peer *p) {
+    size_t drained = 0;
+    int n = 1;
+    while (drained < DRAIN_MAX && (n = peer_read(p)) > 0) {
+        drained += (size_t)n;
+        if (p->state == PS_PAUSED) p->state = PS_STREAMING;
+    }
+    if (n < 0) return;   // gone, and freed
+    if (p->state == PS_NAMING && p->nfirst > 0) finish_naming(p);
+    close_peer(p);
+}
+
+static void stop_server(struct AnalyserListenerHandle *h) {
+    while (h->peers) drop_peer(h->peers);
+    ev_io_remove(h->io);
+    h->io = NULL;
+    if (h->sock != BAD_SOCKET) close_socket(h->sock);
+    h->sock = BAD_SOCKET;
 }
 
 // ===============================================================
@@ -233,19 +918,21 @@ static void *listener_thread(void *arg)
 // ===============================================================
 
 AnalyserListenerHandle *start_analyser_listener(const AnalyserListenerConfig *cfg) {
-    if (!cfg || !cfg->ip || !cfg->outPath || cfg->port <= 0) {
-        fprintf(stderr, "[listener] Invalid config.\n");
+    if (!cfg || !cfg->loop || !cfg->ip || !cfg->outPath || cfg->port <= 0) {
+        log_msg(LOG_ERROR, "listener", "❌ Invalid listener config.");
         return NULL;
     }
 
     struct AnalyserListenerHandle *h =
         (struct AnalyserListenerHandle *)calloc(1, sizeof(*h));
     if (!h) {
-        perror("[listener] calloc");
+        log_msg(LOG_ERROR, "listener", "❌ Listener: out of memory");
         return NULL;
     }
 
-    h->running = 1;
+    h->loop = cfg->loop;
+    h->sock = BAD_SOCKET;
+    h->startedMs = monotime_us() / 1000;
 
     strncpy(h->ip, cfg->ip, sizeof(h->ip) - 1);
     h->ip[sizeof(h->ip) - 1] = '\0';
@@ -255,54 +942,129 @@ AnalyserListenerHandle *start_analyser_listener(const AnalyserListenerConfig *cf
     strncpy(h->outPath, cfg->outPath, sizeof(h->outPath) - 1);
     h->outPath[sizeof(h->outPath) - 1] = '\0';
 
-#ifdef _WIN32
-    uintptr_t handle = _beginthreadex(
-        NULL,
-        0,
-        listener_thread,
-        h,
-        0,
-        NULL
-    );
-    if (handle == 0) {
-        fprintf(stderr, "[listener %s:%d] _beginthreadex failed.\n",
-                h->ip, h->port);
-        free(h);
-        return NULL;
+    h->capture = cfg->capture;
+    h->live = cfg->liveness;
+
+    if (cfg->server) {
+        h->server   = 1;
+        h->sink     = cfg->sink;
+        h->queue    = cfg->queue ? cfg->queue : 256;
+        h->onPeerQueue = cfg->onPeerQueue;
+        h->peerCtx  = cfg->peerCtx;
+        h->maxPeers = cfg->maxPeers > 0 ? cfg->maxPeers : 16;
+        snprintf(h->name, sizeof(h->name), "%s", cfg->name ? cfg->name : "listener");
+        for (int i = 0; i < cfg->npeers && h->nrules < MAX_RULES; i++) {
+            PeerRule *r = &h->rules[h->nrules++];
+            snprintf(r->name, sizeof(r->name), "%s", cfg->peers[i].name);
+            snprintf(r->address, sizeof(r->address), "%s", cfg->peers[i].address ? cfg->peers[i].address : "");
+            snprintf(r->signature, sizeof(r->signature), "%s", cfg->peers[i].signature ? cfg->peers[i].signature : "");
+        }
+        if (!start_server(h)) {
+            free(h);
+            return NULL;
+        }
+        return h;
     }
-    h->thread = (HANDLE)handle;
-#else
-    int err = pthread_create(&h->thread, NULL, listener_thread, h);
-    if (err != 0) {
-        fprintf(stderr, "[listener %s:%d] pthread_create failed: %s\n",
-                h->ip, h->port, strerror(err));
+
+    h->timer = ev_timer_new(h->loop, on_timer, h);
+    h->watchdog = ev_timer_new(h->loop, on_watchdog, h);
+    if (!h->timer || !h->watchdog) {
+        log_msg(LOG_ERROR, "listener", "[listener %s:%d] cannot create timer.", h->ip, h->port);
+        ev_timer_free(h->timer);
+        ev_timer_free(h->watchdog);
         free(h);
         return NULL;
     }
-    // We keep the thread joinable so we can wait on stop()
-#endif
 
-    fprintf(stderr, "[listener %s:%d] Started, output: %s\n",
+    log_msg(LOG_INFO, "listener", "[listener %s:%d] Started, output: %s",
             h->ip, h->port, h->outPath);
 
+    start_connect(h);
     return h;
 }
 
+static void report_stats(const struct AnalyserListenerHandle *h) {
+    AnalyserListenerStats st;
+    get_analyser_listener_stats(h, &st);
+    unsigned long long avg = st.writes ? st.writeUs / st.writes : 0;
+    if (h->server) {
+        log_msg(LOG_INFO, "listener", "[listener %s:%d] %llu bytes in %llu reads from %llu peer(s), hand-off avg %llu us max %llu us",
+                h->ip, h->port, st.bytes, st.reads, st.connects, avg, st.writeMaxUs);
+    } else {
+        log_msg(LOG_INFO, "listener", "[listener %s:%d] %llu bytes in %llu reads, %llu connection(s), %llu reconnect(s), "
+                                      "connect max %.1f ms, hand-off avg %llu us max %llu us",
+                h->ip, h->port, st.bytes, st.reads, st.connects, st.reconnects, st.connectMaxUs / 1000.0,
+                avg, st.writeMaxUs);
+    }
+    if (st.deadPeers > 0) {
+        log_msg(LOG_INFO, "listener", "[listener %s:%d] %llu dead connection(s) detected, last after %.1f s, worst %.1f s",
+                h->ip, h->port, st.deadPeers, st.lastDetectMs / 1000.0, st.maxDetectMs / 1000.0);
+    }
+}
+
+int get_analyser_listener_stats(const AnalyserListenerHandle *handle, AnalyserListenerStats *out) {
+    if (!handle || !out) return 0;
+    const ListenerStats *st = &handle->stats;
+    memset(out, 0, sizeof(*out));
+
+    out->state          = (AnalyserLinkState)atomic_load_explicit((atomic_int *)&st->state, memory_order_relaxed);
+    out->peers          = atomic_load_explicit((atomic_int *)&st->peers, memory_order_relaxed);
+    out->backoffMs      = atomic_load_explicit((atomic_long *)&st->backoffMs, memory_order_relaxed);
+    out->bytes          = stat_get(&st->bytes);
+    out->reads          = stat_get(&st->reads);
+    out->connects       = stat_get(&st->connects);
+    out->reconnects     = stat_get(&st->reconnects);
+    out->connectUs      = stat_get(&st->connectUs);
+    out->connectMaxUs   = stat_get(&st->connectMaxUs);
+    out->lastActivityMs = stat_get(&st->lastActivityMs);
+    out->writes         = stat_get(&st->writes);
+    out->writeUs        = stat_get(&st->writeUs);
+    out->writeLastUs    = stat_get(&st->writeLastUs);
+    out->writeMaxUs     = stat_get(&st->writeMaxUs);
+    out->flushes        = stat_get(&st->flushes);
+    out->flushUs        = stat_get(&st->flushUs);
+    out->flushLastUs    = stat_get(&st->flushLastUs);
+    out->flushMaxUs     = stat_get(&st->flushMaxUs);
+    out->deadPeers      = stat_get(&st->deadPeers);
+    out->lastDetectMs   = stat_get(&st->lastDetectMs);
+    out->maxDetectMs    = stat_get(&st->maxDetectMs);
+
+    unsigned long long now = monotime_us() / 1000;
+    unsigned long long since = out->lastActivityMs ? out->lastActivityMs : handle->startedMs;
+    out->idleMs = now > since ? now - since : 0;
+    return 1;
+}
+
 void stop_analyser_listener(AnalyserListenerHandle *h) {
     if (!h) return;
 
-    h->running = 0;
+    if (h->server) {
+        stop_server(h);
+        report_stats(h);
+        log_msg(LOG_INFO, "listener", "[listener %s:%d] Stopped.", h->ip, h->port);
+        free(h);
+        return;
+    }
 
-#ifdef _WIN32
-    if (h->thread) {
-        WaitForSingleObject(h->thread, 3000);
-        CloseHandle(h->thread);
-        h->thread = NULL;
+    // Keep what the analyser has already sent: closing with unread data
+    // resets the connection and the bytes are gone. capture_publish() may
+    // wait for the sink here, so a paused listener drains too.
+    size_t drained = 0;
+    while ((h->state == LS_CONNECTED || h->state == LS_PAUSED) && drained < DRAIN_MAX) {
+        set_state(h, LS_CONNECTED);
+        int n = read_some(h);
+        if (n <= 0) break;
+        drained += (size_t)n;
     }
-#else
-    // Wait for thread to exit
-    pthread_join(h->thread, NULL);
-#endif
+    if (drained > 0) {
+        log_msg(LOG_INFO, "listener", "[listener %s:%d] Drained %zu bytes at stop.", h->ip, h->port, drained);
+    }
+
+    drop_connection(h);
+    ev_timer_free(h->timer);
+    ev_timer_free(h->watchdog);
+    report_stats(h);
 
+    log_msg(LOG_INFO, "listener", "[listener %s:%d] Stopped.", h->ip, h->port);
     free(h);
 }
@@ -1,21 +1,129 @@
 #ifndef ANALYSER_LISTENER_H
 #define ANALYSER_LISTENER_H
 
+#include "event_loop.h"
+
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct CaptureSource;
+struct CaptureSink;
+
+/**
+ * Server mode: how an analyser that dialled in is named. 'address' is
+ * matched against the peer's IP when it connects; otherwise 'signature'
+ * is looked for in its first message (up to the first line break, at
+ * most 512 bytes, or whatever arrived within 2 s). Exactly one of the two
+ * is set. A peer named by a rule replaces one of that name still
+ * connected: the older connection is read out and closed. Peers matching
+ * no rule are named after their address, with "-2", "-3", ... for further
+ * connections from the same address; they never replace anyone.
+ */
 typedef struct {
-    const char *ip;       // e.g. "192.168.0.173"
+    const char *name;       // e.g. "f200"
+    const char *address;    // e.g. "192.168.0.50"
+    const char *signature;  // e.g. "H|\\^&|||H360"
+} AnalyserPeerRule;
+
+/**
+ * Server mode: a peer's capture queue was added (on naming) or is about to
+ * be retired (on close). Called on the loop thread.
+ */
+typedef void (*AnalyserPeerQueueFn)(void *ctx, struct CaptureSource *queue, int added);
+
+/**
+ * Dead-peer detection. A pulled cable or a crashed analyser leaves a
+ * half-open connection that never reads EOF; these bound how long it goes
+ * unnoticed. Zero keeps the system default (or disables the check).
+ */
+typedef struct {
+    int keepalive;        // SO_KEEPALIVE
+    int keepIdleS;        // TCP_KEEPIDLE: quiet seconds before the first probe
+    int keepIntervalS;    // TCP_KEEPINTVL: seconds between probes
+    int keepCount;        // TCP_KEEPCNT: unanswered probes before the reset
+    int userTimeoutMs;    // TCP_USER_TIMEOUT: unacknowledged data (Linux)
+    int idleTimeoutMs;    // no data at all for this long: reconnect
+    int connectTimeoutMs; // client: give up a connect() after this long
+} AnalyserLiveness;
+
+typedef struct {
+    EventLoop  *loop;     // the listener runs as handlers on this loop
+    const char *ip;       // e.g. "192.168.0.173"; server: bind address ("0.0.0.0" = any)
     int         port;     // e.g. 50001
     const char *outPath;  // e.g. "c:\\ss\\out_f200.txt"
+
+    // Optional: publish received bytes to this capture-sink queue (which
+    // writes outPath) instead of writing outPath from the loop thread.
+    // Reading pauses while the queue is full.
+    struct CaptureSource *capture;
+
+    // Server (LIS-host) mode: listen on ip:port and accept analysers that
+    // connect to us. Every peer has its own read and framing state and is
+    // captured to '<outPath without .txt>_<peer name>.txt', through its own
+    // queue on 'sink' when one is given ('capture' is unused).
+    int                      server;
+    int                      maxPeers;    // concurrent peers (<= 0 = 16)
+    const AnalyserPeerRule  *peers;       // copied at start
+    int                      npeers;
+    struct CaptureSink      *sink;
+    size_t                   queue;       // per-peer queue capacity (0 = 256)
+    const char              *name;        // capture source prefix, may be NULL
+    AnalyserPeerQueueFn      onPeerQueue; // may be NULL
+    void                    *peerCtx;
+
+    // A dead connection is dropped and (client mode) redialled; the time
+    // from its last data to the verdict is logged and kept in the stats.
+    AnalyserLiveness         liveness;
 } AnalyserListenerConfig;
 
 // Opaque handle type for a single listener instance
 typedef struct AnalyserListenerHandle AnalyserListenerHandle;
 
+typedef enum {
+    ANALYSER_LINK_WAITING = 0,  // reconnect timer armed
+    ANALYSER_LINK_CONNECTING,
+    ANALYSER_LINK_CONNECTED,
+    ANALYSER_LINK_PAUSED,       // connected, reading paused: capture queue full
+    ANALYSER_LINK_LISTENING     // server mode
+} AnalyserLinkState;
+
 /**
- * Start a new background listener instance for one analyser.
+ * Snapshot of one listener. Server mode sums over its peers. Times are
+ * CLOCK_MONOTONIC (QueryPerformanceCounter on Windows); latencies are the
+ * last and the worst seen, totals give the average.
+ */
+typedef struct {
+    AnalyserLinkState state;
+    int                peers;            // server: analysers connected now
+
+    unsigned long long bytes;            // received and stored
+    unsigned long long reads;            // recv() calls that returned data
+    unsigned long long connects;         // connections made (server: accepted)
+    unsigned long long reconnects;       // reconnects scheduled after a failure or drop
+    unsigned long long connectUs, connectMaxUs;   // connect() until writable
+
+    unsigned long long lastActivityMs;   // last data, 0 = none yet
+    unsigned long long idleMs;           // since the last data (or the start)
+
+    // One read handed on: capture_publish() or fwrite(); fflush() in
+    // direct-write mode only (the capture sink flushes otherwise).
+    unsigned long long writes, writeUs, writeLastUs, writeMaxUs;
+    unsigned long long flushes, flushUs, flushLastUs, flushMaxUs;
+
+    long               backoffMs;        // before the next attempt / queue re-check, 0 = none
+
+    unsigned long long deadPeers;        // dead connections detected
+    unsigned long long lastDetectMs, maxDetectMs;   // last data -> verdict
+} AnalyserListenerStats;
+
+/**
+ * Start a listener instance for one analyser: connects (and reconnects
+ * every 3 s after a failure) without blocking the loop. In server mode it
+ * binds and accepts instead. Call on the loop thread, or before the loop
+ * runs.
  *
  * Returns:
  *   - non-NULL pointer on success
@@ -24,11 +132,20 @@ typedef struct AnalyserListenerHandle AnalyserListenerHandle;
 AnalyserListenerHandle *start_analyser_listener(const AnalyserListenerConfig *cfg);
 
 /**
- * Stop a listener instance and free its resources.
+ * Close the connection (server mode: every peer and the listening socket)
+ * and free the instance (loop thread, or after the loop has stopped).
  * Safe to call with NULL (no-op).
  */
 void stop_analyser_listener(AnalyserListenerHandle *handle);
 
+/**
+ * Fill 'out' from any thread without locking: every counter is an atomic
+ * the loop thread updates as it goes, so polling many listeners costs a
+ * few loads each. Fields are read one by one and may be a read apart.
+ * 'handle' must not be stopped concurrently. Returns 0 for NULL arguments.
+ */
+int get_analyser_listener_stats(const AnalyserListenerHandle *handle, AnalyserListenerStats *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,422 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "archive.h"
+#include "logger.h"
+#include "spsc_queue.h"   // Doorbell
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <process.h>
+    #include <direct.h>
+#else
+    #include <pthread.h>
+    #include <sys/stat.h>
+#endif
+
+#define ARCHIVE_PATH_MAX      512
+#define ARCHIVE_QUEUE_MAX     4096              // results waiting for the writer
+#define ARCHIVE_COMPACT_EVERY (3600 * 1000ull)  // ms between compaction checks
+
+// Index entry fields the producer fills in (see archive.h).
+enum { E_TIME = 0, E_SAMPLE = 8, E_MACHINE = 16, E_KEY = 24, E_TESTS = 32,
+       E_OFFSET = 40, E_STORED = 48, E_LENGTH = 52, E_KIND = 56, E_CRC = 60 };
+
+typedef struct Item {
+    struct Item  *next;
+    unsigned char entry[ARCHIVE_INDEX_ENTRY];   // all but offset and stored
+    uint32_t      len;
+    unsigned char data[1];
+} Item;
+
+// Queue, under g_lock.
+#ifdef _WIN32
+static SRWLOCK g_lock = SRWLOCK_INIT;
+#define QUEUE_LOCK()   AcquireSRWLockExclusive(&g_lock)
+#define QUEUE_UNLOCK() ReleaseSRWLockExclusive(&g_lock)
+#else
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+#define QUEUE_LOCK()   pthread_mutex_lock(&g_lock)
+#define QUEUE_UNLOCK() pthread_mutex_unlock(&g_lock)
+#endif
+static Item *g_head, *g_tail;
+static int   g_queued;
+
+static atomic_int    g_enabled;
+static atomic_int    g_running;
+static atomic_ullong g_dropped;
+static Doorbell     *g_bell;
+
+#ifdef _WIN32
+static HANDLE    g_thread;
+#else
+static pthread_t g_thread;
+#endif
+
+// Writer state: set up by archive_open(), then the writer thread's.
+static char     g_dir[ARCHIVE_PATH_MAX];
+static uint64_t g_segMax;
+static int      g_compactDays;
+static unsigned g_seg;
+static FILE    *g_data, *g_index;       // NULL = start a segment on the next write
+static uint64_t g_dataLen;
+static int      g_writeFailed;
+static unsigned long long g_lastCompact;
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+// ===============================================================
+//  Test codes
+// ===============================================================
+
+// Append 'v' to the ',' list in 'buf'; 0 when it does not fit.
+static int add_test(char *buf, size_t cap, size_t *len, const char *v) {
+    if (!v || !*v) return 1;
+    size_t n = 0;
+    for (const char *p = v; *p; p++) n += (*p != ',');
+    if (*len + (*len ? 1 : 0) + n + 1 > cap) return 0;
+    if (*len) buf[(*len)++] = ',';
+    for (const char *p = v; *p; p++) {
+        if (*p != ',') buf[(*len)++] = *p;
+    }
+    buf[*len] = '\0';
+    return 1;
+}
+
+void archive_tests(const AnalyserRecord *rec, char *buf, size_t cap) {
+    size_t len = 0;
+    if (cap) buf[0] = '\0';
+    for (int i = 0; i < rec->nitems; i++) {
+        const RecordItem *it = &rec->items[i];
+        int coded = 0;
+        for (int k = 0; k < it->nfields; k++) {
+            const RecordField *f = &rec->fields[it->firstField + k];
+            if (!strcmp(f->key, "test_code") || !strcmp(f->key, "name") || !strcmp(f->key, "test_name")) {
+                coded |= !strcmp(f->key, "test_code");
+                if (!add_test(buf, cap, &len, f->value)) return;
+            }
+        }
+        if (coded) continue;
+        for (int k = 0; k < it->nfields; k++) {
+            const RecordField *f = &rec->fields[it->firstField + k];
+            if (f->result >= 0 && !add_test(buf, cap, &len, f->key)) return;
+        }
+    }
+}
+
+// ===============================================================
+//  Writer thread
+// ===============================================================
+
+static void make_dir(const char *dir) {
+#ifdef _WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0755);
+#endif
+}
+
+static void close_segment(void) {
+    if (g_data) fclose(g_data);
+    if (g_index) fclose(g_index);
+    g_data = g_index = NULL;
+}
+
+static long file_size(FILE *f) {
+    if (fseek(f, 0, SEEK_END) != 0) return -1;
+    return ftell(f);
+}
+
+// Carry on appending to segment 'seg' if it is still open for that: not
+// sealed, not compacted, and its index ends on a whole entry.
+static int resume_segment(unsigned seg) {
+    char path[ARCHIVE_PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/%08u.cbs", g_dir, seg);
+    FILE *f = fopen(path, "rb");
+    if (f) {
+        fclose(f);
+        return 0;
+    }
+
+    snprintf(path, sizeof(path), "%s/%08u.cbi", g_dir, seg);
+    f = fopen(path, "rb");
+    if (!f) return 0;
+    unsigned char h[ARCHIVE_INDEX_HEADER];
+    long size = file_size(f);
+    int whole = size >= ARCHIVE_INDEX_HEADER && (size - ARCHIVE_INDEX_HEADER) % ARCHIVE_INDEX_ENTRY == 0 &&
+                fseek(f, 0, SEEK_SET) == 0 && fread(h, sizeof(h), 1, f) == 1 &&
+                memcmp(h, ARCHIVE_INDEX_MAGIC, 8) == 0 && h[12] == 0;
+    fclose(f);
+    if (!whole) {
+        // Cut short by a crash: keep what it has and start the next one.
+        archive_seal(g_dir, seg);
+        return 0;
+    }
+
+    g_index = fopen(path, "ab");
+    snprintf(path, sizeof(path), "%s/%08u.cbd", g_dir, seg);
+    g_data = fopen(path, "ab");
+    long len = g_data ? file_size(g_data) : -1;
+    if (!g_index || len < 8) {
+        close_segment();
+        return 0;
+    }
+    g_dataLen = (uint64_t)len;   // a record written without its entry is left unreferenced
+    return 1;
+}
+
+static int new_segment(unsigned seg) {
+    char path[ARCHIVE_PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/%08u.cbd", g_dir, seg);
+    g_data = fopen(path, "wb");
+    snprintf(path, sizeof(path), "%s/%08u.cbi", g_dir, seg);
+    g_index = fopen(path, "wb");
+
+    unsigned char h[ARCHIVE_INDEX_HEADER] = {0};
+    memcpy(h, ARCHIVE_INDEX_MAGIC, 8);
+    put_u32(h + 8, ARCHIVE_INDEX_ENTRY);
+    if (!g_data || !g_index || fwrite(ARCHIVE_DATA_MAGIC, 8, 1, g_data) != 1 || fwrite(h, sizeof(h), 1, g_index) != 1 ||
+        fflush(g_data) != 0 || fflush(g_index) != 0) {
+        close_segment();
+        return 0;
+    }
+    g_dataLen = 8;
+    return 1;
+}
+
+// The segment the next record goes to: the newest one if it is still open,
+// else a new one after it.
+static int open_segment(void) {
+    long last = archive_last_segment(g_dir);
+    if (last >= 0 && resume_segment((unsigned)last)) {
+        g_seg = (unsigned)last;
+        return 1;
+    }
+    g_seg = last >= 0 ? (unsigned)last + 1 : 1;
+    return new_segment(g_seg);
+}
+
+static void seal_segment(void) {
+    close_segment();
+    if (archive_seal(g_dir, g_seg)) {
+        log_msg(LOG_INFO, "archive", "🗄️  Archive segment %08u sealed (%llu bytes)", g_seg,
+                (unsigned long long)g_dataLen);
+    } else {
+        log_msg(LOG_WARN, "archive", "⚠️  Cannot seal archive segment %08u; lookups in it scan the index", g_seg);
+    }
+    new_segment(++g_seg);   // on failure the next write tries again
+}
+
+static void write_item(Item *it) {
+    if (!g_data && !open_segment()) {
+        if (!g_writeFailed) log_msg(LOG_ERROR, "archive", "❌ Cannot create an archive segment in %s", g_dir);
+        g_writeFailed = 1;
+        return;
+    }
+    put_u64(it->entry + E_OFFSET, g_dataLen);
+    put_u32(it->entry + E_STORED, it->len);
+    // Data before its entry: a crash in between leaves unreferenced bytes,
+    // never an entry pointing at nothing.
+    if (fwrite(it->data, 1, it->len, g_data) != it->len || fflush(g_data) != 0 ||
+        fwrite(it->entry, sizeof(it->entry), 1, g_index) != 1) {
+        if (!g_writeFailed) log_msg(LOG_ERROR, "archive", "❌ Cannot write archive segment %08u", g_seg);
+        g_writeFailed = 1;
+        close_segment();   // reopened (or a new one started) on the next write
+        return;
+    }
+    g_writeFailed = 0;
+    g_dataLen += it->len;
+    if (g_dataLen >= g_segMax) {
+        fflush(g_index);
+        seal_segment();
+    }
+}
+
+static void compact_due(void) {
+    if (g_compactDays <= 0) return;
+    unsigned long long now = archive_now_ms();
+    if (now - g_lastCompact < ARCHIVE_COMPACT_EVERY) return;
+    g_lastCompact = now;
+
+    char err[256] = "";
+    int n = archive_compact(g_dir, now - (unsigned long long)g_compactDays * 86400000ull, err, sizeof(err));
+    if (n > 0) log_msg(LOG_INFO, "archive", "🗜️  Compacted %d archive segment(s)", n);
+    if (n < 0) log_msg(LOG_WARN, "archive", "⚠️  Archive compaction stopped: %s", err);
+}
+
+static void drain(void) {
+    QUEUE_LOCK();
+    Item *it = g_head;
+    g_head = g_tail = NULL;
+    g_queued = 0;
+    QUEUE_UNLOCK();
+
+    while (it) {
+        Item *next = it->next;
+        write_item(it);
+        free(it);
+        it = next;
+    }
+    if (g_index) fflush(g_index);
+
+    unsigned long long lost = atomic_exchange(&g_dropped, 0);
+    if (lost) log_msg(LOG_WARN, "archive", "⚠️  %llu result(s) not archived: the archive could not keep up", lost);
+}
+
+#ifdef _WIN32
+static unsigned __stdcall writer_thread(void *arg)
+#else
+static void *writer_thread(void *arg)
+#endif
+{
+    (void)arg;
+    while (atomic_load(&g_running)) {
+        doorbell_wait(g_bell, 60000);
+        drain();
+        compact_due();
+    }
+    drain();
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+// ===============================================================
+//  Public API
+// ===============================================================
+
+int archive_enabled(void) {
+    return atomic_load_explicit(&g_enabled, memory_order_relaxed);
+}
+
+void archive_close(void) {
+    // Under the queue lock: no archive_append() is left holding the bell.
+    QUEUE_LOCK();
+    int was = atomic_exchange(&g_enabled, 0);
+    QUEUE_UNLOCK();
+    if (!was) return;
+    atomic_store(&g_running, 0);
+    doorbell_ring(g_bell);
+#ifdef _WIN32
+    WaitForSingleObject(g_thread, INFINITE);
+    CloseHandle(g_thread);
+#else
+    pthread_join(g_thread, NULL);
+#endif
+    drain();   // anything appended while the writer was finishing
+    close_segment();
+    doorbell_destroy(g_bell);
+    g_bell = NULL;
+}
+
+int archive_open(const char *dir, int segmentMb, int compactDays) {
+    archive_close();
+    if (!dir || !dir[0]) return 1;
+
+    snprintf(g_dir, sizeof(g_dir), "%s", dir);
+    g_segMax = (uint64_t)(segmentMb > 0 ? segmentMb : 64) * 1024 * 1024;
+    g_compactDays = compactDays;
+    g_lastCompact = 0;
+    g_writeFailed = 0;
+    make_dir(g_dir);
+    if (!open_segment()) return 0;   // not writable: say so now, not per result
+
+    g_bell = doorbell_create();
+    if (!g_bell) {
+        close_segment();
+        return 0;
+    }
+    atomic_store(&g_running, 1);
+#ifdef _WIN32
+    uintptr_t h = _beginthreadex(NULL, 0, writer_thread, NULL, 0, NULL);
+    if (h == 0) {
+#else
+    if (pthread_create(&g_thread, NULL, writer_thread, NULL) != 0) {
+#endif
+        atomic_store(&g_running, 0);
+        close_segment();
+        doorbell_destroy(g_bell);
+        g_bell = NULL;
+        return 0;
+    }
+#ifdef _WIN32
+    g_thread = (HANDLE)h;
+#endif
+    atomic_store(&g_enabled, 1);
+    return 1;
+}
+
+void archive_append(const ArchiveRecord *rec) {
+    if (!archive_enabled()) return;
+
+    const char *str[5] = { rec->sampleId, rec->machineId, rec->mac, rec->contentType, rec->tests };
+    size_t slen[5], total = rec->bodyLen;
+    for (int i = 0; i < 5; i++) {
+        if (!str[i]) str[i] = "";
+        slen[i] = strlen(str[i]) + 1;
+        total += slen[i];
+    }
+    if (total > 0xFFFFFFFFu) return;
+
+    Item *it = (Item *)malloc(sizeof(Item) + total);
+    if (!it) {
+        atomic_fetch_add(&g_dropped, 1);
+        return;
+    }
+    it->next = NULL;
+    it->len = (uint32_t)total;
+    unsigned char *p = it->data;
+    for (int i = 0; i < 5; i++) {
+        memcpy(p, str[i], slen[i]);
+        p += slen[i];
+    }
+    if (rec->bodyLen) memcpy(p, rec->body, rec->bodyLen);
+
+    uint64_t tests = 0;
+    for (const char *t = str[4]; *t;) {
+        const char *end = strchr(t, ',');
+        size_t n = end ? (size_t)(end - t) : strlen(t);
+        if (n) tests |= archive_test_bit(t, n);
+        if (!end) break;
+        t = end + 1;
+    }
+
+    memset(it->entry, 0, sizeof(it->entry));
+    put_u64(it->entry + E_TIME, rec->timeMs ? rec->timeMs : archive_now_ms());
+    put_u64(it->entry + E_SAMPLE, str[0][0] ? archive_hash(str[0]) : 0);
+    put_u64(it->entry + E_MACHINE, archive_hash(str[1]));
+    put_u64(it->entry + E_KEY, rec->key);
+    put_u64(it->entry + E_TESTS, tests);
+    put_u32(it->entry + E_LENGTH, it->len);
+    it->entry[E_KIND] = (unsigned char)rec->kind;
+    put_u32(it->entry + E_CRC, (uint32_t)crc32(0L, it->data, it->len));
+
+    QUEUE_LOCK();
+    int queued = archive_enabled() && g_queued < ARCHIVE_QUEUE_MAX;
+    if (queued) {
+        if (g_tail) g_tail->next = it;
+        else g_head = it;
+        g_tail = it;
+        g_queued++;
+        doorbell_ring(g_bell);
+    }
+    QUEUE_UNLOCK();
+    if (!queued) {
+        free(it);
+        atomic_fetch_add(&g_dropped, 1);
+    }
+}
@@ -0,0 +1,193 @@
+#ifndef COMBAIN_ARCHIVE_H
+#define COMBAIN_ARCHIVE_H
+
+#include "analyser_record.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Local archive of every uploaded result, so a result can be looked up and
+ * sent again after its file is gone (the backend lost it, the lab asks for
+ * sample X from last week).
+ *
+ * The archive is a folder of numbered segments. Each segment is an
+ * append-only data file plus a fixed-size index with one entry per
+ * result. The index holds the upload time, hashes of the sample ID and the
+ * machine, a 64-bit mask of the test codes, and where the record sits in
+ * the data file. Once a segment reaches its size limit it is sealed: a
+ * copy of its index sorted by sample hash is written next to it, so a
+ * sample lookup is a binary search per segment. Machine, test and time
+ * filters scan the index, which is 64 bytes per result; the data is only
+ * read for results that pass them. Readers map the files (file_map.h).
+ *
+ * Sealed segments older than a few days are compacted: every record is
+ * deflated on its own (zlib), so lookups still read just what they need.
+ * The compacted data file replaces the raw one, and the index is switched
+ * over with an atomic rename.
+ *
+ * Files, all integers little-endian, NNNNNNNN the segment number:
+ *
+ *   NNNNNNNN.cbd  raw data: "CBDATA01", then records back to back
+ *   NNNNNNNN.cbz  compacted data: the same records, each deflated
+ *   NNNNNNNN.cbi  index: 16-byte header ("CBINDEX1", u32 entry size,
+ *                 u32 ARCHIVE_SEG_* flags), then one entry per record:
+ *                   u64 time        upload time, ms since 1970
+ *                   u64 sample      archive_hash(sample ID), 0 = none
+ *                   u64 machine     archive_hash(MachineID)
+ *                   u64 key         idempotency key (dedupe.h), 0 = none
+ *                   u64 tests       archive_test_bit() of every test code
+ *                   u64 offset      in the data file
+ *                   u32 stored      bytes in the data file
+ *                   u32 length      bytes of the record itself
+ *                   u8  kind        AnalyserKind
+ *                   u8  flags       ARCHIVE_REC_*
+ *                   u16 0
+ *                   u32 crc         crc32 of the record itself
+ *   NNNNNNNN.cbs  sealed: 32-byte header ("CBSORT01", u32 count, u32 0,
+ *                 u64 first time, u64 last time), then count pairs of
+ *                 u64 sample hash, u32 entry, u32 0, sorted
+ *
+ * A record is five NUL-terminated strings (sample ID, MachineID, MAC,
+ * Content-Type, test codes joined by ',') followed by the upload body.
+ */
+
+#define ARCHIVE_INDEX_MAGIC   "CBINDEX1"
+#define ARCHIVE_DATA_MAGIC    "CBDATA01"
+#define ARCHIVE_SORT_MAGIC    "CBSORT01"
+#define ARCHIVE_INDEX_HEADER  16
+#define ARCHIVE_INDEX_ENTRY   64
+#define ARCHIVE_SORT_HEADER   32
+#define ARCHIVE_SORT_PAIR     16
+
+#define ARCHIVE_SEG_COMPACTED 0x01   // data is in the .cbz
+#define ARCHIVE_REC_DEFLATED  0x01   // stored bytes are a zlib stream
+
+#define ARCHIVE_TESTS_MAX     512
+
+/** One result, as appended or as read back (strings are never NULL). */
+typedef struct {
+    unsigned long long timeMs;
+    int         kind;
+    uint64_t    key;
+    const char *sampleId;
+    const char *machineId;
+    const char *mac;
+    const char *contentType;
+    const char *tests;          // test codes and names, ',' separated
+    const char *body;
+    size_t      bodyLen;
+} ArchiveRecord;
+
+/** FNV-1a 64 of a string; what the index stores for sample and machine. */
+uint64_t archive_hash(const char *s);
+
+/** The bit test code 'code' sets in an index entry's mask. */
+uint64_t archive_test_bit(const char *code, size_t len);
+
+unsigned long long archive_now_ms(void);
+
+// ===============================================================
+//  Writing (combain)
+// ===============================================================
+
+/**
+ * Archive into 'dir' from now on (created if missing). A segment is
+ * sealed past 'segmentMb' MB; sealed segments whose newest result is
+ * older than 'compactDays' days are compacted (0 = never). A writer
+ * thread does the disk work. NULL or "" closes the archive. Returns 1 on
+ * success; on failure the archive is closed.
+ */
+int  archive_open(const char *dir, int segmentMb, int compactDays);
+
+/** Write out what is queued and stop the writer. */
+void archive_close(void);
+
+/** 1 while an archive is open (cheap; for skipping the extra work). */
+int  archive_enabled(void);
+
+/**
+ * ArchiveRecord.tests for 'rec': each item's test_code and name, or for
+ * formats without codes (urine) the keys of its results. Cut at a ','
+ * when it does not fit 'cap'.
+ */
+void archive_tests(const AnalyserRecord *rec, char *buf, size_t cap);
+
+/**
+ * Queue a copy of 'rec' for the writer. Any thread; never blocks on the
+ * disk. A timeMs of 0 is stamped with the current time.
+ */
+void archive_append(const ArchiveRecord *rec);
+
+// ===============================================================
+//  Reading (archive_store.c: also built into tools/archive_tool)
+// ===============================================================
+
+typedef struct {
+    const char        *sampleId;    // NULL = any
+    const char        *machineId;   // NULL = any
+    const char        *test;        // a test code or name; NULL = any
+    int                kind;        // 0 = any
+    unsigned long long fromMs;      // 0 = open
+    unsigned long long toMs;        // 0 = open (exclusive)
+} ArchiveQuery;
+
+/** Return 0 to stop the query. 'rec' is only valid during the call. */
+typedef int (*ArchiveVisitFn)(void *ctx, const ArchiveRecord *rec);
+
+typedef struct {
+    int                segments, sealed, compacted;
+    unsigned long long records;
+    unsigned long long rawBytes;      // records as written
+    unsigned long long storedBytes;   // data files on disk
+    unsigned long long firstMs, lastMs;
+} ArchiveStats;
+
+typedef struct ArchiveReader ArchiveReader;
+
+/**
+ * Map every segment of 'dir' as it is now (later appends are not seen).
+ * NULL if the folder holds no archive or on error.
+ */
+ArchiveReader *archive_reader_open(const char *dir);
+void           archive_reader_close(ArchiveReader *ar);
+
+/**
+ * Visit the results matching every set field of 'q', oldest segment
+ * first. Returns the number visited. Records that fail their checksum
+ * are skipped and counted by archive_reader_damaged().
+ */
+long archive_query(ArchiveReader *ar, const ArchiveQuery *q, ArchiveVisitFn fn, void *ctx);
+
+unsigned long archive_reader_damaged(const ArchiveReader *ar);
+
+void archive_stats(ArchiveReader *ar, ArchiveStats *st);
+
+// ===============================================================
+//  Segment maintenance (the writer thread, or the tool)
+// ===============================================================
+
+/** Highest segment number in 'dir', -1 if there is none. */
+long archive_last_segment(const char *dir);
+
+/**
+ * Write the sample-sorted copy of segment 'seg' of 'dir'. Returns 1 on
+ * success.
+ */
+int archive_seal(const char *dir, unsigned seg);
+
+/**
+ * Compact sealed segments whose newest result is before 'beforeMs'.
+ * Returns the number compacted, -1 on an error ('err' says which).
+ */
+int archive_compact(const char *dir, unsigned long long beforeMs, char *err, size_t errcap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMBAIN_ARCHIVE_H
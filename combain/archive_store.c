@@ -0,0 +1,609 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "archive.h"
+#include "analyser.h"     // analyser_scan_dir, file_map.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <zlib.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <process.h>
+    #define getpid _getpid
+#else
+    #include <unistd.h>
+#endif
+
+#define ARCHIVE_PATH_MAX 512
+
+// ===============================================================
+//  Shared helpers
+// ===============================================================
+
+uint64_t archive_hash(const char *s) {
+    uint64_t h = 14695981039346656037ull;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ull;
+    }
+    return h ? h : 1;   // 0 means "none" in the index
+}
+
+uint64_t archive_test_bit(const char *code, size_t len) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)code[i];
+        h *= 1099511628211ull;
+    }
+    return 1ull << (h >> 58);
+}
+
+unsigned long long archive_now_ms(void) {
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    ULARGE_INTEGER u;
+    u.LowPart = ft.dwLowDateTime;
+    u.HighPart = ft.dwHighDateTime;
+    return (u.QuadPart - 116444736000000000ull) / 10000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ull + (unsigned long long)ts.tv_nsec / 1000000;
+#endif
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+// Index entry fields (offsets within ARCHIVE_INDEX_ENTRY).
+enum {
+    E_TIME = 0, E_SAMPLE = 8, E_MACHINE = 16, E_KEY = 24, E_TESTS = 32,
+    E_OFFSET = 40, E_STORED = 48, E_LENGTH = 52, E_KIND = 56, E_FLAGS = 57, E_CRC = 60
+};
+
+static void seg_path(char *buf, size_t cap, const char *dir, unsigned seg, const char *ext) {
+    snprintf(buf, cap, "%s/%08u%s", dir, seg, ext);
+}
+
+static int file_exists(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f) fclose(f);
+    return f != NULL;
+}
+
+// rename() that replaces 'to' on every platform.
+static int replace_file(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+typedef struct {
+    unsigned *v;
+    int       n, cap;
+} SegList;
+
+static void list_one(const char *path, const char *name, void *ctx) {
+    (void)path;
+    SegList *l = (SegList *)ctx;
+    char *end;
+    unsigned long seg = strtoul(name, &end, 10);
+    if (end - name != 8 || strcmp(end, ".cbi") != 0) return;
+    if (l->n == l->cap) {
+        int cap = l->cap ? l->cap * 2 : 64;
+        unsigned *v = (unsigned *)realloc(l->v, (size_t)cap * sizeof(unsigned));
+        if (!v) return;
+        l->v = v;
+        l->cap = cap;
+    }
+    l->v[l->n++] = (unsigned)seg;
+}
+
+static int cmp_unsigned(const void *a, const void *b) {
+    unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+    return (x > y) - (x < y);
+}
+
+// Segment numbers of 'dir', ascending. The caller frees l->v.
+static void list_segments(const char *dir, SegList *l) {
+    memset(l, 0, sizeof(*l));
+    analyser_scan_dir(dir, ".cbi", list_one, l);
+    if (l->n > 1) qsort(l->v, (size_t)l->n, sizeof(unsigned), cmp_unsigned);
+}
+
+long archive_last_segment(const char *dir) {
+    SegList l;
+    list_segments(dir, &l);
+    long last = l.n ? (long)l.v[l.n - 1] : -1;
+    free(l.v);
+    return last;
+}
+
+// Header check of a mapped index; number of whole entries, -1 if invalid.
+static long index_entries(const FileMap *fm, uint32_t *flags) {
+    const unsigned char *p = (const unsigned char *)fm->data;
+    if (fm->len < ARCHIVE_INDEX_HEADER || memcmp(p, ARCHIVE_INDEX_MAGIC, 8) != 0 ||
+        get_u32(p + 8) != ARCHIVE_INDEX_ENTRY) return -1;
+    if (flags) *flags = get_u32(p + 12);
+    return (long)((fm->len - ARCHIVE_INDEX_HEADER) / ARCHIVE_INDEX_ENTRY);
+}
+
+// ===============================================================
+//  Reader
+// ===============================================================
+
+typedef struct {
+    unsigned seg;
+    FileMap  index, data, sorted;
+    int      hasData, hasSorted;
+    uint32_t flags;
+    long     count;
+    unsigned long long firstMs, lastMs;   // sealed only
+} Segment;
+
+struct ArchiveReader {
+    char           dir[ARCHIVE_PATH_MAX];
+    Segment       *segs;
+    int            nsegs;
+    unsigned char *buf;                   // inflated record
+    size_t         bufCap;
+    unsigned long  damaged;
+};
+
+static void segment_close(Segment *s) {
+    file_map_close(&s->index);
+    if (s->hasData) file_map_close(&s->data);
+    if (s->hasSorted) file_map_close(&s->sorted);
+    s->hasData = s->hasSorted = 0;
+}
+
+static int segment_open(const char *dir, unsigned seg, Segment *s) {
+    char path[ARCHIVE_PATH_MAX + 16];
+    memset(s, 0, sizeof(*s));
+    s->seg = seg;
+
+    // The index names the data file; compaction may switch both between
+    // the two opens, so a vanished data file means "read the index again".
+    for (int attempt = 0; attempt < 2; attempt++) {
+        seg_path(path, sizeof(path), dir, seg, ".cbi");
+        if (!file_map_open(&s->index, path, NULL)) return 0;
+        s->count = index_entries(&s->index, &s->flags);
+        if (s->count < 0) {
+            file_map_close(&s->index);
+            return 0;
+        }
+        seg_path(path, sizeof(path), dir, seg, (s->flags & ARCHIVE_SEG_COMPACTED) ? ".cbz" : ".cbd");
+        if (file_map_open(&s->data, path, NULL)) {
+            s->hasData = 1;
+            break;
+        }
+        file_map_close(&s->index);
+    }
+    if (!s->hasData) return 0;
+
+    seg_path(path, sizeof(path), dir, seg, ".cbs");
+    if (file_exists(path) && file_map_open(&s->sorted, path, NULL)) {
+        const unsigned char *p = (const unsigned char *)s->sorted.data;
+        if (s->sorted.len >= ARCHIVE_SORT_HEADER && memcmp(p, ARCHIVE_SORT_MAGIC, 8) == 0 &&
+            s->sorted.len >= ARCHIVE_SORT_HEADER + (size_t)get_u32(p + 8) * ARCHIVE_SORT_PAIR) {
+            s->hasSorted = 1;
+            s->firstMs = get_u64(p + 16);
+            s->lastMs = get_u64(p + 24);
+        } else {
+            file_map_close(&s->sorted);
+        }
+    }
+    return 1;
+}
+
+ArchiveReader *archive_reader_open(const char *dir) {
+    SegList l;
+    list_segments(dir, &l);
+    if (l.n == 0) {
+        free(l.v);
+        return NULL;
+    }
+
+    ArchiveReader *ar = (ArchiveReader *)calloc(1, sizeof(*ar));
+    Segment *segs = (Segment *)calloc((size_t)l.n, sizeof(Segment));
+    if (!ar || !segs) {
+        free(ar);
+        free(segs);
+        free(l.v);
+        return NULL;
+    }
+    snprintf(ar->dir, sizeof(ar->dir), "%s", dir);
+    ar->segs = segs;
+    for (int i = 0; i < l.n; i++) {
+        if (segment_open(dir, l.v[i], &ar->segs[ar->nsegs])) ar->nsegs++;
+    }
+    free(l.v);
+    return ar;
+}
+
+void archive_reader_close(ArchiveReader *ar) {
+    if (!ar) return;
+    for (int i = 0; i < ar->nsegs; i++) segment_close(&ar->segs[i]);
+    free(ar->segs);
+    free(ar->buf);
+    free(ar);
+}
+
+unsigned long archive_reader_damaged(const ArchiveReader *ar) {
+    return ar->damaged;
+}
+
+static const unsigned char *entry_at(const Segment *s, long i) {
+    return (const unsigned char *)s->index.data + ARCHIVE_INDEX_HEADER + (size_t)i * ARCHIVE_INDEX_ENTRY;
+}
+
+// The record of entry 'e' into 'rec'. 0 if it is cut short or damaged.
+static int load_record(ArchiveReader *ar, const Segment *s, const unsigned char *e, ArchiveRecord *rec) {
+    uint64_t off = get_u64(e + E_OFFSET);
+    uint32_t stored = get_u32(e + E_STORED), len = get_u32(e + E_LENGTH);
+    if (off > s->data.len || stored > s->data.len - off || len == 0) return 0;
+
+    const unsigned char *p = (const unsigned char *)s->data.data + off;
+    if (e[E_FLAGS] & ARCHIVE_REC_DEFLATED) {
+        if (ar->bufCap < len) {
+            unsigned char *b = (unsigned char *)realloc(ar->buf, len);
+            if (!b) return 0;
+            ar->buf = b;
+            ar->bufCap = len;
+        }
+        uLongf out = len;
+        if (uncompress(ar->buf, &out, p, stored) != Z_OK || out != len) return 0;
+        p = ar->buf;
+    } else if (stored != len) {
+        return 0;
+    }
+    if (crc32(0L, p, len) != get_u32(e + E_CRC)) return 0;
+
+    // Five strings, then the body.
+    const char *str[5];
+    size_t at = 0;
+    for (int i = 0; i < 5; i++) {
+        const void *nul = memchr(p + at, '\0', len - at);
+        if (!nul) return 0;
+        str[i] = (const char *)p + at;
+        at = (size_t)((const unsigned char *)nul - p) + 1;
+    }
+
+    rec->timeMs      = get_u64(e + E_TIME);
+    rec->kind        = e[E_KIND];
+    rec->key         = get_u64(e + E_KEY);
+    rec->sampleId    = str[0];
+    rec->machineId   = str[1];
+    rec->mac         = str[2];
+    rec->contentType = str[3];
+    rec->tests       = str[4];
+    rec->body        = (const char *)p + at;
+    rec->bodyLen     = len - at;
+    return 1;
+}
+
+// 'test' is one of the ','-separated names in 'list'.
+static int has_test(const char *list, const char *test) {
+    size_t n = strlen(test);
+    for (const char *p = list; *p;) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == n && memcmp(p, test, n) == 0) return 1;
+        if (!end) break;
+        p = end + 1;
+    }
+    return 0;
+}
+
+typedef struct {
+    const ArchiveQuery *q;
+    uint64_t sample, machine, tests;
+} Filter;
+
+static int entry_matches(const Filter *f, const unsigned char *e) {
+    const ArchiveQuery *q = f->q;
+    uint64_t t = get_u64(e + E_TIME);
+    if (q->fromMs && t < q->fromMs) return 0;
+    if (q->toMs && t >= q->toMs) return 0;
+    if (q->kind && e[E_KIND] != q->kind) return 0;
+    if (f->sample && get_u64(e + E_SAMPLE) != f->sample) return 0;
+    if (f->machine && get_u64(e + E_MACHINE) != f->machine) return 0;
+    if (f->tests && !(get_u64(e + E_TESTS) & f->tests)) return 0;
+    return 1;
+}
+
+// Entry 'i' passed the index filter: read it, rule out hash collisions,
+// visit. Returns 0 when the visitor stops the query.
+static int visit(ArchiveReader *ar, const Filter *f, const Segment *s, long i,
+                 ArchiveVisitFn fn, void *ctx, long *n) {
+    ArchiveRecord rec;
+    if (!load_record(ar, s, entry_at(s, i), &rec)) {
+        ar->damaged++;
+        return 1;
+    }
+    const ArchiveQuery *q = f->q;
+    if (q->sampleId && strcmp(rec.sampleId, q->sampleId) != 0) return 1;
+    if (q->machineId && strcmp(rec.machineId, q->machineId) != 0) return 1;
+    if (q->test && !has_test(rec.tests, q->test)) return 1;
+    (*n)++;
+    return fn(ctx, &rec);
+}
+
+long archive_query(ArchiveReader *ar, const ArchiveQuery *q, ArchiveVisitFn fn, void *ctx) {
+    Filter f;
+    f.q = q;
+    f.sample  = q->sampleId ? archive_hash(q->sampleId) : 0;
+    f.machine = q->machineId ? archive_hash(q->machineId) : 0;
+    f.tests   = q->test ? archive_test_bit(q->test, strlen(q->test)) : 0;
+
+    long n = 0;
+    for (int k = 0; k < ar->nsegs; k++) {
+        const Segment *s = &ar->segs[k];
+        if (s->hasSorted && ((q->fromMs && s->lastMs < q->fromMs) || (q->toMs && s->firstMs >= q->toMs))) continue;
+
+        if (f.sample && s->hasSorted) {
+            // Binary search for the first pair of the sample, then walk.
+            const unsigned char *pairs = (const unsigned char *)s->sorted.data + ARCHIVE_SORT_HEADER;
+            long lo = 0, hi = (long)get_u32((const unsigned char *)s->sorted.data + 8);
+            long count = hi;
+            while (lo < hi) {
+                long mid = lo + (hi - lo) / 2;
+                if (get_u64(pairs + (size_t)mid * ARCHIVE_SORT_PAIR) < f.sample) lo = mid + 1;
+                else hi = mid;
+            }
+            for (long j = lo; j < count; j++) {
+                const unsigned char *pr = pairs + (size_t)j * ARCHIVE_SORT_PAIR;
+                if (get_u64(pr) != f.sample) break;
+                long i = (long)get_u32(pr + 8);
+                if (i >= s->count || !entry_matches(&f, entry_at(s, i))) continue;
+                if (!visit(ar, &f, s, i, fn, ctx, &n)) return n;
+            }
+            continue;
+        }
+
+        for (long i = 0; i < s->count; i++) {
+            if (!entry_matches(&f, entry_at(s, i))) continue;
+            if (!visit(ar, &f, s, i, fn, ctx, &n)) return n;
+        }
+    }
+    return n;
+}
+
+void archive_stats(ArchiveReader *ar, ArchiveStats *st) {
+    memset(st, 0, sizeof(*st));
+    for (int k = 0; k < ar->nsegs; k++) {
+        const Segment *s = &ar->segs[k];
+        st->segments++;
+        st->sealed += s->hasSorted;
+        st->compacted += (s->flags & ARCHIVE_SEG_COMPACTED) != 0;
+        st->storedBytes += s->data.len;
+        for (long i = 0; i < s->count; i++) {
+            const unsigned char *e = entry_at(s, i);
+            uint64_t t = get_u64(e + E_TIME);
+            st->records++;
+            st->rawBytes += get_u32(e + E_LENGTH);
+            if (!st->firstMs || t < st->firstMs) st->firstMs = t;
+            if (t > st->lastMs) st->lastMs = t;
+        }
+    }
+}
+
+// ===============================================================
+//  Sealing
+// ===============================================================
+
+typedef struct {
+    uint64_t hash;
+    uint32_t entry;
+} Pair;
+
+static int cmp_pair(const void *a, const void *b) {
+    const Pair *x = (const Pair *)a, *y = (const Pair *)b;
+    if (x->hash != y->hash) return (x->hash > y->hash) - (x->hash < y->hash);
+    return (x->entry > y->entry) - (x->entry < y->entry);
+}
+
+// Write 'path' through a temporary file and a rename, so readers see the
+// old file or the whole new one.
+static FILE *open_temp(char *tmp, size_t cap, const char *path) {
+    snprintf(tmp, cap, "%s.%d.tmp", path, (int)getpid());
+    return fopen(tmp, "wb");
+}
+
+// Close a temporary file; 'path' = NULL leaves it to be renamed later.
+static int close_temp(FILE *f, const char *tmp, const char *path, int ok) {
+    if (fflush(f) != 0) ok = 0;
+    if (fclose(f) != 0) ok = 0;
+    if (ok && (!path || replace_file(tmp, path))) return 1;
+    remove(tmp);
+    return 0;
+}
+
+int archive_seal(const char *dir, unsigned seg) {
+    char path[ARCHIVE_PATH_MAX + 16], tmp[ARCHIVE_PATH_MAX + 32];
+    FileMap fm;
+    seg_path(path, sizeof(path), dir, seg, ".cbi");
+    if (!file_map_open(&fm, path, NULL)) return 0;
+    long count = index_entries(&fm, NULL);
+    if (count < 0) {
+        file_map_close(&fm);
+        return 0;
+    }
+
+    Pair *pairs = (Pair *)malloc((size_t)(count ? count : 1) * sizeof(Pair));
+    if (!pairs) {
+        file_map_close(&fm);
+        return 0;
+    }
+    uint64_t first = 0, last = 0;
+    uint32_t npairs = 0;
+    for (long i = 0; i < count; i++) {
+        const unsigned char *e = (const unsigned char *)fm.data + ARCHIVE_INDEX_HEADER + (size_t)i * ARCHIVE_INDEX_ENTRY;
+        uint64_t t = get_u64(e + E_TIME), h = get_u64(e + E_SAMPLE);
+        if (i == 0 || t < first) first = t;
+        if (t > last) last = t;
+        if (h) {
+            pairs[npairs].hash = h;
+            pairs[npairs].entry = (uint32_t)i;
+            npairs++;
+        }
+    }
+    file_map_close(&fm);
+    qsort(pairs, npairs, sizeof(Pair), cmp_pair);
+
+    seg_path(path, sizeof(path), dir, seg, ".cbs");
+    FILE *f = open_temp(tmp, sizeof(tmp), path);
+    if (!f) {
+        free(pairs);
+        return 0;
+    }
+    unsigned char h[ARCHIVE_SORT_HEADER] = {0};
+    memcpy(h, ARCHIVE_SORT_MAGIC, 8);
+    put_u32(h + 8, npairs);
+    put_u64(h + 16, first);
+    put_u64(h + 24, last);
+    int ok = fwrite(h, sizeof(h), 1, f) == 1;
+    for (uint32_t i = 0; ok && i < npairs; i++) {
+        unsigned char p[ARCHIVE_SORT_PAIR] = {0};
+        put_u64(p, pairs[i].hash);
+        put_u32(p + 8, pairs[i].entry);
+        ok = fwrite(p, sizeof(p), 1, f) == 1;
+    }
+    free(pairs);
+    return close_temp(f, tmp, path, ok);
+}
+
+// ===============================================================
+//  Compaction
+// ===============================================================
+
+// Deflate every record of a sealed segment into NNNNNNNN.cbz, then switch
+// the index over to it and drop the raw file. Closes 's' (Windows cannot
+// replace or delete a mapped file).
+static int compact_segment(const char *dir, Segment *s, char *err, size_t errcap) {
+    char cbz[ARCHIVE_PATH_MAX + 16], cbi[ARCHIVE_PATH_MAX + 16], cbd[ARCHIVE_PATH_MAX + 16];
+    char tmpZ[ARCHIVE_PATH_MAX + 32], tmpI[ARCHIVE_PATH_MAX + 32];
+    seg_path(cbz, sizeof(cbz), dir, s->seg, ".cbz");
+    seg_path(cbi, sizeof(cbi), dir, s->seg, ".cbi");
+    seg_path(cbd, sizeof(cbd), dir, s->seg, ".cbd");
+
+    size_t indexLen = ARCHIVE_INDEX_HEADER + (size_t)s->count * ARCHIVE_INDEX_ENTRY;
+    unsigned char *index = (unsigned char *)malloc(indexLen);
+    unsigned char *zbuf = NULL;
+    size_t zcap = 0;
+    FILE *fz = open_temp(tmpZ, sizeof(tmpZ), cbz);
+    if (!index || !fz) {
+        snprintf(err, errcap, "segment %08u: cannot create %s", s->seg, cbz);
+        free(index);
+        if (fz) close_temp(fz, tmpZ, cbz, 0);
+        return 0;
+    }
+    memcpy(index, s->index.data, indexLen);
+    put_u32(index + 12, s->flags | ARCHIVE_SEG_COMPACTED);
+
+    int ok = fwrite(ARCHIVE_DATA_MAGIC, 8, 1, fz) == 1;
+    uint64_t at = 8;
+    for (long i = 0; ok && i < s->count; i++) {
+        unsigned char *e = index + ARCHIVE_INDEX_HEADER + (size_t)i * ARCHIVE_INDEX_ENTRY;
+        uint64_t off = get_u64(e + E_OFFSET);
+        uint32_t stored = get_u32(e + E_STORED);
+        if (off > s->data.len || stored > s->data.len - off) {
+            snprintf(err, errcap, "segment %08u: entry %ld points past the data file", s->seg, i);
+            ok = 0;
+            break;
+        }
+        const unsigned char *src = (const unsigned char *)s->data.data + off;
+        const unsigned char *out = src;
+        uLongf outLen = stored;
+        if (!(e[E_FLAGS] & ARCHIVE_REC_DEFLATED)) {
+            uLong bound = compressBound(stored);
+            if (zcap < bound) {
+                unsigned char *z = (unsigned char *)realloc(zbuf, bound);
+                if (!z) {
+                    snprintf(err, errcap, "out of memory");
+                    ok = 0;
+                    break;
+                }
+                zbuf = z;
+                zcap = bound;
+            }
+            uLongf zlen = bound;
+            // Kept raw when deflate does not pay (tiny or incompressible).
+            if (compress2(zbuf, &zlen, src, stored, 6) == Z_OK && zlen < stored) {
+                out = zbuf;
+                outLen = zlen;
+                e[E_FLAGS] |= ARCHIVE_REC_DEFLATED;
+            }
+        }
+        put_u64(e + E_OFFSET, at);
+        put_u32(e + E_STORED, (uint32_t)outLen);
+        ok = fwrite(out, 1, outLen, fz) == outLen;
+        at += outLen;
+    }
+    free(zbuf);
+    if (!close_temp(fz, tmpZ, NULL, ok)) {
+        if (ok) snprintf(err, errcap, "segment %08u: cannot write %s", s->seg, cbz);
+        free(index);
+        return 0;
+    }
+
+    FILE *fi = open_temp(tmpI, sizeof(tmpI), cbi);
+    ok = fi && fwrite(index, 1, indexLen, fi) == indexLen;
+    free(index);
+    if (!fi || !close_temp(fi, tmpI, NULL, ok)) {
+        snprintf(err, errcap, "segment %08u: cannot write %s", s->seg, cbi);
+        remove(tmpZ);
+        return 0;
+    }
+
+    // Data first: until the index is switched, readers still use the .cbd.
+    segment_close(s);
+    if (!replace_file(tmpZ, cbz) || !replace_file(tmpI, cbi)) {
+        snprintf(err, errcap, "segment %08u: cannot replace %s", s->seg, cbi);
+        remove(tmpZ);
+        remove(tmpI);
+        return 0;
+    }
+    remove(cbd);
+    return 1;
+}
+
+int archive_compact(const char *dir, unsigned long long beforeMs, char *err, size_t errcap) {
+    SegList l;
+    list_segments(dir, &l);
+    int done = 0;
+    for (int i = 0; i < l.n; i++) {
+        Segment s;
+        if (!segment_open(dir, l.v[i], &s)) continue;
+        int due = s.hasSorted && !(s.flags & ARCHIVE_SEG_COMPACTED) && s.lastMs < beforeMs;
+        int ok = !due || compact_segment(dir, &s, err, errcap);
+        segment_close(&s);
+        if (!ok) {
+            free(l.v);
+            return -1;
+        }
+        done += due;
+    }
+    free(l.v);
+    return done;
+}
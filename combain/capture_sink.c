@@ -0,0 +1,341 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "capture_sink.h"
+#include "logger.h"
+#include "monotime.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <process.h>
+#else
+    #include <pthread.h>
+#endif
+
+typedef struct {
+    size_t             len;
+    unsigned long long publishedUs;
+    char               data[];
+} CaptureFrame;
+
+struct CaptureSource {
+    CaptureSink *sink;
+    char         name[64];
+    char         outPath[512];
+    char         spillPath[512];
+    SpscQueue   *queue;
+    atomic_int   retiring;   // producer gone: drain, report and free
+    int          traceSlot;
+
+    // sink thread only
+    int                dirty;    // written since the scanner was last rung
+    unsigned long long lastMs;
+    unsigned long long handoffMaxUs, handoffSumUs, handoffN;
+};
+
+struct CaptureSink {
+    // Filled by the registering thread, emptied by the sink thread once a
+    // retired source is drained; a slot is only reused after that.
+    _Atomic(CaptureSource *) sources[CAPTURE_MAX_SOURCES];
+
+    Doorbell      *bell;         // producers -> sink
+    CaptureReadyFn onReady;      // sink -> scanner
+    void          *readyCtx;
+    atomic_int    idleMs;
+    atomic_int    running;
+
+#ifdef _WIN32
+    HANDLE        thread;
+#else
+    pthread_t     thread;
+#endif
+    int           started;
+};
+
+
+static unsigned long long now_ms(void) {
+    return monotime_us() / 1000;
+}
+
+// ===============================================================
+//  Queue callbacks (producer thread)
+// ===============================================================
+
+static void discard_frame(void *ctx, void *item) {
+    (void)ctx;
+    free(item);
+}
+
+static int spill_frame(void *ctx, void *item) {
+    CaptureSource *src = (CaptureSource *)ctx;
+    CaptureFrame *f = (CaptureFrame *)item;
+
+    FILE *fp = fopen(src->spillPath, "ab");
+    int ok = 0;
+    if (fp) {
+        ok = (fwrite(f->data, 1, f->len, fp) == f->len);
+        fclose(fp);
+    }
+    free(f);
+    return ok;
+}
+
+// ===============================================================
+//  Sink thread
+// ===============================================================
+
+// Append everything queued for 'src'. The file is opened per batch rather
+// than held open, so the scanner deleting it after an upload never leaves
+// us writing into an unlinked file.
+static void drain_source(CaptureSource *src) {
+    CaptureFrame *f = (CaptureFrame *)spsc_pop(src->queue);
+    if (!f) return;
+
+    FILE *fp = fopen(src->outPath, "ab");
+    if (!fp) log_msg(LOG_ERROR, "capture", "❌ Cannot open %s: %s", src->outPath, strerror(errno));
+
+    trace_received(src->traceSlot, f->publishedUs);
+
+    unsigned long long t = monotime_us();
+    do {
+        unsigned long long lat = t - f->publishedUs;
+        if (lat > src->handoffMaxUs) src->handoffMaxUs = lat;
+        src->handoffSumUs += lat;
+        src->handoffN++;
+
+        if (fp && fwrite(f->data, 1, f->len, fp) != f->len) log_msg(LOG_ERROR, "capture", "❌ Cannot write %s: %s", src->outPath, strerror(errno));
+        free(f);
+    } while ((f = (CaptureFrame *)spsc_pop(src->queue)) != NULL);
+
+    if (fp) fclose(fp);
+    src->dirty  = 1;
+    src->lastMs = now_ms();
+}
+
+static void report_source(const CaptureSource *src) {
+    SpscStats st;
+    spsc_stats(src->queue, &st);
+    log_msg(LOG_INFO, "capture",
+            "[capture %s] pushed=%llu popped=%llu blocked=%llu (%llu us) spilled=%llu "
+            "dropped=%llu lost=%llu maxDepth=%zu/%zu hand-off avg=%llu us max=%llu us",
+            src->name, st.pushed, st.popped, st.blocked, st.blockedUs, st.spilled,
+            st.dropped, st.lost, st.maxDepth, st.capacity,
+            src->handoffN ? src->handoffSumUs / src->handoffN : 0ull, src->handoffMaxUs);
+}
+
+// Last pass over a source: write what is left, report, free.
+static void finish_source(CaptureSource *src) {
+    drain_source(src);
+    report_source(src);
+    spsc_close(src->queue);
+    spsc_destroy(src->queue);
+    free(src);
+}
+
+static long sink_pass(CaptureSink *s) {
+    long wait = 1000;
+    long idleMs = atomic_load(&s->idleMs);
+    unsigned long long now = 0;
+    int ready = 0;
+
+    // Retired sources first: a replacement writing the same file must not
+    // get ahead of what its predecessor left queued.
+    for (int i = 0; i < CAPTURE_MAX_SOURCES; i++) {
+        CaptureSource *src = atomic_load(&s->sources[i]);
+        if (!src || !atomic_load(&src->retiring)) continue;
+        drain_source(src);
+        ready |= src->dirty;
+        if (src->dirty) trace_framed(src->traceSlot, trace_now_us());
+        finish_source(src);
+        atomic_store(&s->sources[i], NULL);
+    }
+
+    for (int i = 0; i < CAPTURE_MAX_SOURCES; i++) {
+        CaptureSource *src = atomic_load(&s->sources[i]);
+        if (!src) continue;
+        drain_source(src);
+        if (!src->dirty) continue;
+
+        if (!now) now = now_ms();
+        long idle = (long)(now - src->lastMs);
+        if (idle >= idleMs) {
+            src->dirty = 0;
+            ready = 1;
+            trace_framed(src->traceSlot, trace_now_us());
+        } else if (idleMs - idle < wait) {
+            wait = idleMs - idle;
+        }
+    }
+    if (ready && s->onReady) s->onReady(s->readyCtx);
+    return wait;
+}
+
+#ifdef _WIN32
+static unsigned __stdcall sink_thread(void *arg)
+#else
+static void *sink_thread(void *arg)
+#endif
+{
+    CaptureSink *s = (CaptureSink *)arg;
+    long wait = 1000;
+
+    while (atomic_load(&s->running)) {
+        doorbell_wait(s->bell, wait);
+        wait = sink_pass(s);
+    }
+
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+// ===============================================================
+//  Public API
+// ===============================================================
+
+CaptureSink *capture_sink_create(CaptureReadyFn onReady, void *ctx, int idleMs) {
+    CaptureSink *s = (CaptureSink *)calloc(1, sizeof(CaptureSink));
+    if (!s) return NULL;
+    s->bell = doorbell_create();
+    if (!s->bell) {
+        free(s);
+        return NULL;
+    }
+    s->onReady  = onReady;
+    s->readyCtx = ctx;
+    atomic_init(&s->idleMs, idleMs > 0 ? idleMs : 500);
+    atomic_init(&s->running, 0);
+    for (int i = 0; i < CAPTURE_MAX_SOURCES; i++) atomic_init(&s->sources[i], NULL);
+    return s;
+}
+
+void capture_sink_set_idle(CaptureSink *sink, int idleMs) {
+    if (!sink || idleMs <= 0) return;
+    atomic_store(&sink->idleMs, idleMs);
+    doorbell_ring(sink->bell);
+}
+
+CaptureSource *capture_sink_add(CaptureSink *sink, const char *name, const char *outPath,
+                                SpscPolicy policy, size_t capacity) {
+    if (!sink) return NULL;
+
+    int slot = -1;
+    for (int i = 0; i < CAPTURE_MAX_SOURCES && slot < 0; i++) {
+        if (!atomic_load(&sink->sources[i])) slot = i;
+    }
+    if (slot < 0) return NULL;
+
+    CaptureSource *src = (CaptureSource *)calloc(1, sizeof(CaptureSource));
+    if (!src) return NULL;
+    src->sink = sink;
+    atomic_init(&src->retiring, 0);
+    snprintf(src->name, sizeof(src->name), "%s", name);
+    snprintf(src->outPath, sizeof(src->outPath), "%s", outPath);
+    src->traceSlot = trace_source(outPath);
+
+    size_t n = strlen(outPath);
+    if (n >= 4 && strcmp(outPath + n - 4, ".txt") == 0) n -= 4;
+    snprintf(src->spillPath, sizeof(src->spillPath), "%.*s_spill.txt", (int)n, outPath);
+
+    src->queue = spsc_create(capacity, policy, spill_frame, discard_frame, src);
+    if (!src->queue) {
+        free(src);
+        return NULL;
+    }
+
+    // Publishes the initialised source to the sink thread.
+    atomic_store(&sink->sources[slot], src);
+    return src;
+}
+
+void capture_source_retire(CaptureSource *src) {
+    if (!src) return;
+    CaptureSink *sink = src->sink;
+    if (sink->started) {
+        atomic_store(&src->retiring, 1);
+        doorbell_ring(sink->bell);
+        return;
+    }
+    for (int i = 0; i < CAPTURE_MAX_SOURCES; i++) {
+        if (atomic_load(&sink->sources[i]) == src) atomic_store(&sink->sources[i], NULL);
+    }
+    finish_source(src);
+}
+
+int capture_sink_start(CaptureSink *sink) {
+    if (!sink || sink->started) return 0;
+    atomic_store(&sink->running, 1);
+#ifdef _WIN32
+    uintptr_t h = _beginthreadex(NULL, 0, sink_thread, sink, 0, NULL);
+    if (h == 0) {
+        atomic_store(&sink->running, 0);
+        return 0;
+    }
+    sink->thread = (HANDLE)h;
+#else
+    if (pthread_create(&sink->thread, NULL, sink_thread, sink) != 0) {
+        atomic_store(&sink->running, 0);
+        return 0;
+    }
+#endif
+    sink->started = 1;
+    return 1;
+}
+
+int capture_publish(CaptureSource *src, const void *data, size_t len) {
+    if (!src || len == 0) return 1;
+
+    CaptureFrame *f = (CaptureFrame *)malloc(sizeof(CaptureFrame) + len);
+    if (!f) return 0;
+    f->len = len;
+    f->publishedUs = monotime_us();
+    memcpy(f->data, data, len);
+
+    SpscResult r = spsc_push(src->queue, f);
+    if (r == SPSC_PUSHED) doorbell_ring(src->sink->bell);
+    return r == SPSC_PUSHED || r == SPSC_SPILLED;
+}
+
+int capture_source_full(const CaptureSource *src) {
+    return spsc_full(src->queue);
+}
+
+const char *capture_source_name(const CaptureSource *src) {
+    return src->name;
+}
+
+void capture_source_stats(const CaptureSource *src, SpscStats *out) {
+    spsc_stats(src->queue, out);
+}
+
+void capture_sink_stop(CaptureSink *sink) {
+    if (!sink) return;
+
+    if (sink->started) {
+        atomic_store(&sink->running, 0);
+        doorbell_ring(sink->bell);
+#ifdef _WIN32
+        WaitForSingleObject(sink->thread, INFINITE);
+        CloseHandle(sink->thread);
+#else
+        pthread_join(sink->thread, NULL);
+#endif
+    }
+
+    for (int i = 0; i < CAPTURE_MAX_SOURCES; i++) {
+        CaptureSource *src = atomic_load(&sink->sources[i]);
+        if (src) finish_source(src);
+    }
+
+    doorbell_destroy(sink->bell);
+    free(sink);
+}
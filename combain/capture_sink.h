@@ -0,0 +1,85 @@
+#ifndef CAPTURE_SINK_H
+#define CAPTURE_SINK_H
+
+#include "spsc_queue.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Processing stage between the capture threads (serial, listeners) and the
+ * analyser scanner.
+ *
+ * Each capture source publishes the bytes it receives into its own SPSC
+ * queue. One sink thread drains every queue, appends the data to that
+ * source's capture file (the same files the readers used to write
+ * themselves), and notifies the scanner once a source has been idle
+ * for 'idleMs', i.e. when a result has finished arriving. The scanner then
+ * picks it up at once instead of on its next 10-second pass.
+ */
+
+#define CAPTURE_MAX_SOURCES 64
+
+typedef struct CaptureSink   CaptureSink;
+typedef struct CaptureSource CaptureSource;
+
+/** Called on the sink thread when captured data is ready to scan. */
+typedef void (*CaptureReadyFn)(void *ctx);
+
+/** 'onReady' may be NULL. */
+CaptureSink *capture_sink_create(CaptureReadyFn onReady, void *ctx, int idleMs);
+
+/**
+ * Register a capture source, before or after capture_sink_start() (always
+ * from the same thread). Data is appended to 'outPath'. With SPSC_SPILL,
+ * data that does not fit the queue is appended by the producer to
+ * '<outPath without .txt>_spill.txt' in the same folder, which the scanner
+ * also picks up. NULL on error or when all CAPTURE_MAX_SOURCES slots are
+ * taken.
+ */
+CaptureSource *capture_sink_add(CaptureSink *sink, const char *name, const char *outPath,
+                                SpscPolicy policy, size_t capacity);
+
+/**
+ * Unregister a source whose producer has stopped publishing: the sink
+ * writes out what is still queued, prints its counters and frees it.
+ * 'src' must not be used afterwards. Safe with NULL.
+ */
+void capture_source_retire(CaptureSource *src);
+
+/** Change the idle time that marks a finished result. Any thread. */
+void capture_sink_set_idle(CaptureSink *sink, int idleMs);
+
+/** Start the sink thread. Returns 1 on success. */
+int capture_sink_start(CaptureSink *sink);
+
+/**
+ * Producer side (one thread per source): copy 'len' bytes into a frame and
+ * queue it. Returns 1 if the data was queued or spilled, 0 if it was lost.
+ */
+int capture_publish(CaptureSource *src, const void *data, size_t len);
+
+/**
+ * Producer side: 1 if the next capture_publish() would block, spill or
+ * drop. Loop-driven producers pause reading while this holds.
+ */
+int capture_source_full(const CaptureSource *src);
+
+const char *capture_source_name(const CaptureSource *src);
+void capture_source_stats(const CaptureSource *src, SpscStats *out);
+
+/**
+ * Stop the sink thread, write out everything still queued, print per-source
+ * queue counters and free. Producers must have stopped publishing.
+ * Safe to call with NULL (no-op).
+ */
+void capture_sink_stop(CaptureSink *sink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAPTURE_SINK_H
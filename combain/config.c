@@ -0,0 +1,513 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "config.h"
+#include "logger.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// ===============================================================
+//  Defaults (the values combain had compiled in)
+// ===============================================================
+
+#ifdef _WIN32
+  #define DEF_SCAN_DIR     "C:\\ss"
+  #define DEF_SERIAL_DEV   "COM3"
+  #define DEF_SERIAL_OUT   "C:\\ss\\serial_data.txt"
+  #define DEF_F200_OUT     "C:\\ss\\out_f200.txt"
+  #define DEF_H360_OUT     "C:\\ss\\out_h360.txt"
+#else
+  #define DEF_SCAN_DIR     "./ss"
+  #define DEF_SERIAL_DEV   "/dev/ttyUSB0"     // mac: "/dev/tty.usbserial-0001" etc.
+  #define DEF_SERIAL_OUT   "./ss/serial_data.txt"
+  #define DEF_F200_OUT     "ss/out_f200.txt"
+  #define DEF_H360_OUT     "ss/out_h360.txt"
+#endif
+
+static void copy_str(char *dst, size_t cap, const char *src) {
+    size_t n = strlen(src);
+    if (n >= cap) n = cap - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+static void listener_defaults(ListenerSpec *l, const char *name) {
+    memset(l, 0, sizeof(*l));
+    copy_str(l->name, sizeof(l->name), name);
+    l->queue = 256;
+    l->enabled = 1;
+    l->maxPeers = 16;
+    // A dead link is noticed in about 25 s (10 + 3 x 5) when quiet, 30 s
+    // with data in flight; the kernel defaults take over two hours.
+    l->live.keepalive        = 1;
+    l->live.keepIdleS        = 10;
+    l->live.keepIntervalS    = 5;
+    l->live.keepCount        = 3;
+    l->live.userTimeoutMs    = 30000;
+    l->live.connectTimeoutMs = 10000;
+}
+
+static void set_listener(ListenerSpec *l, const char *name, const char *host, int port,
+                         const char *out) {
+    listener_defaults(l, name);
+    copy_str(l->host, sizeof(l->host), host);
+    l->port = port;
+    copy_str(l->outPath, sizeof(l->outPath), out);
+}
+
+void config_defaults(CombainConfig *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    copy_str(cfg->scanDir, sizeof(cfg->scanDir), DEF_SCAN_DIR);
+    copy_str(cfg->machineId, sizeof(cfg->machineId), "MC0003");
+    copy_str(cfg->mac, sizeof(cfg->mac), "00:11:22:33:44:55");
+    copy_str(cfg->encoding, sizeof(cfg->encoding), "json");
+    copy_str(cfg->endpoints[1], sizeof(cfg->endpoints[1]), "https://api.superceuticals.in/test-one/saveCbc");
+    copy_str(cfg->endpoints[2], sizeof(cfg->endpoints[2]), "https://api.superceuticals.in/test-two/saveResults");
+    copy_str(cfg->endpoints[3], sizeof(cfg->endpoints[3]), "https://api.superceuticals.in/test-three/saveUrine");
+
+    cfg->parseWorkers      = 0;
+    cfg->uploadConnections = 0;
+    cfg->scanBatch         = 256;
+    cfg->rescanMs          = 10000;
+    cfg->settleMs          = 500;
+    cfg->sinkIdleMs        = 500;
+    cfg->metricsPort       = 9464;
+    cfg->dedupeCapacity    = 65536;
+    cfg->dedupeWindowS     = 86400;
+    cfg->archiveSegmentMb  = 64;
+    cfg->archiveCompactDays = 7;
+    cfg->priorityAgingS    = 60;
+    cfg->logLevel          = LOG_INFO;
+    cfg->logConsole        = 1;
+    cfg->logMaxKb          = 10240;
+    cfg->logKeep           = 5;
+
+    set_listener(&cfg->listeners[0], "f200", "192.168.0.173", 50001, DEF_F200_OUT);
+    set_listener(&cfg->listeners[1], "h360", "192.168.0.173", 50002, DEF_H360_OUT);
+    cfg->nlisteners = 2;
+
+    SerialSpec *s = &cfg->serials[0];
+    copy_str(s->name, sizeof(s->name), "serial");
+    copy_str(s->device, sizeof(s->device), DEF_SERIAL_DEV);
+    s->baud = 19200;
+    copy_str(s->outPath, sizeof(s->outPath), DEF_SERIAL_OUT);
+    s->queue = 1024;
+    s->enabled = 1;
+    cfg->nserials = 1;
+}
+
+// ===============================================================
+//  INI parsing
+// ===============================================================
+
+typedef enum { SEC_NONE, SEC_GENERAL, SEC_ENDPOINTS, SEC_LISTENER, SEC_SERIAL, SEC_SCAN } Section;
+
+typedef struct {
+    CombainConfig *cfg;
+    Section        sec;
+    ListenerSpec  *listener;
+    SerialSpec    *serial;
+    ScanDirSpec   *scan;
+    int            ownListeners;   // defaults dropped once the file declares one
+    int            ownSerials;
+    int            line;
+    char          *err;
+    size_t         errcap;
+} Parser;
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1])) e--;
+    *e = '\0';
+    return s;
+}
+
+// "value   ; note" -> "value   ". A ';' or '#' inside a value (URLs) is
+// kept unless whitespace precedes it.
+static char *strip_comment(char *v) {
+    for (char *c = v; *c; c++) {
+        if ((*c == ';' || *c == '#') && (c == v || isspace((unsigned char)c[-1]))) {
+            *c = '\0';
+            break;
+        }
+    }
+    return v;
+}
+
+static int fail(Parser *p, const char *what, const char *detail) {
+    snprintf(p->err, p->errcap, "line %d: %s%s%s", p->line, what, detail ? ": " : "", detail ? detail : "");
+    return 0;
+}
+
+static int parse_int(Parser *p, const char *key, const char *v, int lo, int hi, int *out) {
+    char *end;
+    errno = 0;
+    long n = strtol(v, &end, 10);
+    if (errno || end == v || *trim(end) || n < lo || n > hi) return fail(p, "bad number for", key);
+    *out = (int)n;
+    return 1;
+}
+
+static int parse_bool(Parser *p, const char *key, const char *v, int *out) {
+    if (!strcmp(v, "1") || !strcmp(v, "yes") || !strcmp(v, "true") || !strcmp(v, "on")) { *out = 1; return 1; }
+    if (!strcmp(v, "0") || !strcmp(v, "no") || !strcmp(v, "false") || !strcmp(v, "off")) { *out = 0; return 1; }
+    return fail(p, "bad boolean for", key);
+}
+
+static int parse_level(Parser *p, const char *key, const char *v, int *out) {
+    int level = log_level_parse(v);
+    if (level < 0) return fail(p, "expected debug, info, warn or error for", key);
+    *out = level;
+    return 1;
+}
+
+static int set_text(Parser *p, const char *key, char *dst, size_t cap, const char *v) {
+    if (strlen(v) >= cap) return fail(p, "value too long for", key);
+    copy_str(dst, cap, v);
+    return 1;
+}
+
+static int begin_section(Parser *p, char *hdr) {
+    char *name = hdr;
+    while (*name && !isspace((unsigned char)*name)) name++;
+    if (*name) *name++ = '\0';
+    name = trim(name);
+
+    p->listener = NULL;
+    p->serial = NULL;
+    p->scan = NULL;
+
+    if (!strcmp(hdr, "general"))   { p->sec = SEC_GENERAL;   return 1; }
+    if (!strcmp(hdr, "endpoints")) { p->sec = SEC_ENDPOINTS; return 1; }
+
+    int isListener = !strcmp(hdr, "listener");
+    int isScan = !strcmp(hdr, "scan");
+    if (!isListener && !isScan && strcmp(hdr, "serial")) return fail(p, "unknown section", hdr);
+    if (!*name) return fail(p, "section needs a name", hdr);
+    if (strlen(name) >= CONFIG_NAME_MAX) return fail(p, "name too long", name);
+
+    CombainConfig *cfg = p->cfg;
+    if (isScan) {
+        for (int i = 0; i < cfg->nscans; i++) {
+            if (!strcmp(cfg->scans[i].name, name)) return fail(p, "duplicate scan", name);
+        }
+        if (cfg->nscans == CONFIG_MAX_SCANS) return fail(p, "too many scan folders", NULL);
+        ScanDirSpec *d = &cfg->scans[cfg->nscans++];
+        memset(d, 0, sizeof(*d));
+        copy_str(d->name, sizeof(d->name), name);
+        p->scan = d;
+        p->sec = SEC_SCAN;
+    } else if (isListener) {
+        if (!p->ownListeners) { cfg->nlisteners = 0; p->ownListeners = 1; }
+        for (int i = 0; i < cfg->nlisteners; i++) {
+            if (!strcmp(cfg->listeners[i].name, name)) return fail(p, "duplicate listener", name);
+        }
+        if (cfg->nlisteners == CONFIG_MAX_LISTENERS) return fail(p, "too many listeners", NULL);
+        ListenerSpec *l = &cfg->listeners[cfg->nlisteners++];
+        listener_defaults(l, name);
+        p->listener = l;
+        p->sec = SEC_LISTENER;
+    } else {
+        if (!p->ownSerials) { cfg->nserials = 0; p->ownSerials = 1; }
+        for (int i = 0; i < cfg->nserials; i++) {
+            if (!strcmp(cfg->serials[i].name, name)) return fail(p, "duplicate serial", name);
+        }
+        if (cfg->nserials == CONFIG_MAX_SERIALS) return fail(p, "too many serial ports", NULL);
+        SerialSpec *s = &cfg->serials[cfg->nserials++];
+        memset(s, 0, sizeof(*s));
+        copy_str(s->name, sizeof(s->name), name);
+        s->baud = 19200;
+        s->queue = 1024;
+        s->enabled = 1;
+        p->serial = s;
+        p->sec = SEC_SERIAL;
+    }
+    return 1;
+}
+
+// -1: not an identity key.
+static int identity_key(Parser *p, IdentitySpec *id, const char *k, const char *v) {
+    if (!strcmp(k, "machine_id")) return set_text(p, k, id->machineId, sizeof(id->machineId), v);
+    if (!strcmp(k, "mac"))        return set_text(p, k, id->mac, sizeof(id->mac), v);
+    if (!strcmp(k, "cbc"))        return set_text(p, k, id->endpoints[1], sizeof(id->endpoints[1]), v);
+    if (!strcmp(k, "results"))    return set_text(p, k, id->endpoints[2], sizeof(id->endpoints[2]), v);
+    if (!strcmp(k, "urine"))      return set_text(p, k, id->endpoints[3], sizeof(id->endpoints[3]), v);
+    return -1;
+}
+
+// "peer_addr = f200 192.168.0.50" / "peer_sig = h360 H|\^&|||H360" add a
+// naming rule; "peer_machine_id = f200 MC0011" (likewise peer_mac,
+// peer_cbc, peer_results, peer_urine) sets the identity of the peer's
+// first rule, or of a rule of its own. -1: not a peer key.
+static int add_peer(Parser *p, ListenerSpec *l, const char *k, char *v) {
+    static const char *const ID_KEYS[] = { "machine_id", "mac", "cbc", "results", "urine" };
+    int naming = !strcmp(k, "peer_addr") || !strcmp(k, "peer_sig");
+    int known = naming;
+    for (size_t i = 0; i < sizeof(ID_KEYS) / sizeof(ID_KEYS[0]) && !known; i++) {
+        known = !strncmp(k, "peer_", 5) && !strcmp(k + 5, ID_KEYS[i]);
+    }
+    if (!known) return -1;
+
+    char *rest = v;
+    while (*rest && !isspace((unsigned char)*rest)) rest++;
+    if (*rest) *rest++ = '\0';
+    rest = trim(rest);
+    if (!*v || !*rest) return fail(p, "expected <peer name> <value> for", k);
+    if (strlen(v) >= CONFIG_NAME_MAX) return fail(p, "peer name too long", v);
+
+    PeerSpec *peer = NULL;
+    for (int i = 0; i < l->npeers && !naming && !peer; i++) {
+        if (!strcmp(l->peers[i].name, v)) peer = &l->peers[i];
+    }
+    if (!peer) {
+        if (l->npeers == CONFIG_MAX_PEERS) return fail(p, "too many peers", NULL);
+        peer = &l->peers[l->npeers++];
+        memset(peer, 0, sizeof(*peer));
+        copy_str(peer->name, sizeof(peer->name), v);
+    }
+    if (!strcmp(k, "peer_addr")) return set_text(p, k, peer->address, sizeof(peer->address), rest);
+    if (!strcmp(k, "peer_sig"))  return set_text(p, k, peer->signature, sizeof(peer->signature), rest);
+    return identity_key(p, &peer->id, k + 5, rest);
+}
+
+static int set_key(Parser *p, const char *k, char *v) {
+    CombainConfig *cfg = p->cfg;
+    int rc;
+
+    switch (p->sec) {
+    case SEC_GENERAL:
+        if (!strcmp(k, "scan_dir"))           return set_text(p, k, cfg->scanDir, sizeof(cfg->scanDir), v);
+        if (!strcmp(k, "machine_id"))         return set_text(p, k, cfg->machineId, sizeof(cfg->machineId), v);
+        if (!strcmp(k, "mac"))                return set_text(p, k, cfg->mac, sizeof(cfg->mac), v);
+        if (!strcmp(k, "upload_encoding"))    return set_text(p, k, cfg->encoding, sizeof(cfg->encoding), v);
+        if (!strcmp(k, "parse_workers"))      return parse_int(p, k, v, 0, 64, &cfg->parseWorkers);
+        if (!strcmp(k, "upload_connections")) return parse_int(p, k, v, 0, 256, &cfg->uploadConnections);
+        if (!strcmp(k, "scan_batch"))         return parse_int(p, k, v, 1, 256, &cfg->scanBatch);
+        if (!strcmp(k, "rescan_interval_ms")) return parse_int(p, k, v, 100, 86400000, &cfg->rescanMs);
+        if (!strcmp(k, "settle_ms"))          return parse_int(p, k, v, 0, 60000, &cfg->settleMs);
+        if (!strcmp(k, "sink_idle_ms"))       return parse_int(p, k, v, 10, 60000, &cfg->sinkIdleMs);
+        if (!strcmp(k, "metrics_port"))       return parse_int(p, k, v, 0, 65535, &cfg->metricsPort);
+        if (!strcmp(k, "trace_file"))         return set_text(p, k, cfg->traceFile, sizeof(cfg->traceFile), v);
+        if (!strcmp(k, "dedupe_file"))        return set_text(p, k, cfg->dedupeFile, sizeof(cfg->dedupeFile), v);
+        if (!strcmp(k, "dedupe_capacity"))    return parse_int(p, k, v, 1024, 4194304, &cfg->dedupeCapacity);
+        if (!strcmp(k, "dedupe_window_s"))    return parse_int(p, k, v, 0, 31536000, &cfg->dedupeWindowS);
+        if (!strcmp(k, "archive_dir"))        return set_text(p, k, cfg->archiveDir, sizeof(cfg->archiveDir), v);
+        if (!strcmp(k, "archive_segment_mb")) return parse_int(p, k, v, 1, 1024, &cfg->archiveSegmentMb);
+        if (!strcmp(k, "archive_compact_days")) return parse_int(p, k, v, 0, 3650, &cfg->archiveCompactDays);
+        if (!strcmp(k, "priority_stat_marker")) return set_text(p, k, cfg->priorityStatMarker, sizeof(cfg->priorityStatMarker), v);
+        if (!strcmp(k, "priority_tests"))     return set_text(p, k, cfg->priorityTests, sizeof(cfg->priorityTests), v);
+        if (!strcmp(k, "priority_aging_s"))   return parse_int(p, k, v, 0, 86400, &cfg->priorityAgingS);
+        if (!strcmp(k, "log_level"))          return parse_level(p, k, v, &cfg->logLevel);
+        if (!strcmp(k, "log_console"))        return parse_bool(p, k, v, &cfg->logConsole);
+        if (!strcmp(k, "log_file"))           return set_text(p, k, cfg->logFile, sizeof(cfg->logFile), v);
+        if (!strcmp(k, "log_max_kb"))         return parse_int(p, k, v, 0, 4194304, &cfg->logMaxKb);
+        if (!strcmp(k, "log_keep"))           return parse_int(p, k, v, 0, 99, &cfg->logKeep);
+        break;
+
+    case SEC_ENDPOINTS:
+        if (!strcmp(k, "cbc"))     return set_text(p, k, cfg->endpoints[1], sizeof(cfg->endpoints[1]), v);
+        if (!strcmp(k, "results")) return set_text(p, k, cfg->endpoints[2], sizeof(cfg->endpoints[2]), v);
+        if (!strcmp(k, "urine"))   return set_text(p, k, cfg->endpoints[3], sizeof(cfg->endpoints[3]), v);
+        break;
+
+    case SEC_LISTENER: {
+        ListenerSpec *l = p->listener;
+        if (!strcmp(k, "host"))    return set_text(p, k, l->host, sizeof(l->host), v);
+        if (!strcmp(k, "port"))    return parse_int(p, k, v, 1, 65535, &l->port);
+        if (!strcmp(k, "out"))     return set_text(p, k, l->outPath, sizeof(l->outPath), v);
+        if (!strcmp(k, "queue"))   return parse_int(p, k, v, 2, 1 << 20, &l->queue);
+        if (!strcmp(k, "enabled")) return parse_bool(p, k, v, &l->enabled);
+        if (!strcmp(k, "max_peers")) return parse_int(p, k, v, 1, 256, &l->maxPeers);
+        if (!strcmp(k, "keepalive"))            return parse_bool(p, k, v, &l->live.keepalive);
+        if (!strcmp(k, "keepalive_idle_s"))     return parse_int(p, k, v, 0, 86400, &l->live.keepIdleS);
+        if (!strcmp(k, "keepalive_interval_s")) return parse_int(p, k, v, 0, 3600, &l->live.keepIntervalS);
+        if (!strcmp(k, "keepalive_count"))      return parse_int(p, k, v, 0, 100, &l->live.keepCount);
+        if (!strcmp(k, "user_timeout_ms"))      return parse_int(p, k, v, 0, 86400000, &l->live.userTimeoutMs);
+        if (!strcmp(k, "idle_timeout_ms"))      return parse_int(p, k, v, 0, 86400000, &l->live.idleTimeoutMs);
+        if (!strcmp(k, "connect_timeout_ms"))   return parse_int(p, k, v, 0, 600000, &l->live.connectTimeoutMs);
+        if (!strcmp(k, "mode")) {
+            if (!strcmp(v, "client")) { l->server = 0; return 1; }
+            if (!strcmp(v, "server")) { l->server = 1; return 1; }
+            return fail(p, "mode must be client or server", v);
+        }
+        if ((rc = add_peer(p, l, k, v)) >= 0) return rc;
+        if ((rc = identity_key(p, &l->id, k, v)) >= 0) return rc;
+        break;
+    }
+
+    case SEC_SERIAL: {
+        SerialSpec *s = p->serial;
+        if (!strcmp(k, "device"))  return set_text(p, k, s->device, sizeof(s->device), v);
+        if (!strcmp(k, "baud"))    return parse_int(p, k, v, 50, 4000000, &s->baud);
+        if (!strcmp(k, "out"))     return set_text(p, k, s->outPath, sizeof(s->outPath), v);
+        if (!strcmp(k, "queue"))   return parse_int(p, k, v, 2, 1 << 20, &s->queue);
+        if (!strcmp(k, "enabled")) return parse_bool(p, k, v, &s->enabled);
+        if ((rc = identity_key(p, &s->id, k, v)) >= 0) return rc;
+        break;
+    }
+
+    case SEC_SCAN:
+        if (!strcmp(k, "dir")) return set_text(p, k, p->scan->dir, sizeof(p->scan->dir), v);
+        if ((rc = identity_key(p, &p->scan->id, k, v)) >= 0) return rc;
+        break;
+
+    default:
+        return fail(p, "key outside a section", k);
+    }
+
+    log_msg(LOG_WARN, "config", "⚠️  config line %d: unknown key '%s' ignored", p->line, k);
+    return 1;
+}
+
+static int check_complete(Parser *p) {
+    CombainConfig *cfg = p->cfg;
+    for (int i = 0; i < cfg->nlisteners; i++) {
+        ListenerSpec *l = &cfg->listeners[i];
+        if (l->server && !l->host[0]) copy_str(l->host, sizeof(l->host), "0.0.0.0");
+        if (l->enabled && (!l->host[0] || !l->port || !l->outPath[0])) {
+            snprintf(p->err, p->errcap, "listener %s: host, port and out are required", l->name);
+            return 0;
+        }
+    }
+    for (int i = 0; i < cfg->nserials; i++) {
+        const SerialSpec *s = &cfg->serials[i];
+        if (s->enabled && (!s->device[0] || !s->outPath[0])) {
+            snprintf(p->err, p->errcap, "serial %s: device and out are required", s->name);
+            return 0;
+        }
+    }
+    for (int i = 0; i < cfg->nscans; i++) {
+        if (!cfg->scans[i].dir[0]) {
+            snprintf(p->err, p->errcap, "scan %s: dir is required", cfg->scans[i].name);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void apply_env(CombainConfig *cfg) {
+    const char *v;
+    if ((v = getenv("MachineID")) && *v)       copy_str(cfg->machineId, sizeof(cfg->machineId), v);
+    if ((v = getenv("MAC")) && *v)             copy_str(cfg->mac, sizeof(cfg->mac), v);
+    if ((v = getenv("UPLOAD_ENCODING")) && *v) copy_str(cfg->encoding, sizeof(cfg->encoding), v);
+    if ((v = getenv("PARSE_WORKERS")))         cfg->parseWorkers = atoi(v);
+}
+
+int config_load(CombainConfig *cfg, const char *path, char *err, size_t errcap) {
+    config_defaults(cfg);
+    if (err && errcap) err[0] = '\0';
+
+    FILE *f = path ? fopen(path, "r") : NULL;
+    if (!f) {
+        apply_env(cfg);
+        return 0;
+    }
+
+    char dummy[8];
+    Parser p;
+    memset(&p, 0, sizeof(p));
+    p.cfg = cfg;
+    p.err = err ? err : dummy;
+    p.errcap = err ? errcap : sizeof(dummy);
+
+    char raw[1024];
+    int ok = 1;
+    while (ok && fgets(raw, sizeof(raw), f)) {
+        p.line++;
+        char *s = trim(raw);
+        if (!*s || *s == ';' || *s == '#') continue;
+
+        if (*s == '[') {
+            char *e = strchr(s, ']');
+            if (!e) { ok = fail(&p, "unterminated section header", NULL); break; }
+            *e = '\0';
+            ok = begin_section(&p, trim(s + 1));
+            continue;
+        }
+
+        char *eq = strchr(s, '=');
+        if (!eq) { ok = fail(&p, "expected key = value", s); break; }
+        *eq = '\0';
+        ok = set_key(&p, trim(s), trim(strip_comment(eq + 1)));
+    }
+    fclose(f);
+
+    if (ok) ok = check_complete(&p);
+    if (!ok) return -1;
+    apply_env(cfg);
+    return 1;
+}
+
+// ===============================================================
+//  Comparison helpers for reload
+// ===============================================================
+
+unsigned long long config_file_stamp(const char *path) {
+    struct stat st;
+    if (!path || stat(path, &st) != 0) return 0;
+    return ((unsigned long long)st.st_mtime << 20) ^ (unsigned long long)st.st_size ^ 1ull;
+}
+
+int config_listener_equal(const ListenerSpec *a, const ListenerSpec *b) {
+    if (strcmp(a->name, b->name) || strcmp(a->host, b->host) || a->port != b->port ||
+        strcmp(a->outPath, b->outPath) || a->queue != b->queue || a->enabled != b->enabled ||
+        a->server != b->server || a->maxPeers != b->maxPeers || a->npeers != b->npeers ||
+        memcmp(&a->live, &b->live, sizeof(a->live)) != 0) return 0;
+    for (int i = 0; i < a->npeers; i++) {
+        const PeerSpec *x = &a->peers[i], *y = &b->peers[i];
+        if (strcmp(x->name, y->name) || strcmp(x->address, y->address) ||
+            strcmp(x->signature, y->signature)) return 0;
+    }
+    return 1;
+}
+
+int config_serial_equal(const SerialSpec *a, const SerialSpec *b) {
+    return !strcmp(a->name, b->name) && !strcmp(a->device, b->device) && a->baud == b->baud &&
+           !strcmp(a->outPath, b->outPath) && a->queue == b->queue && a->enabled == b->enabled;
+}
+
+static int identity_equal(const IdentitySpec *a, const IdentitySpec *b) {
+    if (strcmp(a->machineId, b->machineId) || strcmp(a->mac, b->mac)) return 0;
+    for (int k = 0; k < 4; k++) {
+        if (strcmp(a->endpoints[k], b->endpoints[k])) return 0;
+    }
+    return 1;
+}
+
+int config_scanner_changed(const CombainConfig *a, const CombainConfig *b) {
+    if (strcmp(a->scanDir, b->scanDir) || strcmp(a->machineId, b->machineId) ||
+        strcmp(a->mac, b->mac) || strcmp(a->encoding, b->encoding)) return 1;
+    for (int k = 0; k < 4; k++) {
+        if (strcmp(a->endpoints[k], b->endpoints[k])) return 1;
+    }
+    if (a->parseWorkers != b->parseWorkers || a->uploadConnections != b->uploadConnections ||
+        a->scanBatch != b->scanBatch) return 1;
+    if (strcmp(a->priorityStatMarker, b->priorityStatMarker) || strcmp(a->priorityTests, b->priorityTests) ||
+        a->priorityAgingS != b->priorityAgingS) return 1;
+
+    // Folders and per-instrument identities.
+    if (a->nscans != b->nscans || a->nlisteners != b->nlisteners || a->nserials != b->nserials) return 1;
+    for (int i = 0; i < a->nscans; i++) {
+        if (strcmp(a->scans[i].dir, b->scans[i].dir) ||
+            !identity_equal(&a->scans[i].id, &b->scans[i].id)) return 1;
+    }
+    for (int i = 0; i < a->nlisteners; i++) {
+        const ListenerSpec *x = &a->listeners[i], *y = &b->listeners[i];
+        if (strcmp(x->outPath, y->outPath) || !identity_equal(&x->id, &y->id) ||
+            x->npeers != y->npeers) return 1;
+        for (int j = 0; j < x->npeers; j++) {
+            if (strcmp(x->peers[j].name, y->peers[j].name) ||
+                !identity_equal(&x->peers[j].id, &y->peers[j].id)) return 1;
+        }
+    }
+    for (int i = 0; i < a->nserials; i++) {
+        if (strcmp(a->serials[i].outPath, b->serials[i].outPath) ||
+            !identity_equal(&a->serials[i].id, &b->serials[i].id)) return 1;
+    }
+    return 0;
+}
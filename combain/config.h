@@ -0,0 +1,181 @@
+#ifndef COMBAIN_CONFIG_H
+#define COMBAIN_CONFIG_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * combain runtime configuration (INI file).
+ *
+ *   [general]   scan_dir, machine_id, mac, upload_encoding, parse_workers,
+ *               upload_connections, scan_batch, rescan_interval_ms,
+ *               settle_ms, sink_idle_ms, metrics_port, trace_file,
+ *               dedupe_file, dedupe_capacity, dedupe_window_s,
+ *               archive_dir, archive_segment_mb, archive_compact_days,
+ *               priority_stat_marker, priority_tests, priority_aging_s,
+ *               log_level, log_console, log_file, log_max_kb, log_keep
+ *   [endpoints] cbc, results, urine            (upload URL per analyser kind)
+ *   [listener <name>]  host, port, out, queue, enabled,
+ *                      mode (client | server), max_peers,
+ *                      peer_addr = <peer name> <ip>      (repeatable)
+ *                      peer_sig  = <peer name> <text>    (repeatable)
+ *                      peer_machine_id, peer_mac, peer_cbc, peer_results,
+ *                      peer_urine = <peer name> <value>  (peer identity)
+ *                      keepalive, keepalive_idle_s, keepalive_interval_s,
+ *                      keepalive_count, user_timeout_ms, idle_timeout_ms,
+ *                      connect_timeout_ms
+ *   [serial <name>]    device, baud, out, queue, enabled
+ *   [scan <name>]      dir                     (another folder to drain)
+ *
+ * Listener, serial and scan sections may also carry their own identity:
+ * machine_id, mac and the cbc / results / urine upload URLs. Result files
+ * a listener or serial port writes (its 'out' file and the spill file next
+ * to it) are uploaded with that identity, other files in a scan folder
+ * with the folder's, anything unset falls back to [general] / [endpoints].
+ * A server-mode peer's identity covers its own capture file and falls
+ * back to the listener's.
+ * One process can so serve several instruments with one worker pool and
+ * one set of upload connections.
+ *
+ * Anything not set keeps the built-in default (the values combain always
+ * had). Declaring any [listener ...] replaces the default listeners, and
+ * likewise for [serial ...]; 'enabled = no' keeps an instance declared
+ * but stopped. Lines starting with ';' or '#' are comments.
+ *
+ * The environment still wins over the file for MachineID, MAC,
+ * UPLOAD_ENCODING and PARSE_WORKERS.
+ */
+
+#define CONFIG_MAX_LISTENERS 16
+#define CONFIG_MAX_SERIALS   4
+#define CONFIG_MAX_SCANS     8
+#define CONFIG_MAX_PEERS     16
+#define CONFIG_NAME_MAX      32
+#define CONFIG_PATH_MAX      512
+
+/** Per-instrument overrides; empty strings inherit. */
+typedef struct {
+    char machineId[64];
+    char mac[64];
+    char endpoints[4][CONFIG_PATH_MAX];   // indexed by AnalyserKind
+} IdentitySpec;
+
+/** Server mode: names an analyser that dialled in (address or signature). */
+typedef struct {
+    char name[CONFIG_NAME_MAX];
+    char address[64];
+    char signature[128];
+    IdentitySpec id;           // set on the peer's first rule
+} PeerSpec;
+
+/** Dead-peer detection for one listener (0 = system default / off). */
+typedef struct {
+    int keepalive;
+    int keepIdleS;
+    int keepIntervalS;
+    int keepCount;
+    int userTimeoutMs;
+    int idleTimeoutMs;          // quiet for this long: reconnect (0 = never)
+    int connectTimeoutMs;
+} LivenessSpec;
+
+typedef struct {
+    char name[CONFIG_NAME_MAX];
+    char host[64];              // server: bind address (default any)
+    int  port;
+    char outPath[CONFIG_PATH_MAX];
+    int  queue;                 // capture queue capacity (server: per peer)
+    int  enabled;
+    int  server;                // accept analysers instead of dialling out
+    int  maxPeers;
+    PeerSpec peers[CONFIG_MAX_PEERS];
+    int      npeers;
+    LivenessSpec live;
+    IdentitySpec id;
+} ListenerSpec;
+
+typedef struct {
+    char name[CONFIG_NAME_MAX];
+    char device[128];
+    int  baud;
+    char outPath[CONFIG_PATH_MAX];
+    int  queue;
+    int  enabled;
+    IdentitySpec id;
+} SerialSpec;
+
+typedef struct {
+    char name[CONFIG_NAME_MAX];
+    char dir[CONFIG_PATH_MAX];
+    IdentitySpec id;
+} ScanDirSpec;
+
+typedef struct {
+    char scanDir[CONFIG_PATH_MAX];
+    char machineId[64];
+    char mac[64];
+    char encoding[16];
+    char endpoints[4][CONFIG_PATH_MAX];   // indexed by AnalyserKind
+
+    int parseWorkers;        // 0 = one per CPU
+    int uploadConnections;   // 0 = one per parse worker
+    int scanBatch;           // files per parse/upload batch
+    int rescanMs;            // retry / fallback rescan interval
+    int settleMs;            // quiet time after a folder change
+    int sinkIdleMs;          // capture idle time that marks a finished result
+    int metricsPort;         // GET /metrics on 127.0.0.1 (0 = off)
+    char traceFile[CONFIG_PATH_MAX];   // per-result latency records ("" = off)
+    char dedupeFile[CONFIG_PATH_MAX];  // index of uploaded results ("" = off)
+    int  dedupeCapacity;     // results the index remembers
+    int  dedupeWindowS;      // a repeat this much later is uploaded again (0 = never)
+    char archiveDir[CONFIG_PATH_MAX];  // archive of uploaded results ("" = off)
+    int  archiveSegmentMb;   // seal an archive segment past this size
+    int  archiveCompactDays; // deflate sealed segments this old (0 = never)
+    char priorityStatMarker[32];          // in a sample ID: upload first ("" = none)
+    char priorityTests[CONFIG_PATH_MAX];  // test codes uploaded ahead of routine ones
+    int  priorityAgingS;     // waiting this long counts as one priority level (0 = never)
+    int  logLevel;           // LogLevel: debug, info, warn, error
+    int  logConsole;         // echo the log to stdout / stderr
+    char logFile[CONFIG_PATH_MAX];     // "" = console only
+    int  logMaxKb;           // rotate the log file beyond this (0 = never)
+    int  logKeep;            // rotated log files kept
+
+    ListenerSpec listeners[CONFIG_MAX_LISTENERS];
+    int          nlisteners;
+    SerialSpec   serials[CONFIG_MAX_SERIALS];
+    int          nserials;
+    ScanDirSpec  scans[CONFIG_MAX_SCANS];
+    int          nscans;
+} CombainConfig;
+
+/** Built-in defaults. */
+void config_defaults(CombainConfig *cfg);
+
+/**
+ * Defaults, then 'path', then the environment overrides.
+ * Returns 1 if the file was read, 0 if it does not exist (defaults are
+ * used), -1 on a syntax error ('err' says where; 'cfg' is then undefined).
+ */
+int config_load(CombainConfig *cfg, const char *path, char *err, size_t errcap);
+
+/** Monotonic-enough change stamp of 'path' (mtime ^ size); 0 if missing. */
+unsigned long long config_file_stamp(const char *path);
+
+/** 1 if the capture side is the same (identity is the scanner's concern). */
+int config_listener_equal(const ListenerSpec *a, const ListenerSpec *b);
+int config_serial_equal(const SerialSpec *a, const SerialSpec *b);
+
+/**
+ * 1 if the scanner (pool, pipeline, uploads, instrument identities) must
+ * be rebuilt.
+ */
+int config_scanner_changed(const CombainConfig *a, const CombainConfig *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMBAIN_CONFIG_H
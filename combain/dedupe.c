@@ -0,0 +1,348 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "dedupe.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
+#define DEDUPE_PATH_MAX 512
+#define DEDUPE_MAX_CAP  (1u << 22)
+
+// Bloom filter: 2^n bits, at least 20 per ring slot because keys that left
+// the ring keep their bits until the ring wraps and the filter is rebuilt
+// (so up to twice 'capacity' keys are in it). 7 probes: about 1 % false
+// positives at that fill.
+#define BLOOM_BITS_PER_SLOT 20
+#define BLOOM_PROBES        7
+
+typedef struct {
+    uint64_t key;
+    uint64_t time;
+} Slot;
+
+static Slot     *g_ring;          // NULL = no index
+static uint32_t  g_cap;
+static uint32_t  g_next;          // slot the next key goes to
+static uint64_t *g_bloom;
+static uint64_t  g_bloomMask;     // bits - 1
+static uint32_t *g_index;         // open addressing: ring slot + 1 by key, 0 = empty
+static uint32_t  g_indexMask;     // entries - 1, at least twice g_cap
+static int       g_windowS;
+static FILE     *g_file;
+static char      g_path[DEDUPE_PATH_MAX];
+static int       g_writeFailed;   // warned once
+
+#ifdef _WIN32
+static SRWLOCK g_lock = SRWLOCK_INIT;
+#define DEDUPE_LOCK()   AcquireSRWLockExclusive(&g_lock)
+#define DEDUPE_UNLOCK() ReleaseSRWLockExclusive(&g_lock)
+#else
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+#define DEDUPE_LOCK()   pthread_mutex_lock(&g_lock)
+#define DEDUPE_UNLOCK() pthread_mutex_unlock(&g_lock)
+#endif
+
+// ===============================================================
+//  Keys
+// ===============================================================
+
+uint64_t dedupe_key(const AnalyserRecord *rec) {
+    if (!rec->sampleId[0] && rec->nresults < DEDUPE_MIN_RESULTS) return 0;
+    return record_content_hash(rec);
+}
+
+void dedupe_header(uint64_t key, char *buf, size_t cap) {
+    snprintf(buf, cap, "Idempotency-Key: %016llx", (unsigned long long)key);
+}
+
+// ===============================================================
+//  Bloom filter (double hashing over the key, which is mixed already)
+// ===============================================================
+
+static void bloom_add(uint64_t key) {
+    uint64_t h2 = ((key >> 32) | (key << 32)) | 1;
+    for (int i = 0; i < BLOOM_PROBES; i++) {
+        uint64_t bit = (key + (uint64_t)i * h2) & g_bloomMask;
+        g_bloom[bit >> 6] |= 1ull << (bit & 63);
+    }
+}
+
+static int bloom_maybe(uint64_t key) {
+    uint64_t h2 = ((key >> 32) | (key << 32)) | 1;
+    for (int i = 0; i < BLOOM_PROBES; i++) {
+        uint64_t bit = (key + (uint64_t)i * h2) & g_bloomMask;
+        if (!(g_bloom[bit >> 6] & (1ull << (bit & 63)))) return 0;
+    }
+    return 1;
+}
+
+static void bloom_rebuild(void) {
+    memset(g_bloom, 0, (size_t)((g_bloomMask + 1) / 8));
+    for (uint32_t i = 0; i < g_cap; i++) {
+        if (g_ring[i].key) bloom_add(g_ring[i].key);
+    }
+}
+
+// ===============================================================
+//  Index: the ring slot holding each key, newest wins (linear probing)
+// ===============================================================
+
+static uint32_t index_home(uint64_t key) {
+    return (uint32_t)(key >> 32) & g_indexMask;   // the key is mixed already
+}
+
+// The entry for 'key', or the empty one it would go to.
+static uint32_t *index_find(uint64_t key) {
+    uint32_t h = index_home(key);
+    while (g_index[h] && g_ring[g_index[h] - 1].key != key) h = (h + 1) & g_indexMask;
+    return &g_index[h];
+}
+
+static void index_put(uint32_t slot) {
+    *index_find(g_ring[slot].key) = slot + 1;
+}
+
+// Before ring slot 'slot' is overwritten. An older copy of a key that was
+// added again is not indexed and leaves nothing to remove.
+static void index_remove(uint32_t slot) {
+    uint32_t *e = index_find(g_ring[slot].key);
+    if (*e != slot + 1) return;
+
+    // Backward shift: move up every later entry of the run that may not sit
+    // past the hole, so lookups never stop short.
+    uint32_t hole = (uint32_t)(e - g_index), j = hole;
+    for (;;) {
+        j = (j + 1) & g_indexMask;
+        if (!g_index[j]) break;
+        uint32_t home = index_home(g_ring[g_index[j] - 1].key);
+        int stays = hole <= j ? (home > hole && home <= j) : (home > hole || home <= j);
+        if (stays) continue;
+        g_index[hole] = g_index[j];
+        hole = j;
+    }
+    g_index[hole] = 0;
+}
+
+static void index_rebuild(void) {
+    memset(g_index, 0, ((size_t)g_indexMask + 1) * sizeof(uint32_t));
+    for (uint32_t n = 0; n < g_cap; n++) {
+        uint32_t i = (g_next + n) % g_cap;   // oldest first
+        if (g_ring[i].key) index_put(i);
+    }
+}
+
+// ===============================================================
+//  File
+// ===============================================================
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static int write_header(FILE *f) {
+    unsigned char h[DEDUPE_FILE_HEADER];
+    memcpy(h, DEDUPE_FILE_MAGIC, 8);
+    put_u32(h + 8, g_cap);
+    put_u32(h + 12, g_next);
+    return fseek(f, 0, SEEK_SET) == 0 && fwrite(h, sizeof(h), 1, f) == 1;
+}
+
+static int write_slot(FILE *f, uint32_t i) {
+    unsigned char s[DEDUPE_FILE_SLOT];
+    put_u64(s, g_ring[i].key);
+    put_u64(s + 8, g_ring[i].time);
+    return fseek(f, (long)(DEDUPE_FILE_HEADER + (size_t)i * DEDUPE_FILE_SLOT), SEEK_SET) == 0 &&
+           fwrite(s, sizeof(s), 1, f) == 1;
+}
+
+// The whole ring, for a new file or a new capacity.
+static FILE *write_file(const char *path) {
+    FILE *f = fopen(path, "w+b");
+    if (!f) return NULL;
+    int ok = write_header(f);
+    for (uint32_t i = 0; ok && i < g_cap; i++) ok = write_slot(f, i);
+    if (!ok || fflush(f) != 0) {
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+// Keys of an existing file into the (empty) ring. With another capacity
+// they are replayed oldest first, so the newest g_cap survive a smaller
+// ring. Returns 1 if the file can be kept as it is, 0 if it must be
+// rewritten, -1 if it is not an index at all.
+static int load_file(FILE *f) {
+    unsigned char h[DEDUPE_FILE_HEADER];
+    if (fread(h, sizeof(h), 1, f) != 1) return 0;   // empty or cut short: start over
+    if (memcmp(h, DEDUPE_FILE_MAGIC, 8) != 0) return -1;
+    uint32_t cap = get_u32(h + 8), next = get_u32(h + 12);
+    if (cap == 0 || cap > DEDUPE_MAX_CAP || next >= cap) return 0;
+
+    Slot *old = cap == g_cap ? g_ring : (Slot *)calloc(cap, sizeof(Slot));
+    if (!old) return 0;
+    uint32_t n = 0;
+    unsigned char s[DEDUPE_FILE_SLOT];
+    while (n < cap && fread(s, sizeof(s), 1, f) == 1) {
+        old[n].key = get_u64(s);
+        old[n].time = get_u64(s + 8);
+        n++;
+    }
+    if (old == g_ring) {
+        g_next = next;
+        return n == cap;
+    }
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < cap; i++) {
+        const Slot *o = &old[(next + i) % cap];
+        if (o->key) g_ring[kept++ % g_cap] = *o;
+    }
+    g_next = kept % g_cap;   // past the newest; the oldest if it wrapped
+    free(old);
+    return 0;
+}
+
+// ===============================================================
+//  Public API
+// ===============================================================
+
+static void close_locked(void) {
+    if (g_file) fclose(g_file);
+    g_file = NULL;
+    free(g_ring);
+    free(g_bloom);
+    free(g_index);
+    g_ring = NULL;
+    g_bloom = NULL;
+    g_index = NULL;
+    g_cap = g_next = 0;
+    g_path[0] = '\0';
+}
+
+int dedupe_open(const char *path, int capacity, int windowS) {
+    DEDUPE_LOCK();
+    close_locked();
+    if (!path || !path[0]) {
+        DEDUPE_UNLOCK();
+        return 1;
+    }
+
+    g_cap = capacity < 1 ? 1 : (uint32_t)capacity > DEDUPE_MAX_CAP ? DEDUPE_MAX_CAP : (uint32_t)capacity;
+    g_windowS = windowS > 0 ? windowS : 0;
+    uint64_t bits = 1024;
+    while (bits < (uint64_t)g_cap * BLOOM_BITS_PER_SLOT) bits <<= 1;
+    g_bloomMask = bits - 1;
+    uint32_t entries = 16;
+    while (entries < 2 * g_cap) entries <<= 1;
+    g_indexMask = entries - 1;
+    g_ring = (Slot *)calloc(g_cap, sizeof(Slot));
+    g_bloom = (uint64_t *)calloc((size_t)(bits / 64), sizeof(uint64_t));
+    g_index = (uint32_t *)calloc(entries, sizeof(uint32_t));
+    if (!g_ring || !g_bloom || !g_index) {
+        close_locked();
+        DEDUPE_UNLOCK();
+        return 0;
+    }
+
+    int rc = 0;
+    FILE *f = fopen(path, "r+b");
+    if (f) {
+        rc = load_file(f);
+        if (rc < 0) {
+            fclose(f);
+            log_msg(LOG_ERROR, "dedupe", "❌ %s is not a dedupe index, leaving it alone", path);
+            close_locked();
+            DEDUPE_UNLOCK();
+            return 0;
+        }
+        if (rc == 0) {
+            fclose(f);
+            f = NULL;
+        }
+    }
+    if (!f) f = write_file(path);
+    if (!f) {
+        close_locked();
+        DEDUPE_UNLOCK();
+        return 0;
+    }
+
+    g_file = f;
+    g_writeFailed = 0;
+    snprintf(g_path, sizeof(g_path), "%s", path);
+    bloom_rebuild();
+    index_rebuild();
+    DEDUPE_UNLOCK();
+    return 1;
+}
+
+void dedupe_close(void) {
+    DEDUPE_LOCK();
+    close_locked();
+    DEDUPE_UNLOCK();
+}
+
+int dedupe_seen(uint64_t key) {
+    if (!key) return 0;
+    int seen = 0;
+    DEDUPE_LOCK();
+    if (g_ring && bloom_maybe(key)) {
+        uint32_t e = *index_find(key);
+        if (e) seen = g_windowS == 0 || (uint64_t)time(NULL) - g_ring[e - 1].time < (uint64_t)g_windowS;
+    }
+    DEDUPE_UNLOCK();
+    return seen;
+}
+
+void dedupe_add(uint64_t key) {
+    if (!key) return;
+    DEDUPE_LOCK();
+    if (!g_ring) {
+        DEDUPE_UNLOCK();
+        return;
+    }
+
+    uint32_t i = g_next;
+    if (g_ring[i].key) index_remove(i);
+    g_ring[i].key = key;
+    g_ring[i].time = (uint64_t)time(NULL);
+    index_put(i);
+    g_next = (i + 1) % g_cap;
+    bloom_add(key);
+    if (g_next == 0) bloom_rebuild();   // a lap done: forget keys that left the ring
+
+    // Slot first, then the header that points past it: a crash in between
+    // at worst loses this one key.
+    int ok = write_slot(g_file, i) && write_header(g_file) && fflush(g_file) == 0;
+    if (!ok && !g_writeFailed) {
+        g_writeFailed = 1;
+        log_msg(LOG_WARN, "dedupe", "⚠️  Cannot write %s: uploads are remembered until restart only", g_path);
+    }
+    DEDUPE_UNLOCK();
+}
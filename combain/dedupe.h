@@ -0,0 +1,77 @@
+#ifndef COMBAIN_DEDUPE_H
+#define COMBAIN_DEDUPE_H
+
+#include "analyser_record.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Results that were uploaded already, by content hash.
+ *
+ * The same report can reach the scanner twice: the analyser retransmits
+ * it, it is captured over TCP and dropped into a folder as well, or
+ * combain stops between an upload succeeding and the file being deleted.
+ * Every result that identifies itself gets a key (dedupe_key()); it is
+ * sent as the Idempotency-Key header, and with an index open the scanner
+ * deletes a result whose key was uploaded within the window instead of
+ * sending it again.
+ *
+ * The index is a ring of the last 'capacity' keys with their upload time,
+ * kept in memory and mirrored to a file so it survives a restart, with a
+ * Bloom filter in front (about 1 % false positives) so a result that was
+ * never seen costs a few bit tests; only a "maybe" looks the key up in a
+ * hash index of the ring. The ring is first in, first out: a duplicate
+ * does not refresh its key, so the window counts from the upload.
+ *
+ * File layout, all integers little-endian: a 16-byte header ("CBDEDUP1",
+ * u32 capacity, u32 next slot) followed by 'capacity' slots of
+ *   u64 key       0 = empty
+ *   u64 time      upload time, seconds since 1970
+ *
+ * All functions are thread-safe.
+ */
+
+#define DEDUPE_FILE_MAGIC  "CBDEDUP1"
+#define DEDUPE_FILE_HEADER 16
+#define DEDUPE_FILE_SLOT   16
+
+/** Results with fewer values and no sample ID get no key (see dedupe_key). */
+#define DEDUPE_MIN_RESULTS 4
+
+/**
+ * Idempotency key of a parsed record (its identity set), 0 for none.
+ * Only records that tell one sample from another get one: a sample ID, or
+ * at least DEDUPE_MIN_RESULTS values. A single H360 result line ("GLU
+ * 5.6") is the same text for any patient with that value and stays
+ * keyless, so it is never taken for a duplicate.
+ */
+uint64_t dedupe_key(const AnalyserRecord *rec);
+
+/** "Idempotency-Key: <16 hex digits>" for 'key'. */
+void dedupe_header(uint64_t key, char *buf, size_t cap);
+
+/**
+ * Keep the index in 'path' (created if missing, resized if 'capacity'
+ * changed, keeping the newest keys); a key counts as uploaded for
+ * 'windowS' seconds (0 = as long as it is in the ring). NULL or "" closes
+ * the index. Returns 1 on success; on failure the index is closed.
+ */
+int  dedupe_open(const char *path, int capacity, int windowS);
+void dedupe_close(void);
+
+/** 1 if 'key' was uploaded within the window. 0 for key 0 or no index. */
+int  dedupe_seen(uint64_t key);
+
+/** 'key' was uploaded just now. Flushed to the file before returning. */
+void dedupe_add(uint64_t key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMBAIN_DEDUPE_H
@@ -0,0 +1,88 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "dir_watch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+  #include <sys/inotify.h>
+  #include <unistd.h>
+#endif
+
+struct DirWatch {
+    int        fd;
+    int        wd;
+    EvIo      *io;
+    DirWatchFn fn;
+    void      *ctx;
+};
+
+#ifdef __linux__
+
+static void on_readable(void *ctx, int revents) {
+    struct DirWatch *dw = (struct DirWatch *)ctx;
+    (void)revents;
+
+    // Aligned for struct inotify_event, as inotify(7) recommends.
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t n = read(dw->fd, buf, sizeof(buf));
+        if (n <= 0) break;   // EAGAIN: drained
+
+        for (char *p = buf; p < buf + n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->mask & IN_Q_OVERFLOW) dw->fn(dw->ctx, "");
+            else if (ev->len > 0) dw->fn(dw->ctx, ev->name);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+}
+
+DirWatch *dir_watch_open(EventLoop *loop, const char *dir, DirWatchFn fn, void *ctx) {
+    struct DirWatch *dw = (struct DirWatch *)calloc(1, sizeof(*dw));
+    if (!dw) return NULL;
+    dw->fn  = fn;
+    dw->ctx = ctx;
+
+    dw->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (dw->fd < 0) {
+        perror("[dir_watch] inotify_init1");
+        free(dw);
+        return NULL;
+    }
+    dw->wd = inotify_add_watch(dw->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (dw->wd < 0) {
+        perror("[dir_watch] inotify_add_watch");
+        close(dw->fd);
+        free(dw);
+        return NULL;
+    }
+    dw->io = ev_io_add(loop, dw->fd, EV_READ, on_readable, dw);
+    if (!dw->io) {
+        close(dw->fd);
+        free(dw);
+        return NULL;
+    }
+    return dw;
+}
+
+void dir_watch_close(DirWatch *dw) {
+    if (!dw) return;
+    ev_io_remove(dw->io);
+    close(dw->fd);
+    free(dw);
+}
+
+#else // no notification API usable from the loop
+
+DirWatch *dir_watch_open(EventLoop *loop, const char *dir, DirWatchFn fn, void *ctx) {
+    (void)loop; (void)dir; (void)fn; (void)ctx;
+    return NULL;
+}
+
+void dir_watch_close(DirWatch *dw) {
+    (void)dw;
+}
+
+#endif
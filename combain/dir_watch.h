@@ -0,0 +1,32 @@
+#ifndef DIR_WATCH_H
+#define DIR_WATCH_H
+
+#include "event_loop.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Directory change notifications on the event loop (inotify on Linux):
+ * reports files in 'dir' that were closed after writing or moved in.
+ *
+ * Where this is not available dir_watch_open() returns NULL and the caller
+ * falls back to periodic rescans.
+ */
+
+typedef struct DirWatch DirWatch;
+
+/** 'name' is the file name within the directory. */
+typedef void (*DirWatchFn)(void *ctx, const char *name);
+
+DirWatch *dir_watch_open(EventLoop *loop, const char *dir, DirWatchFn fn, void *ctx);
+
+/** Safe to call with NULL. */
+void dir_watch_close(DirWatch *dw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIR_WATCH_H
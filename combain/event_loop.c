@@ -0,0 +1,888 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "event_loop.h"
+#include "logger.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #include <windows.h>
+  #pragma comment(lib, "ws2_32.lib")
+#else
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <pthread.h>
+  #include <unistd.h>
+  #ifdef __linux__
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+    #define EV_HAVE_EPOLL 1
+  #endif
+  #if defined(HAVE_LIBURING) && defined(__linux__)
+    #include <liburing.h>
+    #define EV_HAVE_URING 1
+  #endif
+#endif
+
+typedef enum {
+    BACKEND_POLL = 0,   // poll() / WSAPoll()
+    BACKEND_EPOLL,
+    BACKEND_URING
+} Backend;
+
+#define EPOLL_BATCH 64
+
+#ifdef EV_HAVE_URING
+// One per outstanding POLL_ADD. Removing or re-arming a watcher detaches
+// its arm (io = NULL) instead of waiting for the cancel to complete, so the
+// watcher can be freed at once; the stale completion just frees the arm.
+typedef struct UringArm {
+    EvIo            *io;
+    struct UringArm *prev, *next;
+} UringArm;
+#endif
+
+struct EvIo {
+    EventLoop *loop;
+    EvSocket   fd;
+    int        events;
+    EvIoFn     fn;
+    void      *ctx;
+    int        index;       // in loop->ios
+    int        dead;        // removed; freed at the end of the iteration
+    int        registered;  // epoll: currently in the interest set
+#ifdef EV_HAVE_URING
+    UringArm  *arm;
+#endif
+};
+
+struct EvTimer {
+    EventLoop         *loop;
+    EvTimerFn          fn;
+    void              *ctx;
+    unsigned long long due;
+    long               repeatMs;
+    int                heapIndex;   // -1 = not armed
+};
+
+struct EvAsync {
+    EventLoop      *loop;
+    EvPostFn        fn;
+    void           *ctx;
+    atomic_int      pending;
+    struct EvAsync *prev, *next;
+};
+
+typedef struct PostItem {
+    EvPostFn         fn;
+    void            *ctx;
+    struct PostItem *next;
+} PostItem;
+
+struct EventLoop {
+    Backend backend;
+
+    EvIo  **ios;
+    int     nios, capIos;
+    EvIo  **dead;
+    int     ndead, capDead;
+
+    EvTimer **heap;
+    int       nheap, capHeap;
+
+    unsigned long long now;
+    atomic_int stopRequested;
+    atomic_int wakePending;
+
+    // Wakeup channel for stop/post from other threads.
+#ifdef _WIN32
+    SOCKET wakeSock;            // UDP socket connected to itself
+    CRITICAL_SECTION postLock;
+#else
+    int wakeRead, wakeWrite;    // eventfd: both the same fd
+    pthread_mutex_t postLock;
+#endif
+    EvIo     *wakeIo;
+    PostItem *postHead, *postTail;
+    EvAsync  *asyncs;           // loop thread only
+
+    // poll backend scratch
+#ifdef _WIN32
+    WSAPOLLFD *pfds;
+#else
+    struct pollfd *pfds;
+#endif
+    EvIo **pios;
+    int    capPfds;
+
+#ifdef EV_HAVE_EPOLL
+    int epfd;
+#endif
+#ifdef EV_HAVE_URING
+    struct io_uring ring;
+    UringArm       *arms;       // every outstanding arm, for destroy
+#endif
+};
+
+static unsigned long long mono_ms(void) {
+#ifdef _WIN32
+    return (unsigned long long)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ull + (unsigned long long)ts.tv_nsec / 1000000;
+#endif
+}
+
+static int grow(void **arr, int *cap, int need, size_t elem) {
+    if (need <= *cap) return 1;
+    int n = *cap ? *cap * 2 : 16;
+    while (n < need) n *= 2;
+    void *p = realloc(*arr, (size_t)n * elem);
+    if (!p) return 0;
+    *arr = p;
+    *cap = n;
+    return 1;
+}
+
+// ===============================================================
+//  Timer heap (min-heap on 'due')
+// ===============================================================
+
+static void heap_swap(EventLoop *loop, int a, int b) {
+    EvTimer *t = loop->heap[a];
+    loop->heap[a] = loop->heap[b];
+    loop->heap[b] = t;
+    loop->heap[a]->heapIndex = a;
+    loop->heap[b]->heapIndex = b;
+}
+
+static void heap_up(EventLoop *loop, int i) {
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (loop->heap[p]->due <= loop->heap[i]->due) break;
+        heap_swap(loop, i, p);
+        i = p;
+    }
+}
+
+static void heap_down(EventLoop *loop, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < loop->nheap && loop->heap[l]->due < loop->heap[m]->due) m = l;
+        if (r < loop->nheap && loop->heap[r]->due < loop->heap[m]->due) m = r;
+        if (m == i) break;
+        heap_swap(loop, i, m);
+        i = m;
+    }
+}
+
+static void heap_remove(EventLoop *loop, EvTimer *t) {
+    int i = t->heapIndex;
+    if (i < 0) return;
+    t->heapIndex = -1;
+    loop->nheap--;
+    if (i == loop->nheap) return;
+    loop->heap[i] = loop->heap[loop->nheap];
+    loop->heap[i]->heapIndex = i;
+    heap_down(loop, i);
+    heap_up(loop, i);
+}
+
+static int heap_push(EventLoop *loop, EvTimer *t) {
+    if (!grow((void **)&loop->heap, &loop->capHeap, loop->nheap + 1, sizeof(EvTimer *))) return 0;
+    t->heapIndex = loop->nheap;
+    loop->heap[loop->nheap++] = t;
+    heap_up(loop, t->heapIndex);
+    return 1;
+}
+
+static long next_timeout(EventLoop *loop) {
+    if (loop->nheap == 0) return -1;
+    unsigned long long due = loop->heap[0]->due;
+    if (due <= loop->now) return 0;
+    unsigned long long d = due - loop->now;
+    return d > 60000 ? 60000 : (long)d;
+}
+
+static void run_timers(EventLoop *loop) {
+    while (loop->nheap > 0 && loop->heap[0]->due <= loop->now) {
+        EvTimer *t = loop->heap[0];
+        heap_remove(loop, t);
+        if (t->repeatMs > 0) {
+            t->due = loop->now + (unsigned long long)t->repeatMs;
+            heap_push(loop, t);
+        }
+        t->fn(t->ctx);   // may stop or free t
+    }
+}
+
+// ===============================================================
+//  Backends
+// ===============================================================
+
+#ifdef EV_HAVE_URING
+static unsigned uring_mask(int events) {
+    unsigned m = 0;
+    if (events & EV_READ)  m |= POLLIN;
+    if (events & EV_WRITE) m |= POLLOUT;
+    return m;
+}
+
+static struct io_uring_sqe *uring_sqe(EventLoop *loop) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&loop->ring);
+    if (!sqe) {
+        io_uring_submit(&loop->ring);
+        sqe = io_uring_get_sqe(&loop->ring);
+    }
+    return sqe;
+}
+
+static void uring_arm(EvIo *io) {
+    EventLoop *loop = io->loop;
+    if (io->arm || !io->events || io->dead) return;
+
+    struct io_uring_sqe *sqe = uring_sqe(loop);
+    UringArm *a = (UringArm *)calloc(1, sizeof(UringArm));
+    if (!sqe || !a) {
+        free(a);
+        log_msg(LOG_ERROR, "event_loop", "❌ io_uring: cannot arm fd %d", (int)io->fd);
+        return;
+    }
+    a->io = io;
+    a->next = loop->arms;
+    if (loop->arms) loop->arms->prev = a;
+    loop->arms = a;
+
+    io_uring_prep_poll_add(sqe, io->fd, uring_mask(io->events));
+    io_uring_sqe_set_data(sqe, a);
+    io->arm = a;
+}
+
+static void uring_disarm(EvIo *io) {
+    UringArm *a = io->arm;
+    if (!a) return;
+    a->io = NULL;
+    io->arm = NULL;
+
+    struct io_uring_sqe *sqe = uring_sqe(io->loop);
+    if (!sqe) return;   // the poll fires eventually and frees the arm
+    // POLL_REMOVE by user_data; spelled out because the liburing helper
+    // changed signature between releases.
+    io_uring_prep_rw(IORING_OP_POLL_REMOVE, sqe, -1, NULL, 0, 0);
+    sqe->addr = (unsigned long long)(uintptr_t)a;
+    io_uring_sqe_set_data(sqe, NULL);
+}
+
+static void uring_unlink(EventLoop *loop, UringArm *a) {
+    if (a->prev) a->prev->next = a->next; else loop->arms = a->next;
+    if (a->next) a->next->prev = a->prev;
+    free(a);
+}
+
+static int uring_wait(EventLoop *loop, long timeout) {
+    struct io_uring_cqe *cqe = NULL;
+    int rc;
+    io_uring_submit(&loop->ring);
+    if (timeout < 0) {
+        rc = io_uring_wait_cqe(&loop->ring, &cqe);
+    } else {
+        struct __kernel_timespec ts;
+        ts.tv_sec  = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000L;
+        rc = io_uring_wait_cqe_timeout(&loop->ring, &cqe, &ts);
+    }
+    if (rc == -ETIME || rc == -EINTR) return 0;
+    if (rc < 0) {
+        log_msg(LOG_ERROR, "event_loop", "❌ io_uring wait: %s", strerror(-rc));
+        return -1;
+    }
+
+    loop->now = mono_ms();
+    while (io_uring_peek_cqe(&loop->ring, &cqe) == 0) {
+        UringArm *a = (UringArm *)io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(&loop->ring, cqe);
+        if (!a) continue;   // a POLL_REMOVE completing
+
+        EvIo *io = a->io;
+        uring_unlink(loop, a);
+        if (!io || io->dead) continue;
+        io->arm = NULL;
+
+        int rev = 0;
+        if (res < 0) {
+            rev = EV_ERROR | io->events;
+        } else {
+            if (res & POLLIN)  rev |= EV_READ;
+            if (res & POLLOUT) rev |= EV_WRITE;
+            if (res & (POLLERR | POLLHUP)) rev |= EV_ERROR | io->events;
+        }
+        io->fn(io->ctx, rev);
+        uring_arm(io);   // one-shot polls: re-arm for level-triggered behaviour
+    }
+    return 0;
+}
+#endif
+
+#ifdef EV_HAVE_EPOLL
+static int epoll_apply(EvIo *io, int events) {
+    EventLoop *loop = io->loop;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.data.ptr = io;
+    if (events & EV_READ)  ev.events |= EPOLLIN;
+    if (events & EV_WRITE) ev.events |= EPOLLOUT;
+
+    // A watcher with no events leaves the set, otherwise a hang-up would be
+    // reported (and spin) while the owner has paused it.
+    if (!events) {
+        if (io->registered) epoll_ctl(loop->epfd, EPOLL_CTL_DEL, io->fd, &ev);
+        io->registered = 0;
+        return 1;
+    }
+    int op = io->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(loop->epfd, op, io->fd, &ev) != 0) {
+        log_msg(LOG_ERROR, "event_loop", "❌ epoll_ctl: %s", strerror(errno));
+        return 0;
+    }
+    io->registered = 1;
+    return 1;
+}
+
+static int epoll_wait_dispatch(EventLoop *loop, long timeout) {
+    struct epoll_event evs[EPOLL_BATCH];
+    int n = epoll_wait(loop->epfd, evs, EPOLL_BATCH, (int)timeout);
+    if (n < 0) {
+        if (errno == EINTR) return 0;
+        log_msg(LOG_ERROR, "event_loop", "❌ epoll_wait: %s", strerror(errno));
+        return -1;
+    }
+    loop->now = mono_ms();
+    for (int i = 0; i < n; i++) {
+        EvIo *io = (EvIo *)evs[i].data.ptr;
+        if (io->dead) continue;
+        int rev = 0;
+        if (evs[i].events & EPOLLIN)  rev |= EV_READ;
+        if (evs[i].events & EPOLLOUT) rev |= EV_WRITE;
+        if (evs[i].events & (EPOLLERR | EPOLLHUP)) rev |= EV_ERROR | io->events;
+        rev &= io->events | EV_ERROR;   // an earlier callback may have paused it
+        if (rev) io->fn(io->ctx, rev);
+    }
+    return 0;
+}
+#endif
+
+static int poll_wait_dispatch(EventLoop *loop, long timeout) {
+    if (!grow((void **)&loop->pfds, &loop->capPfds, loop->nios, sizeof(*loop->pfds))) return -1;
+    loop->pios = (EvIo **)realloc(loop->pios, (size_t)loop->capPfds * sizeof(EvIo *));
+    if (!loop->pios) return -1;
+
+    int n = 0;
+    for (int i = 0; i < loop->nios; i++) {
+        EvIo *io = loop->ios[i];
+        if (!io->events) continue;
+        memset(&loop->pfds[n], 0, sizeof(loop->pfds[n]));
+        loop->pfds[n].fd = io->fd;
+#ifdef _WIN32
+        if (io->events & EV_READ)  loop->pfds[n].events |= POLLRDNORM;
+        if (io->events & EV_WRITE) loop->pfds[n].events |= POLLWRNORM;
+#else
+        if (io->events & EV_READ)  loop->pfds[n].events |= POLLIN;
+        if (io->events & EV_WRITE) loop->pfds[n].events |= POLLOUT;
+#endif
+        loop->pios[n++] = io;
+    }
+
+#ifdef _WIN32
+    int rc = WSAPoll(loop->pfds, (ULONG)n, (INT)timeout);
+    if (rc == SOCKET_ERROR) {
+        log_msg(LOG_ERROR, "event_loop", "❌ WSAPoll failed: %d", WSAGetLastError());
+        return -1;
+    }
+#else
+    int rc = poll(loop->pfds, (nfds_t)n, (int)timeout);
+    if (rc < 0) {
+        if (errno == EINTR) return 0;
+        log_msg(LOG_ERROR, "event_loop", "❌ poll: %s", strerror(errno));
+        return -1;
+    }
+#endif
+    loop->now = mono_ms();
+
+    for (int i = 0; i < n && rc > 0; i++) {
+        short re = loop->pfds[i].revents;
+        if (!re) continue;
+        rc--;
+        EvIo *io = loop->pios[i];
+        if (io->dead) continue;
+        int rev = 0;
+        if (re & (POLLIN | POLLRDNORM))  rev |= EV_READ;
+        if (re & (POLLOUT | POLLWRNORM)) rev |= EV_WRITE;
+        if (re & (POLLERR | POLLHUP | POLLNVAL)) rev |= EV_ERROR | io->events;
+        rev &= io->events | EV_ERROR;
+        if (rev) io->fn(io->ctx, rev);
+    }
+    return 0;
+}
+
+// ===============================================================
+//  Wakeup + posted callbacks
+// ===============================================================
+
+static void post_lock(EventLoop *loop) {
+#ifdef _WIN32
+    EnterCriticalSection(&loop->postLock);
+#else
+    pthread_mutex_lock(&loop->postLock);
+#endif
+}
+
+static void post_unlock(EventLoop *loop) {
+#ifdef _WIN32
+    LeaveCriticalSection(&loop->postLock);
+#else
+    pthread_mutex_unlock(&loop->postLock);
+#endif
+}
+
+static void wake(EventLoop *loop) {
+    if (atomic_exchange(&loop->wakePending, 1) != 0) return;
+#ifdef _WIN32
+    char b = 1;
+    send(loop->wakeSock, &b, 1, 0);
+#elif defined(EV_HAVE_EPOLL)
+    uint64_t one = 1;
+    ssize_t rc = write(loop->wakeWrite, &one, sizeof(one));
+    (void)rc;
+#else
+    char b = 1;
+    ssize_t rc = write(loop->wakeWrite, &b, 1);
+    (void)rc;
+#endif
+}
+
+static void drain_wake(EventLoop *loop) {
+    char buf[64];
+#ifdef _WIN32
+    while (recv(loop->wakeSock, buf, sizeof(buf), 0) > 0) {}
+#else
+    while (read(loop->wakeRead, buf, sizeof(buf)) > 0) {}
+#endif
+}
+
+static void wake_cb(void *ctx, int revents) {
+    EventLoop *loop = (EventLoop *)ctx;
+    (void)revents;
+
+    // Clear first: a wake() from now on writes again and is not lost.
+    atomic_store(&loop->wakePending, 0);
+    drain_wake(loop);
+
+    for (EvAsync *a = loop->asyncs, *next; a; a = next) {
+        next = a->next;   // the callback may free its own handle
+        if (atomic_exchange(&a->pending, 0)) a->fn(a->ctx);
+    }
+
+    post_lock(loop);
+    PostItem *p = loop->postHead;
+    loop->postHead = loop->postTail = NULL;
+    post_unlock(loop);
+
+    while (p) {
+        PostItem *next = p->next;
+        p->fn(p->ctx);
+        free(p);
+        p = next;
+    }
+}
+
+static int wake_open(EventLoop *loop) {
+#ifdef _WIN32
+    loop->wakeSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (loop->wakeSock == INVALID_SOCKET) return 0;
+    struct sockaddr_in addr;
+    int alen = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    u_long nb = 1;
+    if (bind(loop->wakeSock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(loop->wakeSock, (struct sockaddr *)&addr, &alen) != 0 ||
+        connect(loop->wakeSock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        ioctlsocket(loop->wakeSock, FIONBIO, &nb) != 0) {
+        closesocket(loop->wakeSock);
+        loop->wakeSock = INVALID_SOCKET;
+        return 0;
+    }
+    return 1;
+#elif defined(EV_HAVE_EPOLL)
+    loop->wakeRead = loop->wakeWrite = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return loop->wakeRead >= 0;
+#else
+    int p[2];
+    if (pipe(p) != 0) return 0;
+    for (int i = 0; i < 2; i++) {
+        fcntl(p[i], F_SETFL, fcntl(p[i], F_GETFL) | O_NONBLOCK);
+        fcntl(p[i], F_SETFD, FD_CLOEXEC);
+    }
+    loop->wakeRead = p[0];
+    loop->wakeWrite = p[1];
+    return 1;
+#endif
+}
+
+static void wake_close(EventLoop *loop) {
+#ifdef _WIN32
+    if (loop->wakeSock != INVALID_SOCKET) closesocket(loop->wakeSock);
+#else
+    if (loop->wakeRead >= 0) close(loop->wakeRead);
+    if (loop->wakeWrite >= 0 && loop->wakeWrite != loop->wakeRead) close(loop->wakeWrite);
+#endif
+}
+
+// ===============================================================
+//  Loop
+// ===============================================================
+
+static Backend pick_backend(void) {
+#ifdef EV_HAVE_URING
+    const char *env = getenv("EVENT_BACKEND");
+    if (env && strcmp(env, "io_uring") == 0) return BACKEND_URING;
+#endif
+#ifdef EV_HAVE_EPOLL
+    const char *envp = getenv("EVENT_BACKEND");
+    if (envp && strcmp(envp, "poll") == 0) return BACKEND_POLL;
+    return BACKEND_EPOLL;
+#else
+    return BACKEND_POLL;
+#endif
+}
+
+EventLoop *event_loop_create(void) {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return NULL;
+#endif
+    EventLoop *loop = (EventLoop *)calloc(1, sizeof(EventLoop));
+    if (!loop) {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return NULL;
+    }
+#ifdef _WIN32
+    loop->wakeSock = INVALID_SOCKET;
+    InitializeCriticalSection(&loop->postLock);
+#else
+    loop->wakeRead = loop->wakeWrite = -1;
+    pthread_mutex_init(&loop->postLock, NULL);
+#endif
+    atomic_init(&loop->stopRequested, 0);
+    atomic_init(&loop->wakePending, 0);
+    loop->now = mono_ms();
+    loop->backend = pick_backend();
+
+#ifdef EV_HAVE_URING
+    if (loop->backend == BACKEND_URING) {
+        int rc = io_uring_queue_init(256, &loop->ring, 0);
+        if (rc < 0) {
+            log_msg(LOG_WARN, "event_loop", "⚠️  io_uring unavailable (%s), using epoll", strerror(-rc));
+            loop->backend = BACKEND_EPOLL;
+        }
+    }
+#endif
+#ifdef EV_HAVE_EPOLL
+    loop->epfd = -1;
+    if (loop->backend == BACKEND_EPOLL) {
+        loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (loop->epfd < 0) {
+            log_msg(LOG_ERROR, "event_loop", "❌ epoll_create1: %s", strerror(errno));
+            event_loop_destroy(loop);
+            return NULL;
+        }
+    }
+#endif
+
+    if (!wake_open(loop)) {
+        log_msg(LOG_ERROR, "event_loop", "❌ Cannot create the event loop wakeup channel");
+        event_loop_destroy(loop);
+        return NULL;
+    }
+#ifdef _WIN32
+    loop->wakeIo = ev_io_add(loop, (EvSocket)loop->wakeSock, EV_READ, wake_cb, loop);
+#else
+    loop->wakeIo = ev_io_add(loop, loop->wakeRead, EV_READ, wake_cb, loop);
+#endif
+    if (!loop->wakeIo) {
+        event_loop_destroy(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+const char *event_loop_backend(const EventLoop *loop) {
+    switch (loop->backend) {
+    case BACKEND_EPOLL: return "epoll";
+    case BACKEND_URING: return "io_uring";
+    default:
+#ifdef _WIN32
+        return "WSAPoll";
+#else
+        return "poll";
+#endif
+    }
+}
+
+static void free_dead(EventLoop *loop) {
+    for (int i = 0; i < loop->ndead; i++) free(loop->dead[i]);
+    loop->ndead = 0;
+}
+
+int event_loop_run(EventLoop *loop) {
+    int rc = 0;
+    while (!atomic_load(&loop->stopRequested)) {
+        loop->now = mono_ms();
+        long timeout = next_timeout(loop);
+
+        switch (loop->backend) {
+#ifdef EV_HAVE_URING
+        case BACKEND_URING: rc = uring_wait(loop, timeout); break;
+#endif
+#ifdef EV_HAVE_EPOLL
+        case BACKEND_EPOLL: rc = epoll_wait_dispatch(loop, timeout); break;
+#endif
+        default:            rc = poll_wait_dispatch(loop, timeout); break;
+        }
+        if (rc < 0) break;
+
+        loop->now = mono_ms();
+        run_timers(loop);
+        free_dead(loop);
+    }
+    atomic_store(&loop->stopRequested, 0);
+    return rc;
+}
+
+void event_loop_stop(EventLoop *loop) {
+    atomic_store(&loop->stopRequested, 1);
+    wake(loop);
+}
+
+int event_loop_post(EventLoop *loop, EvPostFn fn, void *ctx) {
+    PostItem *p = (PostItem *)malloc(sizeof(PostItem));
+    if (!p) return 0;
+    p->fn = fn;
+    p->ctx = ctx;
+    p->next = NULL;
+
+    post_lock(loop);
+    if (loop->postTail) loop->postTail->next = p; else loop->postHead = p;
+    loop->postTail = p;
+    post_unlock(loop);
+
+    wake(loop);
+    return 1;
+}
+
+unsigned long long event_loop_now_ms(EventLoop *loop) {
+    return loop->now;
+}
+
+void event_loop_destroy(EventLoop *loop) {
+    if (!loop) return;
+
+    while (loop->nios > 0) ev_io_remove(loop->ios[loop->nios - 1]);
+    free_dead(loop);
+    while (loop->nheap > 0) {
+        EvTimer *t = loop->heap[0];
+        heap_remove(loop, t);
+        t->loop = NULL;   // owners still hold it; ev_timer_free() just frees
+    }
+
+    PostItem *p = loop->postHead;
+    while (p) {
+        PostItem *next = p->next;
+        free(p);
+        p = next;
+    }
+    for (EvAsync *a = loop->asyncs; a; a = a->next) a->loop = NULL;
+    loop->asyncs = NULL;
+
+    wake_close(loop);
+#ifdef EV_HAVE_EPOLL
+    if (loop->epfd >= 0) close(loop->epfd);
+#endif
+#ifdef EV_HAVE_URING
+    if (loop->backend == BACKEND_URING) {
+        io_uring_queue_exit(&loop->ring);
+        while (loop->arms) uring_unlink(loop, loop->arms);
+    }
+#endif
+#ifdef _WIN32
+    DeleteCriticalSection(&loop->postLock);
+#else
+    pthread_mutex_destroy(&loop->postLock);
+#endif
+
+    free(loop->ios);
+    free(loop->dead);
+    free(loop->heap);
+    free(loop->pfds);
+    free(loop->pios);
+    free(loop);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+// ===============================================================
+//  I/O watchers
+// ===============================================================
+
+EvIo *ev_io_add(EventLoop *loop, EvSocket fd, int events, EvIoFn fn, void *ctx) {
+    if (!grow((void **)&loop->ios, &loop->capIos, loop->nios + 1, sizeof(EvIo *))) return NULL;
+    EvIo *io = (EvIo *)calloc(1, sizeof(EvIo));
+    if (!io) return NULL;
+    io->loop  = loop;
+    io->fd    = fd;
+    io->fn    = fn;
+    io->ctx   = ctx;
+    io->index = loop->nios;
+    loop->ios[loop->nios++] = io;
+
+    if (!ev_io_set(io, events)) {
+        loop->nios--;
+        free(io);
+        return NULL;
+    }
+    return io;
+}
+
+int ev_io_set(EvIo *io, int events) {
+    events &= EV_READ | EV_WRITE;
+    if (io->dead) return 0;
+    if (events == io->events && (io->registered || !events)) return 1;
+
+    switch (io->loop->backend) {
+#ifdef EV_HAVE_EPOLL
+    case BACKEND_EPOLL:
+        if (!epoll_apply(io, events)) return 0;
+        break;
+#endif
+#ifdef EV_HAVE_URING
+    case BACKEND_URING:
+        uring_disarm(io);
+        io->events = events;
+        uring_arm(io);
+        return 1;
+#endif
+    default:
+        break;   // poll rebuilds its set every iteration
+    }
+    io->events = events;
+    return 1;
+}
+
+int ev_io_events(const EvIo *io) {
+    return io->events;
+}
+
+void ev_io_remove(EvIo *io) {
+    if (!io || io->dead) return;
+    EventLoop *loop = io->loop;
+
+#ifdef EV_HAVE_EPOLL
+    if (loop->backend == BACKEND_EPOLL && io->registered) epoll_apply(io, 0);
+#endif
+#ifdef EV_HAVE_URING
+    if (loop->backend == BACKEND_URING) uring_disarm(io);
+#endif
+
+    // Unlink now (swap-remove) but free only after the current dispatch,
+    // which may still hold a pointer to it.
+    int i = io->index;
+    loop->ios[i] = loop->ios[--loop->nios];
+    loop->ios[i]->index = i;
+    io->dead = 1;
+    io->events = 0;
+
+    if (grow((void **)&loop->dead, &loop->capDead, loop->ndead + 1, sizeof(EvIo *))) {
+        loop->dead[loop->ndead++] = io;
+    }   // else: leak rather than risk a use-after-free
+}
+
+// ===============================================================
+//  Timers
+// ===============================================================
+
+EvTimer *ev_timer_new(EventLoop *loop, EvTimerFn fn, void *ctx) {
+    EvTimer *t = (EvTimer *)calloc(1, sizeof(EvTimer));
+    if (!t) return NULL;
+    t->loop = loop;
+    t->fn = fn;
+    t->ctx = ctx;
+    t->heapIndex = -1;
+    return t;
+}
+
+void ev_timer_start(EvTimer *t, long ms, long repeatMs) {
+    if (!t || !t->loop) return;
+    heap_remove(t->loop, t);
+    t->due = t->loop->now + (unsigned long long)(ms > 0 ? ms : 0);
+    t->repeatMs = repeatMs;
+    if (!heap_push(t->loop, t)) log_msg(LOG_ERROR, "event_loop", "❌ Out of memory arming a timer");
+}
+
+void ev_timer_stop(EvTimer *t) {
+    if (t && t->loop) heap_remove(t->loop, t);
+}
+
+int ev_timer_active(const EvTimer *t) {
+    return t && t->heapIndex >= 0;
+}
+
+void ev_timer_free(EvTimer *t) {
+    if (!t) return;
+    ev_timer_stop(t);
+    free(t);
+}
+
+// ===============================================================
+//  Async handles
+// ===============================================================
+
+EvAsync *ev_async_new(EventLoop *loop, EvPostFn fn, void *ctx) {
+    EvAsync *a = (EvAsync *)calloc(1, sizeof(EvAsync));
+    if (!a) return NULL;
+    a->loop = loop;
+    a->fn = fn;
+    a->ctx = ctx;
+    atomic_init(&a->pending, 0);
+    a->next = loop->asyncs;
+    if (loop->asyncs) loop->asyncs->prev = a;
+    loop->asyncs = a;
+    return a;
+}
+
+void ev_async_send(EvAsync *a) {
+    if (!a || !a->loop) return;
+    atomic_store(&a->pending, 1);
+    wake(a->loop);
+}
+
+void ev_async_free(EvAsync *a) {
+    if (!a) return;
+    if (a->loop) {
+        if (a->prev) a->prev->next = a->next; else a->loop->asyncs = a->next;
+        if (a->next) a->next->prev = a->prev;
+    }
+    free(a);
+}
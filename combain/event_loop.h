@@ -0,0 +1,126 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Single-threaded reactor that owns combain's sockets, the serial fd,
+ * directory notifications, curl's sockets and all timers.
+ *
+ * Backends:
+ *   epoll     Linux default
+ *   io_uring  Linux, built with -DHAVE_LIBURING (-luring) and selected with
+ *             EVENT_BACKEND=io_uring; falls back to epoll if unavailable
+ *   poll      other POSIX systems
+ *   WSAPoll   Windows (sockets only)
+ *
+ * Everything except event_loop_stop(), event_loop_post() and
+ * ev_async_send() must be called on the loop thread (or before
+ * event_loop_run()). Callbacks may add and remove watchers and timers,
+ * including their own.
+ */
+
+#ifdef _WIN32
+typedef uintptr_t EvSocket;   // SOCKET
+#else
+typedef int EvSocket;
+#endif
+
+enum {
+    EV_READ  = 1,
+    EV_WRITE = 2,
+    EV_ERROR = 4     // reported only: hang-up or socket error
+};
+
+typedef struct EventLoop EventLoop;
+typedef struct EvIo      EvIo;
+typedef struct EvTimer   EvTimer;
+typedef struct EvAsync   EvAsync;
+
+typedef void (*EvIoFn)(void *ctx, int revents);
+typedef void (*EvTimerFn)(void *ctx);
+typedef void (*EvPostFn)(void *ctx);
+
+/** Returns NULL on error. */
+EventLoop *event_loop_create(void);
+
+/** Backend name ("epoll", "io_uring", "poll", "WSAPoll"). */
+const char *event_loop_backend(const EventLoop *loop);
+
+/** Run until event_loop_stop(). Returns 0, or -1 on a backend error. */
+int event_loop_run(EventLoop *loop);
+
+/** Make event_loop_run() return. Any thread; async-signal-safe. */
+void event_loop_stop(EventLoop *loop);
+
+/**
+ * Run fn(ctx) on the loop thread soon. Any thread. Returns 0 if out of
+ * memory.
+ */
+int event_loop_post(EventLoop *loop, EvPostFn fn, void *ctx);
+
+/** Monotonic milliseconds, cached per loop iteration. */
+unsigned long long event_loop_now_ms(EventLoop *loop);
+
+/**
+ * Free the loop. Watchers and timers still registered are freed with it;
+ * posted callbacks that never ran are dropped. Safe to call with NULL.
+ */
+void event_loop_destroy(EventLoop *loop);
+
+// ===============================================================
+//  I/O watchers (level-triggered)
+// ===============================================================
+
+/** Watch 'fd' for 'events' (EV_READ | EV_WRITE, may be 0). NULL on error. */
+EvIo *ev_io_add(EventLoop *loop, EvSocket fd, int events, EvIoFn fn, void *ctx);
+
+/** Change the events watched. Returns 0 on error. */
+int ev_io_set(EvIo *io, int events);
+
+int ev_io_events(const EvIo *io);
+
+/** Stop watching and free. Does not close the fd. Safe with NULL. */
+void ev_io_remove(EvIo *io);
+
+// ===============================================================
+//  Timers
+// ===============================================================
+
+EvTimer *ev_timer_new(EventLoop *loop, EvTimerFn fn, void *ctx);
+
+/** (Re)arm: first fire after 'ms', then every 'repeatMs' (0 = once). */
+void ev_timer_start(EvTimer *t, long ms, long repeatMs);
+
+void ev_timer_stop(EvTimer *t);
+int  ev_timer_active(const EvTimer *t);
+
+/** Stop and free. Safe with NULL. */
+void ev_timer_free(EvTimer *t);
+
+// ===============================================================
+//  Async handles
+// ===============================================================
+
+/**
+ * Wakeup that can be raised from anywhere, including a signal handler:
+ * fn(ctx) runs once on the loop thread after one or more sends.
+ * NULL on error.
+ */
+EvAsync *ev_async_new(EventLoop *loop, EvPostFn fn, void *ctx);
+
+/** Any thread; async-signal-safe. */
+void ev_async_send(EvAsync *a);
+
+/** Loop thread (its own callback included). Safe with NULL. */
+void ev_async_free(EvAsync *a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENT_LOOP_H
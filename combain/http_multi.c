@@ -0,0 +1,221 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "http_multi.h"
+#include "analyser_upload.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <curl/curl.h>
+
+typedef struct Transfer {
+    HttpPost        *post;
+    HttpDoneFn       done;
+    void            *ctx;
+    struct Transfer *prev, *next;
+} Transfer;
+
+// One per socket curl asks us to watch.
+typedef struct SockWatch {
+    struct HttpMulti *hm;
+    curl_socket_t     s;
+    EvIo             *io;
+    struct SockWatch *prev, *next;
+} SockWatch;
+
+struct HttpMulti {
+    EventLoop *loop;
+    CURLM     *multi;
+    EvTimer   *timer;
+    Transfer  *transfers;
+    SockWatch *socks;
+    int        active;
+};
+
+static void unlink_sock(struct HttpMulti *hm, SockWatch *w) {
+    if (w->prev) w->prev->next = w->next; else hm->socks = w->next;
+    if (w->next) w->next->prev = w->prev;
+    ev_io_remove(w->io);
+    free(w);
+}
+
+static void unlink_transfer(struct HttpMulti *hm, Transfer *t) {
+    if (t->prev) t->prev->next = t->next; else hm->transfers = t->next;
+    if (t->next) t->next->prev = t->prev;
+}
+
+// ===============================================================
+//  Completion
+// ===============================================================
+
+static void check_done(struct HttpMulti *hm) {
+    CURLMsg *msg;
+    int left;
+    while ((msg = curl_multi_info_read(hm->multi, &left)) != NULL) {
+        if (msg->msg != CURLMSG_DONE) continue;
+
+        CURL *easy = msg->easy_handle;
+        CURLcode result = msg->data.result;
+        Transfer *t = NULL;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char **)&t);
+        curl_multi_remove_handle(hm->multi, easy);
+
+        unlink_transfer(hm, t);
+        hm->active--;
+
+        char *resp = NULL;
+        long status = http_post_status(t->post, (int)result);
+        int ok = http_post_finish(t->post, (int)result, &resp);
+        t->done(t->ctx, ok, status, resp);   // may start more transfers
+        free(resp);
+        free(t);
+    }
+}
+
+// ===============================================================
+//  Loop <-> curl glue
+// ===============================================================
+
+static void sock_event(void *ctx, int revents) {
+    SockWatch *w = (SockWatch *)ctx;
+    struct HttpMulti *hm = w->hm;
+    curl_socket_t s = w->s;   // w may be freed by socket_action
+
+    int flags = 0;
+    if (revents & EV_READ)  flags |= CURL_CSELECT_IN;
+    if (revents & EV_WRITE) flags |= CURL_CSELECT_OUT;
+    if (revents & EV_ERROR) flags |= CURL_CSELECT_ERR;
+
+    int running = 0;
+    curl_multi_socket_action(hm->multi, s, flags, &running);
+    check_done(hm);
+}
+
+static void timer_event(void *ctx) {
+    struct HttpMulti *hm = (struct HttpMulti *)ctx;
+    int running = 0;
+    curl_multi_socket_action(hm->multi, CURL_SOCKET_TIMEOUT, 0, &running);
+    check_done(hm);
+}
+
+static int socket_cb(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp) {
+    struct HttpMulti *hm = (struct HttpMulti *)userp;
+    SockWatch *w = (SockWatch *)socketp;
+    (void)easy;
+
+    if (what == CURL_POLL_REMOVE) {
+        if (w) unlink_sock(hm, w);
+        return 0;
+    }
+
+    int events = 0;
+    if (what & CURL_POLL_IN)  events |= EV_READ;
+    if (what & CURL_POLL_OUT) events |= EV_WRITE;
+
+    if (w) {
+        ev_io_set(w->io, events);
+        return 0;
+    }
+
+    w = (SockWatch *)calloc(1, sizeof(SockWatch));
+    if (!w) return -1;
+    w->hm = hm;
+    w->s  = s;
+    w->io = ev_io_add(hm->loop, (EvSocket)s, events, sock_event, w);
+    if (!w->io) {
+        free(w);
+        return -1;
+    }
+    w->next = hm->socks;
+    if (hm->socks) hm->socks->prev = w;
+    hm->socks = w;
+    curl_multi_assign(hm->multi, s, w);
+    return 0;
+}
+
+static int timer_cb(CURLM *multi, long timeout_ms, void *userp) {
+    struct HttpMulti *hm = (struct HttpMulti *)userp;
+    (void)multi;
+    // Never drive curl from inside its own callback: a 0 ms timeout is
+    // handled on the next loop iteration.
+    if (timeout_ms < 0) ev_timer_stop(hm->timer);
+    else ev_timer_start(hm->timer, timeout_ms, 0);
+    return 0;
+}
+
+// ===============================================================
+//  Public API
+// ===============================================================
+
+HttpMulti *http_multi_create(EventLoop *loop, int maxConnections) {
+    struct HttpMulti *hm = (struct HttpMulti *)calloc(1, sizeof(*hm));
+    if (!hm) return NULL;
+    hm->loop  = loop;
+    hm->multi = curl_multi_init();
+    hm->timer = ev_timer_new(loop, timer_event, hm);
+    if (!hm->multi || !hm->timer) {
+        http_multi_destroy(hm);
+        return NULL;
+    }
+
+    curl_multi_setopt(hm->multi, CURLMOPT_SOCKETFUNCTION, socket_cb);
+    curl_multi_setopt(hm->multi, CURLMOPT_SOCKETDATA, hm);
+    curl_multi_setopt(hm->multi, CURLMOPT_TIMERFUNCTION, timer_cb);
+    curl_multi_setopt(hm->multi, CURLMOPT_TIMERDATA, hm);
+    curl_multi_setopt(hm->multi, CURLMOPT_MAX_TOTAL_CONNECTIONS,
+                      (long)(maxConnections > 0 ? maxConnections : 8));
+    return hm;
+}
+
+int http_multi_post(HttpMulti *hm, const char *url, const char *contentType, const char *header,
+                    const char *body, size_t bodyLen, HttpDoneFn done, void *ctx) {
+    Transfer *t = (Transfer *)calloc(1, sizeof(Transfer));
+    if (!t) return 0;
+    t->post = http_post_prepare(NULL, url, contentType, body, bodyLen);
+    if (!t->post) {
+        free(t);
+        return 0;
+    }
+    if (header && !http_post_add_header(t->post, header)) {
+        http_post_finish(t->post, (int)CURLE_FAILED_INIT, NULL);
+        free(t);
+        return 0;
+    }
+    t->done = done;
+    t->ctx  = ctx;
+
+    CURL *easy = (CURL *)http_post_easy(t->post);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, t);
+    if (curl_multi_add_handle(hm->multi, easy) != CURLM_OK) {
+        http_post_finish(t->post, (int)CURLE_FAILED_INIT, NULL);
+        free(t);
+        return 0;
+    }
+
+    t->next = hm->transfers;
+    if (hm->transfers) hm->transfers->prev = t;
+    hm->transfers = t;
+    hm->active++;
+    return 1;
+}
+
+int http_multi_active(const HttpMulti *hm) {
+    return hm->active;
+}
+
+void http_multi_destroy(HttpMulti *hm) {
+    if (!hm) return;
+
+    while (hm->transfers) {
+        Transfer *t = hm->transfers;
+        unlink_transfer(hm, t);
+        curl_multi_remove_handle(hm->multi, (CURL *)http_post_easy(t->post));
+        http_post_finish(t->post, (int)CURLE_ABORTED_BY_CALLBACK, NULL);
+        free(t);
+    }
+    if (hm->multi) curl_multi_cleanup(hm->multi);
+    while (hm->socks) unlink_sock(hm, hm->socks);
+    ev_timer_free(hm->timer);
+    free(hm);
+}
@@ -0,0 +1,55 @@
+#ifndef HTTP_MULTI_H
+#define HTTP_MULTI_H
+
+#include "event_loop.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Non-blocking uploads: a curl multi handle whose sockets and timeout are
+ * driven by the event loop, so transfers progress on the loop thread
+ * without tying up a thread each.
+ *
+ * Requests are built exactly like http_post_body() (same headers, 30 s
+ * timeout); only the way they are driven differs.
+ */
+
+typedef struct HttpMulti HttpMulti;
+
+/**
+ * Called on the loop thread when a transfer ends. 'ok' follows the
+ * http_post_body() convention (HTTP 2xx); 'status' is the HTTP status, 0
+ * when no response arrived; 'response' may be NULL and is only valid
+ * during the call.
+ */
+typedef void (*HttpDoneFn)(void *ctx, int ok, long status, const char *response);
+
+/** 'maxConnections' caps parallel connections (<= 0 = 8). NULL on error. */
+HttpMulti *http_multi_create(EventLoop *loop, int maxConnections);
+
+/**
+ * Start POSTing 'body' ('body' must stay valid until 'done' runs).
+ * 'header' is one extra request header ("Name: value"), NULL for none.
+ * Returns 1 if started, 0 on error ('done' is then not called).
+ */
+int http_multi_post(HttpMulti *hm, const char *url, const char *contentType, const char *header,
+                    const char *body, size_t bodyLen, HttpDoneFn done, void *ctx);
+
+/** Transfers in flight. */
+int http_multi_active(const HttpMulti *hm);
+
+/**
+ * Abort transfers still in flight (their 'done' is not called) and free.
+ * Call before destroying the loop. Safe to call with NULL.
+ */
+void http_multi_destroy(HttpMulti *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTP_MULTI_H
@@ -0,0 +1,207 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "instruments.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char         dir[CONFIG_PATH_MAX];    // normalised
+    char         stem[CONFIG_PATH_MAX];   // "" = the whole folder
+    ScanIdentity id;
+} Entry;
+
+struct InstrumentMap {
+    Entry       *entries;
+    int          n;
+    const char  *dirs[1 + CONFIG_MAX_SCANS];
+    int          ndirs;
+    ScanIdentity general;
+};
+
+// ===============================================================
+//  Paths
+// ===============================================================
+
+// "./ss/", "ss" and "ss\\" all compare equal.
+static void normalise(char *dst, size_t cap, const char *src) {
+    size_t n = 0;
+    for (; *src && n + 1 < cap; src++) dst[n++] = (*src == '\\') ? '/' : *src;
+    dst[n] = '\0';
+
+    char *s = dst;
+    while (s[0] == '.' && s[1] == '/') s += 2;
+    n = strlen(s);
+    while (n > 1 && s[n - 1] == '/') s[--n] = '\0';
+    memmove(dst, s, n + 1);
+    if (!dst[0]) strcpy(dst, ".");
+}
+
+// Capture file 'out' -> its folder and its name without ".txt".
+static void split_out(const char *out, char *dir, char *stem) {
+    char path[CONFIG_PATH_MAX];
+    normalise(path, sizeof(path), out);
+
+    char *slash = strrchr(path, '/');
+    const char *base = slash ? slash + 1 : path;
+    strcpy(stem, base);
+    size_t n = strlen(stem);
+    if (n >= 4 && strcmp(stem + n - 4, ".txt") == 0) stem[n - 4] = '\0';
+
+    if (slash) {
+        *slash = '\0';
+        normalise(dir, CONFIG_PATH_MAX, path[0] ? path : "/");
+    } else {
+        strcpy(dir, ".");
+    }
+}
+
+// ===============================================================
+//  Build
+// ===============================================================
+
+static int has_identity(const IdentitySpec *spec) {
+    if (spec->machineId[0] || spec->mac[0]) return 1;
+    for (int k = 0; k < 4; k++) {
+        if (spec->endpoints[k][0]) return 1;
+    }
+    return 0;
+}
+
+static ScanIdentity merge(const IdentitySpec *spec, const ScanIdentity *base) {
+    ScanIdentity id;
+    id.MachineID = spec->machineId[0] ? spec->machineId : base->MachineID;
+    id.MAC       = spec->mac[0] ? spec->mac : base->MAC;
+    for (int k = 0; k < 4; k++) id.endpoints[k] = spec->endpoints[k][0] ? spec->endpoints[k] : base->endpoints[k];
+    return id;
+}
+
+static Entry *folder_entry(InstrumentMap *m, const char *dir) {
+    for (int i = 0; i < m->n; i++) {
+        if (!m->entries[i].stem[0] && strcmp(m->entries[i].dir, dir) == 0) return &m->entries[i];
+    }
+    return NULL;
+}
+
+static Entry *add_entry(InstrumentMap *m, const char *dir, const char *stem, ScanIdentity id) {
+    Entry *e = &m->entries[m->n++];
+    strcpy(e->dir, dir);
+    strcpy(e->stem, stem);
+    e->id = id;
+    return e;
+}
+
+// Returns the capture's folder entry, NULL if it is outside the scan folders.
+static Entry *add_capture(InstrumentMap *m, const char *kind, const char *name, const char *out,
+                          int enabled, const IdentitySpec *spec, char *dir, char *stem) {
+    split_out(out, dir, stem);
+
+    Entry *folder = folder_entry(m, dir);
+    if (!folder) {
+        if (enabled) {
+            log_msg(LOG_WARN, "scan", "⚠️  %s %s writes %s outside the scan folders: its results are not uploaded",
+                    kind, name, out);
+        }
+        return NULL;
+    }
+    if (has_identity(spec)) add_entry(m, dir, stem, merge(spec, &folder->id));
+    return folder;
+}
+
+InstrumentMap *instrument_map_build(const CombainConfig *cfg) {
+    InstrumentMap *m = (InstrumentMap *)calloc(1, sizeof(InstrumentMap));
+    if (!m) return NULL;
+    int npeers = 0;
+    for (int i = 0; i < cfg->nlisteners; i++) npeers += cfg->listeners[i].npeers;
+    m->entries = (Entry *)calloc((size_t)(1 + cfg->nscans + cfg->nlisteners + npeers + cfg->nserials),
+                                 sizeof(Entry));
+    if (!m->entries) {
+        free(m);
+        return NULL;
+    }
+
+    m->general.MachineID = cfg->machineId;
+    m->general.MAC       = cfg->mac;
+    for (int k = 0; k < 4; k++) m->general.endpoints[k] = cfg->endpoints[k][0] ? cfg->endpoints[k] : NULL;
+
+    char dir[CONFIG_PATH_MAX];
+    normalise(dir, sizeof(dir), cfg->scanDir);
+    add_entry(m, dir, "", m->general);
+    m->dirs[m->ndirs++] = cfg->scanDir;
+
+    for (int i = 0; i < cfg->nscans; i++) {
+        const ScanDirSpec *s = &cfg->scans[i];
+        normalise(dir, sizeof(dir), s->dir);
+        Entry *folder = folder_entry(m, dir);
+        if (folder) {
+            folder->id = merge(&s->id, &folder->id);   // identity for a folder already scanned
+        } else {
+            add_entry(m, dir, "", merge(&s->id, &m->general));
+            m->dirs[m->ndirs++] = s->dir;
+        }
+    }
+
+    char stem[CONFIG_PATH_MAX];
+    for (int i = 0; i < cfg->nlisteners; i++) {
+        const ListenerSpec *l = &cfg->listeners[i];
+        Entry *folder = add_capture(m, "Listener", l->name, l->outPath, l->enabled, &l->id, dir, stem);
+        if (!folder || !l->server) continue;
+
+        // Server mode: each peer writes '<stem>_<peer>.txt', which the
+        // longest-stem match below picks over the listener's own entry.
+        ScanIdentity base = merge(&l->id, &folder->id);
+        for (int j = 0; j < l->npeers; j++) {
+            const PeerSpec *peer = &l->peers[j];
+            if (!has_identity(&peer->id)) continue;
+            char peerStem[CONFIG_PATH_MAX];
+            snprintf(peerStem, sizeof(peerStem), "%.*s_%s", (int)(sizeof(peerStem) - CONFIG_NAME_MAX - 2), stem,
+                     peer->name);
+            add_entry(m, dir, peerStem, merge(&peer->id, &base));
+        }
+    }
+    for (int i = 0; i < cfg->nserials; i++) {
+        const SerialSpec *s = &cfg->serials[i];
+        add_capture(m, "Serial", s->name, s->outPath, s->enabled, &s->id, dir, stem);
+    }
+    return m;
+}
+
+void instrument_map_free(InstrumentMap *m) {
+    if (!m) return;
+    free(m->entries);
+    free(m);
+}
+
+// ===============================================================
+//  Queries
+// ===============================================================
+
+int instrument_map_ndirs(const InstrumentMap *m) {
+    return m->ndirs;
+}
+
+const char *instrument_map_dir(const InstrumentMap *m, int i) {
+    return m->dirs[i];
+}
+
+const ScanIdentity *instrument_map_lookup(void *ctx, const char *dir, const char *name) {
+    InstrumentMap *m = (InstrumentMap *)ctx;
+    char key[CONFIG_PATH_MAX];
+    normalise(key, sizeof(key), dir);
+
+    const Entry *best = NULL;
+    size_t bestLen = 0;
+    for (int i = 0; i < m->n; i++) {
+        const Entry *e = &m->entries[i];
+        if (strcmp(e->dir, key) != 0) continue;
+        size_t n = strlen(e->stem);
+        if (n > 0 && (strncmp(name, e->stem, n) != 0 || (name[n] != '.' && name[n] != '_'))) continue;
+        if (!best || n > bestLen) {
+            best = e;
+            bestLen = n;
+        }
+    }
+    return best ? &best->id : &m->general;
+}
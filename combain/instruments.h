@@ -0,0 +1,43 @@
+#ifndef COMBAIN_INSTRUMENTS_H
+#define COMBAIN_INSTRUMENTS_H
+
+#include "config.h"
+#include "scan_pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Which instrument a result file belongs to, derived from the config.
+ *
+ * The scan folders are [general] scan_dir plus every [scan ...] dir. A
+ * file is matched, most specific first, against:
+ *   - the capture files of listeners and serial ports: 'out' without
+ *     ".txt", followed by '.' or '_' (so the _spill file matches too);
+ *   - the folder it was found in;
+ *   - [general] / [endpoints].
+ * Unset fields of a match fall back the same way, so every identity the
+ * map returns is complete.
+ */
+
+typedef struct InstrumentMap InstrumentMap;
+
+/** Strings are borrowed from 'cfg', which must outlive the map. */
+InstrumentMap *instrument_map_build(const CombainConfig *cfg);
+
+/** Safe to call with NULL. */
+void instrument_map_free(InstrumentMap *m);
+
+/** Scan folders, without duplicates; [general] scan_dir comes first. */
+int instrument_map_ndirs(const InstrumentMap *m);
+const char *instrument_map_dir(const InstrumentMap *m, int i);
+
+/** A ScanIdentifyFn: 'ctx' is the map. Never NULL for a built map. */
+const ScanIdentity *instrument_map_lookup(void *ctx, const char *dir, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMBAIN_INSTRUMENTS_H
@@ -0,0 +1,340 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "logger.h"
+#include "spsc_queue.h"   // Doorbell
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <process.h>
+#else
+    #include <pthread.h>
+#endif
+
+#define LOG_RING     1024     // records; a power of two
+#define LOG_TAG_MAX  16
+#define LOG_TEXT_MAX 480
+#define LOG_PATH_MAX 512
+
+typedef struct {
+    atomic_size_t      seq;       // ring protocol, see log_msg()
+    unsigned char      level;
+    char               tag[LOG_TAG_MAX];
+    unsigned long long wallMs;
+    char               text[LOG_TEXT_MAX];
+} Cell;
+
+static Cell          g_ring[LOG_RING];
+static atomic_size_t g_head;      // next position a producer claims
+static size_t        g_tail;      // writer thread only
+static atomic_ullong g_dropped;
+
+static atomic_int    g_level = LOG_INFO;
+static atomic_int    g_started;
+static atomic_int    g_running;
+static Doorbell     *g_bell;
+
+#ifdef _WIN32
+static HANDLE        g_thread;
+#else
+static pthread_t     g_thread;
+#endif
+
+// Settings the writer applies on its next pass; 'g_gen' says they changed.
+#ifdef _WIN32
+static SRWLOCK g_cfgLock = SRWLOCK_INIT;
+#define CFG_LOCK()   AcquireSRWLockExclusive(&g_cfgLock)
+#define CFG_UNLOCK() ReleaseSRWLockExclusive(&g_cfgLock)
+#else
+static pthread_mutex_t g_cfgLock = PTHREAD_MUTEX_INITIALIZER;
+#define CFG_LOCK()   pthread_mutex_lock(&g_cfgLock)
+#define CFG_UNLOCK() pthread_mutex_unlock(&g_cfgLock)
+#endif
+static char       g_cfgPath[LOG_PATH_MAX];
+static long       g_cfgMaxBytes;
+static int        g_cfgKeep;
+static atomic_int g_console = 1;
+static atomic_int g_gen;
+
+// Writer thread state
+static FILE *g_file;
+static long  g_fileBytes;
+static char  g_path[LOG_PATH_MAX];
+static long  g_maxBytes;
+static int   g_keep;
+static int   g_appliedGen = -1;
+
+static const char *const LEVEL_NAMES[LOG_LEVELS] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+static unsigned long long wall_ms(void) {
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    ULARGE_INTEGER u;
+    u.LowPart = ft.dwLowDateTime;
+    u.HighPart = ft.dwHighDateTime;
+    return (u.QuadPart - 116444736000000000ull) / 10000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ull + (unsigned long long)ts.tv_nsec / 1000000;
+#endif
+}
+
+static void echo(int level, const char *text) {
+    FILE *out = level >= LOG_WARN ? stderr : stdout;
+    if (out == stderr) fflush(stdout);   // keep the order when both go to one place
+    fputs(text, out);
+    fputc('\n', out);
+}
+
+// ===============================================================
+//  Writer thread
+// ===============================================================
+
+static void close_file(void) {
+    if (g_file) fclose(g_file);
+    g_file = NULL;
+}
+
+static void open_file(void) {
+    close_file();
+    if (!g_path[0]) return;
+    g_file = fopen(g_path, "ab");
+    if (!g_file) {
+        fprintf(stderr, "[log] cannot open %s\n", g_path);
+        return;
+    }
+    fseek(g_file, 0, SEEK_END);
+    g_fileBytes = ftell(g_file);
+}
+
+// <path> -> <path>.1 -> ... -> <path>.<keep>, the oldest dropped.
+static void rotate(void) {
+    close_file();
+    char from[LOG_PATH_MAX + 16], to[LOG_PATH_MAX + 16];
+    if (g_keep > 0) {
+        snprintf(to, sizeof(to), "%s.%d", g_path, g_keep);
+        remove(to);
+        for (int i = g_keep - 1; i >= 1; i--) {
+            snprintf(from, sizeof(from), "%s.%d", g_path, i);
+            snprintf(to, sizeof(to), "%s.%d", g_path, i + 1);
+            rename(from, to);
+        }
+        snprintf(to, sizeof(to), "%s.1", g_path);
+        rename(g_path, to);
+    } else {
+        remove(g_path);
+    }
+    open_file();
+}
+
+static void apply_config(void) {
+    int gen = atomic_load(&g_gen);
+    if (gen == g_appliedGen) return;
+    g_appliedGen = gen;
+
+    CFG_LOCK();
+    int reopen = strcmp(g_path, g_cfgPath) != 0 || !g_file;
+    memcpy(g_path, g_cfgPath, sizeof(g_path));
+    g_maxBytes = g_cfgMaxBytes;
+    g_keep = g_cfgKeep;
+    CFG_UNLOCK();
+
+    if (reopen) open_file();
+}
+
+static void write_file(int level, const char *tag, unsigned long long wallMs, const char *text) {
+    if (!g_file) return;
+
+    time_t s = (time_t)(wallMs / 1000);
+    struct tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &s);
+#else
+    localtime_r(&s, &tm);
+#endif
+    char when[32];
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+
+    int n = fprintf(g_file, "%s.%03u %-5s %-9s %s\n", when, (unsigned)(wallMs % 1000),
+                    LEVEL_NAMES[level], tag, text);
+    if (n > 0) g_fileBytes += n;
+    if (g_maxBytes > 0 && g_fileBytes >= g_maxBytes) rotate();
+}
+
+// Everything queued so far. Returns the number of records written.
+static int drain(void) {
+    apply_config();
+    int console = atomic_load(&g_console);
+    int n = 0;
+
+    for (;;) {
+        Cell *c = &g_ring[g_tail & (LOG_RING - 1)];
+        if (atomic_load_explicit(&c->seq, memory_order_acquire) != g_tail + 1) break;
+        if (console) echo(c->level, c->text);
+        write_file(c->level, c->tag, c->wallMs, c->text);
+        atomic_store_explicit(&c->seq, g_tail + LOG_RING, memory_order_release);
+        g_tail++;
+        n++;
+    }
+
+    unsigned long long lost = atomic_exchange(&g_dropped, 0);
+    if (lost) {
+        char text[96];
+        snprintf(text, sizeof(text), "[log] %llu record(s) dropped: the log could not keep up", lost);
+        if (console) echo(LOG_WARN, text);
+        write_file(LOG_WARN, "log", wall_ms(), text);
+    }
+
+    if (n || lost) {
+        if (console) {
+            fflush(stdout);
+            fflush(stderr);
+        }
+        if (g_file) fflush(g_file);
+    }
+    return n;
+}
+
+#ifdef _WIN32
+static unsigned __stdcall writer_thread(void *arg)
+#else
+static void *writer_thread(void *arg)
+#endif
+{
+    (void)arg;
+    while (atomic_load(&g_running)) {
+        doorbell_wait(g_bell, 1000);
+        drain();
+    }
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+// ===============================================================
+//  Public API
+// ===============================================================
+
+void logger_configure(const LoggerConfig *cfg) {
+    atomic_store(&g_level, cfg->level);
+    atomic_store(&g_console, cfg->console);
+
+    CFG_LOCK();
+    snprintf(g_cfgPath, sizeof(g_cfgPath), "%s", cfg->path ? cfg->path : "");
+    g_cfgMaxBytes = cfg->maxBytes;
+    g_cfgKeep = cfg->keep;
+    CFG_UNLOCK();
+    atomic_fetch_add(&g_gen, 1);
+    if (g_bell) doorbell_ring(g_bell);
+}
+
+int logger_start(const LoggerConfig *cfg) {
+    if (atomic_load(&g_started)) return 1;
+    for (size_t i = 0; i < LOG_RING; i++) atomic_store(&g_ring[i].seq, i);
+    atomic_store(&g_head, 0);
+    g_tail = 0;
+
+    logger_configure(cfg);
+    g_bell = doorbell_create();
+    if (!g_bell) return 0;
+
+    atomic_store(&g_running, 1);
+#ifdef _WIN32
+    uintptr_t h = _beginthreadex(NULL, 0, writer_thread, NULL, 0, NULL);
+    if (h == 0) {
+#else
+    if (pthread_create(&g_thread, NULL, writer_thread, NULL) != 0) {
+#endif
+        atomic_store(&g_running, 0);
+        doorbell_destroy(g_bell);
+        g_bell = NULL;
+        return 0;
+    }
+#ifdef _WIN32
+    g_thread = (HANDLE)h;
+#endif
+    atomic_store(&g_started, 1);
+    return 1;
+}
+
+void logger_stop(void) {
+    if (!atomic_exchange(&g_started, 0)) return;
+    atomic_store(&g_running, 0);
+    doorbell_ring(g_bell);
+#ifdef _WIN32
+    WaitForSingleObject(g_thread, INFINITE);
+    CloseHandle(g_thread);
+#else
+    pthread_join(g_thread, NULL);
+#endif
+    drain();   // anything pushed while the writer was finishing
+    close_file();
+    g_appliedGen = -1;
+    doorbell_destroy(g_bell);
+    g_bell = NULL;
+}
+
+void log_msg(LogLevel level, const char *tag, const char *fmt, ...) {
+    if ((int)level < atomic_load_explicit(&g_level, memory_order_relaxed)) return;
+    if ((int)level >= LOG_LEVELS) level = LOG_ERROR;
+
+    char text[LOG_TEXT_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    size_t len = strlen(text);
+    if (len && text[len - 1] == '\n') text[--len] = '\0';
+
+    if (!atomic_load_explicit(&g_started, memory_order_acquire)) {
+        if (atomic_load(&g_console)) echo(level, text);
+        return;
+    }
+
+    // Bounded multi-producer ring: a cell whose sequence equals the claimed
+    // position is free; the producer fills it and publishes position + 1,
+    // the writer frees it again as position + LOG_RING.
+    size_t pos = atomic_load_explicit(&g_head, memory_order_relaxed);
+    Cell *c;
+    for (;;) {
+        c = &g_ring[pos & (LOG_RING - 1)];
+        size_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) break;
+        } else if (dif < 0) {
+            atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+            return;   // full
+        } else {
+            pos = atomic_load_explicit(&g_head, memory_order_relaxed);
+        }
+    }
+
+    c->level = (unsigned char)level;
+    snprintf(c->tag, sizeof(c->tag), "%s", tag ? tag : "");
+    c->wallMs = wall_ms();
+    memcpy(c->text, text, len + 1);
+    atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+    doorbell_ring(g_bell);
+}
+
+int log_level_parse(const char *name) {
+    if (!strcmp(name, "debug")) return LOG_DEBUG;
+    if (!strcmp(name, "info")) return LOG_INFO;
+    if (!strcmp(name, "warn") || !strcmp(name, "warning")) return LOG_WARN;
+    if (!strcmp(name, "error")) return LOG_ERROR;
+    return -1;
+}
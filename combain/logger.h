@@ -0,0 +1,70 @@
+#ifndef COMBAIN_LOGGER_H
+#define COMBAIN_LOGGER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Asynchronous log with levels and per-component tags.
+ *
+ * log_msg() formats the message into a slot of a fixed lock-free ring and
+ * returns; it never touches stdio and never waits. One writer thread
+ * drains the ring: it echoes each message to the console as before
+ * (warnings and errors on stderr) and appends
+ *
+ *   2026-01-31 14:05:09.123 INFO  listener  [listener ...] Connected.
+ *
+ * to the log file, rotating it to <file>.1 .. <file>.N once it grows past
+ * the configured size. When the ring is full (a burst faster than the
+ * console) records are dropped and counted rather than slowing the
+ * caller; the writer reports how many.
+ *
+ * Records below the configured level cost one relaxed load. Before
+ * logger_start() and after logger_stop() log_msg() writes straight to the
+ * console.
+ */
+
+typedef enum {
+    LOG_DEBUG = 0,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR,
+    LOG_LEVELS
+} LogLevel;
+
+typedef struct {
+    LogLevel    level;      // records below it are discarded
+    int         console;    // echo to stdout / stderr
+    const char *path;       // log file; NULL or "" = none
+    long        maxBytes;   // rotate beyond this size (0 = never)
+    int         keep;       // rotated files kept next to it
+} LoggerConfig;
+
+/** Start the writer thread. Returns 1 on success (0: log_msg() stays synchronous). */
+int logger_start(const LoggerConfig *cfg);
+
+/** Apply a new configuration (reload). Any thread. */
+void logger_configure(const LoggerConfig *cfg);
+
+/** Write out what is queued, stop the writer and close the file. */
+void logger_stop(void);
+
+/**
+ * Log one message (printf-style, a trailing newline is optional). 'tag'
+ * names the component ("scan", "listener", ...). Any thread.
+ */
+void log_msg(LogLevel level, const char *tag, const char *fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    ;
+
+/** "debug", "info", "warn" / "warning", "error" -> level; -1 if unknown. */
+int log_level_parse(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMBAIN_LOGGER_H
@@ -1,12 +1,25 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "analyser_listener.h"
+#include "analyser.h"
+#include "scan_pipeline.h"
+#include "capture_sink.h"
+#include "config.h"
+#include "instruments.h"
+#include "event_loop.h"
+#include "http_multi.h"
+#include "dir_watch.h"
+#include "metrics_server.h"
+#include "trace.h"
+#include "dedupe.h"
+#include "archive.h"
+#include "logger.h"
+#include "shutdown.h"
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <time.h>
-#include <signal.h>
 
 #ifdef _WIN32
   #include <windows.h>
@@ -20,544 +33,69 @@
   #define PATH_SEP '/'
   #include <fcntl.h>
   #include <termios.h>
+  #include <errno.h>
 #endif
 
 #include <curl/curl.h>
 
-// -------- Portable tokenization shim (strtok_r on POSIX, strtok_s on Windows) -----
-#ifdef _WIN32
-  #define STRTOK_CTX char*
-  #define STRTOK(str, delim, ctx) strtok_s((str), (delim), (ctx))
-#else
-  #define STRTOK_CTX char*
-  #define STRTOK(str, delim, ctx) strtok_r((str), (delim), (ctx))
-#endif
-
-// ===================== GLOBAL RUN FLAG =====================
-static volatile int keepRunning = 1;
-
-void intHandler(int dummy) {
-  (void)dummy;
-  keepRunning = 0;
-  printf("\n🛑 SIGINT received, stopping threads...\n");
-}
+// ===================== SHUTDOWN =====================
+// SIGINT/SIGTERM stop the event loop (see shutdown.h). Uploads already in
+// flight then get this long to finish before they are abandoned (their
+// files stay and go out on the next start).
+#define SHUTDOWN_GRACE_MS 500
 
 // ===================== Config =====================
-static const char* API_ANALYSER1 = "https://api.superceuticals.in/test-one/saveCbc";
-static const char* API_ANALYSER2 = "https://api.superceuticals.in/test-two/saveResults";
-static const char* API_ANALYSER3 = "https://api.superceuticals.in/test-three/saveUrine";
+// Analysers, endpoints, ports and intervals come from an INI file (see
+// config.h; built-in defaults when it is missing). COMBAIN_CONFIG names
+// it. SIGHUP or saving the file applies changes without a restart.
+#define DEFAULT_CONFIG_FILE "combain.ini"
+#define CONFIG_SETTLE_MS    200     // editors write in several steps
+#define CONFIG_POLL_MS      2000    // where the folder cannot be watched
 
+// ===================== Small utils =====================
+static unsigned long long mono_now_ms(void) {
 #ifdef _WIN32
-  static const char* DEFAULT_SCAN_DIR = "C:\\ss";
-  #define DEFAULT_PORT     "COM3"
-  #define DEFAULT_SERIAL_FILE "C:\\ss\\serial_data.txt"
-  static HANDLE hSerial = INVALID_HANDLE_VALUE;
+  return (unsigned long long)GetTickCount64();
 #else
-  // Use a relative folder for both analyser and serial log
-  static const char* DEFAULT_SCAN_DIR = "./ss";
-  #define DEFAULT_PORT     "/dev/ttyUSB0"        // change for mac: "/dev/tty.usbserial-0001" etc.
-  #define DEFAULT_SERIAL_FILE "./ss/serial_data.txt"
-  static int serial_fd = -1;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000ull + (unsigned long long)ts.tv_nsec / 1000000;
 #endif
-
-// ===================== Small utils =====================
-static int starts_with(const char* s, const char* prefix) {
-  if (!s || !prefix) return 0;
-  size_t a = strlen(s), b = strlen(prefix);
-  return a >= b && strncmp(s, prefix, b) == 0;
-}
-
-static void trim_inplace(char* s) {
-  if (!s) return;
-  size_t len = strlen(s);
-  size_t i = 0;
-  while (i < len && isspace((unsigned char)s[i])) i++;
-  size_t j = len;
-  while (j > i && isspace((unsigned char)s[j-1])) j--;
-  if (i > 0) memmove(s, s + i, j - i);
-  s[j - i] = '\0';
-}
-
-static char** split_preserve_empty(const char* s, char delim, int* count) {
-  if (!s) { *count = 0; return NULL; }
-  int cap = 16, n = 0;
-  char** out = (char**)malloc(cap * sizeof(char*));
-  const char* p = s;
-  const char* start = p;
-  while (1) {
-    if (*p == delim || *p == '\0') {
-      int len = (int)(p - start);
-      char* tok = (char*)malloc((size_t)len + 1);
-      memcpy(tok, start, (size_t)len);
-      tok[len] = '\0';
-      if (n >= cap) { cap *= 2; out = (char**)realloc(out, cap * sizeof(char*)); }
-      out[n++] = tok;
-      if (*p == '\0') break;
-      p++; start = p;
-    } else {
-      p++;
-    }
-  }
-  *count = n;
-  return out;
-}
-
-static void free_split(char** arr, int count) {
-  if (!arr) return;
-  for (int i = 0; i < count; i++) free(arr[i]);
-  free(arr);
-}
-
-static void remove_spaces_and_asterisks(char* s) {
-  if (!s) return;
-  char* w = s;
-  for (char* r = s; *r; ++r) {
-    if (*r != ' ' && *r != '*') *w++ = *r;
-  }
-  *w = '\0';
-}
-
-static int read_file_text(const char* path, char** out) {
-  FILE* f = fopen(path, "rb");
-  if (!f) return 0;
-  fseek(f, 0, SEEK_END);
-  long sz = ftell(f);
-  if (sz < 0) { fclose(f); return 0; }
-  fseek(f, 0, SEEK_SET);
-  char* buf = (char*)malloc((size_t)sz + 1);
-  if (!buf) { fclose(f); return 0; }
-  size_t rd = fread(buf, 1, (size_t)sz, f);
-  fclose(f);
-  buf[rd] = '\0';
-  *out = buf;
-  return 1;
 }
 
-static void delete_file(const char* path) {
+static void ensure_dir(const char* dir) {
 #ifdef _WIN32
-  _unlink(path);
+  _mkdir(dir);
 #else
-  unlink(path);
+  mkdir(dir, 0755);
 #endif
 }
 
-// ===================== HTTP (libcurl) =====================
-struct mem_sink { char* data; size_t size; };
-static size_t write_cb(void* contents, size_t size, size_t nmemb, void* userp) {
-  size_t real = size * nmemb;
-  struct mem_sink* ms = (struct mem_sink*)userp;
-  char* ptr = (char*)realloc(ms->data, ms->size + real + 1);
-  if (!ptr) return 0;
-  ms->data = ptr;
-  memcpy(ms->data + ms->size, contents, real);
-  ms->size += real;
-  ms->data[ms->size] = '\0';
-  return real;
-}
-
-static int http_post_json(const char* url, const char* json_body, char** response_out) {
-  CURL* curl = curl_easy_init();
-  if (!curl) return 0;
-
-  struct curl_slist* headers = NULL;
-  headers = curl_slist_append(headers, "Content-Type: application/json");
-
-  struct mem_sink sink = {0};
-
-  curl_easy_setopt(curl, CURLOPT_URL, url);
-  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-  curl_easy_setopt(curl, CURLOPT_POST, 1L);
-  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_body);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sink);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-  // curl_easy_setopt(curl, CURLOPT_CAINFO, "cacert.pem");
-
-  CURLcode res = curl_easy_perform(curl);
-  long code = 0;
-  if (res == CURLE_OK) curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
-
-  if (response_out) *response_out = sink.data; else free(sink.data);
-  curl_slist_free_all(headers);
-  curl_easy_cleanup(curl);
-
-  return (res == CURLE_OK && code >= 200 && code < 300);
-}
-
-// ===================== JSON helpers =====================
-static void json_escape_copy(char* dst, size_t dst_cap, const char* src) {
-  size_t w = 0;
-  for (size_t i = 0; src && src[i] && w + 2 < dst_cap; i++) {
-    unsigned char c = (unsigned char)src[i];
-    if (c == '\\' || c == '\"') {
-      if (w + 2 >= dst_cap) break;
-      dst[w++] = '\\'; dst[w++] = (char)c;
-    } else if (c >= 0x20) {
-      dst[w++] = (char)c;
-    }
-  }
-  if (w < dst_cap) dst[w] = '\0';
-}
-
-static void sb_append(char** buf, size_t* len, size_t* cap, const char* s) {
-  size_t L = strlen(s);
-  if (*len + L + 1 > *cap) {
-    size_t newcap = (*cap == 0 ? 1024 : *cap * 2);
-    while (newcap < *len + L + 1) newcap *= 2;
-    *buf = (char*)realloc(*buf, newcap);
-    *cap = newcap;
-  }
-  memcpy(*buf + *len, s, L);
-  *len += L;
-  (*buf)[*len] = '\0';
-}
-
-static void sb_append_json_str(char** buf, size_t* len, size_t* cap, const char* s) {
-  sb_append(buf, len, cap, "\"");
-  char tmp[4096]; tmp[0] = '\0';
-  json_escape_copy(tmp, sizeof(tmp), s ? s : "");
-  sb_append(buf, len, cap, tmp);
-  sb_append(buf, len, cap, "\"");
-}
-
-// ===================== Analyser parsers =====================
-static int analyser_1(char** arr, int n, const char* filePath,
-                      const char* MachineID, const char* MAC) {
-  int start = 6, end = 28;
-  if (n < start) return 0;
-
-  char* json = NULL; size_t len = 0, cap = 0;
-  sb_append(&json, &len, &cap, "{\"mydata\":[");
-  int first = 1;
-
-  for (int idx = start; idx < n && idx < end; idx++) {
-    int token_count = 0;
-    char** tokens = split_preserve_empty(arr[idx], '|', &token_count);
-    if (!tokens || token_count == 0) { free_split(tokens, token_count); continue; }
-
-    int slice_pos = idx - start;
-    int base = (slice_pos >= 4 && slice_pos < 22) ? 3 : 0;
-    if (base >= token_count) { free_split(tokens, token_count); continue; }
-
-    int pcount = 0;
-    char** parts = split_preserve_empty(tokens[base + 0], '^', &pcount);
-
-    const char* test_code = (pcount > 0 ? parts[0] : "");
-    const char* name      = (pcount > 1 ? parts[1] : "");
-    const char* system    = (pcount > 2 ? parts[2] : "");
-
-    const char* result        = (base + 1 < token_count ? tokens[base + 1] : "");
-    const char* units         = (base + 2 < token_count ? tokens[base + 2] : "");
-    const char* normal_range  = (base + 4 < token_count ? tokens[base + 4] : "");
-    const char* flag          = (base + 5 < token_count ? tokens[base + 5] : "");
-
-    if (!first) sb_append(&json, &len, &cap, ",");
-    first = 0;
-
-    sb_append(&json, &len, &cap, "{");
-    sb_append(&json, &len, &cap, "\"test_code\":"); sb_append_json_str(&json, &len, &cap, test_code); sb_append(&json, &len, &cap, ",");
-    sb_append(&json, &len, &cap, "\"name\":");      sb_append_json_str(&json, &len, &cap, name);      sb_append(&json, &len, &cap, ",");
-    sb_append(&json, &len, &cap, "\"system\":");    sb_append_json_str(&json, &len, &cap, system);    sb_append(&json, &len, &cap, ",");
-    sb_append(&json, &len, &cap, "\"result\":");    sb_append_json_str(&json, &len, &cap, result);    sb_append(&json, &len, &cap, ",");
-    sb_append(&json, &len, &cap, "\"units\":");     sb_append_json_str(&json, &len, &cap, units);     sb_append(&json, &len, &cap, ",");
-    sb_append(&json, &len, &cap, "\"normal_range\":"); sb_append_json_str(&json, &len, &cap, normal_range); sb_append(&json, &len, &cap, ",");
-    sb_append(&json, &len, &cap, "\"flag\":");      sb_append_json_str(&json, &len, &cap, flag);
-    sb_append(&json, &len, &cap, "}");
-
-    free_split(parts, pcount);
-    free_split(tokens, token_count);
-  }
-
-  sb_append(&json, &len, &cap, "],\"MachineID\":");
-  sb_append_json_str(&json, &len, &cap, MachineID);
-  sb_append(&json, &len, &cap, ",\"MAC\":");
-  sb_append_json_str(&json, &len, &cap, MAC);
-  sb_append(&json, &len, &cap, "}");
-
-  char* resp = NULL;
-  int ok = http_post_json(API_ANALYSER1, json, &resp);
-  if (!ok) {
-    fprintf(stderr, "❌ Failed to upload [%s]: %s\n", API_ANALYSER1, resp ? resp : "(no response)");
-  } else {
-    printf("✅ Upload successful (Analyser1): %s\n", filePath);
-    delete_file(filePath);
-  }
-  free(resp);
-  free(json);
-  return ok;
-}
-
-static int analyser_2(char** arr, int n, const char* filePath,
-                      const char* MachineID, const char* MAC) {
-  if (n <= 0) return 0;
-
-  int rcount = 0;
-  char** resultParts = split_preserve_empty(arr[0], '|', &rcount);
-  if (!resultParts || rcount == 0) { free_split(resultParts, rcount); return 0; }
-
-  int pcount0 = 0;
-  char** parts0 = split_preserve_empty(resultParts[0], '^', &pcount0);
-
-  int pcount1 = 0;
-  char** parts1 = NULL;
-  if (rcount > 3) parts1 = split_preserve_empty(resultParts[3], '^', &pcount1);
-
-  const char* test_code = (pcount0 > 0 ? parts0[0] : "");
-  const char* test_name = (pcount0 > 1 ? parts0[1] : "");
-  const char* system    = (pcount0 > 2 ? parts0[2] : "");
-
-  const char* result = (rcount > 2 ? resultParts[2] : "");
-  const char* units  = (pcount1 > 0 ? parts1[0] : "");
-
-  char units_system[512] = {0};
-  if (pcount1 > 1) strncat(units_system, parts1[1], sizeof(units_system)-1);
-  if (pcount1 > 2) strncat(units_system, parts1[2], sizeof(units_system)-1);
-
-  char* json = NULL; size_t len = 0, cap = 0;
-  sb_append(&json, &len, &cap, "{\"mydata\":[{");
-  sb_append(&json, &len, &cap, "\"test_code\":");   sb_append_json_str(&json, &len, &cap, test_code); sb_append(&json, &len, &cap, ",");
-  sb_append(&json, &len, &cap, "\"test_name\":");   sb_append_json_str(&json, &len, &cap, test_name); sb_append(&json, &len, &cap, ",");
-  sb_append(&json, &len, &cap, "\"system\":");      sb_append_json_str(&json, &len, &cap, system);    sb_append(&json, &len, &cap, ",");
-  sb_append(&json, &len, &cap, "\"result\":");      sb_append_json_str(&json, &len, &cap, result);    sb_append(&json, &len, &cap, ",");
-  sb_append(&json, &len, &cap, "\"units\":");       sb_append_json_str(&json, &len, &cap, units);     sb_append(&json, &len, &cap, ",");
-  sb_append(&json, &len, &cap, "\"units_system\":");sb_append_json_str(&json, &len, &cap, units_system);
-  sb_append(&json, &len, &cap, "}],\"MachineID\":");
-  sb_append_json_str(&json, &len, &cap, MachineID);
-  sb_append(&json, &len, &cap, ",\"MAC\":");
-  sb_append_json_str(&json, &len, &cap, MAC);
-  sb_append(&json, &len, &cap, "}");
-
-  char* resp = NULL;
-  int ok = http_post_json(API_ANALYSER2, json, &resp);
-  if (!ok) {
-    fprintf(stderr, "❌ Failed to upload [%s]: %s\n", API_ANALYSER2, resp ? resp : "(no response)");
-  } else {
-    printf("✅ Upload successful (Analyser2): %s\n", filePath);
-    delete_file(filePath);
-  }
-  free(resp);
-  free(json);
-  free_split(parts0, pcount0);
-  free_split(parts1, pcount1);
-  free_split(resultParts, rcount);
-  return ok;
-}
-
-static int analyser_3(const char* filePath, const char* MachineID, const char* MAC) {
-  char* text = NULL;
-  if (!read_file_text(filePath, &text)) {
-    fprintf(stderr, "❌ Error in analyser_3: cannot read file\n");
-    return 0;
-  }
-
-  remove_spaces_and_asterisks(text);
-
-  int cap = 64, n = 0;
-  char** lines = (char**)malloc(cap * sizeof(char*));
-  STRTOK_CTX save = NULL;
-  char* tok = STRTOK(text, "\n", &save);
-  while (tok) {
-    if (n >= cap) { cap *= 2; lines = (char**)realloc(lines, cap * sizeof(char*)); }
-    lines[n++] = tok;
-    tok = STRTOK(NULL, "\n", &save);
-  }
-
-  if (n > 7) {
-    char* l7 = lines[7];
-    size_t L = strlen(l7);
-    if (L > 0 && l7[L-1] == '\r') l7[L-1] = '\0';
-    if (strcmp(l7, "Measurementerror!") == 0) {
-      fprintf(stderr, "⚠️  Test error found in %s\n", filePath);
-      free(lines);
-      free(text);
-      return 0;
-    }
-  }
-
-  int start = -1, end = -1;
-  for (int i = 0; i < n; i++) {
-    if (strcmp(lines[i], "........................") == 0) start = i;
-    if (strcmp(lines[i], "------------------------") == 0) { end = i; break; }
-  }
-  if (start < 0 || end < 0 || start + 1 >= end) {
-    fprintf(stderr, "❌ Error in analyser_3: markers not found\n");
-    free(lines);
-    free(text);
-    return 0;
-  }
-
-  const char* labels[10] = {"BLD","LEU","BIL","UBG","KET","GLU","PRO","pH","NIT","SG"};
-  const int expected = 10;
-  int count = (end - (start + 1));
-  if (count < expected) {
-    fprintf(stderr, "❌ Error in analyser_3: insufficient result lines (%d)\n", count);
-    free(lines);
-    free(text);
-    return 0;
-  }
-
-  char* json = NULL; size_t len = 0, capj = 0;
-  sb_append(&json, &len, &capj, "{\"mydata\":{");
-  for (int i = 0; i < expected; i++) {
-    const char* row = lines[start + 1 + i];
-    const char* key = labels[i];
-    size_t klen = strlen(key);
-    const char* val = row;
-    if (starts_with(row, key)) val = row + klen;
-
-    char tmp[512]; tmp[0] = '\0';
-    size_t w = 0;
-    size_t rlen = strlen(val);
-    for (size_t r = 0; r < rlen && w + 1 < sizeof(tmp); r++) {
-      if (r + 5 <= rlen && strncmp(val + r, "mg/dl", 5) == 0) { r += 4; continue; }
-      tmp[w++] = val[r];
-    }
-    tmp[w] = '\0';
-
-    if (i > 0) sb_append(&json, &len, &capj, ",");
-    sb_append(&json, &len, &capj, "\""); sb_append(&json, &len, &capj, key); sb_append(&json, &len, &capj, "\":");
-    sb_append_json_str(&json, &len, &capj, tmp);
-  }
-  sb_append(&json, &len, &capj, "},\"MachineID\":");
-  sb_append_json_str(&json, &len, &capj, MachineID);
-  sb_append(&json, &len, &capj, ",\"MAC\":");
-  sb_append_json_str(&json, &len, &capj, MAC);
-  sb_append(&json, &len, &capj, "}");
-
-  char* resp = NULL;
-  int ok = http_post_json(API_ANALYSER3, json, &resp);
-  if (!ok) {
-    fprintf(stderr, "❌ Failed to upload [%s]: %s\n", API_ANALYSER3, resp ? resp : "(no response)");
-  } else {
-    printf("✅ Upload successful (Analyser3): %s\n", filePath);
-    delete_file(filePath);
-  }
-  free(resp);
-  free(json);
-
-  free(lines);
-  free(text);
-  return ok;
-}
-
-// ===================== Directory scan & dispatch =====================
-static int load_and_tokenize_csvish(const char* path, char*** out_arr, int* out_n, char** out_storage) {
-  char* text = NULL;
-  if (!read_file_text(path, &text)) return 0;
-
-  size_t L = strlen(text);
-  size_t start = (L > 0 ? 1 : 0);
-  size_t end = (L >= 2 ? L - 2 : 0);
-  if (end < start) end = start;
-
-  char* sliced = (char*)malloc(end - start + 1);
-  memcpy(sliced, text + start, end - start);
-  sliced[end - start] = '\0';
-  free(text);
-
-  trim_inplace(sliced);
-
-  int cap = 16, n = 0;
-  char** arr = (char**)malloc(cap * sizeof(char*));
-  STRTOK_CTX save = NULL;
-  char* tok = STRTOK(sliced, ",", &save);
-  while (tok) {
-    if (n >= cap) { cap *= 2; arr = (char**)realloc(arr, cap * sizeof(char*)); }
-    arr[n++] = tok;
-    tok = STRTOK(NULL, ",", &save);
-  }
-
-  *out_arr = arr;
-  *out_n = n;
-  *out_storage = sliced;
-  return 1;
-}
-
-static void free_tokenized_csvish(char** arr, char* storage) {
-  free(arr);
-  free(storage);
-}
-
-static void process_directory(const char* dirPath, const char* MachineID, const char* MAC) {
+// ===================== SERIAL PORT HELPERS =====================
+typedef struct {
 #ifdef _WIN32
-  char pattern[MAX_PATH];
-  snprintf(pattern, sizeof(pattern), "%s\\*.txt", dirPath);
-
-  WIN32_FIND_DATAA ffd;
-  HANDLE hFind = FindFirstFileA(pattern, &ffd);
-  if (hFind == INVALID_HANDLE_VALUE) return;
-
-  do {
-    if (!(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-      char filePath[MAX_PATH];
-      snprintf(filePath, sizeof(filePath), "%s\\%s", dirPath, ffd.cFileName);
-
-      char** arr = NULL; int n = 0; char* storage = NULL;
-      if (!load_and_tokenize_csvish(filePath, &arr, &n, &storage)) continue;
-
-      if (n > 0 && starts_with(arr[0], "\\\\SCAN\n")) {
-        printf("📥 Processing %s → Analyser 3\n", ffd.cFileName);
-        analyser_3(filePath, MachineID, MAC);
-      } else if (n > 0 && starts_with(arr[0], "02001^Take Mode")) {
-        printf("📥 Processing %s → Analyser 1\n", ffd.cFileName);
-        analyser_1(arr, n, filePath, MachineID, MAC);
-      } else {
-        printf("📥 Processing %s → Analyser 2\n", ffd.cFileName);
-        analyser_2(arr, n, filePath, MachineID, MAC);
-      }
-      free_tokenized_csvish(arr, storage);
-    }
-  } while (FindNextFileA(hFind, &ffd));
-  FindClose(hFind);
-
+  HANDLE h;
 #else
-  DIR* d = opendir(dirPath);
-  if (!d) return;
-  struct dirent* ent;
-  while ((ent = readdir(d)) != NULL) {
-    if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
-    const char* dot = strrchr(ent->d_name, '.');
-    if (!dot || strcmp(dot, ".txt") != 0) continue;
-
-    char filePath[4096];
-    snprintf(filePath, sizeof(filePath), "%s/%s", dirPath, ent->d_name);
-
-    char** arr = NULL; int n = 0; char* storage = NULL;
-    if (!load_and_tokenize_csvish(filePath, &arr, &n, &storage)) continue;
-
-    if (n > 0 && starts_with(arr[0], "\\\\SCAN\n")) {
-      printf("📥 Processing %s → Analyser 3\n", ent->d_name);
-      analyser_3(filePath, MachineID, MAC);
-    } else if (n > 0 && starts_with(arr[0], "02001^Take Mode")) {
-      printf("📥 Processing %s → Analyser 1\n", ent->d_name);
-      analyser_1(arr, n, filePath, MachineID, MAC);
-    } else {
-      printf("📥 Processing %s → Analyser 2\n", ent->d_name);
-      analyser_2(arr, n, filePath, MachineID, MAC);
-    }
-    free_tokenized_csvish(arr, storage);
-  }
-  closedir(d);
+  int fd;
 #endif
-}
+} SerialPort;
 
-// ===================== SERIAL PORT HELPERS =====================
 #ifdef _WIN32
-int open_serial(const char* portName, int baudRate) {
-  char fullPortName[32];
+int open_serial(SerialPort* port, const char* portName, int baudRate) {
+  char fullPortName[160];
   snprintf(fullPortName, sizeof(fullPortName), "\\\\.\\%s", portName);
-  hSerial = CreateFileA(fullPortName, GENERIC_READ | GENERIC_WRITE, 0, 0,
+  port->h = CreateFileA(fullPortName, GENERIC_READ | GENERIC_WRITE, 0, 0,
                         OPEN_EXISTING, 0, 0);
-  if (hSerial == INVALID_HANDLE_VALUE) {
-    fprintf(stderr, "❌ ERROR: Unable to open %s — check USB connection or COM port.\n", portName);
+  if (port->h == INVALID_HANDLE_VALUE) {
+    log_msg(LOG_ERROR, "serial", "❌ ERROR: Unable to open %s — check USB connection or COM port.", portName);
     return 0;
   }
 
   DCB dcb = {0};
   dcb.DCBlength = sizeof(dcb);
-  if (!GetCommState(hSerial, &dcb)) {
-    fprintf(stderr, "❌ GetCommState failed.\n");
-    CloseHandle(hSerial); hSerial = INVALID_HANDLE_VALUE;
+  if (!GetCommState(port->h, &dcb)) {
+    log_msg(LOG_ERROR, "serial", "❌ GetCommState failed.");
+    CloseHandle(port->h); port->h = INVALID_HANDLE_VALUE;
     return 0;
   }
 
@@ -566,9 +104,9 @@ int open_serial(const char* portName, int baudRate) {
   dcb.StopBits = ONESTOPBIT;
   dcb.Parity   = NOPARITY;
   dcb.fDtrControl = DTR_CONTROL_ENABLE;
-  if (!SetCommState(hSerial, &dcb)) {
-    fprintf(stderr, "❌ SetCommState failed.\n");
-    CloseHandle(hSerial); hSerial = INVALID_HANDLE_VALUE;
+  if (!SetCommState(port->h, &dcb)) {
+    log_msg(LOG_ERROR, "serial", "❌ SetCommState failed.");
+    CloseHandle(port->h); port->h = INVALID_HANDLE_VALUE;
     return 0;
   }
 
@@ -576,25 +114,29 @@ int open_serial(const char* portName, int baudRate) {
   t.ReadIntervalTimeout = 50;
   t.ReadTotalTimeoutConstant = 50;
   t.ReadTotalTimeoutMultiplier = 10;
-  SetCommTimeouts(hSerial, &t);
+  SetCommTimeouts(port->h, &t);
 
-  printf("✅ Opened %s @ %d baud\n", portName, baudRate);
+  log_msg(LOG_INFO, "serial", "✅ Opened %s @ %d baud", portName, baudRate);
   return 1;
 }
 
-void close_serial() {
-  if (hSerial != INVALID_HANDLE_VALUE) {
-    CloseHandle(hSerial);
-    hSerial = INVALID_HANDLE_VALUE;
-    printf("🔒 Port closed.\n");
+void close_serial(SerialPort* port) {
+  if (port->h != INVALID_HANDLE_VALUE) {
+    CloseHandle(port->h);
+    port->h = INVALID_HANDLE_VALUE;
+    log_msg(LOG_INFO, "serial", "🔒 Port closed.");
   }
 }
 
-int read_serial_line(char* buf, size_t maxlen) {
+int read_serial_line(SerialPort* port, atomic_int* stop, char* buf, size_t maxlen) {
   DWORD bytes = 0; char ch; size_t i = 0;
   while (i < maxlen - 1) {
-    if (!ReadFile(hSerial, &ch, 1, &bytes, NULL)) return -1;
-    if (bytes == 0) continue;
+    if (!ReadFile(port->h, &ch, 1, &bytes, NULL)) return -1;
+    if (bytes == 0) {
+      // read timeouts (~60 ms) are where a stop request is noticed
+      if (shutdown_requested() || atomic_load(stop)) break;
+      continue;
+    }
     if (ch == '\n') break;
     buf[i++] = ch;
   }
@@ -603,23 +145,44 @@ int read_serial_line(char* buf, size_t maxlen) {
 }
 
 #else // POSIX
-int open_serial(const char* portName, int baudRate) {
-  serial_fd = open(portName, O_RDWR | O_NOCTTY | O_SYNC);
-  if (serial_fd < 0) {
-    perror("❌ ERROR opening port");
-    fprintf(stderr, "⚠️  Check if the USB device is connected or use correct /dev/cu.* path.\n");
+static speed_t baud_speed(int baudRate) {
+  switch (baudRate) {
+    case 1200:   return B1200;
+    case 2400:   return B2400;
+    case 4800:   return B4800;
+    case 9600:   return B9600;
+    case 19200:  return B19200;
+    case 38400:  return B38400;
+    case 57600:  return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default:     return 0;
+  }
+}
+
+int open_serial(SerialPort* port, const char* portName, int baudRate) {
+  speed_t speed = baud_speed(baudRate);
+  if (!speed) {
+    log_msg(LOG_ERROR, "serial", "❌ Unsupported baud rate %d for %s", baudRate, portName);
+    return 0;
+  }
+
+  port->fd = open(portName, O_RDWR | O_NOCTTY | O_SYNC);
+  if (port->fd < 0) {
+    log_msg(LOG_ERROR, "serial", "❌ ERROR opening port: %s", strerror(errno));
+    log_msg(LOG_WARN, "serial", "⚠️  Check if the USB device is connected or use correct /dev/cu.* path.");
     return 0;
   }
 
   struct termios tty;
-  if (tcgetattr(serial_fd, &tty) != 0) {
-    perror("tcgetattr");
-    close(serial_fd); serial_fd = -1;
+  if (tcgetattr(port->fd, &tty) != 0) {
+    log_msg(LOG_ERROR, "serial", "tcgetattr: %s", strerror(errno));
+    close(port->fd); port->fd = -1;
     return 0;
   }
 
-  cfsetospeed(&tty, B19200);
-  cfsetispeed(&tty, B19200);
+  cfsetospeed(&tty, speed);
+  cfsetispeed(&tty, speed);
 
   tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8;
   tty.c_iflag &= ~IGNBRK;
@@ -631,280 +194,1035 @@ int open_serial(const char* portName, int baudRate) {
   tty.c_cflag |= (CLOCAL | CREAD);
   tty.c_cflag &= ~(PARENB | PARODD | CSTOPB | CRTSCTS);
 
-  if (tcsetattr(serial_fd, TCSANOW, &tty) != 0) {
-    perror("tcsetattr");
-    close(serial_fd); serial_fd = -1;
+  if (tcsetattr(port->fd, TCSANOW, &tty) != 0) {
+    log_msg(LOG_ERROR, "serial", "tcsetattr: %s", strerror(errno));
+    close(port->fd); port->fd = -1;
     return 0;
   }
 
-  printf("✅ Opened %s @ %d baud\n", portName, baudRate);
+  // Read from the event loop: never block it.
+  fcntl(port->fd, F_SETFL, fcntl(port->fd, F_GETFL) | O_NONBLOCK);
+
+  log_msg(LOG_INFO, "serial", "✅ Opened %s @ %d baud", portName, baudRate);
   return 1;
 }
 
-void close_serial() {
-  if (serial_fd >= 0) {
-    close(serial_fd);
-    serial_fd = -1;
-    printf("🔒 Port closed.\n");
+void close_serial(SerialPort* port) {
+  if (port->fd >= 0) {
+    close(port->fd);
+    port->fd = -1;
+    log_msg(LOG_INFO, "serial", "🔒 Port closed.");
   }
 }
 
-int read_serial_line(char* buf, size_t maxlen) {
-  char ch; size_t i = 0;
-  while (i < maxlen - 1) {
-    int n = read(serial_fd, &ch, 1);
-    if (n < 0) return -1;
-    if (ch == '\r') continue;
-    if (ch == '\n') break;
-    buf[i++] = ch;
-  }
-  buf[i] = '\0';
-  return (int)i;
-}
 #endif
 
-// ===================== THREAD CONFIG =====================
+// ===================== SCANNER (event loop) =====================
+// Drains the scan folders whenever something may have arrived: the capture
+// sink reports a finished result, inotify sees a file written into a
+// folder (once it has settled), or a retry is due. Parsing runs on the
+// worker pool, uploads on the loop through curl multi; both are shared by
+// every instrument, each file is uploaded with its instrument's identity.
+#define SCAN_MAX_DIRS (1 + CONFIG_MAX_SCANS)
+
+// Everything built from one configuration. A reload builds a new one
+// next to the running one and swaps only once it is complete.
 typedef struct {
-  const char* scanDir;
-  const char* MachineID;
-  const char* MAC;
-} AnalyserConfig;
+  CombainConfig conf;          // what the pool/pipeline were built from
+  ScanPipelineConfig pipeCfg;  // points into conf
+  InstrumentMap* instruments;  // per-file identity, from conf
+  WorkPool* pool;
+  ScanPipeline* pipeline;
+  HttpMulti* http;
+  DirWatch* watch[SCAN_MAX_DIRS];  // NULL = no notifications, rescan periodically
+  int ndirs;
+} ScanSetup;
 
 typedef struct {
-  const char* portName;
-  const char* filePath;
-  int baudRate;
-} SerialConfig;
+  ScanSetup* s;                // NULL until the first build succeeds
+  EventLoop* loop;
+  int dirIndex;                // folder being drained in this pass
+  int passFiles, passUploaded; // over all folders of this pass
+  EvTimer* rescanTimer;
+  EvTimer* settleTimer;
+  CombainConfig next;          // reload waiting for the running drain
+  int rebuild;
+  int again;                   // triggered while a drain was running
+  int stopping;                // shutting down: start nothing new
+} Scanner;
+
+static void scanner_kick(Scanner* sc);
+static void on_dir_event(void* ctx, const char* name);
+
+static int scanner_busy(const Scanner* sc) {
+  return sc->s && scan_pipeline_busy(sc->s->pipeline);
+}
+
+static void setup_free(ScanSetup* s) {
+  if (!s) return;
+  // Pool first: finishing parse tasks still post to the loop.
+  work_pool_destroy(s->pool);
+  http_multi_destroy(s->http);
+  scan_pipeline_destroy(s->pipeline);
+  for (int i = 0; i < s->ndirs; i++) dir_watch_close(s->watch[i]);
+  instrument_map_free(s->instruments);
+  free(s);
+}
+
+// Pool, pipeline, uploads and folder watches for 'cfg'; NULL (nothing
+// left behind) if any part cannot be created.
+static ScanSetup* setup_build(Scanner* sc, const CombainConfig* cfg) {
+  ScanSetup* s = (ScanSetup*)calloc(1, sizeof(ScanSetup));
+  if (!s) return NULL;
+  s->conf = *cfg;
+  const CombainConfig* c = &s->conf;
+  ScanPipelineConfig* p = &s->pipeCfg;
+
+  s->instruments = instrument_map_build(c);
+  if (!s->instruments) {
+    setup_free(s);
+    return NULL;
+  }
+
+  p->MachineID = c->machineId;
+  p->MAC       = c->mac;
+  p->encoder   = record_encoder_by_name(c->encoding);
+  p->batchSize = c->scanBatch;
+  for (int k = 0; k < 4; k++) p->endpoints[k] = c->endpoints[k][0] ? c->endpoints[k] : NULL;
+  p->identify    = instrument_map_lookup;
+  p->identifyCtx = s->instruments;
+  p->statMarker    = c->priorityStatMarker;
+  p->priorityTests = c->priorityTests;
+  p->agingS        = c->priorityAgingS;
+
+  s->pool = work_pool_create(c->parseWorkers);
+  int conns = c->uploadConnections > 0 ? c->uploadConnections : (s->pool ? work_pool_size(s->pool) : 0);
+  p->uploadSlots = conns > 0 ? conns : 8;   // http_multi_create()'s default
+  s->pipeline = s->pool ? scan_pipeline_create(p, s->pool) : NULL;
+  s->http = http_multi_create(sc->loop, conns);
+  if (!s->pipeline || !s->http) {
+    setup_free(s);
+    return NULL;
+  }
+  log_msg(LOG_INFO, "scan", "📦 Upload encoding: %s", p->encoder->name);
+  log_msg(LOG_INFO, "scan", "🧵 Analyser pool: %d workers", work_pool_size(s->pool));
+
+  s->ndirs = instrument_map_ndirs(s->instruments);
+  for (int i = 0; i < s->ndirs; i++) {
+    const char* dir = instrument_map_dir(s->instruments, i);
+    ensure_dir(dir);
+    s->watch[i] = dir_watch_open(sc->loop, dir, on_dir_event, sc);
+    if (s->watch[i]) log_msg(LOG_INFO, "scan", "📂 Folder %s watched", dir);
+    else log_msg(LOG_INFO, "scan", "📂 Folder %s rescanned every %d ms", dir, c->rescanMs);
+  }
+  return s;
+}
+
+static int scanner_all_watched(const Scanner* sc) {
+  for (int i = 0; i < sc->s->ndirs; i++) {
+    if (!sc->s->watch[i]) return 0;
+  }
+  return 1;
+}
+
+// Posted: never tear the pipeline down from inside its own callback.
+static void scanner_rebuild_cb(void* ctx) {
+  Scanner* sc = (Scanner*)ctx;
+  if (!sc->rebuild || sc->stopping || scanner_busy(sc)) return;
+  sc->rebuild = 0;
+
+  ScanSetup* next = setup_build(sc, &sc->next);
+  if (!next) {
+    // Keep uploading with what runs now and try the new one again later.
+    log_msg(LOG_ERROR, "scan", "❌ Analyser scanner: cannot rebuild with the new configuration, retrying in %d ms",
+            sc->s->conf.rescanMs);
+    sc->rebuild = 1;
+    ev_timer_start(sc->rescanTimer, sc->s->conf.rescanMs, 0);
+    return;
+  }
+  setup_free(sc->s);
+  sc->s = next;
+  sc->again = 0;
+  scanner_kick(sc);
+}
+
+// Take a reloaded configuration: intervals at once, anything the pool or
+// pipeline was built from once no drain is running.
+static void scanner_reconfigure(Scanner* sc, const CombainConfig* cfg) {
+  sc->s->conf.rescanMs = cfg->rescanMs;
+  sc->s->conf.settleMs = cfg->settleMs;
+  sc->next = *cfg;
+  sc->rebuild = config_scanner_changed(&sc->s->conf, cfg);
+  if (sc->rebuild && !scanner_busy(sc)) scanner_rebuild_cb(sc);
+}
+
+static void scan_done(void* ctx, const ScanDrainStats* st);
+
+static int scanner_begin_dir(Scanner* sc) {
+  const ScanSetup* s = sc->s;
+  return scan_pipeline_begin(s->pipeline, instrument_map_dir(s->instruments, sc->dirIndex), sc->loop, s->http,
+                             scan_done, sc);
+}
+
+static void scan_done(void* ctx, const ScanDrainStats* st) {
+  Scanner* sc = (Scanner*)ctx;
+  if (sc->stopping) {
+    event_loop_stop(sc->loop);   // scanner_wind_down() is waiting for this
+    return;
+  }
+  if (st->files > 0) {
+    log_msg(LOG_INFO, "scan", "🧮 %d files, %d uploaded, %d duplicates; per file ≤ %zu allocs / %zu bytes; arena high-water %zu bytes, %zu chunk mallocs",
+            st->files, st->uploaded, st->duplicates, st->jobAllocsMax, st->jobBytesMax, st->arenaHighWater,
+            st->arenaMallocs);
+  }
+  if (st->uploaded > 0) {
+    static const char* const names[SCAN_PRIORITIES] = { "stat", "urgent", "routine" };
+    char waits[192];
+    size_t n = 0;
+    for (int l = 0; l < SCAN_PRIORITIES && n < sizeof(waits); l++) {
+      if (!st->byPriority[l]) continue;
+      n += (size_t)snprintf(waits + n, sizeof(waits) - n, "%s%s %d (avg %.1f s, max %.1f s)", n ? ", " : "",
+                            names[l], st->byPriority[l], st->waitSumUs[l] / 1e6 / st->byPriority[l],
+                            st->waitMaxUs[l] / 1e6);
+    }
+    log_msg(LOG_INFO, "scan", "⏱️  Waited by priority: %s", waits);
+  }
+  sc->passFiles += st->files;
+  sc->passUploaded += st->uploaded + st->duplicates;
+
+  // Next folder of this pass.
+  int failed = 0;
+  if (!sc->rebuild && ++sc->dirIndex < sc->s->ndirs) {
+    if (scanner_begin_dir(sc)) return;
+    log_msg(LOG_ERROR, "scan", "❌ Cannot scan %s, retrying in %d ms",
+            instrument_map_dir(sc->s->instruments, sc->dirIndex), sc->s->conf.rescanMs);
+    metrics_scan_retry();
+    failed = 1;
+  }
+  log_msg(LOG_INFO, "scan", "✅ Finished batch");
+
+  if (sc->rebuild) {
+    event_loop_post(sc->loop, scanner_rebuild_cb, sc);   // kicks when rebuilt
+  } else if (sc->again) {
+    sc->again = 0;
+    scanner_kick(sc);
+  } else if (failed || !scanner_all_watched(sc) || sc->passUploaded < sc->passFiles) {
+    // Nothing will announce a retry of what is left: poll for it.
+    ev_timer_start(sc->rescanTimer, sc->s->conf.rescanMs, 0);
+  }
+}
+
+static void scanner_kick(Scanner* sc) {
+  if (sc->stopping || !sc->s) return;
+  if (scanner_busy(sc)) {
+    sc->again = 1;
+    scan_pipeline_refresh(sc->s->pipeline);   // urgent newcomers need not wait for the backlog
+    return;
+  }
+  ev_timer_stop(sc->rescanTimer);
+  log_msg(LOG_INFO, "scan", "⏳ Running analyser scan...");
+  sc->dirIndex = 0;
+  sc->passFiles = sc->passUploaded = 0;
+  if (!scanner_begin_dir(sc)) {
+    log_msg(LOG_ERROR, "scan", "❌ Cannot start analyser scan, retrying in %d ms", sc->s->conf.rescanMs);
+    metrics_scan_retry();
+    ev_timer_start(sc->rescanTimer, sc->s->conf.rescanMs, 0);
+  }
+}
+
+static void scanner_kick_cb(void* ctx) {
+  scanner_kick((Scanner*)ctx);
+}
+
+// Capture sink thread: a source went idle after receiving data.
+static void on_capture_ready(void* ctx) {
+  Scanner* sc = (Scanner*)ctx;
+  event_loop_post(sc->loop, scanner_kick_cb, sc);
+}
+
+static void on_dir_event(void* ctx, const char* name) {
+  Scanner* sc = (Scanner*)ctx;
+  size_t n = strlen(name);
+  if (n > 0 && (n < 4 || strcmp(name + n - 4, ".txt") != 0)) return;
+  // Writers append in bursts: wait until the folder has been quiet.
+  ev_timer_start(sc->settleTimer, sc->s->conf.settleMs, 0);
+}
+
+static int scanner_start(Scanner* sc, const CombainConfig* cfg, EventLoop* loop) {
+  memset(sc, 0, sizeof(*sc));
+  sc->loop = loop;
+  sc->rescanTimer = ev_timer_new(loop, scanner_kick_cb, sc);
+  sc->settleTimer = ev_timer_new(loop, scanner_kick_cb, sc);
+  if (!sc->rescanTimer || !sc->settleTimer) return 0;
+  sc->s = setup_build(sc, cfg);
+  return sc->s != NULL;
+}
+
+static void grace_expired(void* ctx) {
+  log_msg(LOG_INFO, "scan", "⌛ Shutdown grace period over, abandoning uploads in flight.");
+  event_loop_stop((EventLoop*)ctx);
+}
+
+// Let a running drain finish the uploads it has started (bounded by
+// SHUTDOWN_GRACE_MS) so nothing is sent twice after a restart.
+static void scanner_wind_down(Scanner* sc) {
+  sc->stopping = 1;
+  ev_timer_stop(sc->rescanTimer);
+  ev_timer_stop(sc->settleTimer);
+  if (!scanner_busy(sc)) return;
+
+  scan_pipeline_cancel(sc->s->pipeline);
+  EvTimer* grace = ev_timer_new(sc->loop, grace_expired, sc->loop);
+  if (!grace) return;
+  log_msg(LOG_INFO, "scan", "⏳ Waiting up to %d ms for uploads in flight...", SHUTDOWN_GRACE_MS);
+  ev_timer_start(grace, SHUTDOWN_GRACE_MS, 0);
+  event_loop_run(sc->loop);
+  ev_timer_free(grace);
+}
 
+static void scanner_stop(Scanner* sc) {
+  setup_free(sc->s);
+  sc->s = NULL;
+  ev_timer_free(sc->rescanTimer);
+  ev_timer_free(sc->settleTimer);
+  log_msg(LOG_INFO, "scan", "🧵 Analyser scanner stopped.");
+}
+
+// ===================== SERIAL CAPTURE =====================
+// One per [serial ...] section.
+typedef struct {
+  SerialSpec spec;
+  CaptureSource* capture;      // NULL = write spec.outPath directly
+  SerialPort port;
+  int running;
+  FILE* fout;
+  atomic_ullong bytes;         // captured, for the metrics endpoint
 #ifdef _WIN32
-  typedef DWORD thread_ret;
-  #define THREAD_CALL __stdcall
+  HANDLE thread;
+  atomic_int stop;
 #else
-  #include <pthread.h>
-  typedef void* thread_ret;
-  #define THREAD_CALL
+  EvIo* io;
+  char line[512 + 2];          // room for the line ending added on publish
+  int len;
 #endif
+} SerialInst;
 
-// ===================== THREAD FUNCTIONS =====================
+static void serial_emit_line(SerialInst* si, char* line, int len) {
+  log_msg(LOG_DEBUG, "serial", "Received data: %s", line);
+  if (si->capture) {
+    // same bytes the text-mode file used to get
 #ifdef _WIN32
-thread_ret THREAD_CALL analyser_thread_func(void* arg)
+    memcpy(line + len, "\r\n", 3);
+    len += 2;
 #else
-thread_ret THREAD_CALL analyser_thread_func(void* arg)
+    memcpy(line + len, "\n", 2);
+    len += 1;
 #endif
-{
-  AnalyserConfig* cfg = (AnalyserConfig*)arg;
+    capture_publish(si->capture, line, (size_t)len);
+  } else {
+    fprintf(si->fout, "%s\n", line);
+    fflush(si->fout);
+    len += 1;
+  }
+  atomic_fetch_add_explicit(&si->bytes, (unsigned long long)len, memory_order_relaxed);
+}
 
-  while (keepRunning) {
-    printf("⏳ Running analyser scan...\n");
-    process_directory(cfg->scanDir, cfg->MachineID, cfg->MAC);
-    printf("✅ Finished batch\n");
+static int serial_open_output(SerialInst* si) {
+  si->fout = si->capture ? NULL : fopen(si->spec.outPath, "a");
+  if (!si->capture && !si->fout) {
+    log_msg(LOG_ERROR, "serial", "❌ Cannot open output file %s", si->spec.outPath);
+    close_serial(&si->port);
+    return 0;
+  }
+  return 1;
+}
 
 #ifdef _WIN32
-    Sleep(10000);
-#else
-    sleep(10);
-#endif
+// COM handles cannot join WSAPoll, so each port keeps its own reader thread.
+DWORD __stdcall serial_thread_func(void* arg)
+{
+  SerialInst* si = (SerialInst*)arg;
+
+  char line[512 + 2];  // room for the line ending added on publish
+  while (!shutdown_requested() && !atomic_load(&si->stop)) {
+    int len = read_serial_line(&si->port, &si->stop, line, 512);
+    if (len > 0) serial_emit_line(si, line, len);  // incl. a partial line at stop
+    if (len < 0) break;
   }
 
-  printf("🧵 Analyser thread exiting...\n");
-#ifdef _WIN32
+  if (si->fout) fclose(si->fout);
+  si->fout = NULL;
+  close_serial(&si->port);
+  log_msg(LOG_INFO, "serial", "✅ Serial thread %s exiting gracefully.", si->spec.name);
   return 0;
-#else
-  return NULL;
-#endif
 }
 
-#ifdef _WIN32
-thread_ret THREAD_CALL serial_thread_func(void* arg)
-#else
-thread_ret THREAD_CALL serial_thread_func(void* arg)
-#endif
-{
-  SerialConfig* cfg = (SerialConfig*)arg;
+static int serial_start(SerialInst* si, EventLoop* loop) {
+  (void)loop;
+  si->port.h = INVALID_HANDLE_VALUE;
+  atomic_init(&si->stop, 0);
+
+  if (!open_serial(&si->port, si->spec.device, si->spec.baud)) {
+    log_msg(LOG_ERROR, "serial", "❌ Serial %s: device not found, serial capture disabled.", si->spec.name);
+    return 0;
+  }
+  if (!serial_open_output(si)) return 0;
+
+  log_msg(LOG_INFO, "serial", "📡 Listening on %s ... writing to %s", si->spec.device, si->spec.outPath);
+  si->thread = CreateThread(NULL, 0, serial_thread_func, si, 0, NULL);
+  if (!si->thread) {
+    log_msg(LOG_ERROR, "serial", "Failed to create serial thread");
+    if (si->fout) fclose(si->fout);
+    si->fout = NULL;
+    close_serial(&si->port);
+    return 0;
+  }
+  return 1;
+}
+
+static void serial_stop(SerialInst* si) {
+  atomic_store(&si->stop, 1);
+  WaitForSingleObject(si->thread, INFINITE);  // returns within one read timeout
+  CloseHandle(si->thread);
+  si->thread = NULL;
+}
 
-#ifndef _WIN32
-  mkdir("ss", 0755);
 #else
-  _mkdir("C:\\ss");
-#endif
+// Each serial fd is one more event-loop source; lines are assembled across
+// reads exactly as the blocking reader used to split them.
+static void serial_feed(SerialInst* si, const char* buf, ssize_t n) {
+  for (ssize_t i = 0; i < n; i++) {
+    char ch = buf[i];
+    if (ch == '\r') continue;
+    if (ch != '\n') si->line[si->len++] = ch;
+    if (ch == '\n' || si->len == 511) {
+      si->line[si->len] = '\0';
+      if (si->len > 0) serial_emit_line(si, si->line, si->len);
+      si->len = 0;
+    }
+  }
+}
 
-  if (!open_serial(cfg->portName, cfg->baudRate)) {
-    fprintf(stderr, "❌ Serial thread: device not found, exiting thread.\n");
-#ifdef _WIN32
+// Stop: take what the port has already buffered.
+static void serial_drain(SerialInst* si) {
+  if (!si->io) return;
+  char buf[256];
+  ssize_t n;
+  while ((n = read(si->port.fd, buf, sizeof(buf))) > 0) serial_feed(si, buf, n);
+}
+
+static void serial_close_reader(SerialInst* si) {
+  if (si->len > 0) {   // keep an unterminated last line
+    si->line[si->len] = '\0';
+    serial_emit_line(si, si->line, si->len);
+    si->len = 0;
+  }
+  ev_io_remove(si->io);
+  si->io = NULL;
+  if (si->fout) fclose(si->fout);
+  si->fout = NULL;
+  close_serial(&si->port);
+}
+
+static void on_serial_readable(void* ctx, int revents) {
+  SerialInst* si = (SerialInst*)ctx;
+  (void)revents;
+
+  char buf[256];
+  ssize_t n = read(si->port.fd, buf, sizeof(buf));
+  if (n <= 0) {
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+    log_msg(LOG_ERROR, "serial", "❌ Serial port %s lost, reader stopped.", si->spec.device);
+    serial_close_reader(si);
+    return;
+  }
+
+  serial_feed(si, buf, n);
+}
+
+static int serial_start(SerialInst* si, EventLoop* loop) {
+  si->port.fd = -1;
+
+  if (!open_serial(&si->port, si->spec.device, si->spec.baud)) {
+    log_msg(LOG_ERROR, "serial", "❌ Serial %s: device not found, serial capture disabled.", si->spec.name);
     return 0;
-#else
-    return NULL;
-#endif
   }
+  if (!serial_open_output(si)) return 0;
 
-  FILE* fout = fopen(cfg->filePath, "a");
-  if (!fout) {
-    fprintf(stderr, "❌ Cannot open output file %s\n", cfg->filePath);
-    close_serial();
-#ifdef _WIN32
+  si->io = ev_io_add(loop, si->port.fd, EV_READ, on_serial_readable, si);
+  if (!si->io) {
+    serial_close_reader(si);
     return 0;
-#else
-    return NULL;
-#endif
   }
+  log_msg(LOG_INFO, "serial", "📡 Listening on %s ... writing to %s", si->spec.device, si->spec.outPath);
+  return 1;
+}
 
-  printf("📡 Listening on %s ... writing to %s\n", cfg->portName, cfg->filePath);
+static void serial_stop(SerialInst* si) {
+  if (!si->io) return;   // port already lost
+  serial_drain(si);
+  serial_close_reader(si);
+}
+#endif
 
-  char line[512];
-  while (keepRunning) {
-    int len = read_serial_line(line, sizeof(line));
-    if (len > 0) {
-      printf("Received data: %s\n", line);
-      fprintf(fout, "%s\n", line);
-      fflush(fout);
+// ===================== RUNTIME (config-driven instances) =====================
+typedef struct {
+  ListenerSpec spec;
+  CaptureSource* capture;
+  AnalyserListenerHandle* handle;
+} ListenerInst;
+
+typedef struct {
+  const char* path;            // config file
+  const char* serialOverride;  // argv[1]: device of the first serial port
+  CombainConfig cfg;           // what is running
+  EventLoop* loop;
+  CaptureSink* sink;           // NULL = capture files written directly
+  Scanner* scanner;
+
+  ListenerInst* listeners[CONFIG_MAX_LISTENERS];
+  int nlisteners;
+  SerialInst* serials[CONFIG_MAX_SERIALS];
+  int nserials;
+  CaptureSource* peerQueues[CAPTURE_MAX_SOURCES];   // server-mode peers, for metrics
+  int npeerQueues;
+
+  EvAsync* reloadAsync;        // SIGHUP
+  DirWatch* cfgWatch;          // the config file's folder
+  EvTimer* cfgTimer;           // settle after a change, or stamp polling
+  unsigned long long cfgStamp;
+
+  MetricsServer* metrics;
+  int metricsPort;             // what 'metrics' listens on
+  char traceFile[CONFIG_PATH_MAX];   // the trace file being written
+  char dedupeFile[CONFIG_PATH_MAX];  // the dedupe index in use
+  int dedupeCapacity, dedupeWindowS;
+  char archiveDir[CONFIG_PATH_MAX];  // the archive being written
+  int archiveSegmentMb, archiveCompactDays;
+} Runtime;
+
+// Server-mode peers come and go with their connections (loop thread).
+static void runtime_peer_queue(void* ctx, CaptureSource* queue, int added) {
+  Runtime* rt = (Runtime*)ctx;
+  if (added) {
+    if (rt->npeerQueues < CAPTURE_MAX_SOURCES) rt->peerQueues[rt->npeerQueues++] = queue;
+    return;
+  }
+  for (int i = 0; i < rt->npeerQueues; i++) {
+    if (rt->peerQueues[i] == queue) {
+      rt->peerQueues[i] = rt->peerQueues[--rt->npeerQueues];
+      return;
     }
   }
+}
 
-  fclose(fout);
-  close_serial();
-  printf("✅ Serial thread exiting gracefully.\n");
+static ListenerInst* listener_up(Runtime* rt, const ListenerSpec* spec) {
+  ListenerInst* li = (ListenerInst*)calloc(1, sizeof(ListenerInst));
+  if (!li) return NULL;
+  li->spec = *spec;
+  if (!spec->enabled) {
+    log_msg(LOG_INFO, "listener", "⏸️  Listener %s disabled.", spec->name);
+    return li;
+  }
 
-#ifdef _WIN32
-  return 0;
-#else
-  return NULL;
-#endif
+  // Listeners pause reading while their queue is full: the analyser
+  // sees TCP backpressure. In server mode every peer gets its own queue.
+  if (rt->sink && !spec->server) {
+    li->capture = capture_sink_add(rt->sink, spec->name, spec->outPath, SPSC_BLOCK, (size_t)spec->queue);
+  }
+
+  AnalyserPeerRule rules[CONFIG_MAX_PEERS];
+  for (int i = 0; i < spec->npeers; i++) {
+    const PeerSpec* p = &spec->peers[i];
+    rules[i].name      = p->name;
+    rules[i].address   = p->address[0] ? p->address : NULL;
+    rules[i].signature = p->signature[0] ? p->signature : NULL;
+  }
+
+  AnalyserListenerConfig lc = {
+      .loop     = rt->loop,
+      .ip       = spec->host,
+      .port     = spec->port,
+      .outPath  = spec->outPath,
+      .capture  = li->capture,
+      .server   = spec->server,
+      .maxPeers = spec->maxPeers,
+      .peers    = rules,
+      .npeers   = spec->npeers,
+      .sink     = rt->sink,
+      .queue    = (size_t)spec->queue,
+      .name     = spec->name,
+      .onPeerQueue = runtime_peer_queue,
+      .peerCtx  = rt,
+      .liveness = {
+          .keepalive        = spec->live.keepalive,
+          .keepIdleS        = spec->live.keepIdleS,
+          .keepIntervalS    = spec->live.keepIntervalS,
+          .keepCount        = spec->live.keepCount,
+          .userTimeoutMs    = spec->live.userTimeoutMs,
+          .idleTimeoutMs    = spec->live.idleTimeoutMs,
+          .connectTimeoutMs = spec->live.connectTimeoutMs
+      }
+  };
+  li->handle = start_analyser_listener(&lc);
+  if (!li->handle) {
+    log_msg(LOG_ERROR, "listener", "Failed to start %s analyser listener.", spec->name);
+    capture_source_retire(li->capture);
+    li->capture = NULL;
+  }
+  return li;
 }
 
-// ===================== MAIN: start both threads =====================
-int main(int argc, char* argv[]) {
-  signal(SIGINT, intHandler);
+static void listener_down(ListenerInst* li) {
+  if (!li) return;
+  if (li->handle) stop_analyser_listener(li->handle);  // keeps what is on the wire
+  capture_source_retire(li->capture);
+  free(li);
+}
 
-  const char* envMachine = getenv("MachineID");
-  const char* envMAC     = getenv("MAC");
+static SerialInst* serial_up(Runtime* rt, const SerialSpec* spec) {
+  SerialInst* si = (SerialInst*)calloc(1, sizeof(SerialInst));
+  if (!si) return NULL;
+  si->spec = *spec;
+  if (!spec->enabled) {
+    log_msg(LOG_INFO, "serial", "⏸️  Serial %s disabled.", spec->name);
+    return si;
+  }
 
-  const char* MachineID = (envMachine && *envMachine) ? envMachine : "MC0003";
-  const char* MAC       = (envMAC && *envMAC) ? envMAC : "00:11:22:33:44:55";
+  // Serial cannot be paused, so overflow spills to disk.
+  if (rt->sink) si->capture = capture_sink_add(rt->sink, spec->name, spec->outPath, SPSC_SPILL, (size_t)spec->queue);
+  si->running = serial_start(si, rt->loop);
+  if (!si->running) {
+    capture_source_retire(si->capture);
+    si->capture = NULL;
+  }
+  return si;
+}
 
-  const char* scanDir = DEFAULT_SCAN_DIR;
+static void serial_down(SerialInst* si) {
+  if (!si) return;
+  if (si->running) serial_stop(si);
+  capture_source_retire(si->capture);
+  free(si);
+}
 
-#ifndef _WIN32
-  mkdir("ss", 0755);
-  const char* f200OutPath = "ss/out_f200.txt";
-  const char* h360OutPath = "ss/out_h360.txt";
-#else
-  _mkdir("C:\\ss");
-  const char* f200OutPath = "C:\\ss\\out_f200.txt";
-  const char* h360OutPath = "C:\\ss\\out_h360.txt";
-#endif
+static void apply_overrides(Runtime* rt, CombainConfig* cfg) {
+  if (rt->serialOverride && cfg->nserials > 0) {
+    snprintf(cfg->serials[0].device, sizeof(cfg->serials[0].device), "%s", rt->serialOverride);
+  }
+}
 
-  const char* portName   = (argc > 1) ? argv[1] : DEFAULT_PORT;
-  const char* serialFile = DEFAULT_SERIAL_FILE;
-  const int   baudRate   = 19200;
+static void runtime_start_instances(Runtime* rt) {
+  for (int i = 0; i < rt->cfg.nlisteners; i++) rt->listeners[rt->nlisteners++] = listener_up(rt, &rt->cfg.listeners[i]);
+  for (int i = 0; i < rt->cfg.nserials; i++) rt->serials[rt->nserials++] = serial_up(rt, &rt->cfg.serials[i]);
+}
 
-  curl_global_init(CURL_GLOBAL_DEFAULT);
+static void runtime_stop_instances(Runtime* rt) {
+  // Stop capture, keeping what has already arrived on the wire
+  for (int i = 0; i < rt->nlisteners; i++) listener_down(rt->listeners[i]);
+  for (int i = 0; i < rt->nserials; i++) serial_down(rt->serials[i]);
+  rt->nlisteners = rt->nserials = 0;
+}
 
-  AnalyserConfig analyserCfg = (AnalyserConfig){ scanDir, MachineID, MAC };
-  SerialConfig   serialCfg   = (SerialConfig){ portName, serialFile, baudRate };
+// Instances whose section is unchanged keep running untouched (connection,
+// queue, counters); changed ones are restarted, others stopped or started.
+static void runtime_diff_listeners(Runtime* rt, const CombainConfig* next, int* started, int* stopped) {
+  ListenerInst* keep[CONFIG_MAX_LISTENERS] = {0};
+  for (int i = 0; i < rt->nlisteners; i++) {
+    ListenerInst* li = rt->listeners[i];
+    int j = 0;
+    while (j < next->nlisteners && !config_listener_equal(&li->spec, &next->listeners[j])) j++;
+    if (j < next->nlisteners) {
+      keep[j] = li;
+      li->spec = next->listeners[j];   // identity may differ
+    } else {
+      if (li->spec.enabled) (*stopped)++;
+      listener_down(li);
+    }
+  }
+  for (int j = 0; j < next->nlisteners; j++) {
+    if (!keep[j]) {
+      keep[j] = listener_up(rt, &next->listeners[j]);
+      if (next->listeners[j].enabled) (*started)++;
+    }
+    rt->listeners[j] = keep[j];
+  }
+  rt->nlisteners = next->nlisteners;
+}
 
-  // ===============================================================
-  // 🔹 F200 ANALYSER CONFIG (port 50001)
-  // ===============================================================
-  AnalyserListenerConfig f200Cfg = {
-      .ip      = "192.168.0.173",
-      .port    = 50001,
-      .outPath = f200OutPath
-  };
+static void runtime_diff_serials(Runtime* rt, const CombainConfig* next, int* started, int* stopped) {
+  SerialInst* keep[CONFIG_MAX_SERIALS] = {0};
+  for (int i = 0; i < rt->nserials; i++) {
+    SerialInst* si = rt->serials[i];
+    int j = 0;
+    while (j < next->nserials && !config_serial_equal(&si->spec, &next->serials[j])) j++;
+    // A port that failed to open is retried on every reload.
+    if (j < next->nserials && (si->running || !si->spec.enabled)) {
+      keep[j] = si;
+      si->spec = next->serials[j];
+    } else {
+      if (si->running) (*stopped)++;
+      serial_down(si);
+    }
+  }
+  for (int j = 0; j < next->nserials; j++) {
+    if (!keep[j]) {
+      keep[j] = serial_up(rt, &next->serials[j]);
+      if (keep[j] && keep[j]->running) (*started)++;
+    }
+    rt->serials[j] = keep[j];
+  }
+  rt->nserials = next->nserials;
+}
 
-  // ===============================================================
-  // 🔹 H360 ANALYSER CONFIG (port 50002)
-  // ===============================================================
-  AnalyserListenerConfig h360Cfg = {
-      .ip      = "192.168.0.173",
-      .port    = 50002,
-      .outPath = h360OutPath
-  };
+// ===================== METRICS =====================
+// Served on the loop thread, so the instance arrays can be walked as they
+// are; counters of the scan pipeline come from metrics.c.
+static void collect_listeners(Runtime* rt, MetricsText* t) {
+  AnalyserListenerStats st[CONFIG_MAX_LISTENERS];
+  char name[CONFIG_MAX_LISTENERS][2 * CONFIG_NAME_MAX];
+  int n = 0;
+  for (int i = 0; i < rt->nlisteners; i++) {
+    ListenerInst* li = rt->listeners[i];
+    if (!li || !get_analyser_listener_stats(li->handle, &st[n])) continue;
+    metrics_escape(name[n], sizeof(name[n]), li->spec.name);
+    n++;
+  }
 
-  // ===============================================================
-  // 🚀 START BOTH LISTENERS (multi-instance)
-  // ===============================================================
-  AnalyserListenerHandle *f200Handle = start_analyser_listener(&f200Cfg);
-  if (!f200Handle) {
-      fprintf(stderr, "Failed to start F200 analyser listener.\n");
+  metrics_family(t, "combain_listener_connected", "gauge", "1 while the analyser link is up (server: listening).");
+  for (int i = 0; i < n; i++) {
+    int up = st[i].state == ANALYSER_LINK_CONNECTED || st[i].state == ANALYSER_LINK_PAUSED ||
+             st[i].state == ANALYSER_LINK_LISTENING;
+    metrics_printf(t, "combain_listener_connected{listener=\"%s\"} %d\n", name[i], up);
+  }
+  metrics_family(t, "combain_listener_peers", "gauge", "Analysers connected to a server-mode listener.");
+  for (int i = 0; i < n; i++) metrics_printf(t, "combain_listener_peers{listener=\"%s\"} %d\n", name[i], st[i].peers);
+  metrics_family(t, "combain_listener_reconnects_total", "counter", "Reconnects after a failed connect or a dropped link.");
+  for (int i = 0; i < n; i++) metrics_printf(t, "combain_listener_reconnects_total{listener=\"%s\"} %llu\n", name[i], st[i].reconnects);
+  metrics_family(t, "combain_listener_dead_connections_total", "counter", "Half-open links detected by keepalive or the idle timeout.");
+  for (int i = 0; i < n; i++) metrics_printf(t, "combain_listener_dead_connections_total{listener=\"%s\"} %llu\n", name[i], st[i].deadPeers);
+
+  metrics_family(t, "combain_capture_bytes_total", "counter", "Bytes captured, by listener and serial port.");
+  for (int i = 0; i < n; i++) {
+    metrics_printf(t, "combain_capture_bytes_total{source=\"listener\",name=\"%s\"} %llu\n", name[i], st[i].bytes);
+  }
+  for (int i = 0; i < rt->nserials; i++) {
+    SerialInst* si = rt->serials[i];
+    if (!si || !si->spec.enabled) continue;
+    char esc[2 * CONFIG_NAME_MAX];
+    metrics_printf(t, "combain_capture_bytes_total{source=\"serial\",name=\"%s\"} %llu\n",
+                   metrics_escape(esc, sizeof(esc), si->spec.name), atomic_load(&si->bytes));
   }
+}
 
-  AnalyserListenerHandle *h360Handle = start_analyser_listener(&h360Cfg);
-  if (!h360Handle) {
-      fprintf(stderr, "Failed to start H360 analyser listener.\n");
+// Capture queues of listeners (client mode: the listener's, server mode:
+// each connected peer's) and serial ports.
+static void collect_queues(Runtime* rt, MetricsText* t) {
+  CaptureSource* src[CAPTURE_MAX_SOURCES];
+  int n = 0;
+  for (int i = 0; i < rt->nlisteners; i++) {
+    if (rt->listeners[i] && rt->listeners[i]->capture) src[n++] = rt->listeners[i]->capture;
+  }
+  for (int i = 0; i < rt->npeerQueues && n < CAPTURE_MAX_SOURCES; i++) src[n++] = rt->peerQueues[i];
+  for (int i = 0; i < rt->nserials && n < CAPTURE_MAX_SOURCES; i++) {
+    if (rt->serials[i] && rt->serials[i]->capture) src[n++] = rt->serials[i]->capture;
   }
 
-#ifdef _WIN32
-  HANDLE analyserThread = CreateThread(NULL, 0, analyser_thread_func, &analyserCfg, 0, NULL);
-  if (!analyserThread) {
-    fprintf(stderr, "Failed to create analyser thread\n");
+  SpscStats st[CAPTURE_MAX_SOURCES];
+  char name[CAPTURE_MAX_SOURCES][2 * CONFIG_NAME_MAX];
+  for (int i = 0; i < n; i++) {
+    capture_source_stats(src[i], &st[i]);
+    metrics_escape(name[i], sizeof(name[i]), capture_source_name(src[i]));
+  }
+
+  metrics_family(t, "combain_capture_queue_depth", "gauge", "Frames waiting in a capture queue.");
+  for (int i = 0; i < n; i++) metrics_printf(t, "combain_capture_queue_depth{name=\"%s\"} %zu\n", name[i], st[i].depth);
+  metrics_family(t, "combain_capture_queue_capacity", "gauge", "Capture queue size in frames.");
+  for (int i = 0; i < n; i++) metrics_printf(t, "combain_capture_queue_capacity{name=\"%s\"} %zu\n", name[i], st[i].capacity);
+  metrics_family(t, "combain_capture_queue_blocked_total", "counter", "Publishes that waited for queue space.");
+  for (int i = 0; i < n; i++) metrics_printf(t, "combain_capture_queue_blocked_total{name=\"%s\"} %llu\n", name[i], st[i].blocked);
+  metrics_family(t, "combain_capture_queue_spilled_total", "counter", "Frames written to the spill file instead.");
+  for (int i = 0; i < n; i++) metrics_printf(t, "combain_capture_queue_spilled_total{name=\"%s\"} %llu\n", name[i], st[i].spilled);
+  metrics_family(t, "combain_capture_queue_lost_total", "counter", "Frames dropped or lost.");
+  for (int i = 0; i < n; i++) {
+    metrics_printf(t, "combain_capture_queue_lost_total{name=\"%s\"} %llu\n", name[i], st[i].dropped + st[i].lost);
+  }
+}
 
-    if (f200Handle) { stop_analyser_listener(f200Handle); f200Handle = NULL; }
-    if (h360Handle) { stop_analyser_listener(h360Handle); h360Handle = NULL; }
+static void runtime_collect(void* ctx, MetricsText* t) {
+  Runtime* rt = (Runtime*)ctx;
+  collect_listeners(rt, t);
+  collect_queues(rt, t);
+  trace_render(t);
 
-    curl_global_cleanup();
-    return 1;
+  metrics_family(t, "combain_uploads_in_flight", "gauge", "Uploads started and not finished.");
+  metrics_printf(t, "combain_uploads_in_flight %d\n", rt->scanner->s ? http_multi_active(rt->scanner->s->http) : 0);
+}
+
+// Start, move or stop the endpoint to match rt->cfg.metricsPort.
+static void runtime_metrics_apply(Runtime* rt) {
+  if (rt->metrics && rt->metricsPort == rt->cfg.metricsPort) return;
+  metrics_server_stop(rt->metrics);
+  rt->metrics = NULL;
+  rt->metricsPort = rt->cfg.metricsPort;
+  if (rt->metricsPort <= 0) return;
+
+  rt->metrics = metrics_server_start(rt->loop, "127.0.0.1", rt->metricsPort, runtime_collect, rt);
+  if (rt->metrics) log_msg(LOG_INFO, "metrics", "📊 Metrics on http://127.0.0.1:%d/metrics", rt->metricsPort);
+  else log_msg(LOG_WARN, "metrics", "⚠️  Metrics endpoint unavailable on port %d", rt->metricsPort);
+}
+
+static LoggerConfig logger_config(const CombainConfig* cfg) {
+  LoggerConfig lc;
+  lc.level    = (LogLevel)cfg->logLevel;
+  lc.console  = cfg->logConsole;
+  lc.path     = cfg->logFile;
+  lc.maxBytes = (long)cfg->logMaxKb * 1024;
+  lc.keep     = cfg->logKeep;
+  return lc;
+}
+
+// Open, switch or close the trace file to match rt->cfg.traceFile.
+static void runtime_trace_apply(Runtime* rt) {
+  if (strcmp(rt->traceFile, rt->cfg.traceFile) == 0) return;
+  if (!trace_file_open(rt->cfg.traceFile)) {
+    log_msg(LOG_WARN, "trace", "⚠️  Cannot write trace file %s", rt->cfg.traceFile);
+    return;
   }
+  snprintf(rt->traceFile, sizeof(rt->traceFile), "%s", rt->cfg.traceFile);
+  if (rt->traceFile[0]) log_msg(LOG_INFO, "trace", "⏱️  Tracing result latency to %s", rt->traceFile);
+}
 
-  HANDLE serialThread = CreateThread(NULL, 0, serial_thread_func, &serialCfg, 0, NULL);
-  if (!serialThread) {
-    fprintf(stderr, "Failed to create serial thread\n");
-    keepRunning = 0;
+// Open, reopen or close the dedupe index to match rt->cfg.
+static void runtime_dedupe_apply(Runtime* rt) {
+  const CombainConfig* c = &rt->cfg;
+  if (strcmp(rt->dedupeFile, c->dedupeFile) == 0 && rt->dedupeCapacity == c->dedupeCapacity &&
+      rt->dedupeWindowS == c->dedupeWindowS) return;
+  rt->dedupeFile[0] = '\0';
+  rt->dedupeCapacity = c->dedupeCapacity;
+  rt->dedupeWindowS = c->dedupeWindowS;
+  if (!dedupe_open(c->dedupeFile, c->dedupeCapacity, c->dedupeWindowS)) {
+    log_msg(LOG_WARN, "dedupe", "⚠️  Cannot use dedupe index %s, every result is uploaded", c->dedupeFile);
+    return;
+  }
+  snprintf(rt->dedupeFile, sizeof(rt->dedupeFile), "%s", c->dedupeFile);
+  if (rt->dedupeFile[0]) {
+    char window[32] = "ever";
+    if (rt->dedupeWindowS > 0) snprintf(window, sizeof(window), "in the last %d s", rt->dedupeWindowS);
+    log_msg(LOG_INFO, "dedupe", "♻️  Skipping results uploaded %s (index %s, %d entries)",
+            window, rt->dedupeFile, rt->dedupeCapacity);
+  }
+}
 
-    WaitForSingleObject(analyserThread, INFINITE);
-    CloseHandle(analyserThread);
+// Open, reopen or close the result archive to match rt->cfg.
+static void runtime_archive_apply(Runtime* rt) {
+  const CombainConfig* c = &rt->cfg;
+  if (strcmp(rt->archiveDir, c->archiveDir) == 0 && rt->archiveSegmentMb == c->archiveSegmentMb &&
+      rt->archiveCompactDays == c->archiveCompactDays) return;
+  rt->archiveDir[0] = '\0';
+  rt->archiveSegmentMb = c->archiveSegmentMb;
+  rt->archiveCompactDays = c->archiveCompactDays;
+  if (!archive_open(c->archiveDir, c->archiveSegmentMb, c->archiveCompactDays)) {
+    log_msg(LOG_WARN, "archive", "⚠️  Cannot write archive %s, uploaded results are not kept", c->archiveDir);
+    return;
+  }
+  snprintf(rt->archiveDir, sizeof(rt->archiveDir), "%s", c->archiveDir);
+  if (rt->archiveDir[0]) log_msg(LOG_INFO, "archive", "🗄️  Archiving uploaded results to %s", rt->archiveDir);
+}
 
-    if (f200Handle) { stop_analyser_listener(f200Handle); f200Handle = NULL; }
-    if (h360Handle) { stop_analyser_listener(h360Handle); h360Handle = NULL; }
+static void runtime_reload(Runtime* rt) {
+  if (shutdown_requested()) return;
 
-    curl_global_cleanup();
-    return 1;
+  CombainConfig next;
+  char err[256];
+  int rc = config_load(&next, rt->path, err, sizeof(err));
+  if (rc < 0) {
+    log_msg(LOG_ERROR, "config", "❌ Config %s: %s — keeping the running configuration", rt->path, err);
+    return;
+  }
+  if (rc == 0) {
+    log_msg(LOG_WARN, "config", "⚠️  Config %s is gone, keeping the running configuration", rt->path);
+    return;
   }
+  apply_overrides(rt, &next);
+
+  int lStarted = 0, lStopped = 0, sStarted = 0, sStopped = 0;
+  runtime_diff_listeners(rt, &next, &lStarted, &lStopped);
+  runtime_diff_serials(rt, &next, &sStarted, &sStopped);
+
+  int scannerChanged = config_scanner_changed(&rt->cfg, &next);
+  scanner_reconfigure(rt->scanner, &next);
+  capture_sink_set_idle(rt->sink, next.sinkIdleMs);
+  rt->cfg = next;
+  LoggerConfig lc = logger_config(&rt->cfg);
+  logger_configure(&lc);
+  runtime_metrics_apply(rt);
+  runtime_trace_apply(rt);
+  runtime_dedupe_apply(rt);
+  runtime_archive_apply(rt);
+
+  log_msg(LOG_INFO, "config", "🔄 Config reloaded: listeners +%d/-%d, serial +%d/-%d, scanner %s",
+          lStarted, lStopped, sStarted, sStopped,
+          scannerChanged ? (rt->scanner->rebuild ? "rebuild after the running scan" : "rebuilt") : "unchanged");
+}
 
-  printf("🚀 All threads started (analyser, serial, F200 + H360 listeners). Press Ctrl+C to stop.\n");
+static void on_reload_signal(void* ctx) {
+  Runtime* rt = (Runtime*)ctx;
+  log_msg(LOG_INFO, "config", "🔄 SIGHUP: reloading %s", rt->path);
+  rt->cfgStamp = config_file_stamp(rt->path);
+  runtime_reload(rt);
+}
 
-  WaitForSingleObject(analyserThread, INFINITE);
-  WaitForSingleObject(serialThread, INFINITE);
-  CloseHandle(analyserThread);
-  CloseHandle(serialThread);
+static void on_config_timer(void* ctx) {
+  Runtime* rt = (Runtime*)ctx;
+  unsigned long long stamp = config_file_stamp(rt->path);
+  if (stamp == rt->cfgStamp) return;
+  rt->cfgStamp = stamp;
+  log_msg(LOG_INFO, "config", "🔄 %s changed, reloading", rt->path);
+  runtime_reload(rt);
+}
 
-#else
-  pthread_t analyserThread;
-  pthread_t serialThread;
+static void on_config_dir_event(void* ctx, const char* name) {
+  Runtime* rt = (Runtime*)ctx;
+  const char* base = strrchr(rt->path, PATH_SEP);
+#ifdef _WIN32
+  const char* fwd = strrchr(rt->path, '/');
+  if (fwd > base) base = fwd;
+#endif
+  base = base ? base + 1 : rt->path;
+  if (*name && strcmp(name, base) != 0) return;
+  ev_timer_start(rt->cfgTimer, CONFIG_SETTLE_MS, 0);
+}
 
-  if (pthread_create(&analyserThread, NULL, analyser_thread_func, &analyserCfg) != 0) {
-    perror("pthread_create analyserThread");
+static void runtime_watch_config(Runtime* rt) {
+  rt->cfgStamp = config_file_stamp(rt->path);
+  rt->reloadAsync = ev_async_new(rt->loop, on_reload_signal, rt);
+  shutdown_on_reload(rt->reloadAsync);
+  rt->cfgTimer = ev_timer_new(rt->loop, on_config_timer, rt);
+
+  char dir[CONFIG_PATH_MAX];
+  snprintf(dir, sizeof(dir), "%s", rt->path);
+  char* sep = strrchr(dir, PATH_SEP);
+  if (sep) *sep = '\0'; else snprintf(dir, sizeof(dir), ".");
+  rt->cfgWatch = dir_watch_open(rt->loop, dir, on_config_dir_event, rt);
+  if (!rt->cfgWatch) ev_timer_start(rt->cfgTimer, CONFIG_POLL_MS, CONFIG_POLL_MS);
+}
 
-    if (f200Handle) { stop_analyser_listener(f200Handle); f200Handle = NULL; }
-    if (h360Handle) { stop_analyser_listener(h360Handle); h360Handle = NULL; }
+static void runtime_unwatch_config(Runtime* rt) {
+  shutdown_on_reload(NULL);
+  ev_async_free(rt->reloadAsync);
+  dir_watch_close(rt->cfgWatch);
+  ev_timer_free(rt->cfgTimer);
+  rt->reloadAsync = NULL;
+  rt->cfgWatch = NULL;
+  rt->cfgTimer = NULL;
+}
 
-    curl_global_cleanup();
+// ===================== MAIN: one event loop =====================
+int main(int argc, char* argv[]) {
+  static Runtime rt;   // large: keep it off the stack
+  static Scanner scanner;
+
+  const char* envConfig = getenv("COMBAIN_CONFIG");
+  rt.path = (envConfig && *envConfig) ? envConfig : DEFAULT_CONFIG_FILE;
+  rt.serialOverride = (argc > 1) ? argv[1] : NULL;
+
+  char err[256];
+  int rc = config_load(&rt.cfg, rt.path, err, sizeof(err));
+  if (rc < 0) {
+    log_msg(LOG_ERROR, "config", "❌ Config %s: %s", rt.path, err);
     return 1;
   }
+  apply_overrides(&rt, &rt.cfg);
 
-  if (pthread_create(&serialThread, NULL, serial_thread_func, &serialCfg) != 0) {
-    perror("pthread_create serialThread");
-    keepRunning = 0;
-
-    pthread_join(analyserThread, NULL);
+  // From here on the console and the log file are written by their own
+  // thread; a slow console no longer holds up capture or uploads.
+  LoggerConfig lc = logger_config(&rt.cfg);
+  if (!logger_start(&lc)) fprintf(stderr, "⚠️  Log writer unavailable, logging synchronously\n");
+  log_msg(LOG_INFO, "config", "⚙️  Config: %s%s", rt.path, rc ? "" : " not found, using built-in defaults");
+  ensure_dir(rt.cfg.scanDir);
 
-    if (f200Handle) { stop_analyser_listener(f200Handle); f200Handle = NULL; }
-    if (h360Handle) { stop_analyser_listener(h360Handle); h360Handle = NULL; }
+  format_registry_init();
+  curl_global_init(CURL_GLOBAL_DEFAULT);
 
+  // ===============================================================
+  // 🔹 EVENT LOOP: sockets, serial fd, folder notifications, curl
+  //    sockets and timers all run on this thread.
+  //    EVENT_BACKEND=io_uring|poll overrides the default where built.
+  // ===============================================================
+  EventLoop* loop = event_loop_create();
+  if (!loop) {
+    log_msg(LOG_ERROR, "main", "❌ Cannot create event loop");
     curl_global_cleanup();
+    logger_stop();
+    return 1;
+  }
+  shutdown_install(loop);
+  log_msg(LOG_INFO, "main", "🔁 Event loop: %s", event_loop_backend(loop));
+  rt.loop = loop;
+  rt.scanner = &scanner;
+
+  if (!scanner_start(&scanner, &rt.cfg, loop)) {
+    log_msg(LOG_ERROR, "main", "❌ Analyser scanner: cannot start worker pool");
+    scanner_stop(&scanner);
+    shutdown_done();
+    event_loop_destroy(loop);
+    curl_global_cleanup();
+    logger_stop();
     return 1;
   }
 
-  printf("🚀 All threads started (analyser, serial, F200 + H360 listeners). Press Ctrl+C to stop.\n");
-
-  pthread_join(analyserThread, NULL);
-  pthread_join(serialThread, NULL);
-#endif
+  // ===============================================================
+  // 🔹 CAPTURE SINK: serial + listeners publish into in-memory queues;
+  //    one thread writes the capture files and wakes the scanner.
+  //    Sources come and go with the configuration.
+  // ===============================================================
+  rt.sink = capture_sink_create(on_capture_ready, &scanner, rt.cfg.sinkIdleMs);
+  if (!rt.sink || !capture_sink_start(rt.sink)) {
+    log_msg(LOG_WARN, "main", "⚠️  Capture sink unavailable, capture files are written directly.");
+    capture_sink_stop(rt.sink);
+    rt.sink = NULL;
+  }
 
-  // 🔻 Cleanly stop both listeners
-  if (f200Handle) { stop_analyser_listener(f200Handle); f200Handle = NULL; }
-  if (h360Handle) { stop_analyser_listener(h360Handle); h360Handle = NULL; }
+  // ===============================================================
+  // 🚀 START LISTENERS + SERIAL PORTS (one instance per config section)
+  // ===============================================================
+  runtime_start_instances(&rt);
+  runtime_watch_config(&rt);
+  runtime_metrics_apply(&rt);
+  runtime_trace_apply(&rt);
+  runtime_dedupe_apply(&rt);
+  runtime_archive_apply(&rt);
+
+  scanner_kick(&scanner);
+
+  log_msg(LOG_INFO, "main", "🚀 Event loop running (scanner, %d listener(s), %d serial port(s)). Press Ctrl+C to stop.",
+          rt.nlisteners, rt.nserials);
+  event_loop_run(loop);
+  unsigned long long stopStart = mono_now_ms();
+
+  // 🔻 1. Stop capture, keeping what has already arrived on the wire
+  metrics_server_stop(rt.metrics);
+  rt.metrics = NULL;
+  runtime_unwatch_config(&rt);
+  runtime_stop_instances(&rt);
+
+  // 🔻 2. Flush the capture queues to disk
+  capture_sink_stop(rt.sink);
+
+  // 🔻 3. Let uploads in flight finish, then stop the scanner
+  scanner_wind_down(&scanner);
+  scanner_stop(&scanner);
+  trace_report();
+  trace_file_close();
+  dedupe_close();
+  archive_close();
+
+  shutdown_done();
+  event_loop_destroy(loop);
 
   curl_global_cleanup();
-  printf("🏁 Main exiting.\n");
+  log_msg(LOG_INFO, "main", "🏁 Main exiting (shutdown took %llu ms).", mono_now_ms() - stopStart);
+  logger_stop();
   return 0;
 }
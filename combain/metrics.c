@@ -0,0 +1,332 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "metrics.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
+#if defined(_MSC_VER)
+    #define THREAD_LOCAL __declspec(thread)
+#else
+    #define THREAD_LOCAL _Thread_local
+#endif
+
+#define UPLOAD_STATUSES 5     // 2xx, 4xx, 5xx, other, no response
+#define NBUCKETS        11    // + Inf
+#define NWAIT_BUCKETS   11    // + Inf
+
+static const char *const KIND_NAMES[METRICS_KINDS] = { "unknown", "cbc", "results", "urine" };
+static const char *const PARSE_NAMES[METRIC_PARSE_STATUSES] = { "ok", "test_error", "error", "unreadable" };
+static const char *const UPLOAD_NAMES[UPLOAD_STATUSES] = { "2xx", "4xx", "5xx", "other", "no_response" };
+static const char *const PRIORITY_NAMES[METRICS_PRIORITIES] = { "stat", "urgent", "routine" };
+
+// Upper bounds of the latency buckets.
+static const unsigned long long BUCKET_US[NBUCKETS] = {
+    10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 30000000
+};
+static const char *const BUCKET_LE[NBUCKETS] = {
+    "0.01", "0.025", "0.05", "0.1", "0.25", "0.5", "1", "2.5", "5", "10", "30"
+};
+
+// Arrival-to-upload waits include any backlog: seconds to an hour.
+static const unsigned long long WAIT_BUCKET_US[NWAIT_BUCKETS] = {
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 30000000, 60000000, 300000000, 3600000000ull
+};
+static const char *const WAIT_BUCKET_LE[NWAIT_BUCKETS] = {
+    "0.1", "0.25", "0.5", "1", "2.5", "5", "10", "30", "60", "300", "3600"
+};
+
+// Slots of one block.
+enum {
+    C_SCANNED    = 0,
+    C_PARSED     = 1,
+    C_UPLOADS    = C_PARSED + METRICS_KINDS * METRIC_PARSE_STATUSES,
+    C_LATENCY    = C_UPLOADS + METRICS_KINDS * UPLOAD_STATUSES,
+    C_LAT_SUM    = C_LATENCY + METRICS_KINDS * (NBUCKETS + 1),
+    C_DEFERRED   = C_LAT_SUM + METRICS_KINDS,
+    C_SCAN_RETRIES,
+    C_DUPLICATES,
+    C_WAIT       = C_DUPLICATES + METRICS_KINDS,
+    C_WAIT_SUM   = C_WAIT + METRICS_PRIORITIES * (NWAIT_BUCKETS + 1),
+    C_COUNT      = C_WAIT_SUM + METRICS_PRIORITIES
+};
+
+// ===============================================================
+//  Per-thread blocks
+// ===============================================================
+
+typedef struct Shard {
+    atomic_ullong v[C_COUNT];
+    atomic_int    owned;      // a live thread writes it
+    struct Shard *next;       // never unlinked
+} Shard;
+
+static _Atomic(Shard *) g_shards;
+static THREAD_LOCAL Shard *t_shard;
+
+// A thread has exited: the next new thread carries on adding to its
+// counts, so the sums stay right and the list stays as long as the most
+// threads ever alive at once.
+static void release_shard(void *p) {
+    if (p) atomic_store(&((Shard *)p)->owned, 0);
+}
+
+#ifdef _WIN32
+
+static INIT_ONCE g_once = INIT_ONCE_STATIC_INIT;
+static DWORD     g_key = FLS_OUT_OF_INDEXES;
+
+static VOID WINAPI release_fls(PVOID p) {
+    release_shard(p);
+}
+
+static BOOL CALLBACK make_key(PINIT_ONCE once, PVOID param, PVOID *ctx) {
+    (void)once; (void)param; (void)ctx;
+    g_key = FlsAlloc(release_fls);
+    return TRUE;
+}
+
+static void bind_thread(Shard *s) {
+    InitOnceExecuteOnce(&g_once, make_key, NULL, NULL);
+    if (g_key != FLS_OUT_OF_INDEXES) FlsSetValue(g_key, s);
+}
+
+#else
+
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static pthread_key_t  g_key;
+static int            g_keyOk;
+
+static void make_key(void) {
+    g_keyOk = pthread_key_create(&g_key, release_shard) == 0;
+}
+
+static void bind_thread(Shard *s) {
+    pthread_once(&g_once, make_key);
+    if (g_keyOk) pthread_setspecific(g_key, s);
+}
+
+#endif
+
+static Shard *take_shard(void) {
+    for (Shard *s = atomic_load(&g_shards); s; s = s->next) {
+        int free_ = 0;
+        if (atomic_compare_exchange_strong(&s->owned, &free_, 1)) return s;
+    }
+
+    Shard *s = (Shard *)calloc(1, sizeof(Shard));
+    if (!s) return NULL;
+    for (int i = 0; i < C_COUNT; i++) atomic_init(&s->v[i], 0);
+    atomic_init(&s->owned, 1);
+    s->next = atomic_load(&g_shards);
+    while (!atomic_compare_exchange_weak(&g_shards, &s->next, s)) { }
+    return s;
+}
+
+static Shard *my_shard(void) {
+    if (!t_shard) {
+        t_shard = take_shard();
+        if (t_shard) bind_thread(t_shard);
+    }
+    return t_shard;
+}
+
+// Single writer per block: a relaxed load and store, no read-modify-write.
+static void bump(int slot, unsigned long long n) {
+    Shard *s = my_shard();
+    if (!s) return;
+    unsigned long long v = atomic_load_explicit(&s->v[slot], memory_order_relaxed);
+    atomic_store_explicit(&s->v[slot], v + n, memory_order_relaxed);
+}
+
+static int kind_index(int kind) {
+    return (kind > 0 && kind < METRICS_KINDS) ? kind : 0;
+}
+
+// ===============================================================
+//  Recording
+// ===============================================================
+
+void metrics_file_scanned(void) {
+    bump(C_SCANNED, 1);
+}
+
+void metrics_file_parsed(int kind, MetricParseStatus status) {
+    bump(C_PARSED + kind_index(kind) * METRIC_PARSE_STATUSES + (int)status, 1);
+}
+
+void metrics_upload(int kind, long httpStatus, unsigned long long us) {
+    int k = kind_index(kind);
+    int st = httpStatus <= 0                      ? 4
+           : httpStatus >= 200 && httpStatus < 300 ? 0
+           : httpStatus >= 400 && httpStatus < 500 ? 1
+           : httpStatus >= 500 && httpStatus < 600 ? 2
+           : 3;
+    bump(C_UPLOADS + k * UPLOAD_STATUSES + st, 1);
+
+    int b = 0;
+    while (b < NBUCKETS && us > BUCKET_US[b]) b++;
+    bump(C_LATENCY + k * (NBUCKETS + 1) + b, 1);
+    bump(C_LAT_SUM + k, us);
+}
+
+void metrics_upload_deferred(int n) {
+    if (n > 0) bump(C_DEFERRED, (unsigned long long)n);
+}
+
+void metrics_scan_retry(void) {
+    bump(C_SCAN_RETRIES, 1);
+}
+
+void metrics_duplicate_skipped(int kind) {
+    bump(C_DUPLICATES + kind_index(kind), 1);
+}
+
+void metrics_result_wait(int priority, unsigned long long us) {
+    if (priority < 0 || priority >= METRICS_PRIORITIES) return;
+    int b = 0;
+    while (b < NWAIT_BUCKETS && us > WAIT_BUCKET_US[b]) b++;
+    bump(C_WAIT + priority * (NWAIT_BUCKETS + 1) + b, 1);
+    bump(C_WAIT_SUM + priority, us);
+}
+
+// ===============================================================
+//  Text exposition
+// ===============================================================
+
+void metrics_printf(MetricsText *t, const char *fmt, ...) {
+    if (t->failed) return;
+    for (;;) {
+        size_t room = t->cap - t->len;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(t->data ? t->data + t->len : NULL, room, fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            t->failed = 1;
+            return;
+        }
+        if ((size_t)n < room) {
+            t->len += (size_t)n;
+            return;
+        }
+        size_t cap = t->cap ? t->cap * 2 : 4096;
+        while (cap - t->len <= (size_t)n) cap *= 2;
+        char *p = (char *)realloc(t->data, cap);
+        if (!p) {
+            t->failed = 1;
+            return;
+        }
+        t->data = p;
+        t->cap = cap;
+    }
+}
+
+void metrics_family(MetricsText *t, const char *name, const char *type, const char *help) {
+    metrics_printf(t, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+const char *metrics_escape(char *dst, size_t cap, const char *src) {
+    size_t n = 0;
+    for (; *src && n + 2 < cap; src++) {
+        char c = *src;
+        if (c == '\\' || c == '"' || c == '\n') {
+            dst[n++] = '\\';
+            c = (c == '\n') ? 'n' : c;
+        }
+        dst[n++] = c;
+    }
+    dst[n] = '\0';
+    return dst;
+}
+
+void metrics_render(MetricsText *t) {
+    unsigned long long sum[C_COUNT] = {0};
+    for (Shard *s = atomic_load(&g_shards); s; s = s->next) {
+        for (int i = 0; i < C_COUNT; i++) sum[i] += atomic_load_explicit(&s->v[i], memory_order_relaxed);
+    }
+
+    metrics_family(t, "combain_files_scanned_total", "counter", "Result files found in the scan folders.");
+    metrics_printf(t, "combain_files_scanned_total %llu\n", sum[C_SCANNED]);
+
+    metrics_family(t, "combain_files_parsed_total", "counter", "Result files parsed, by analyser type and outcome.");
+    for (int k = 1; k < METRICS_KINDS; k++) {
+        for (int s = 0; s < METRIC_PARSE_STATUSES - 1; s++) {
+            metrics_printf(t, "combain_files_parsed_total{analyser=\"%s\",status=\"%s\"} %llu\n",
+                           KIND_NAMES[k], PARSE_NAMES[s], sum[C_PARSED + k * METRIC_PARSE_STATUSES + s]);
+        }
+    }
+    metrics_printf(t, "combain_files_parsed_total{analyser=\"unknown\",status=\"unreadable\"} %llu\n",
+                   sum[C_PARSED + METRIC_PARSE_UNREADABLE]);
+
+    metrics_family(t, "combain_uploads_total", "counter", "Result uploads, by endpoint and HTTP status class.");
+    for (int k = 1; k < METRICS_KINDS; k++) {
+        for (int s = 0; s < UPLOAD_STATUSES; s++) {
+            metrics_printf(t, "combain_uploads_total{endpoint=\"%s\",status=\"%s\"} %llu\n",
+                           KIND_NAMES[k], UPLOAD_NAMES[s], sum[C_UPLOADS + k * UPLOAD_STATUSES + s]);
+        }
+    }
+
+    metrics_family(t, "combain_upload_duration_seconds", "histogram", "Time from starting an upload to its end.");
+    for (int k = 1; k < METRICS_KINDS; k++) {
+        const unsigned long long *b = &sum[C_LATENCY + k * (NBUCKETS + 1)];
+        unsigned long long cum = 0;
+        for (int i = 0; i < NBUCKETS; i++) {
+            cum += b[i];
+            metrics_printf(t, "combain_upload_duration_seconds_bucket{endpoint=\"%s\",le=\"%s\"} %llu\n",
+                           KIND_NAMES[k], BUCKET_LE[i], cum);
+        }
+        cum += b[NBUCKETS];
+        metrics_printf(t, "combain_upload_duration_seconds_bucket{endpoint=\"%s\",le=\"+Inf\"} %llu\n",
+                       KIND_NAMES[k], cum);
+        metrics_printf(t, "combain_upload_duration_seconds_sum{endpoint=\"%s\"} %.6f\n",
+                       KIND_NAMES[k], sum[C_LAT_SUM + k] / 1e6);
+        metrics_printf(t, "combain_upload_duration_seconds_count{endpoint=\"%s\"} %llu\n", KIND_NAMES[k], cum);
+    }
+
+    metrics_family(t, "combain_upload_retries_total", "counter",
+                   "Results left in the folder for a later pass: failed, or queued behind a failed upload of the same sample.");
+    metrics_printf(t, "combain_upload_retries_total %llu\n", sum[C_DEFERRED]);
+
+    metrics_family(t, "combain_scan_retries_total", "counter", "Scans that could not start and were rescheduled.");
+    metrics_printf(t, "combain_scan_retries_total %llu\n", sum[C_SCAN_RETRIES]);
+
+    metrics_family(t, "combain_duplicates_skipped_total", "counter",
+                   "Results deleted without an upload: the same content was uploaded before.");
+    for (int k = 1; k < METRICS_KINDS; k++) {
+        metrics_printf(t, "combain_duplicates_skipped_total{analyser=\"%s\"} %llu\n",
+                       KIND_NAMES[k], sum[C_DUPLICATES + k]);
+    }
+
+    metrics_family(t, "combain_result_wait_seconds", "histogram",
+                   "Time from a result arriving in its scan folder to its upload, by upload priority.");
+    for (int p = 0; p < METRICS_PRIORITIES; p++) {
+        const unsigned long long *b = &sum[C_WAIT + p * (NWAIT_BUCKETS + 1)];
+        unsigned long long cum = 0;
+        for (int i = 0; i < NWAIT_BUCKETS; i++) {
+            cum += b[i];
+            metrics_printf(t, "combain_result_wait_seconds_bucket{priority=\"%s\",le=\"%s\"} %llu\n",
+                           PRIORITY_NAMES[p], WAIT_BUCKET_LE[i], cum);
+        }
+        cum += b[NWAIT_BUCKETS];
+        metrics_printf(t, "combain_result_wait_seconds_bucket{priority=\"%s\",le=\"+Inf\"} %llu\n",
+                       PRIORITY_NAMES[p], cum);
+        metrics_printf(t, "combain_result_wait_seconds_sum{priority=\"%s\"} %.6f\n",
+                       PRIORITY_NAMES[p], sum[C_WAIT_SUM + p] / 1e6);
+        metrics_printf(t, "combain_result_wait_seconds_count{priority=\"%s\"} %llu\n", PRIORITY_NAMES[p], cum);
+    }
+}
+
+void metrics_text_free(MetricsText *t) {
+    free(t->data);
+    memset(t, 0, sizeof(*t));
+}
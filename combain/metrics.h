@@ -0,0 +1,91 @@
+#ifndef COMBAIN_METRICS_H
+#define COMBAIN_METRICS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Process-wide counters for the metrics endpoint (Prometheus text format).
+ *
+ * Every thread records into a block of its own, taken on its first update
+ * and handed to the next new thread once it exits: an update is a
+ * thread-local lookup and a relaxed store, with no lock and no cache line
+ * shared with another writer. A scrape sums the blocks. Values that
+ * already live elsewhere (listener and capture statistics) are added by
+ * the server's collector at scrape time instead.
+ *
+ * Analyser types are indexed by AnalyserKind (1..3); 0 is "unknown".
+ */
+
+#define METRICS_KINDS 4
+
+/** Upload priorities, indexed by ScanPriority (scan_pipeline.h). */
+#define METRICS_PRIORITIES 3
+
+typedef enum {
+    METRIC_PARSE_OK = 0,
+    METRIC_PARSE_TEST_ERROR,   // the instrument reported a measurement error
+    METRIC_PARSE_ERROR,        // the file did not parse
+    METRIC_PARSE_UNREADABLE,   // could not be read or classified
+    METRIC_PARSE_STATUSES
+} MetricParseStatus;
+
+/** A result file was listed in a scan folder. */
+void metrics_file_scanned(void);
+
+void metrics_file_parsed(int kind, MetricParseStatus status);
+
+/**
+ * One upload to the endpoint of 'kind' ended. 'httpStatus' is the HTTP
+ * status, 0 when no response arrived. 'us' is the time from the request
+ * being started to its end.
+ */
+void metrics_upload(int kind, long httpStatus, unsigned long long us);
+
+/** 'n' results were left in the folder for a later pass to retry. */
+void metrics_upload_deferred(int n);
+
+/** A scan could not start and was rescheduled. */
+void metrics_scan_retry(void);
+
+/** A result of 'kind' was already uploaded and was dropped unsent. */
+void metrics_duplicate_skipped(int kind);
+
+/**
+ * A result of upload priority 'priority' was uploaded 'us' after it
+ * arrived in its scan folder.
+ */
+void metrics_result_wait(int priority, unsigned long long us);
+
+// ===============================================================
+//  Text exposition
+// ===============================================================
+
+typedef struct {
+    char  *data;
+    size_t len, cap;
+    int    failed;     // out of memory: the text is incomplete
+} MetricsText;
+
+/** Append printf-style. */
+void metrics_printf(MetricsText *t, const char *fmt, ...);
+
+/** "# HELP" and "# TYPE" lines of one metric family. */
+void metrics_family(MetricsText *t, const char *name, const char *type, const char *help);
+
+/** 'src' as a label value (backslash, quote and newline escaped). */
+const char *metrics_escape(char *dst, size_t cap, const char *src);
+
+/** Append every counter recorded through this module. */
+void metrics_render(MetricsText *t);
+
+void metrics_text_free(MetricsText *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMBAIN_METRICS_H
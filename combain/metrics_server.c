@@ -0,0 +1,275 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "metrics_server.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #pragma comment(lib, "ws2_32.lib")
+#else
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <sys/types.h>
+  #include <sys/socket.h>
+  #include <netinet/in.h>
+  #include <arpa/inet.h>
+#endif
+
+#define REQUEST_MAX   2048
+#define CLIENT_MS     5000    // a scrape must be over by then
+#define MAX_CLIENTS   8
+
+typedef struct Client {
+    struct MetricsServer *ms;
+    EvSocket sock;
+    EvIo    *io;
+    EvTimer *timer;
+    char     req[REQUEST_MAX];
+    size_t   nreq;
+    MetricsText resp;         // head and body, once the request is in
+    size_t   sent;
+    struct Client *prev, *next;
+} Client;
+
+struct MetricsServer {
+    EventLoop *loop;
+    EvSocket   sock;
+    EvIo      *io;
+    MetricsCollectFn collect;
+    void      *ctx;
+    Client    *clients;
+    int        nclients;
+};
+
+// ===============================================================
+//  Small cross-platform helpers
+// ===============================================================
+
+#ifdef _WIN32
+
+#define BAD_SOCKET ((EvSocket)INVALID_SOCKET)
+
+static void close_socket(EvSocket s) {
+    closesocket((SOCKET)s);
+}
+
+static int set_nonblocking(EvSocket s) {
+    u_long nb = 1;
+    return ioctlsocket((SOCKET)s, FIONBIO, &nb) == 0;
+}
+
+static int would_block(void) {
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+#else // POSIX
+
+#define BAD_SOCKET (-1)
+
+static void close_socket(EvSocket s) {
+    close(s);
+}
+
+static int set_nonblocking(EvSocket s) {
+    int fl = fcntl(s, F_GETFL, 0);
+    return fl >= 0 && fcntl(s, F_SETFL, fl | O_NONBLOCK) == 0;
+}
+
+static int would_block(void) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0   // a scraper hanging up must not raise SIGPIPE
+#endif
+
+#endif
+
+// ===============================================================
+//  One scrape
+// ===============================================================
+
+static void close_client(Client *c) {
+    struct MetricsServer *ms = c->ms;
+    if (c->prev) c->prev->next = c->next; else ms->clients = c->next;
+    if (c->next) c->next->prev = c->prev;
+    ms->nclients--;
+
+    ev_io_remove(c->io);
+    ev_timer_free(c->timer);
+    close_socket(c->sock);
+    metrics_text_free(&c->resp);
+    free(c);
+}
+
+static void build_response(Client *c) {
+    struct MetricsServer *ms = c->ms;
+    int found = strncmp(c->req, "GET /metrics", 12) == 0 &&
+                (c->req[12] == ' ' || c->req[12] == '?');
+
+    MetricsText body = {0};
+    if (found) {
+        metrics_render(&body);
+        if (ms->collect) ms->collect(ms->ctx, &body);
+    } else {
+        metrics_printf(&body, "Not found: try /metrics\n");
+    }
+
+    if (body.failed) {
+        metrics_printf(&c->resp, "HTTP/1.0 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    } else {
+        metrics_printf(&c->resp,
+                       "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                       found ? "200 OK" : "404 Not Found",
+                       found ? "text/plain; version=0.0.4; charset=utf-8" : "text/plain",
+                       body.len);
+        if (body.len) metrics_printf(&c->resp, "%.*s", (int)body.len, body.data);
+    }
+    metrics_text_free(&body);
+}
+
+// Returns 0 once the client is closed.
+static int send_some(Client *c) {
+    while (c->sent < c->resp.len) {
+#ifdef _WIN32
+        int n = send((SOCKET)c->sock, c->resp.data + c->sent, (int)(c->resp.len - c->sent), 0);
+#else
+        int n = (int)send(c->sock, c->resp.data + c->sent, c->resp.len - c->sent, MSG_NOSIGNAL);
+#endif
+        if (n < 0 && would_block()) {
+            ev_io_set(c->io, EV_WRITE);
+            return 1;
+        }
+        if (n <= 0) break;
+        c->sent += (size_t)n;
+    }
+    close_client(c);
+    return 0;
+}
+
+static void on_client_io(void *ctx, int revents) {
+    Client *c = (Client *)ctx;
+    (void)revents;
+
+    if (c->resp.len || c->resp.failed) {
+        send_some(c);
+        return;
+    }
+
+#ifdef _WIN32
+    int n = recv((SOCKET)c->sock, c->req + c->nreq, (int)(sizeof(c->req) - 1 - c->nreq), 0);
+#else
+    int n = (int)recv(c->sock, c->req + c->nreq, sizeof(c->req) - 1 - c->nreq, 0);
+#endif
+    if (n < 0 && would_block()) return;
+    if (n <= 0) {
+        close_client(c);
+        return;
+    }
+    c->nreq += (size_t)n;
+    c->req[c->nreq] = '\0';
+
+    // The request line is all we need; wait for the end of the headers so
+    // the client is not reset while still sending them.
+    if (!strstr(c->req, "\r\n\r\n") && !strstr(c->req, "\n\n") && c->nreq < sizeof(c->req) - 1) return;
+
+    build_response(c);
+    if (c->resp.failed) {
+        close_client(c);
+        return;
+    }
+    send_some(c);
+}
+
+static void on_client_timer(void *ctx) {
+    close_client((Client *)ctx);
+}
+
+static void on_accept(void *ctx, int revents) {
+    struct MetricsServer *ms = (struct MetricsServer *)ctx;
+    (void)revents;
+
+    for (;;) {
+        EvSocket s = (EvSocket)accept(ms->sock, NULL, NULL);
+        if (s == BAD_SOCKET) return;
+
+        Client *c = ms->nclients < MAX_CLIENTS ? (Client *)calloc(1, sizeof(Client)) : NULL;
+        if (!c || !set_nonblocking(s)) {
+            free(c);
+            close_socket(s);
+            continue;
+        }
+        c->ms = ms;
+        c->sock = s;
+        c->next = ms->clients;
+        if (ms->clients) ms->clients->prev = c;
+        ms->clients = c;
+        ms->nclients++;
+
+        c->io = ev_io_add(ms->loop, s, EV_READ, on_client_io, c);
+        c->timer = ev_timer_new(ms->loop, on_client_timer, c);
+        if (!c->io || !c->timer) {
+            close_client(c);
+            continue;
+        }
+        ev_timer_start(c->timer, CLIENT_MS, 0);
+    }
+}
+
+// ===============================================================
+//  Public API
+// ===============================================================
+
+MetricsServer *metrics_server_start(EventLoop *loop, const char *host, int port,
+                                    MetricsCollectFn collect, void *ctx) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons((unsigned short)port);
+    if (!loop || port <= 0 || inet_pton(AF_INET, host, &addr.sin_addr) <= 0) {
+        log_msg(LOG_ERROR, "metrics", "❌ Invalid metrics address %s:%d", host, port);
+        return NULL;
+    }
+
+    EvSocket s = (EvSocket)socket(AF_INET, SOCK_STREAM, 0);
+    if (s == BAD_SOCKET) return NULL;
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *)&one, sizeof(one));
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s, 8) != 0 ||
+        !set_nonblocking(s)) {
+        log_msg(LOG_ERROR, "metrics", "❌ Metrics cannot listen on %s:%d", host, port);
+        close_socket(s);
+        return NULL;
+    }
+
+    struct MetricsServer *ms = (struct MetricsServer *)calloc(1, sizeof(*ms));
+    if (!ms) {
+        close_socket(s);
+        return NULL;
+    }
+    ms->loop    = loop;
+    ms->sock    = s;
+    ms->collect = collect;
+    ms->ctx     = ctx;
+    ms->io = ev_io_add(loop, s, EV_READ, on_accept, ms);
+    if (!ms->io) {
+        close_socket(s);
+        free(ms);
+        return NULL;
+    }
+    return ms;
+}
+
+void metrics_server_stop(MetricsServer *ms) {
+    if (!ms) return;
+    while (ms->clients) close_client(ms->clients);
+    ev_io_remove(ms->io);
+    close_socket(ms->sock);
+    free(ms);
+}
@@ -0,0 +1,37 @@
+#ifndef COMBAIN_METRICS_SERVER_H
+#define COMBAIN_METRICS_SERVER_H
+
+#include "event_loop.h"
+#include "metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * GET /metrics over plain HTTP/1.0, served from the event loop: the
+ * counters of metrics.h plus whatever 'collect' appends. Any other path
+ * gets 404. Each connection answers one request and closes; a client
+ * that stalls is dropped after a few seconds.
+ */
+
+typedef struct MetricsServer MetricsServer;
+
+/** Runs on the loop thread for every scrape. */
+typedef void (*MetricsCollectFn)(void *ctx, MetricsText *out);
+
+/**
+ * Listen on 'host':'port' (e.g. "127.0.0.1", 9464). 'collect' may be
+ * NULL. Returns NULL if the port cannot be bound.
+ */
+MetricsServer *metrics_server_start(EventLoop *loop, const char *host, int port,
+                                    MetricsCollectFn collect, void *ctx);
+
+/** Close the port and any open connection. Safe to call with NULL. */
+void metrics_server_stop(MetricsServer *ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMBAIN_METRICS_SERVER_H
@@ -0,0 +1,25 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "monotime.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+unsigned long long monotime_us(void) {
+#ifdef _WIN32
+    // counts * 10^6 overflows after days at a 10 MHz counter: scale the
+    // whole seconds and the remainder separately.
+    LARGE_INTEGER f, c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    unsigned long long freq = (unsigned long long)f.QuadPart, count = (unsigned long long)c.QuadPart;
+    return (count / freq) * 1000000ull + (count % freq) * 1000000ull / freq;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ull + (unsigned long long)ts.tv_nsec / 1000;
+#endif
+}
@@ -0,0 +1,19 @@
+#ifndef COMBAIN_MONOTIME_H
+#define COMBAIN_MONOTIME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Monotonic clock in microseconds (QueryPerformanceCounter on Windows,
+ * CLOCK_MONOTONIC elsewhere). Only differences are meaningful; it does
+ * not wrap or overflow for the life of the process.
+ */
+unsigned long long monotime_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMBAIN_MONOTIME_H
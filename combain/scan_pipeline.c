@@ -0,0 +1,1012 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "scan_pipeline.h"
+#include "archive.h"
+#include "dedupe.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <ctype.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <curl/curl.h>
+
+// Files per batch. Bounds the encoded bodies held in the arenas between the
+// parse and upload phases (a few KB each).
+#define SCAN_BATCH 256
+
+// ScanFile.level before the file has been triaged.
+#define SCAN_LEVEL_UNKNOWN (-1)
+
+struct ScanPipeline;
+
+typedef struct {
+    char               *path;
+    char               *name;
+    const ScanIdentity *id;
+    uint64_t            nameHash;   // for telling new files from listed ones
+    unsigned long long  arrivedUs;  // trace_now_us() clock
+    uint64_t            sample;     // sample_hash() once triaged, 0 = none
+    int                 level;      // ScanPriority once triaged
+} ScanFile;
+
+typedef struct ScanJob {
+    struct ScanPipeline  *sp;
+    char                 *path;
+    char                 *name;
+    const ScanIdentity   *id;
+
+    const AnalyserFormat *fmt;      // NULL if the file could not be read
+    int                   encoded;  // body holds an upload-ready record
+    ByteBuf               body;     // in the parsing worker's arena
+    char                  sampleId[64];
+    uint64_t              key;      // dedupe_key(), 0 = none
+    int                   level;    // ScanPriority
+    unsigned long long    arrivedUs;
+    unsigned long long    waitUs;   // arrival to upload, once uploaded
+    char                  tests[ARCHIVE_TESTS_MAX];  // only with an archive
+
+    size_t                allocs;   // arena use of the parse phase
+    size_t                bytes;
+
+    struct ScanJob       *nextInGroup;
+    struct ScanJob       *nextReady;
+    int                   groupLevel;   // the most urgent result of its group
+    int                   uploaded;
+    int                   duplicate;
+    TraceTimes            trace;
+} ScanJob;
+
+struct ScanPipeline {
+    const ScanPipelineConfig *cfg;
+    ScanIdentity self;          // cfg's own identity
+    const char  *dir;           // being listed
+    WorkPool *pool;
+
+    // One arena per worker plus one for the draining thread, which runs
+    // tasks itself if the pool cannot queue them.
+    Arena   **arenas;
+    int       narenas;
+
+    ScanJob   jobs[SCAN_BATCH];
+    int       njobs;
+    int       batch;            // configured batch size, <= SCAN_BATCH
+    ScanDrainStats st;
+
+    // scan_pipeline_begin() state (loop thread)
+    EventLoop  *loop;
+    HttpMulti  *http;
+    ScanDoneFn  done;
+    void       *doneCtx;
+    int         busy;
+    ScanFile   *files;          // directory listing still to process
+    int         nfiles, capFiles, nextFile;
+    atomic_int  parseLeft;      // parse tasks of the batch still running
+    int         uploadsLeft;    // sample groups of the batch still uploading
+    atomic_int  cancelled;      // scan_pipeline_cancel(): wind down
+
+    // Upload queue: groups ready to start, FIFO per ScanPriority.
+    ScanJob    *ready[SCAN_PRIORITIES], *readyTail[SCAN_PRIORITIES];
+    int         inFlight;
+    int         relist;         // scan_pipeline_refresh() since the last listing
+    uint64_t   *seen;           // during a relist: names listed so far, sorted
+    int         nseen;
+    atomic_int  triageLeft, triageNext;
+};
+
+static char *dup_str(const char *s) {
+    size_t n = strlen(s) + 1;
+    char *p = (char *)malloc(n);
+    if (p) memcpy(p, s, n);
+    return p;
+}
+
+static const RecordEncoder *encoder_of(const ScanPipelineConfig *cfg) {
+    return cfg->encoder ? cfg->encoder : record_encoder_json();
+}
+
+static const ScanIdentity *identify(struct ScanPipeline *sp, const char *name) {
+    const ScanPipelineConfig *cfg = sp->cfg;
+    const ScanIdentity *id = cfg->identify ? cfg->identify(cfg->identifyCtx, sp->dir, name) : NULL;
+    return id ? id : &sp->self;
+}
+
+static Arena *arena_for(struct ScanPipeline *sp, int worker) {
+    return sp->arenas[worker >= 0 ? worker : sp->narenas - 1];
+}
+
+// ===============================================================
+//  Priority
+// ===============================================================
+
+// Case-insensitive: is 's' one of the ',' separated entries of 'list'?
+static int in_list(const char *list, const char *s) {
+    size_t n = strlen(s);
+    if (!list || !n) return 0;
+    for (const char *p = list; *p;) {
+        while (*p == ',' || *p == ' ') p++;
+        const char *e = p;
+        while (*e && *e != ',') e++;
+        const char *t = e;
+        while (t > p && t[-1] == ' ') t--;
+        if ((size_t)(t - p) == n) {
+            size_t i = 0;
+            while (i < n && tolower((unsigned char)p[i]) == tolower((unsigned char)s[i])) i++;
+            if (i == n) return 1;
+        }
+        p = e;
+    }
+    return 0;
+}
+
+static int contains_nocase(const char *s, const char *needle) {
+    size_t n = strlen(needle);
+    for (; *s; s++) {
+        size_t i = 0;
+        while (i < n && s[i] && tolower((unsigned char)s[i]) == tolower((unsigned char)needle[i])) i++;
+        if (i == n) return 1;
+    }
+    return 0;
+}
+
+// Is a test code or name of 'rec' in 'tests'? Formats without codes
+// (urine) name their results by key.
+static int has_priority_test(const char *tests, const AnalyserRecord *rec) {
+    for (int i = 0; i < rec->nfields; i++) {
+        const RecordField *f = &rec->fields[i];
+        int coded = !strcmp(f->key, "test_code") || !strcmp(f->key, "name") || !strcmp(f->key, "test_name");
+        if (coded ? in_list(tests, f->value) : f->result >= 0 && in_list(tests, f->key)) return 1;
+    }
+    return 0;
+}
+
+static int record_priority(const ScanPipelineConfig *cfg, const AnalyserRecord *rec) {
+    if (cfg->statMarker && cfg->statMarker[0] && contains_nocase(rec->sampleId, cfg->statMarker)) {
+        return SCAN_PRIO_STAT;
+    }
+    int level = SCAN_PRIO_ROUTINE;
+    for (int i = 0; i < rec->nresults; i++) {
+        switch (rec->results[i].flag) {
+        case RESULT_FLAG_CRIT_LOW:
+        case RESULT_FLAG_CRIT_HIGH:
+            return SCAN_PRIO_STAT;
+        case RESULT_FLAG_LOW:
+        case RESULT_FLAG_HIGH:
+        case RESULT_FLAG_ABNORMAL:
+            level = SCAN_PRIO_URGENT;
+            break;
+        default:
+            break;
+        }
+    }
+    if (level == SCAN_PRIO_ROUTINE && cfg->priorityTests && has_priority_test(cfg->priorityTests, rec)) {
+        level = SCAN_PRIO_URGENT;
+    }
+    return level;
+}
+
+// 'level' after waiting since 'arrivedUs': one level up per agingS.
+static int aged_level(int agingS, int level, unsigned long long arrivedUs, unsigned long long now) {
+    if (agingS <= 0 || now <= arrivedUs) return level;
+    unsigned long long steps = (now - arrivedUs) / ((unsigned long long)agingS * 1000000ull);
+    return steps >= (unsigned long long)level ? 0 : level - (int)steps;
+}
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t n) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < n; i++) h = (h ^ p[i]) * 0x100000001b3ull;
+    return h;
+}
+
+// Which results must stay in order (same_sample()): 0 for none.
+static uint64_t sample_hash(const ScanIdentity *id, int kind, const char *sampleId) {
+    if (!sampleId[0]) return 0;
+    uint64_t h = fnv1a(0xcbf29ce484222325ull, &id, sizeof(id));
+    h = fnv1a(h, &kind, sizeof(kind));
+    h = fnv1a(h, sampleId, strlen(sampleId));
+    return h ? h : 1;
+}
+
+// When 'path' arrived, on the trace_now_us() clock: its last write, to the
+// second, or now if that cannot be told.
+static unsigned long long arrived_us(const char *path) {
+    unsigned long long now = trace_now_us();
+    struct stat st;
+    time_t t = time(NULL);
+    if (stat(path, &st) != 0 || t <= st.st_mtime) return now;
+    unsigned long long age = (unsigned long long)(t - st.st_mtime) * 1000000ull;
+    return age < now ? now - age : 1;
+}
+
+// ===============================================================
+//  Phase 1: read + parse + encode (one task per file)
+// ===============================================================
+
+static void parse_task(void *arg, int worker) {
+    ScanJob *job = (ScanJob *)arg;
+    const ScanPipelineConfig *cfg = job->sp->cfg;
+    Arena *arena = arena_for(job->sp, worker);
+
+    ArenaMark mark = arena_mark(arena);
+
+    // Large files are parsed straight from the mapping; small ones are read
+    // once into this worker's arena.
+    FileMap fm;
+    if (!file_map_open(&fm, job->path, arena)) {
+        arena_rewind(arena, mark);
+        metrics_file_parsed(0, METRIC_PARSE_UNREADABLE);
+        return;
+    }
+
+    AnalyserRecord rec;
+    char detail[128];
+    FormatStatus st = analyser_parse_buffer_in(arena, fm.data, fm.len, &rec, &job->fmt, detail, sizeof(detail));
+    file_map_close(&fm);  // the record holds its own copies; unmap before delete
+
+    if (job->fmt) {
+        log_msg(LOG_INFO, "scan", "📥 Processing %s → %s", job->name, job->fmt->label);
+
+        metrics_file_parsed(job->fmt->kind, st == FORMAT_OK             ? METRIC_PARSE_OK
+                                          : st == FORMAT_ERR_TEST_ERROR ? METRIC_PARSE_TEST_ERROR
+                                          : METRIC_PARSE_ERROR);
+        if (st == FORMAT_ERR_TEST_ERROR) {
+            log_msg(LOG_WARN, "scan", "⚠️  Test error found in %s", job->path);
+        } else if (st != FORMAT_OK) {
+            log_msg(LOG_ERROR, "scan", "❌ Error in %s: %s", job->fmt->label, detail);
+        } else {
+            record_set_identity(&rec, job->id->MachineID, job->id->MAC);
+            memcpy(job->sampleId, rec.sampleId, sizeof(job->sampleId));
+            job->key = dedupe_key(&rec);
+            job->level = record_priority(cfg, &rec);
+            if (archive_enabled()) archive_tests(&rec, job->tests, sizeof(job->tests));
+            job->body.arena = arena;
+            if (encoder_of(cfg)->encode(&rec, &job->body)) {
+                job->encoded = 1;
+            } else {
+                log_msg(LOG_ERROR, "scan", "❌ Out of memory encoding %s", job->path);
+            }
+        }
+    } else {
+        metrics_file_parsed(0, METRIC_PARSE_UNREADABLE);
+    }
+    record_free(&rec);
+
+    ArenaStats as;
+    arena_stats(arena, &as);
+    job->allocs = as.allocs - mark.allocs;
+    job->bytes  = as.peakBytes - mark.bytes;
+
+    // Keep only the encoded body: drop the text, scratch and record, then
+    // slide the body down to the mark. Rewinding never frees chunks, so the
+    // source stays valid for the (possibly overlapping) move.
+    char *body = job->body.data;
+    size_t n = job->body.len;
+    arena_rewind(arena, mark);
+    job->body.data = NULL;
+    job->body.cap = 0;
+    if (job->encoded) {
+        char *kept = (char *)arena_alloc(arena, n + 1);
+        if (kept) {
+            memmove(kept, body, n + 1);
+            job->body.data = kept;
+            job->body.cap = n + 1;
+        } else {
+            job->encoded = 0;   // cannot happen: the space was just in use
+        }
+    }
+    job->trace.us[TRACE_PARSED] = trace_now_us();
+}
+
+// ===============================================================
+//  Phase 2: upload (one task per sample group)
+// ===============================================================
+
+// A failed upload leaves it and the rest of its sample group for a later pass.
+static void defer_group(const ScanJob *failed) {
+    int n = 0;
+    for (const ScanJob *j = failed; j; j = j->nextInGroup) n++;
+    metrics_upload_deferred(n);
+}
+
+// Uploaded before: a retransmit, a second capture of the same report, or
+// a stop between an upload and its delete. Returns 1 if 'job' was dropped.
+static int skip_duplicate(ScanJob *job) {
+    if (!dedupe_seen(job->key)) return 0;
+    log_msg(LOG_INFO, "scan", "♻️  Already uploaded (%s), deleting: %s", job->fmt->label, job->path);
+    analyser_delete_file(job->path);
+    metrics_duplicate_skipped(job->fmt->kind);
+    job->duplicate = 1;
+    return 1;
+}
+
+// Remember it before the delete: stopping in between leaves a file that
+// the next start drops instead of sending again.
+static void mark_uploaded(ScanJob *job) {
+    log_msg(LOG_INFO, "scan", "✅ Upload successful (%s): %s", job->fmt->label, job->path);
+    unsigned long long now = trace_now_us();
+    job->waitUs = now > job->arrivedUs ? now - job->arrivedUs : 0;
+    metrics_result_wait(job->level, job->waitUs);
+    dedupe_add(job->key);
+    if (archive_enabled()) {
+        ArchiveRecord ar = {0};
+        ar.kind        = job->fmt->kind;
+        ar.key         = job->key;
+        ar.sampleId    = job->sampleId;
+        ar.machineId   = job->id->MachineID;
+        ar.mac         = job->id->MAC;
+        ar.contentType = encoder_of(job->sp->cfg)->contentType;
+        ar.tests       = job->tests;
+        ar.body        = job->body.data;
+        ar.bodyLen     = job->body.len;
+        archive_append(&ar);
+    }
+    analyser_delete_file(job->path);
+    job->uploaded = 1;
+}
+
+// http_post_body_in() that also reports the HTTP status.
+static int post_body(Arena *arena, const char *url, const char *contentType, const char *header,
+                     const char *body, size_t len, long *status, char **resp) {
+    *status = 0;
+    *resp = NULL;
+    HttpPost *p = http_post_prepare(arena, url, contentType, body, len);
+    if (!p) return 0;
+    if (header && !http_post_add_header(p, header)) {
+        http_post_finish(p, (int)CURLE_FAILED_INIT, NULL);
+        return 0;
+    }
+    int rc = (int)curl_easy_perform((CURL *)http_post_easy(p));
+    *status = http_post_status(p, rc);
+    return http_post_finish(p, rc, resp);
+}
+
+static void upload_task(void *arg, int worker) {
+    ScanJob *head = (ScanJob *)arg;
+    Arena *arena = arena_for(head->sp, worker);
+
+    for (ScanJob *job = head; job; job = job->nextInGroup) {
+        const ScanPipelineConfig *cfg = job->sp->cfg;
+        const char *url = job->id->endpoints[job->fmt->kind];
+        if (skip_duplicate(job)) continue;
+
+        char key[48];
+        if (job->key) dedupe_header(job->key, key, sizeof(key));
+
+        ArenaMark mark = arena_mark(arena);
+        char *resp = NULL;
+        long status = 0;
+        job->trace.us[TRACE_REQUEST] = trace_now_us();
+        int ok = post_body(arena, url, encoder_of(cfg)->contentType, job->key ? key : NULL,
+                           job->body.data, job->body.len, &status, &resp);
+        job->trace.us[TRACE_RESPONSE] = trace_now_us();
+        metrics_upload(job->fmt->kind, status, job->trace.us[TRACE_RESPONSE] - job->trace.us[TRACE_REQUEST]);
+        trace_finish(&job->trace, job->fmt->kind, status, ok);
+        if (ok) {
+            mark_uploaded(job);
+        } else {
+            log_msg(LOG_ERROR, "scan", "❌ Failed to upload [%s]: %s", url, resp ? resp : "(no response)");
+        }
+        arena_rewind(arena, mark);
+        if (!ok) {
+            defer_group(job);
+            break;   // later results for this sample wait for the retry
+        }
+    }
+}
+
+// Sample IDs are only unique per instrument. Two copies of one result
+// (same key) go in one group too, so the second is dropped as a duplicate
+// once the first is uploaded rather than racing it.
+static int same_sample(const ScanJob *a, const ScanJob *b) {
+    if (a->key && a->key == b->key) return 1;
+    return b->sampleId[0] && a->sampleId[0] && a->id == b->id && a->fmt->kind == b->fmt->kind &&
+           strcmp(a->sampleId, b->sampleId) == 0;
+}
+
+// Chain jobs of the same sample in directory order; each chain head is one
+// upload group and carries the group's most urgent level. Returns the
+// number of groups.
+static int group_jobs(struct ScanPipeline *sp, ScanJob **heads) {
+    ScanJob *tails[SCAN_BATCH];
+    int ngroups = 0;
+    for (int i = 0; i < sp->njobs; i++) {
+        ScanJob *job = &sp->jobs[i];
+        if (!job->encoded) continue;
+
+        int g = -1;
+        if (job->sampleId[0] || job->key) {
+            for (int k = 0; k < ngroups; k++) {
+                if (same_sample(heads[k], job)) { g = k; break; }
+            }
+        }
+        if (g >= 0) {
+            tails[g]->nextInGroup = job;
+            tails[g] = job;
+            if (job->level < heads[g]->groupLevel) heads[g]->groupLevel = job->level;
+        } else {
+            heads[ngroups] = tails[ngroups] = job;
+            job->groupLevel = job->level;
+            ngroups++;
+        }
+    }
+    return ngroups;
+}
+
+static void end_batch(struct ScanPipeline *sp) {
+    for (int i = 0; i < sp->njobs; i++) {
+        ScanJob *job = &sp->jobs[i];
+        sp->st.files++;
+        sp->st.uploaded += job->uploaded;
+        sp->st.duplicates += job->duplicate;
+        if (job->uploaded) {
+            sp->st.byPriority[job->level]++;
+            sp->st.waitSumUs[job->level] += job->waitUs;
+            if (job->waitUs > sp->st.waitMaxUs[job->level]) sp->st.waitMaxUs[job->level] = job->waitUs;
+        }
+        if (job->allocs > sp->st.jobAllocsMax) sp->st.jobAllocsMax = job->allocs;
+        if (job->bytes > sp->st.jobBytesMax) sp->st.jobBytesMax = job->bytes;
+        free(job->path);
+        free(job->name);
+    }
+    sp->njobs = 0;
+
+    // One operation releases every body, record and response of the batch.
+    for (int a = 0; a < sp->narenas; a++) arena_reset(sp->arenas[a]);
+}
+
+// The file goes to a parse worker: pick up the stamps its capture left.
+// A captured result arrived with its first byte.
+static void stamp_enqueued(ScanJob *job) {
+    trace_claim(job->path, &job->trace);
+    job->trace.us[TRACE_ENQUEUED] = trace_now_us();
+    job->level = SCAN_PRIO_ROUTINE;
+    if (job->trace.us[TRACE_RECV] && job->trace.us[TRACE_RECV] < job->arrivedUs) {
+        job->arrivedUs = job->trace.us[TRACE_RECV];
+    }
+}
+
+// Most urgent group first (aged), directory order among equals.
+static void order_groups(struct ScanPipeline *sp, ScanJob **heads, int n) {
+    unsigned long long now = trace_now_us();
+    int level[SCAN_BATCH];
+    for (int k = 0; k < n; k++) level[k] = aged_level(sp->cfg->agingS, heads[k]->groupLevel, heads[k]->arrivedUs, now);
+    for (int k = 1; k < n; k++) {
+        ScanJob *h = heads[k];
+        int l = level[k], j = k;
+        for (; j > 0 && level[j - 1] > l; j--) {
+            heads[j] = heads[j - 1];
+            level[j] = level[j - 1];
+        }
+        heads[j] = h;
+        level[j] = l;
+    }
+}
+
+static void run_batch(struct ScanPipeline *sp) {
+    if (sp->njobs == 0) return;
+
+    for (int i = 0; i < sp->njobs; i++) {
+        stamp_enqueued(&sp->jobs[i]);
+        if (!work_pool_submit(sp->pool, parse_task, &sp->jobs[i])) {
+            parse_task(&sp->jobs[i], -1);
+        }
+    }
+    work_pool_wait(sp->pool);
+
+    ScanJob *heads[SCAN_BATCH];
+    int ngroups = group_jobs(sp, heads);
+    order_groups(sp, heads, ngroups);
+    for (int k = 0; k < ngroups; k++) {
+        if (!work_pool_submit(sp->pool, upload_task, heads[k])) {
+            upload_task(heads[k], -1);
+        }
+    }
+    work_pool_wait(sp->pool);
+
+    end_batch(sp);
+}
+
+static void finish_stats(struct ScanPipeline *sp) {
+    for (int a = 0; a < sp->narenas; a++) {
+        ArenaStats as;
+        arena_stats(sp->arenas[a], &as);
+        if (as.highWater > sp->st.arenaHighWater) sp->st.arenaHighWater = as.highWater;
+        sp->st.arenaMallocs += as.mallocs;
+    }
+}
+
+static void collect_file(const char *path, const char *name, void *ctx) {
+    struct ScanPipeline *sp = (struct ScanPipeline *)ctx;
+    metrics_file_scanned();
+
+    ScanJob *job = &sp->jobs[sp->njobs];
+    memset(job, 0, sizeof(*job));
+    job->sp   = sp;
+    job->path = dup_str(path);
+    job->name = dup_str(name);
+    job->id   = identify(sp, name);
+    job->arrivedUs = arrived_us(path);
+    if (!job->path || !job->name) {
+        free(job->path);
+        free(job->name);
+        return;
+    }
+
+    if (++sp->njobs == sp->batch) run_batch(sp);
+}
+
+// ===============================================================
+//  Event-loop drain: parse on the pool, upload through curl multi
+// ===============================================================
+
+static void list_file(const char *path, const char *name, void *ctx) {
+    struct ScanPipeline *sp = (struct ScanPipeline *)ctx;
+    metrics_file_scanned();
+
+    if (sp->nfiles == sp->capFiles) {
+        int cap = sp->capFiles ? sp->capFiles * 2 : 64;
+        ScanFile *f = (ScanFile *)realloc(sp->files, (size_t)cap * sizeof(ScanFile));
+        if (!f) return;
+        sp->files = f;
+        sp->capFiles = cap;
+    }
+    ScanFile *f = &sp->files[sp->nfiles];
+    memset(f, 0, sizeof(*f));
+    f->path = dup_str(path);
+    f->name = dup_str(name);
+    f->id   = identify(sp, name);
+    f->nameHash  = fnv1a(0xcbf29ce484222325ull, name, strlen(name));
+    f->arrivedUs = arrived_us(path);
+    f->level     = SCAN_LEVEL_UNKNOWN;
+    if (!f->path || !f->name) {
+        free(f->path);
+        free(f->name);
+        return;
+    }
+    sp->nfiles++;
+}
+
+static void free_listing(struct ScanPipeline *sp) {
+    for (int i = sp->nextFile; i < sp->nfiles; i++) {
+        free(sp->files[i].path);
+        free(sp->files[i].name);
+    }
+    free(sp->files);
+    sp->files = NULL;
+    sp->nfiles = sp->capFiles = sp->nextFile = 0;
+}
+
+// ---------------------------------------------------------------
+//  Backlog order: when the listing is more than one batch, learn each
+//  file's priority first and take the backlog most urgent first.
+// ---------------------------------------------------------------
+
+typedef struct {
+    uint64_t sample;
+    int      level;
+    int      index;     // in the listing
+} ListOrder;
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int by_sample(const void *a, const void *b) {
+    const ListOrder *x = (const ListOrder *)a, *y = (const ListOrder *)b;
+    if (x->sample != y->sample) return x->sample < y->sample ? -1 : 1;
+    return x->index - y->index;
+}
+
+static int by_level(const void *a, const void *b) {
+    const ListOrder *x = (const ListOrder *)a, *y = (const ListOrder *)b;
+    if (x->level != y->level) return x->level - y->level;
+    return x->index - y->index;
+}
+
+// Files of this pass not listed yet are appended to the listing.
+static void relist_file(const char *path, const char *name, void *ctx) {
+    struct ScanPipeline *sp = (struct ScanPipeline *)ctx;
+    uint64_t h = fnv1a(0xcbf29ce484222325ull, name, strlen(name));
+    if (bsearch(&h, sp->seen, (size_t)sp->nseen, sizeof(h), cmp_u64)) return;
+    list_file(path, name, ctx);
+}
+
+static void relist(struct ScanPipeline *sp) {
+    sp->relist = 0;
+    int n = sp->nfiles;
+    sp->seen = (uint64_t *)malloc((size_t)(n ? n : 1) * sizeof(uint64_t));
+    if (!sp->seen) return;
+    for (int i = 0; i < n; i++) sp->seen[i] = sp->files[i].nameHash;
+    qsort(sp->seen, (size_t)n, sizeof(uint64_t), cmp_u64);
+    sp->nseen = n;
+
+    analyser_scan_dir(sp->dir, ".txt", relist_file, sp);
+    free(sp->seen);
+    sp->seen = NULL;
+    sp->nseen = 0;
+
+    if (sp->nfiles > n) log_msg(LOG_DEBUG, "scan", "📂 %d new file(s) while draining %s", sp->nfiles - n, sp->dir);
+}
+// Parse to learn the priority and sample, then drop everything.
+static void triage_file(struct ScanPipeline *sp, ScanFile *f, Arena *arena) {
+    f->level = SCAN_PRIO_ROUTINE;
+    ArenaMark mark = arena_mark(arena);
+    FileMap fm;
+    if (file_map_open(&fm, f->path, arena)) {
+        AnalyserRecord rec;
+        const AnalyserFormat *fmt = NULL;
+        char detail[16];
+        FormatStatus st = analyser_parse_buffer_in(arena, fm.data, fm.len, &rec, &fmt, detail, sizeof(detail));
+        file_map_close(&fm);
+        if (fmt && st == FORMAT_OK) {
+            f->level  = record_priority(sp->cfg, &rec);
+            f->sample = sample_hash(f->id, fmt->kind, rec.sampleId);
+        }
+        record_free(&rec);
+    }
+    arena_rewind(arena, mark);
+}
+
+static void triaged_cb(void *ctx);
+
+// One per file still to process; each takes the next one.
+static void triage_task(void *arg, int worker) {
+    struct ScanPipeline *sp = (struct ScanPipeline *)arg;
+    int i = atomic_fetch_add(&sp->triageNext, 1);
+    ScanFile *f = &sp->files[i];
+    if (!atomic_load(&sp->cancelled) && f->level == SCAN_LEVEL_UNKNOWN) triage_file(sp, f, arena_for(sp, worker));
+    if (atomic_fetch_sub(&sp->triageLeft, 1) == 1) {
+        if (!event_loop_post(sp->loop, triaged_cb, sp)) {
+            log_msg(LOG_ERROR, "scan", "❌ Scan stalled: cannot post to the event loop");
+        }
+    }
+}
+
+// Returns 1 if triage tasks were started (triaged_cb() carries on).
+static int start_triage(struct ScanPipeline *sp) {
+    int n = sp->nfiles - sp->nextFile, unknown = 0;
+    if (n <= sp->batch) return 0;   // one batch: order_groups() is enough
+    for (int i = sp->nextFile; i < sp->nfiles; i++) unknown += sp->files[i].level == SCAN_LEVEL_UNKNOWN;
+    if (!unknown) return 0;
+
+    atomic_store(&sp->triageNext, sp->nextFile);
+    atomic_store(&sp->triageLeft, n);
+    for (int i = 0; i < n; i++) {
+        if (!work_pool_submit(sp->pool, triage_task, sp)) triage_task(sp, -1);
+    }
+    return 1;
+}
+
+// Sort what is left of the listing most urgent first (aged), listing order
+// among equals. A sample's files all take the level of its most urgent
+// one, so they keep their order.
+static void order_listing(struct ScanPipeline *sp) {
+    int n = sp->nfiles - sp->nextFile;
+    ScanFile *rest = &sp->files[sp->nextFile];
+    ListOrder *o = (ListOrder *)malloc((size_t)n * sizeof(ListOrder));
+    ScanFile *sorted = (ScanFile *)malloc((size_t)n * sizeof(ScanFile));
+    if (!o || !sorted) {
+        free(o);
+        free(sorted);
+        return;
+    }
+
+    unsigned long long now = trace_now_us();
+    int counts[SCAN_PRIORITIES] = {0};
+    for (int i = 0; i < n; i++) {
+        int base = rest[i].level == SCAN_LEVEL_UNKNOWN ? SCAN_PRIO_ROUTINE : rest[i].level;
+        counts[base]++;
+        o[i].sample = rest[i].sample;
+        o[i].level  = aged_level(sp->cfg->agingS, base, rest[i].arrivedUs, now);
+        o[i].index  = i;
+    }
+    qsort(o, (size_t)n, sizeof(ListOrder), by_sample);
+    for (int i = 0; i < n;) {
+        int j = i + 1, level = o[i].level;
+        while (o[i].sample && j < n && o[j].sample == o[i].sample) {
+            if (o[j].level < level) level = o[j].level;
+            j++;
+        }
+        for (int k = i; k < j; k++) o[k].level = level;
+        i = j;
+    }
+    qsort(o, (size_t)n, sizeof(ListOrder), by_level);
+
+    for (int i = 0; i < n; i++) sorted[i] = rest[o[i].index];
+    memcpy(rest, sorted, (size_t)n * sizeof(ScanFile));
+    free(o);
+    free(sorted);
+    log_msg(LOG_INFO, "scan", "🚦 %d waiting results ordered: %d stat, %d urgent, %d routine", n,
+            counts[SCAN_PRIO_STAT], counts[SCAN_PRIO_URGENT], counts[SCAN_PRIO_ROUTINE]);
+}
+
+static void next_batch(struct ScanPipeline *sp);
+
+static void next_batch_cb(void *ctx) {
+    next_batch((struct ScanPipeline *)ctx);
+}
+
+static void triaged_cb(void *ctx) {
+    struct ScanPipeline *sp = (struct ScanPipeline *)ctx;
+    if (!atomic_load(&sp->cancelled)) order_listing(sp);
+    next_batch(sp);
+}
+
+// ---------------------------------------------------------------
+//  Batches
+// ---------------------------------------------------------------
+
+static void parsed_cb(void *ctx);
+
+static void parse_async_task(void *arg, int worker) {
+    ScanJob *job = (ScanJob *)arg;
+    struct ScanPipeline *sp = job->sp;
+    if (!atomic_load(&sp->cancelled)) parse_task(job, worker);
+    // The last parse of the batch hands it back to the loop thread.
+    if (atomic_fetch_sub(&sp->parseLeft, 1) == 1) {
+        if (!event_loop_post(sp->loop, parsed_cb, sp)) {
+            log_msg(LOG_ERROR, "scan", "❌ Scan stalled: cannot post to the event loop");
+        }
+    }
+}
+
+static void group_done(struct ScanPipeline *sp) {
+    if (--sp->uploadsLeft > 0) return;
+    end_batch(sp);
+    next_batch(sp);
+}
+
+// 'job' and the rest of its group wait at 'level'.
+static void queue_ready(struct ScanPipeline *sp, ScanJob *job, int level) {
+    job->groupLevel = level;
+    job->nextReady = NULL;
+    if (sp->readyTail[level]) sp->readyTail[level]->nextReady = job;
+    else sp->ready[level] = job;
+    sp->readyTail[level] = job;
+}
+
+// The front of the most urgent queue, counting the time each front has
+// waited: routine work that has waited long enough goes ahead of urgent
+// work that just arrived.
+int scan_priority_next(const unsigned long long heads[SCAN_PRIORITIES], int agingS, unsigned long long now) {
+    int best = -1, bestLevel = SCAN_PRIORITIES;
+    for (int l = 0; l < SCAN_PRIORITIES; l++) {
+        if (!heads[l]) continue;
+        if (agingS <= 0) return l;   // no aging: strictly by level
+        int aged = aged_level(agingS, l, heads[l], now);
+        if (aged < bestLevel) {
+            best = l;
+            bestLevel = aged;
+        }
+    }
+    return best;
+}
+
+static ScanJob *take_ready(struct ScanPipeline *sp) {
+    unsigned long long heads[SCAN_PRIORITIES];
+    for (int l = 0; l < SCAN_PRIORITIES; l++) heads[l] = sp->ready[l] ? sp->ready[l]->arrivedUs : 0;
+    int agingS = sp->cfg->agingS;
+    int best = scan_priority_next(heads, agingS, agingS > 0 ? trace_now_us() : 0);
+    if (best < 0) return NULL;
+    ScanJob *job = sp->ready[best];
+    sp->ready[best] = job->nextReady;
+    if (!sp->ready[best]) sp->readyTail[best] = NULL;
+    return job;
+}
+
+static void uploaded_cb(void *ctx, int ok, long status, const char *resp);
+
+// Returns 0 if the group is finished without a transfer in flight.
+static int upload_next(ScanJob *job) {
+    struct ScanPipeline *sp = job->sp;
+    int level = job->groupLevel;
+    while (skip_duplicate(job)) {
+        job = job->nextInGroup;
+        if (!job) return 0;
+    }
+    job->groupLevel = level;
+
+    const ScanPipelineConfig *cfg = sp->cfg;
+    const char *url = job->id->endpoints[job->fmt->kind];
+    char key[48];
+    if (job->key) dedupe_header(job->key, key, sizeof(key));
+    job->trace.us[TRACE_REQUEST] = trace_now_us();
+    if (!http_multi_post(sp->http, url, encoder_of(cfg)->contentType, job->key ? key : NULL,
+                         job->body.data, job->body.len, uploaded_cb, job)) {
+        log_msg(LOG_ERROR, "scan", "❌ Failed to upload [%s]: cannot start transfer", url);
+        job->trace.us[TRACE_RESPONSE] = trace_now_us();
+        trace_finish(&job->trace, job->fmt->kind, 0, 0);
+        defer_group(job);
+        return 0;
+    }
+    sp->inFlight++;
+    return 1;
+}
+
+// Start queued groups while upload slots are free. Once cancelled, queued
+// groups are finished unsent.
+static void dispatch(struct ScanPipeline *sp) {
+    int slots = sp->cfg->uploadSlots;
+    while (slots <= 0 || sp->inFlight < slots || atomic_load(&sp->cancelled)) {
+        ScanJob *job = take_ready(sp);
+        if (!job) return;
+        if (atomic_load(&sp->cancelled) || !upload_next(job)) group_done(sp);
+    }
+}
+
+static void uploaded_cb(void *ctx, int ok, long status, const char *resp) {
+    ScanJob *job = (ScanJob *)ctx;
+    struct ScanPipeline *sp = job->sp;
+    sp->inFlight--;
+    job->trace.us[TRACE_RESPONSE] = trace_now_us();
+    metrics_upload(job->fmt->kind, status, job->trace.us[TRACE_RESPONSE] - job->trace.us[TRACE_REQUEST]);
+    trace_finish(&job->trace, job->fmt->kind, status, ok);
+
+    // The group's next result queues again at the group's level; the count
+    // it holds keeps the batch open meanwhile.
+    if (ok) {
+        mark_uploaded(job);
+        if (job->nextInGroup && !atomic_load(&sp->cancelled)) {
+            queue_ready(sp, job->nextInGroup, job->groupLevel);
+            dispatch(sp);
+            return;
+        }
+    } else {
+        log_msg(LOG_ERROR, "scan", "❌ Failed to upload [%s]: %s", job->id->endpoints[job->fmt->kind],
+                resp ? resp : "(no response)");
+        defer_group(job);   // later results for this sample wait for the retry
+    }
+    dispatch(sp);
+    group_done(sp);
+}
+
+static void parsed_cb(void *ctx) {
+    struct ScanPipeline *sp = (struct ScanPipeline *)ctx;
+
+    ScanJob *heads[SCAN_BATCH];
+    int ngroups = atomic_load(&sp->cancelled) ? 0 : group_jobs(sp, heads);
+
+    // One extra count so a transfer failing to start cannot finish the
+    // batch while groups are still being started.
+    sp->uploadsLeft = ngroups + 1;
+    for (int k = 0; k < ngroups; k++) queue_ready(sp, heads[k], heads[k]->groupLevel);
+    dispatch(sp);
+    group_done(sp);
+}
+
+static void next_batch(struct ScanPipeline *sp) {
+    if (!atomic_load(&sp->cancelled)) {
+        if (sp->relist && sp->nextFile < sp->nfiles) relist(sp);
+        if (start_triage(sp)) return;
+    }
+
+    while (!atomic_load(&sp->cancelled) && sp->nextFile < sp->nfiles && sp->njobs < sp->batch) {
+        ScanFile *f = &sp->files[sp->nextFile++];
+        ScanJob *job = &sp->jobs[sp->njobs++];
+        memset(job, 0, sizeof(*job));
+        job->sp   = sp;
+        job->path = f->path;
+        job->name = f->name;
+        job->id   = f->id;
+        job->arrivedUs = f->arrivedUs;
+    }
+
+    if (sp->njobs == 0) {
+        free_listing(sp);
+        finish_stats(sp);
+        sp->busy = 0;
+        sp->relist = 0;
+        if (sp->done) sp->done(sp->doneCtx, &sp->st);
+        return;
+    }
+
+    int n = sp->njobs;
+    atomic_store(&sp->parseLeft, n);
+    for (int i = 0; i < n; i++) {
+        stamp_enqueued(&sp->jobs[i]);
+        if (!work_pool_submit(sp->pool, parse_async_task, &sp->jobs[i])) {
+            parse_async_task(&sp->jobs[i], -1);
+        }
+    }
+}
+
+// ===============================================================
+//  Public API
+// ===============================================================
+
+ScanPipeline *scan_pipeline_create(const ScanPipelineConfig *cfg, WorkPool *pool) {
+    struct ScanPipeline *sp = (struct ScanPipeline *)calloc(1, sizeof(*sp));
+    if (!sp) return NULL;
+    sp->cfg  = cfg;
+    sp->pool = pool;
+    sp->batch = (cfg->batchSize > 0 && cfg->batchSize < SCAN_BATCH) ? cfg->batchSize : SCAN_BATCH;
+    sp->self.MachineID = cfg->MachineID;
+    sp->self.MAC       = cfg->MAC;
+    memcpy(sp->self.endpoints, cfg->endpoints, sizeof(sp->self.endpoints));
+
+    sp->narenas = work_pool_size(pool) + 1;
+    sp->arenas = (Arena **)calloc((size_t)sp->narenas, sizeof(Arena *));
+    if (!sp->arenas) {
+        free(sp);
+        return NULL;
+    }
+    for (int a = 0; a < sp->narenas; a++) {
+        sp->arenas[a] = arena_create(0);
+        if (!sp->arenas[a]) {
+            scan_pipeline_destroy(sp);
+            return NULL;
+        }
+    }
+    return sp;
+}
+
+void scan_pipeline_destroy(ScanPipeline *sp) {
+    if (!sp) return;
+    // An event-loop drain cut short by shutdown: the pool has finished its
+    // tasks by now, in-flight uploads were aborted with the multi handle.
+    for (int i = 0; i < sp->njobs; i++) {
+        free(sp->jobs[i].path);
+        free(sp->jobs[i].name);
+    }
+    free_listing(sp);
+    if (sp->arenas) {
+        for (int a = 0; a < sp->narenas; a++) arena_destroy(sp->arenas[a]);
+        free(sp->arenas);
+    }
+    free(sp);
+}
+
+int scan_pipeline_drain(ScanPipeline *sp, const char *dir, ScanDrainStats *stats) {
+    if (sp->busy) return 0;
+    memset(&sp->st, 0, sizeof(sp->st));
+
+    sp->dir = dir;
+    analyser_scan_dir(dir, ".txt", collect_file, sp);
+    run_batch(sp);
+    finish_stats(sp);
+
+    if (stats) *stats = sp->st;
+    return sp->st.uploaded;
+}
+
+int scan_pipeline_begin(ScanPipeline *sp, const char *dir, EventLoop *loop, HttpMulti *http,
+                        ScanDoneFn done, void *ctx) {
+    if (sp->busy || atomic_load(&sp->cancelled)) return 0;
+    memset(&sp->st, 0, sizeof(sp->st));
+    sp->loop    = loop;
+    sp->http    = http;
+    sp->done    = done;
+    sp->doneCtx = ctx;
+
+    // List first: batches are processed across loop iterations, long after
+    // a directory iteration could be held open.
+    sp->dir = dir;
+    analyser_scan_dir(dir, ".txt", list_file, sp);
+
+    sp->busy = 1;
+    if (!event_loop_post(loop, next_batch_cb, sp)) {
+        sp->busy = 0;
+        free_listing(sp);
+        return 0;
+    }
+    return 1;
+}
+
+void scan_pipeline_refresh(ScanPipeline *sp) {
+    if (sp->busy) sp->relist = 1;
+}
+
+int scan_pipeline_busy(const ScanPipeline *sp) {
+    return sp->busy;
+}
+
+void scan_pipeline_cancel(ScanPipeline *sp) {
+    atomic_store(&sp->cancelled, 1);
+}
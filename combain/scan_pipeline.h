@@ -0,0 +1,152 @@
+#ifndef SCAN_PIPELINE_H
+#define SCAN_PIPELINE_H
+
+#include "analyser.h"
+#include "event_loop.h"
+#include "http_multi.h"
+#include "work_pool.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Who a result file came from: stamped on its record, picks its URL. */
+typedef struct {
+    const char *MachineID;
+    const char *MAC;
+    const char *endpoints[4];   // indexed by AnalyserKind
+} ScanIdentity;
+
+/**
+ * Identity of file 'name' found in 'dir' (the directory as passed to the
+ * drain), or NULL for the config's own. Called on the draining thread
+ * while the directory is listed; the result must stay valid until the
+ * drain has finished.
+ */
+typedef const ScanIdentity *(*ScanIdentifyFn)(void *ctx, const char *dir, const char *name);
+
+/** Upload order of a result, most urgent first. */
+typedef enum {
+    SCAN_PRIO_STAT = 0,    // sample ID carries the STAT marker, or a critical flag (HH / LL)
+    SCAN_PRIO_URGENT,      // an abnormal flag (H, L, A) or one of the priority tests
+    SCAN_PRIO_ROUTINE,
+    SCAN_PRIORITIES
+} ScanPriority;
+
+typedef struct {
+    const char          *MachineID;
+    const char          *MAC;
+    const RecordEncoder *encoder;       // NULL = JSON
+    const char          *endpoints[4];  // indexed by AnalyserKind
+    int                  batchSize;     // files per batch, 1..256 (0 = 256)
+    ScanIdentifyFn       identify;      // NULL = every file is MachineID/MAC
+    void                *identifyCtx;
+    int                  uploadSlots;   // event-loop uploads in flight at once (0 = no limit)
+    const char          *statMarker;    // in a sample ID: STAT (NULL or "" = none)
+    const char          *priorityTests; // test codes / names that make a result urgent, ',' separated
+    int                  agingS;        // every agingS waited counts as one level more urgent (0 = never)
+} ScanPipelineConfig;
+
+typedef struct {
+    int    files;          // result files seen
+    int    uploaded;       // uploaded and deleted
+    int    duplicates;     // uploaded before (dedupe index): deleted unsent
+    int    byPriority[SCAN_PRIORITIES];                // uploaded, by ScanPriority
+    unsigned long long waitSumUs[SCAN_PRIORITIES];     // from arriving in the folder to uploaded
+    unsigned long long waitMaxUs[SCAN_PRIORITIES];
+    size_t jobAllocsMax;   // most arena allocations by one file
+    size_t jobBytesMax;    // largest arena footprint of one file
+    size_t arenaHighWater; // largest single-arena footprint so far (lifetime)
+    size_t arenaMallocs;   // chunk mallocs by all arenas so far (lifetime)
+} ScanDrainStats;
+
+typedef struct ScanPipeline ScanPipeline;
+
+/** Called on the loop thread when scan_pipeline_begin() has finished. */
+typedef void (*ScanDoneFn)(void *ctx, const ScanDrainStats *stats);
+
+/**
+ * Bind a pipeline to 'pool'. Each pool worker gets its own arena that all
+ * per-file memory (file text, parse scratch, record, encoded body, HTTP
+ * response) is carved from; arenas are reset once per batch.
+ * 'cfg' is borrowed and must outlive the pipeline. Returns NULL on error.
+ */
+ScanPipeline *scan_pipeline_create(const ScanPipelineConfig *cfg, WorkPool *pool);
+
+/** Safe to call with NULL (no-op). */
+void scan_pipeline_destroy(ScanPipeline *sp);
+
+/**
+ * Drain every *.txt result file in 'dir'.
+ *
+ * Files are taken in batches: every file of a batch is read, parsed and
+ * encoded in parallel, then uploaded in parallel. Uploads that share a
+ * sample ID (same instrument and analyser kind) go out one at a time in
+ * directory order, and stop at the first failure so a retry on the next
+ * scan cannot land ahead of an older result. Files without a sample ID are unordered.
+ *
+ * Each upload carries its record's Idempotency-Key (dedupe.h) when it has
+ * one. A result whose key the dedupe index has seen uploaded is deleted
+ * unsent; results of one batch with the same key share a group, so the
+ * second is only dropped once the first is in.
+ *
+ * Each result gets a ScanPriority from what it says. Within a batch the
+ * sample groups are uploaded most urgent first; a group is as urgent as
+ * its most urgent result. Waiting raises a result one level every
+ * agingS, so a steady stream of urgent results cannot hold routine ones
+ * back for long; with agingS 0 the levels are strict.
+ *
+ * Returns the number of files uploaded (and deleted); 'stats' may be NULL.
+ */
+int scan_pipeline_drain(ScanPipeline *sp, const char *dir, ScanDrainStats *stats);
+
+/**
+ * scan_pipeline_drain() for the event loop: returns at once and drains in
+ * the background. Parsing runs on the pool; uploads go out through 'http'
+ * on the loop thread, with the same batching and per-sample ordering.
+ * Groups wait in one queue per ScanPriority and at most uploadSlots are
+ * in flight, so an urgent group never queues behind routine transfers.
+ * When more files are listed than fit a batch, every one is parsed once
+ * up front to learn its priority and the backlog is taken most urgent
+ * first (aged as above; a sample's files stay in order).
+ * 'done' (may be NULL) runs on the loop thread when the directory is
+ * drained. Returns 0 if a drain is already running or on error.
+ * The pool must not be shut down before 'done' has run or the loop has
+ * stopped.
+ */
+int scan_pipeline_begin(ScanPipeline *sp, const char *dir, EventLoop *loop, HttpMulti *http,
+                        ScanDoneFn done, void *ctx);
+
+/**
+ * New files arrived in the folder being drained: list it again before the
+ * next batch, so urgent ones among them need not wait for the rest of the
+ * backlog. Loop thread; no-op when no drain is running.
+ */
+void scan_pipeline_refresh(ScanPipeline *sp);
+
+/** 1 while a scan_pipeline_begin() drain is running. */
+int scan_pipeline_busy(const ScanPipeline *sp);
+
+/**
+ * Wind down for shutdown: a running drain starts no further batches or
+ * uploads and skips parses still queued; 'done' runs once the uploads
+ * already in flight have finished. Later begins are refused. Files not
+ * uploaded stay in the folder for the next start.
+ */
+void scan_pipeline_cancel(ScanPipeline *sp);
+
+/**
+ * The ready level to upload from next. heads[l] is when the oldest result
+ * waiting at level l arrived (trace_now_us() clock), 0 for none. A level
+ * counts as one more urgent for every agingS its head has waited (0 =
+ * strict order); ties go to the more urgent level. -1 if all are empty.
+ */
+int scan_priority_next(const unsigned long long heads[SCAN_PRIORITIES], int agingS, unsigned long long now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCAN_PIPELINE_H
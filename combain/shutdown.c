@@ -0,0 +1,130 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "shutdown.h"
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+
+static EventLoop *stopLoop = NULL;
+static atomic_int requested = 0;
+
+#ifdef _WIN32
+static HANDLE doneEvent = NULL;
+#endif
+
+static void say(const char *msg) {
+#ifdef _WIN32
+    fputs(msg, stdout);
+    fflush(stdout);
+#else
+    // write(2) only: this runs in signal context.
+    ssize_t rc = write(STDOUT_FILENO, msg, strlen(msg));
+    (void)rc;
+#endif
+}
+
+void shutdown_request(void) {
+    if (atomic_exchange(&requested, 1) != 0) return;
+    if (stopLoop) event_loop_stop(stopLoop);
+}
+
+int shutdown_requested(void) {
+    return atomic_load(&requested);
+}
+
+static void on_signal(void) {
+    if (atomic_load(&requested)) {
+        say("\n⛔ Second stop signal, exiting now.\n");
+        _exit(130);
+    }
+    say("\n🛑 Stop requested, shutting down...\n");
+    shutdown_request();
+}
+
+#ifdef _WIN32
+
+static BOOL WINAPI console_handler(DWORD type) {
+    switch (type) {
+    case CTRL_C_EVENT:
+    case CTRL_BREAK_EVENT:
+        on_signal();
+        return TRUE;
+    case CTRL_CLOSE_EVENT:
+    case CTRL_LOGOFF_EVENT:
+    case CTRL_SHUTDOWN_EVENT:
+        // The process dies when this returns: give main time to flush.
+        shutdown_request();
+        if (doneEvent) WaitForSingleObject(doneEvent, 4000);
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+void shutdown_install(EventLoop *loop) {
+    stopLoop = loop;
+    if (!doneEvent) doneEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    SetConsoleCtrlHandler(console_handler, TRUE);
+}
+
+void shutdown_on_reload(EvAsync *reload) {
+    (void)reload;
+}
+
+void shutdown_done(void) {
+    stopLoop = NULL;
+    if (doneEvent) SetEvent(doneEvent);
+}
+
+#else // POSIX
+
+static void signal_handler(int sig) {
+    (void)sig;
+    on_signal();
+}
+
+void shutdown_install(EventLoop *loop) {
+    stopLoop = loop;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // A dropped TCP peer must surface as an error, not kill the process.
+    signal(SIGPIPE, SIG_IGN);
+}
+
+static EvAsync *reloadAsync = NULL;
+
+static void hup_handler(int sig) {
+    (void)sig;
+    if (reloadAsync) ev_async_send(reloadAsync);
+}
+
+void shutdown_on_reload(EvAsync *reload) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = reload ? hup_handler : SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    reloadAsync = reload;
+    sigaction(SIGHUP, &sa, NULL);
+}
+
+void shutdown_done(void) {
+    stopLoop = NULL;
+    reloadAsync = NULL;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SHUTDOWN_H
+#define SHUTDOWN_H
+
+#include "event_loop.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Process-wide cooperative shutdown.
+ *
+ * SIGINT / SIGTERM (console Ctrl+C, Ctrl+Break, close, logoff and system
+ * shutdown on Windows) set an atomic flag and stop the event loop through
+ * its wakeup fd, so every wait in the process ends at once: the loop, and
+ * through it the sink, the pool and the serial reader. A second signal
+ * exits immediately.
+ *
+ * On Windows the console handler waits (up to 4 s) for shutdown_done()
+ * before returning, because the process is killed when it returns.
+ */
+
+/** Install the handlers; 'loop' is stopped when shutdown is requested. */
+void shutdown_install(EventLoop *loop);
+
+/** Request shutdown from code. Async-signal-safe. */
+void shutdown_request(void);
+
+/** 1 once shutdown has been requested. Any thread. */
+int shutdown_requested(void);
+
+/**
+ * SIGHUP sends 'reload' (NULL = ignore SIGHUP). No-op on Windows, which
+ * has no equivalent signal.
+ */
+void shutdown_on_reload(EvAsync *reload);
+
+/** Call when cleanup has finished, just before main returns. */
+void shutdown_done(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHUTDOWN_H
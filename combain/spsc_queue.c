@@ -0,0 +1,289 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "spsc_queue.h"
+#include "monotime.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <sys/time.h>
+    #include <unistd.h>
+#endif
+
+#define CACHE_LINE 64
+
+// ===============================================================
+//  Queue
+// ===============================================================
+
+// Padding rather than _Alignas: the struct comes from calloc, which does
+// not promise 64-byte alignment, but a full line of padding between the
+// indices keeps them on different lines either way.
+struct SpscQueue {
+    // Consumer-owned index. The producer also advances it (CAS) when it
+    // drops the oldest item, so it is CAS-updated on both sides.
+    atomic_size_t head;
+    char          pad0[CACHE_LINE];
+    // Producer-owned index.
+    atomic_size_t tail;
+    char          pad1[CACHE_LINE];
+
+    size_t mask;
+    _Atomic(void *) *slots;   // atomic so a dropping producer and the
+                              // consumer may read the same slot safely
+    SpscPolicy     policy;
+    SpscSpillFn    spill;
+    SpscDiscardFn  discard;
+    void          *ctx;
+    atomic_int     closed;
+
+    // Counters: producer-written except 'popped'.
+    atomic_ullong  pushed, popped, blocked, blockedUs, spilled, dropped, lost;
+    atomic_size_t  maxDepth;
+};
+
+
+static void backoff(unsigned spins) {
+    if (spins < 64) return;             // brief busy-wait first
+#ifdef _WIN32
+    Sleep(spins < 256 ? 0 : 1);
+#else
+    usleep(spins < 256 ? 10 : 200);
+#endif
+}
+
+SpscQueue *spsc_create(size_t capacity, SpscPolicy policy,
+                       SpscSpillFn spill, SpscDiscardFn discard, void *ctx) {
+    if (policy == SPSC_SPILL && !spill) return NULL;
+
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+
+    SpscQueue *q = (SpscQueue *)calloc(1, sizeof(SpscQueue));
+    if (!q) return NULL;
+    q->slots = (_Atomic(void *) *)calloc(cap, sizeof(*q->slots));
+    if (!q->slots) {
+        free(q);
+        return NULL;
+    }
+    for (size_t i = 0; i < cap; i++) atomic_init(&q->slots[i], NULL);
+
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    q->mask    = cap - 1;
+    q->policy  = policy;
+    q->spill   = spill;
+    q->discard = discard;
+    q->ctx     = ctx;
+    return q;
+}
+
+static void discard_item(SpscQueue *q, void *item) {
+    if (q->discard) q->discard(q->ctx, item);
+}
+
+SpscResult spsc_push(SpscQueue *q, void *item) {
+    size_t t = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t h = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    if (t - h > q->mask) {
+        switch (q->policy) {
+        case SPSC_BLOCK: {
+            unsigned long long t0 = monotime_us();
+            unsigned spins = 0;
+            while (t - h > q->mask) {
+                if (atomic_load_explicit(&q->closed, memory_order_relaxed)) {
+                    atomic_fetch_add(&q->lost, 1);
+                    discard_item(q, item);
+                    return SPSC_CLOSED;
+                }
+                backoff(++spins);
+                h = atomic_load_explicit(&q->head, memory_order_acquire);
+            }
+            atomic_fetch_add(&q->blocked, 1);
+            atomic_fetch_add(&q->blockedUs, monotime_us() - t0);
+            break;
+        }
+        case SPSC_SPILL:
+            if (q->spill(q->ctx, item)) {
+                atomic_fetch_add(&q->spilled, 1);
+                return SPSC_SPILLED;
+            }
+            atomic_fetch_add(&q->lost, 1);
+            return SPSC_DROPPED;
+
+        case SPSC_DROP_OLDEST:
+            // Take the oldest item away from the consumer. If the consumer
+            // wins the race the CAS fails and there is room anyway.
+            while (t - h > q->mask) {
+                void *old = atomic_load_explicit(&q->slots[h & q->mask], memory_order_acquire);
+                if (atomic_compare_exchange_weak_explicit(&q->head, &h, h + 1,
+                                                          memory_order_acq_rel,
+                                                          memory_order_acquire)) {
+                    atomic_fetch_add(&q->dropped, 1);
+                    discard_item(q, old);
+                    h++;
+                }
+            }
+            break;
+        }
+    }
+
+    if (atomic_load_explicit(&q->closed, memory_order_relaxed)) {
+        atomic_fetch_add(&q->lost, 1);
+        discard_item(q, item);
+        return SPSC_CLOSED;
+    }
+
+    atomic_store_explicit(&q->slots[t & q->mask], item, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, t + 1, memory_order_release);
+    atomic_fetch_add_explicit(&q->pushed, 1, memory_order_relaxed);
+
+    size_t depth = t + 1 - h;
+    if (depth > atomic_load_explicit(&q->maxDepth, memory_order_relaxed)) {
+        atomic_store_explicit(&q->maxDepth, depth, memory_order_relaxed);
+    }
+    return SPSC_PUSHED;
+}
+
+void *spsc_pop(SpscQueue *q) {
+    size_t h = atomic_load_explicit(&q->head, memory_order_relaxed);
+    for (;;) {
+        size_t t = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (h == t) return NULL;
+
+        // Read before claiming; only a successful claim makes it ours.
+        void *item = atomic_load_explicit(&q->slots[h & q->mask], memory_order_acquire);
+        if (q->policy != SPSC_DROP_OLDEST) {
+            atomic_store_explicit(&q->head, h + 1, memory_order_release);
+        } else if (!atomic_compare_exchange_weak_explicit(&q->head, &h, h + 1,
+                                                          memory_order_acq_rel,
+                                                          memory_order_relaxed)) {
+            continue;   // producer dropped it (h reloaded); try the next one
+        }
+        atomic_fetch_add_explicit(&q->popped, 1, memory_order_relaxed);
+        return item;
+    }
+}
+
+void spsc_close(SpscQueue *q) {
+    atomic_store(&q->closed, 1);
+}
+
+void spsc_stats(const SpscQueue *q, SpscStats *out) {
+    SpscQueue *m = (SpscQueue *)q;   // atomics are read-only here
+    memset(out, 0, sizeof(*out));
+    out->pushed    = atomic_load(&m->pushed);
+    out->popped    = atomic_load(&m->popped);
+    out->blocked   = atomic_load(&m->blocked);
+    out->blockedUs = atomic_load(&m->blockedUs);
+    out->spilled   = atomic_load(&m->spilled);
+    out->dropped   = atomic_load(&m->dropped);
+    out->lost      = atomic_load(&m->lost);
+    size_t h       = atomic_load(&m->head);   // head first: tail >= it
+    out->depth     = atomic_load(&m->tail) - h;
+    out->maxDepth  = atomic_load(&m->maxDepth);
+    out->capacity  = q->mask + 1;
+}
+
+int spsc_full(const SpscQueue *q) {
+    SpscQueue *m = (SpscQueue *)q;
+    size_t h = atomic_load_explicit(&m->head, memory_order_acquire);
+    size_t t = atomic_load_explicit(&m->tail, memory_order_relaxed);
+    return t - h > q->mask;
+}
+
+void spsc_destroy(SpscQueue *q) {
+    if (!q) return;
+    void *item;
+    while ((item = spsc_pop(q)) != NULL) discard_item(q, item);
+    free((void *)q->slots);
+    free(q);
+}
+
+// ===============================================================
+//  Doorbell
+// ===============================================================
+
+struct Doorbell {
+    atomic_int rung;
+#ifdef _WIN32
+    CRITICAL_SECTION   lock;
+    CONDITION_VARIABLE cv;
+#else
+    pthread_mutex_t    lock;
+    pthread_cond_t     cv;
+#endif
+};
+
+Doorbell *doorbell_create(void) {
+    Doorbell *d = (Doorbell *)calloc(1, sizeof(Doorbell));
+    if (!d) return NULL;
+    atomic_init(&d->rung, 0);
+#ifdef _WIN32
+    InitializeCriticalSection(&d->lock);
+    InitializeConditionVariable(&d->cv);
+#else
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_cond_init(&d->cv, NULL);
+#endif
+    return d;
+}
+
+void doorbell_destroy(Doorbell *d) {
+    if (!d) return;
+#ifdef _WIN32
+    DeleteCriticalSection(&d->lock);
+#else
+    pthread_cond_destroy(&d->cv);
+    pthread_mutex_destroy(&d->lock);
+#endif
+    free(d);
+}
+
+void doorbell_ring(Doorbell *d) {
+    // Only the 0 -> 1 transition signals; the waiter clears it when it wakes.
+    if (atomic_exchange(&d->rung, 1) != 0) return;
+#ifdef _WIN32
+    EnterCriticalSection(&d->lock);
+    WakeConditionVariable(&d->cv);
+    LeaveCriticalSection(&d->lock);
+#else
+    pthread_mutex_lock(&d->lock);
+    pthread_cond_signal(&d->cv);
+    pthread_mutex_unlock(&d->lock);
+#endif
+}
+
+int doorbell_wait(Doorbell *d, long timeout_ms) {
+#ifdef _WIN32
+    EnterCriticalSection(&d->lock);
+    if (!atomic_load(&d->rung)) {
+        SleepConditionVariableCS(&d->cv, &d->lock, timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms);
+    }
+    LeaveCriticalSection(&d->lock);
+#else
+    pthread_mutex_lock(&d->lock);
+    if (timeout_ms < 0) {
+        while (!atomic_load(&d->rung)) pthread_cond_wait(&d->cv, &d->lock);
+    } else {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec  += timeout_ms / 1000;
+        ts.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+        while (!atomic_load(&d->rung)) {
+            if (pthread_cond_timedwait(&d->cv, &d->lock, &ts) != 0) break;
+        }
+    }
+    pthread_mutex_unlock(&d->lock);
+#endif
+    return atomic_exchange(&d->rung, 0);
+}
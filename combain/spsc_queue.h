@@ -0,0 +1,113 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Bounded lock-free single-producer / single-consumer queue of pointers.
+ *
+ * C11 atomics; head and tail live on their own cache lines so producer and
+ * consumer never share one. (MSVC: build with /std:c11
+ * /experimental:c11atomics.)
+ *
+ * What happens when the queue is full is a per-queue policy:
+ *   SPSC_BLOCK        producer waits for space (TCP peers see backpressure)
+ *   SPSC_SPILL        item is handed to the spill callback (e.g. written to
+ *                     disk) on the producer thread
+ *   SPSC_DROP_OLDEST  the oldest queued item is discarded to make room
+ * Every outcome is counted; see spsc_stats().
+ */
+
+typedef enum {
+    SPSC_BLOCK = 0,
+    SPSC_SPILL,
+    SPSC_DROP_OLDEST
+} SpscPolicy;
+
+typedef enum {
+    SPSC_PUSHED = 0,
+    SPSC_SPILLED,
+    SPSC_DROPPED,    // the new item was discarded (queue closed / spill failed)
+    SPSC_CLOSED
+} SpscResult;
+
+// Called on the producer thread. spill() takes ownership of 'item' and
+// returns 1 if it was saved; discard() frees an item the queue drops.
+typedef int  (*SpscSpillFn)(void *ctx, void *item);
+typedef void (*SpscDiscardFn)(void *ctx, void *item);
+
+typedef struct {
+    unsigned long long pushed;
+    unsigned long long popped;
+    unsigned long long blocked;      // pushes that had to wait for space
+    unsigned long long blockedUs;    // total time spent waiting
+    unsigned long long spilled;
+    unsigned long long dropped;      // oldest items discarded (DROP_OLDEST)
+    unsigned long long lost;         // new items discarded (spill failed, closed)
+    size_t             depth;        // items queued right now
+    size_t             maxDepth;
+    size_t             capacity;
+} SpscStats;
+
+typedef struct SpscQueue SpscQueue;
+
+/**
+ * 'capacity' is rounded up to a power of two. 'spill' is required for
+ * SPSC_SPILL; 'discard' (may be NULL) frees dropped items.
+ * Returns NULL on error.
+ */
+SpscQueue *spsc_create(size_t capacity, SpscPolicy policy,
+                       SpscSpillFn spill, SpscDiscardFn discard, void *ctx);
+
+/**
+ * Producer side. Ownership of 'item' always passes to the queue: it is
+ * queued, spilled or discarded.
+ */
+SpscResult spsc_push(SpscQueue *q, void *item);
+
+/** Consumer side. NULL when empty. */
+void *spsc_pop(SpscQueue *q);
+
+/** Unblock a waiting producer; later pushes are discarded. */
+void spsc_close(SpscQueue *q);
+
+void spsc_stats(const SpscQueue *q, SpscStats *out);
+
+/**
+ * 1 if the next push would hit the full-queue policy. Exact on the
+ * producer thread, which can use it to pause its input instead.
+ */
+int spsc_full(const SpscQueue *q);
+
+/** Pop and discard everything left, then free the queue. NULL = no-op. */
+void spsc_destroy(SpscQueue *q);
+
+// ===============================================================
+//  Doorbell: lets a consumer sleep until a producer has pushed.
+//  ring() only takes the lock when the consumer may be asleep.
+// ===============================================================
+
+typedef struct Doorbell Doorbell;
+
+Doorbell *doorbell_create(void);
+void      doorbell_destroy(Doorbell *d);
+
+/** Wake the waiter (cheap when it is already awake or already rung). */
+void doorbell_ring(Doorbell *d);
+
+/**
+ * Sleep until rung or 'timeout_ms' passes (< 0 = forever).
+ * Returns 1 if rung, 0 on timeout. Consume the queues *after* this
+ * returns: a ring during the drain is kept for the next wait.
+ */
+int doorbell_wait(Doorbell *d, long timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPSC_QUEUE_H
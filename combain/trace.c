@@ -0,0 +1,324 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "trace.h"
+#include "logger.h"
+#include "monotime.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
+#define TRACE_MAX_SOURCES 128
+#define TRACE_PATH_MAX    512
+
+// Histogram shape: values below 2^SUB_BITS us get a bucket each, every
+// power of two above that is split into 2^SUB_BITS linear steps. Values
+// from 2^MAX_BITS us (19 hours) on share the last bucket.
+#define SUB_BITS     6
+#define SUB_COUNT    (1 << SUB_BITS)
+#define MAX_BITS     36
+#define HIST_BUCKETS ((MAX_BITS - SUB_BITS + 1) * SUB_COUNT)
+
+// The gaps between stamps that get a histogram; the last one spans the
+// whole trip.
+enum { SPAN_CAPTURE, SPAN_WAIT, SPAN_PARSE, SPAN_QUEUE, SPAN_UPLOAD, SPAN_TOTAL, SPANS };
+
+static const char *const SPAN_NAMES[SPANS] = { "capture", "wait", "parse", "queue", "upload", "total" };
+
+typedef struct {
+    atomic_int          state;    // 0 free, 1 being filled, 2 in use
+    char                path[TRACE_PATH_MAX];   // normalised
+    atomic_ullong       recvUs;   // first bytes since the last claim
+    atomic_ullong       framedUs; // last time the source went idle
+} Source;
+
+typedef struct {
+    atomic_ullong n, sumUs, maxUs;
+    atomic_ullong b[HIST_BUCKETS];
+} Hist;
+
+static Source g_sources[TRACE_MAX_SOURCES];
+static Hist   g_hist[SPANS];
+
+static FILE  *g_file;             // under g_fileLock
+#ifdef _WIN32
+static SRWLOCK g_fileLock = SRWLOCK_INIT;
+#define FILE_LOCK()   AcquireSRWLockExclusive(&g_fileLock)
+#define FILE_UNLOCK() ReleaseSRWLockExclusive(&g_fileLock)
+#else
+static pthread_mutex_t g_fileLock = PTHREAD_MUTEX_INITIALIZER;
+#define FILE_LOCK()   pthread_mutex_lock(&g_fileLock)
+#define FILE_UNLOCK() pthread_mutex_unlock(&g_fileLock)
+#endif
+
+unsigned long long trace_now_us(void) {
+    return monotime_us();
+}
+
+// "./ss//a.txt" and "ss\\a.txt" compare equal.
+static void normalise(char *dst, size_t cap, const char *src) {
+    size_t n = 0;
+    while (src[0] == '.' && (src[1] == '/' || src[1] == '\\')) src += 2;
+    for (; *src && n + 1 < cap; src++) {
+        char c = (*src == '\\') ? '/' : *src;
+        if (c == '/' && n && dst[n - 1] == '/') continue;
+        dst[n++] = c;
+    }
+    dst[n] = '\0';
+}
+
+// ===============================================================
+//  Capture side
+// ===============================================================
+
+static int find_source(const char *norm) {
+    for (int i = 0; i < TRACE_MAX_SOURCES; i++) {
+        Source *s = &g_sources[i];
+        if (atomic_load(&s->state) == 2 && strcmp(s->path, norm) == 0) return i;
+    }
+    return -1;
+}
+
+int trace_source(const char *path) {
+    char norm[TRACE_PATH_MAX];
+    normalise(norm, sizeof(norm), path);
+    int slot = find_source(norm);
+    if (slot >= 0) return slot;
+
+    for (int i = 0; i < TRACE_MAX_SOURCES; i++) {
+        Source *s = &g_sources[i];
+        int free_ = 0;
+        if (!atomic_compare_exchange_strong(&s->state, &free_, 1)) continue;
+        strcpy(s->path, norm);
+        atomic_store(&s->recvUs, 0);
+        atomic_store(&s->framedUs, 0);
+        atomic_store(&s->state, 2);   // publishes the path
+        return i;
+    }
+    return -1;
+}
+
+void trace_received(int slot, unsigned long long us) {
+    if (slot < 0) return;
+    unsigned long long none = 0;
+    atomic_compare_exchange_strong(&g_sources[slot].recvUs, &none, us);
+}
+
+void trace_framed(int slot, unsigned long long us) {
+    if (slot < 0) return;
+    atomic_store(&g_sources[slot].framedUs, us);
+}
+
+void trace_claim(const char *path, TraceTimes *t) {
+    char norm[TRACE_PATH_MAX];
+    normalise(norm, sizeof(norm), path);
+    int slot = find_source(norm);
+    if (slot < 0) return;
+
+    // Whatever the file holds now goes with this claim, even a result
+    // still arriving (framed stays 0): its later bytes land in a new file.
+    Source *s = &g_sources[slot];
+    t->us[TRACE_FRAMED] = atomic_exchange(&s->framedUs, 0);
+    t->us[TRACE_RECV]   = atomic_exchange(&s->recvUs, 0);
+}
+
+// ===============================================================
+//  Histograms
+// ===============================================================
+
+static int top_bit(unsigned long long v) {
+    int b = 0;
+    while (v >>= 1) b++;
+    return b;
+}
+
+static int bucket_of(unsigned long long us) {
+    if (us < SUB_COUNT) return (int)us;
+    int msb = top_bit(us);
+    if (msb >= MAX_BITS) return HIST_BUCKETS - 1;
+    int shift = msb - SUB_BITS;
+    return ((shift + 1) << SUB_BITS) + (int)((us >> shift) - SUB_COUNT);
+}
+
+// Largest value that lands in bucket 'i'.
+static unsigned long long bucket_top(int i) {
+    if (i < SUB_COUNT) return (unsigned long long)i;
+    int shift = (i >> SUB_BITS) - 1;
+    unsigned long long low = (unsigned long long)((i & (SUB_COUNT - 1)) + SUB_COUNT) << shift;
+    return low + (1ull << shift) - 1;
+}
+
+static void hist_add(Hist *h, unsigned long long us) {
+    atomic_fetch_add_explicit(&h->b[bucket_of(us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sumUs, us, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->n, 1, memory_order_relaxed);
+    unsigned long long m = atomic_load_explicit(&h->maxUs, memory_order_relaxed);
+    while (us > m && !atomic_compare_exchange_weak_explicit(&h->maxUs, &m, us, memory_order_relaxed,
+                                                            memory_order_relaxed)) { }
+}
+
+typedef struct {
+    unsigned long long n, sumUs, maxUs;
+    unsigned long long b[HIST_BUCKETS];
+} HistSnap;
+
+static void hist_snap(const Hist *h, HistSnap *s) {
+    s->n = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        s->b[i] = atomic_load_explicit(&h->b[i], memory_order_relaxed);
+        s->n += s->b[i];
+    }
+    s->sumUs = atomic_load_explicit(&h->sumUs, memory_order_relaxed);
+    s->maxUs = atomic_load_explicit(&h->maxUs, memory_order_relaxed);
+}
+
+static unsigned long long percentile(const HistSnap *s, double q) {
+    if (!s->n) return 0;
+    unsigned long long rank = (unsigned long long)(q * (double)s->n + 0.999999);
+    if (rank < 1) rank = 1;
+    unsigned long long seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += s->b[i];
+        if (seen >= rank) {
+            unsigned long long v = bucket_top(i);
+            return v < s->maxUs ? v : s->maxUs;
+        }
+    }
+    return s->maxUs;
+}
+
+// ===============================================================
+//  Recording
+// ===============================================================
+
+static void put16(unsigned char *p, unsigned v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put32(unsigned char *p, unsigned long v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put64(unsigned char *p, unsigned long long v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void write_record(const TraceTimes *t, int kind, long httpStatus, int ok) {
+    unsigned long long base = 0;
+    for (int i = 0; i < TRACE_STAMPS && !base; i++) base = t->us[i];
+
+    unsigned char rec[TRACE_FILE_RECORD];
+    put64(rec, base);
+    for (int i = 0; i < TRACE_STAMPS; i++) {
+        unsigned long long off = t->us[i] ? t->us[i] - base : TRACE_FILE_MISSING;
+        put32(rec + 8 + 4 * i, (unsigned long)(off < TRACE_FILE_MISSING ? off : TRACE_FILE_MISSING));
+    }
+    put16(rec + 32, (unsigned)(httpStatus > 0 && httpStatus < 65536 ? httpStatus : 0));
+    rec[34] = (unsigned char)kind;
+    rec[35] = ok ? TRACE_FLAG_OK : 0;
+
+    FILE_LOCK();
+    if (g_file && fwrite(rec, 1, sizeof(rec), g_file) != sizeof(rec)) {
+        log_msg(LOG_ERROR, "trace", "❌ Trace file write: %s", strerror(errno));
+        fclose(g_file);
+        g_file = NULL;
+    }
+    FILE_UNLOCK();
+}
+
+void trace_finish(const TraceTimes *t, int kind, long httpStatus, int ok) {
+    write_record(t, kind, httpStatus, ok);
+    if (!ok) return;   // the histograms describe results that made it
+
+    // Span i lies between stamps i and i + 1; a stamp not seen drops both
+    // spans next to it.
+    unsigned long long first = 0;
+    for (int i = 0; i < TRACE_STAMPS; i++) {
+        const unsigned long long *us = t->us;
+        if (us[i] && !first) first = us[i];
+        if (i > 0 && us[i - 1] && us[i]) hist_add(&g_hist[i - 1], us[i] >= us[i - 1] ? us[i] - us[i - 1] : 0);
+    }
+    unsigned long long end = t->us[TRACE_RESPONSE];
+    if (first && end >= first) hist_add(&g_hist[SPAN_TOTAL], end - first);
+}
+
+// ===============================================================
+//  Trace file
+// ===============================================================
+
+int trace_file_open(const char *path) {
+    FILE *fp = NULL;
+    if (path && *path) {
+        fp = fopen(path, "ab");
+        if (!fp) {
+            log_msg(LOG_ERROR, "trace", "❌ Cannot open trace file %s: %s", path, strerror(errno));
+            return 0;
+        }
+        fseek(fp, 0, SEEK_END);
+        if (ftell(fp) == 0) {
+            unsigned char head[TRACE_FILE_HEADER] = {0};
+            memcpy(head, TRACE_FILE_MAGIC, 8);
+            put32(head + 8, TRACE_FILE_RECORD);
+            fwrite(head, 1, sizeof(head), fp);
+        }
+    }
+
+    FILE_LOCK();
+    FILE *old = g_file;
+    g_file = fp;
+    FILE_UNLOCK();
+    if (old) fclose(old);
+    return 1;
+}
+
+void trace_file_close(void) {
+    trace_file_open(NULL);
+}
+
+// ===============================================================
+//  Output
+// ===============================================================
+
+static const double QUANTILES[] = { 0.5, 0.9, 0.99 };
+#define NQUANTILES ((int)(sizeof(QUANTILES) / sizeof(QUANTILES[0])))
+
+void trace_render(MetricsText *t) {
+    static HistSnap s;   // loop thread only; 16 KB
+    metrics_family(t, "combain_stage_latency_seconds", "summary",
+                   "Time accepted uploads spent in each stage: capture (first byte to idle), wait "
+                   "(to the parse queue), parse, queue (to the upload start), upload, total.");
+    for (int k = 0; k < SPANS; k++) {
+        hist_snap(&g_hist[k], &s);
+        for (int q = 0; q < NQUANTILES; q++) {
+            metrics_printf(t, "combain_stage_latency_seconds{stage=\"%s\",quantile=\"%g\"} %.6f\n",
+                           SPAN_NAMES[k], QUANTILES[q], percentile(&s, QUANTILES[q]) / 1e6);
+        }
+        metrics_printf(t, "combain_stage_latency_seconds_sum{stage=\"%s\"} %.6f\n", SPAN_NAMES[k], s.sumUs / 1e6);
+        metrics_printf(t, "combain_stage_latency_seconds_count{stage=\"%s\"} %llu\n", SPAN_NAMES[k], s.n);
+    }
+}
+
+void trace_report(void) {
+    static HistSnap s;
+    hist_snap(&g_hist[SPAN_TOTAL], &s);
+    if (!s.n) return;
+
+    log_msg(LOG_INFO, "trace", "⏱️  Stage latency of %llu accepted upload(s), ms:", s.n);
+    log_msg(LOG_INFO, "trace", "    %-8s %8s %10s %10s %10s %10s", "stage", "n", "p50", "p90", "p99", "max");
+    for (int k = 0; k < SPANS; k++) {
+        hist_snap(&g_hist[k], &s);
+        if (!s.n) continue;
+        log_msg(LOG_INFO, "trace", "    %-8s %8llu %10.2f %10.2f %10.2f %10.2f", SPAN_NAMES[k], s.n,
+                percentile(&s, 0.5) / 1e3, percentile(&s, 0.9) / 1e3, percentile(&s, 0.99) / 1e3,
+                s.maxUs / 1e3);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef COMBAIN_TRACE_H
+#define COMBAIN_TRACE_H
+
+#include "metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Where a result's time goes between the analyser sending it and the API
+ * accepting it.
+ *
+ * Every result carries monotonic timestamps (microseconds, the clock of
+ * trace_now_us()) for the stages it went through:
+ *
+ *   recv      the first bytes of it were handed to the capture sink
+ *   framed    the sink saw its source go idle: the result is complete
+ *   enqueued  the scanner handed the file to a parse worker
+ *   parsed    parsing and encoding finished
+ *   request   its upload started
+ *   response  the upload ended
+ *
+ * recv and framed are only known for files written through the capture
+ * sink; files that were already in a scan folder start at enqueued.
+ *
+ * The gaps between stages feed log-linear histograms (64 linear steps per
+ * power of two, so any percentile is within 1.6 %) that are printed at
+ * shutdown and served on /metrics. With a trace file open every finished
+ * upload also appends one fixed-size record to it; tools/trace_summary
+ * reads the file back offline.
+ */
+
+typedef enum {
+    TRACE_RECV = 0,
+    TRACE_FRAMED,
+    TRACE_ENQUEUED,
+    TRACE_PARSED,
+    TRACE_REQUEST,
+    TRACE_RESPONSE,
+    TRACE_STAMPS
+} TraceStamp;
+
+/** One result's stamps; 0 = the stage was not seen. */
+typedef struct {
+    unsigned long long us[TRACE_STAMPS];
+} TraceTimes;
+
+/**
+ * Trace file layout, all integers little-endian: a 16-byte header
+ * ("CBTRACE1", u32 record size, u32 0) followed by records of
+ *   u64 base      the first stamp present
+ *   u32 off[6]    each stamp - base, TRACE_FILE_MISSING if not seen
+ *   u16 status    HTTP status, 0 = no response
+ *   u8  kind      AnalyserKind
+ *   u8  flags     TRACE_FLAG_*
+ */
+#define TRACE_FILE_MAGIC    "CBTRACE1"
+#define TRACE_FILE_HEADER   16
+#define TRACE_FILE_RECORD   36
+#define TRACE_FILE_MISSING  0xFFFFFFFFu
+#define TRACE_FLAG_OK       0x01      // the upload was accepted
+
+unsigned long long trace_now_us(void);
+
+/**
+ * Capture side. trace_source() returns the slot of capture file 'path'
+ * (the same slot every time for the same file), -1 when the table is full.
+ * trace_received() and trace_framed() are then called from the sink
+ * thread; both ignore a negative slot.
+ */
+int  trace_source(const char *path);
+void trace_received(int slot, unsigned long long us);
+void trace_framed(int slot, unsigned long long us);
+
+/**
+ * Scanner side: 't' gets the recv and framed stamps of the capture file
+ * at 'path' (0 if not seen since the last claim) and the slot starts over
+ * for the next result. Other stamps of 't' are left alone.
+ */
+void trace_claim(const char *path, TraceTimes *t);
+
+/** A result's upload ended: record its stages. Any thread. */
+void trace_finish(const TraceTimes *t, int kind, long httpStatus, int ok);
+
+/**
+ * Append records to 'path' from now on (created with its header if
+ * missing). NULL or "" closes the current file. Returns 1 on success.
+ */
+int trace_file_open(const char *path);
+void trace_file_close(void);
+
+/** Stage percentiles for the metrics endpoint. */
+void trace_render(MetricsText *t);
+
+/** Stage percentiles to the log (at shutdown). */
+void trace_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMBAIN_TRACE_H
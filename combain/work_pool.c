@@ -0,0 +1,318 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "work_pool.h"
+#include "logger.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <process.h>
+
+    typedef CRITICAL_SECTION   pool_mutex;
+    typedef CONDITION_VARIABLE pool_cond;
+    #define mutex_init(m)      InitializeCriticalSection(m)
+    #define mutex_destroy(m)   DeleteCriticalSection(m)
+    #define mutex_lock(m)      EnterCriticalSection(m)
+    #define mutex_unlock(m)    LeaveCriticalSection(m)
+    #define cond_init(c)       InitializeConditionVariable(c)
+    #define cond_destroy(c)    ((void)0)
+    #define cond_wait(c, m)    SleepConditionVariableCS(c, m, INFINITE)
+    #define cond_signal(c)     WakeConditionVariable(c)
+    #define cond_broadcast(c)  WakeAllConditionVariable(c)
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+
+    typedef pthread_mutex_t    pool_mutex;
+    typedef pthread_cond_t     pool_cond;
+    #define mutex_init(m)      pthread_mutex_init(m, NULL)
+    #define mutex_destroy(m)   pthread_mutex_destroy(m)
+    #define mutex_lock(m)      pthread_mutex_lock(m)
+    #define mutex_unlock(m)    pthread_mutex_unlock(m)
+    #define cond_init(c)       pthread_cond_init(c, NULL)
+    #define cond_destroy(c)    pthread_cond_destroy(c)
+    #define cond_wait(c, m)    pthread_cond_wait(c, m)
+    #define cond_signal(c)     pthread_cond_signal(c)
+    #define cond_broadcast(c)  pthread_cond_broadcast(c)
+#endif
+
+#define WORK_POOL_MAX_WORKERS 64
+
+// ===============================================================
+//  Per-worker deque
+// ===============================================================
+
+typedef struct {
+    WorkFn fn;
+    void  *arg;
+} WorkTask;
+
+// Growable ring. 'top' is the steal end (oldest), 'bottom' the owner end.
+typedef struct {
+    pool_mutex lock;
+    WorkTask  *ring;
+    size_t     cap;     // power of two
+    size_t     top;
+    size_t     bottom;
+} WorkDeque;
+
+static int deque_push_bottom(WorkDeque *d, WorkFn fn, void *arg) {
+    mutex_lock(&d->lock);
+    if (d->bottom - d->top == d->cap) {
+        size_t ncap = d->cap ? d->cap * 2 : 64;
+        WorkTask *nr = (WorkTask *)malloc(ncap * sizeof(WorkTask));
+        if (!nr) {
+            mutex_unlock(&d->lock);
+            return 0;
+        }
+        for (size_t i = d->top; i != d->bottom; i++) {
+            nr[i & (ncap - 1)] = d->ring[i & (d->cap - 1)];
+        }
+        free(d->ring);
+        d->ring = nr;
+        d->cap  = ncap;
+    }
+    d->ring[d->bottom & (d->cap - 1)] = (WorkTask){ fn, arg };
+    d->bottom++;
+    mutex_unlock(&d->lock);
+    return 1;
+}
+
+static int deque_pop_bottom(WorkDeque *d, WorkTask *out) {
+    int ok = 0;
+    mutex_lock(&d->lock);
+    if (d->bottom != d->top) {
+        d->bottom--;
+        *out = d->ring[d->bottom & (d->cap - 1)];
+        ok = 1;
+    }
+    mutex_unlock(&d->lock);
+    return ok;
+}
+
+static int deque_steal_top(WorkDeque *d, WorkTask *out) {
+    int ok = 0;
+    mutex_lock(&d->lock);
+    if (d->bottom != d->top) {
+        *out = d->ring[d->top & (d->cap - 1)];
+        d->top++;
+        ok = 1;
+    }
+    mutex_unlock(&d->lock);
+    return ok;
+}
+
+// ===============================================================
+//  Pool
+// ===============================================================
+
+struct WorkPool;
+
+typedef struct {
+    struct WorkPool *pool;
+    int              index;
+#ifdef _WIN32
+    HANDLE           thread;
+#else
+    pthread_t        thread;
+#endif
+} WorkWorker;
+
+struct WorkPool {
+    int         nworkers;
+    WorkDeque   deques[WORK_POOL_MAX_WORKERS];
+    WorkWorker  workers[WORK_POOL_MAX_WORKERS];
+
+    // Tasks move through the deques without 'lock'. It is only taken to
+    // sleep: a worker that found every deque empty bumps 'sleepers' and
+    // looks once more under the lock before waiting, and submit signals
+    // only when someone sleeps, so the common path never touches it.
+    atomic_size_t pending;   // tasks not yet finished
+    atomic_int    sleepers;  // workers in (or about to enter) cond_wait
+    atomic_uint   next;      // round-robin cursor for submit
+    pool_mutex    lock;
+    pool_cond     work_cv;   // workers sleep here when every deque is empty
+    pool_cond     idle_cv;   // work_pool_wait() sleeps here
+    int           stopping;  // under 'lock'
+};
+
+static int online_cpus(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+// Own deque first, then sweep the others starting at our right-hand
+// neighbour so thieves spread out instead of all hitting worker 0.
+static int find_task(WorkPool *p, int self, WorkTask *out) {
+    if (deque_pop_bottom(&p->deques[self], out)) return 1;
+    for (int k = 1; k < p->nworkers; k++) {
+        int victim = (self + k) % p->nworkers;
+        if (deque_steal_top(&p->deques[victim], out)) return 1;
+    }
+    return 0;
+}
+
+// The last task to finish wakes work_pool_wait(); the broadcast is under
+// the lock so a waiter between its check and its wait cannot miss it.
+static void finish_task(WorkPool *p) {
+    if (atomic_fetch_sub(&p->pending, 1) == 1) {
+        mutex_lock(&p->lock);
+        cond_broadcast(&p->idle_cv);
+        mutex_unlock(&p->lock);
+    }
+}
+
+#ifdef _WIN32
+static unsigned __stdcall worker_main(void *arg)
+#else
+static void *worker_main(void *arg)
+#endif
+{
+    WorkWorker *w = (WorkWorker *)arg;
+    WorkPool   *p = w->pool;
+
+    for (;;) {
+        WorkTask t;
+        if (!find_task(p, w->index, &t)) {
+            // Every deque looked empty. Announce the sleep, then look once
+            // more: a submit either lands before this sweep or sees us.
+            mutex_lock(&p->lock);
+            atomic_fetch_add(&p->sleepers, 1);
+            atomic_thread_fence(memory_order_seq_cst);
+            int found = find_task(p, w->index, &t);
+            if (!found && p->stopping) {
+                atomic_fetch_sub(&p->sleepers, 1);
+                mutex_unlock(&p->lock);
+                break;
+            }
+            if (!found) cond_wait(&p->work_cv, &p->lock);
+            atomic_fetch_sub(&p->sleepers, 1);
+            mutex_unlock(&p->lock);
+            if (!found) continue;
+        }
+
+        t.fn(t.arg, w->index);
+        finish_task(p);
+    }
+
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+static void join_workers(WorkPool *p, int n) {
+    for (int i = 0; i < n; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(p->workers[i].thread, INFINITE);
+        CloseHandle(p->workers[i].thread);
+#else
+        pthread_join(p->workers[i].thread, NULL);
+#endif
+    }
+}
+
+static void free_pool(WorkPool *p) {
+    for (int i = 0; i < WORK_POOL_MAX_WORKERS; i++) {
+        free(p->deques[i].ring);
+        mutex_destroy(&p->deques[i].lock);
+    }
+    cond_destroy(&p->idle_cv);
+    cond_destroy(&p->work_cv);
+    mutex_destroy(&p->lock);
+    free(p);
+}
+
+WorkPool *work_pool_create(int nworkers) {
+    if (nworkers <= 0) nworkers = online_cpus();
+    if (nworkers > WORK_POOL_MAX_WORKERS) nworkers = WORK_POOL_MAX_WORKERS;
+
+    WorkPool *p = (WorkPool *)calloc(1, sizeof(WorkPool));
+    if (!p) return NULL;
+
+    mutex_init(&p->lock);
+    cond_init(&p->work_cv);
+    cond_init(&p->idle_cv);
+    for (int i = 0; i < WORK_POOL_MAX_WORKERS; i++) mutex_init(&p->deques[i].lock);
+    p->nworkers = nworkers;
+
+    for (int i = 0; i < nworkers; i++) {
+        WorkWorker *w = &p->workers[i];
+        w->pool  = p;
+        w->index = i;
+#ifdef _WIN32
+        w->thread = (HANDLE)_beginthreadex(NULL, 0, worker_main, w, 0, NULL);
+        int failed = (w->thread == NULL);
+#else
+        int failed = (pthread_create(&w->thread, NULL, worker_main, w) != 0);
+#endif
+        if (failed) {
+            log_msg(LOG_ERROR, "pool", "❌ Failed to start pool worker %d", i);
+            mutex_lock(&p->lock);
+            p->stopping = 1;
+            cond_broadcast(&p->work_cv);
+            mutex_unlock(&p->lock);
+            join_workers(p, i);
+            free_pool(p);
+            return NULL;
+        }
+    }
+    return p;
+}
+
+int work_pool_size(const WorkPool *pool) {
+    return pool ? pool->nworkers : 0;
+}
+
+int work_pool_submit(WorkPool *pool, WorkFn fn, void *arg) {
+    if (!pool || !fn) return 0;
+
+    unsigned slot = atomic_fetch_add(&pool->next, 1) % (unsigned)pool->nworkers;
+    atomic_fetch_add(&pool->pending, 1);
+    if (!deque_push_bottom(&pool->deques[slot], fn, arg)) {
+        finish_task(pool);
+        return 0;
+    }
+
+    // Pairs with the fence in worker_main: either the sleeper's last sweep
+    // sees the task or we see the sleeper.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&pool->sleepers) > 0) {
+        mutex_lock(&pool->lock);
+        cond_signal(&pool->work_cv);
+        mutex_unlock(&pool->lock);
+    }
+    return 1;
+}
+
+void work_pool_wait(WorkPool *pool) {
+    if (!pool) return;
+    mutex_lock(&pool->lock);
+    while (atomic_load(&pool->pending) > 0) {
+        cond_wait(&pool->idle_cv, &pool->lock);
+    }
+    mutex_unlock(&pool->lock);
+}
+
+void work_pool_destroy(WorkPool *pool) {
+    if (!pool) return;
+
+    mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    cond_broadcast(&pool->work_cv);
+    mutex_unlock(&pool->lock);
+
+    join_workers(pool, pool->nworkers);
+    free_pool(pool);
+}
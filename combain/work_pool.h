@@ -0,0 +1,49 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Small work-stealing thread pool used to drain the scan directory.
+ *
+ * Each worker owns a deque. Submitted tasks are dealt round-robin onto the
+ * deques; a worker pops from the bottom of its own deque and, when that is
+ * empty, steals from the top of another worker's deque, so one slow file
+ * (or a slow upload) never leaves the other cores idle.
+ */
+
+typedef void (*WorkFn)(void *arg, int worker);
+
+typedef struct WorkPool WorkPool;
+
+/**
+ * Create a pool with 'nworkers' threads (<= 0 = one per online CPU).
+ * Returns NULL on error.
+ */
+WorkPool *work_pool_create(int nworkers);
+
+/** Number of worker threads in the pool. */
+int work_pool_size(const WorkPool *pool);
+
+/**
+ * Queue fn(arg, worker). Returns 1 on success, 0 if the task could not be
+ * queued (out of memory); the caller then still owns 'arg'.
+ */
+int work_pool_submit(WorkPool *pool, WorkFn fn, void *arg);
+
+/** Block until every task submitted so far has finished. */
+void work_pool_wait(WorkPool *pool);
+
+/**
+ * Finish queued tasks, join the workers and free the pool.
+ * Safe to call with NULL (no-op).
+ */
+void work_pool_destroy(WorkPool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WORK_POOL_H
@@ -0,0 +1,116 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "analyser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+  #include <io.h>
+#else
+  #include <dirent.h>
+  #include <unistd.h>
+#endif
+
+// ===============================================================
+//  Parsing
+// ===============================================================
+
+FormatStatus analyser_parse_buffer(const char *buf, size_t len, AnalyserRecord *out,
+                                   const AnalyserFormat **fmtOut,
+                                   char *detail, size_t detailCap) {
+    return analyser_parse_buffer_in(NULL, buf, len, out, fmtOut, detail, detailCap);
+}
+
+FormatStatus analyser_parse_buffer_in(Arena *arena, const char *buf, size_t len,
+                                      AnalyserRecord *out, const AnalyserFormat **fmtOut,
+                                      char *detail, size_t detailCap) {
+    // Result files have always been handled as C strings: stop at a NUL.
+    const char *nul = (const char *)memchr(buf, '\0', len);
+    if (nul) len = (size_t)(nul - buf);
+
+    const AnalyserFormat *fmt = format_classify(buf, len);
+    if (fmtOut) *fmtOut = fmt;
+
+    record_init_in(out, fmt ? fmt->kind : ANALYSER_KIND_RESULTS, arena);
+    if (!fmt) {
+        if (detail && detailCap) snprintf(detail, detailCap, "no matching format");
+        return FORMAT_ERR_EMPTY;
+    }
+
+    // The parsers do not modify the text, so it is parsed where it lies.
+    return format_parse(fmt, buf, len, out, detail, detailCap);
+}
+
+// ===============================================================
+//  Files
+// ===============================================================
+
+int analyser_read_file(const char *path, char **out, size_t *len) {
+    return analyser_read_file_in(NULL, path, out, len);
+}
+
+int analyser_read_file_in(Arena *arena, const char *path, char **out, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    fseek(f, 0, SEEK_END);
+    long sz = ftell(f);
+    if (sz < 0) { fclose(f); return 0; }
+    fseek(f, 0, SEEK_SET);
+    char *buf = arena ? (char *)arena_alloc(arena, (size_t)sz + 1) : (char *)malloc((size_t)sz + 1);
+    if (!buf) { fclose(f); return 0; }
+    size_t rd = fread(buf, 1, (size_t)sz, f);
+    fclose(f);
+    buf[rd] = '\0';
+    *out = buf;
+    if (len) *len = strlen(buf);
+    return 1;
+}
+
+void analyser_delete_file(const char *path) {
+#ifdef _WIN32
+    _unlink(path);
+#else
+    unlink(path);
+#endif
+}
+
+int analyser_scan_dir(const char *dir, const char *ext, AnalyserFileFn fn, void *ctx) {
+#ifdef _WIN32
+    char pattern[MAX_PATH];
+    snprintf(pattern, sizeof(pattern), "%s\\*%s", dir, ext);
+
+    WIN32_FIND_DATAA ffd;
+    HANDLE hFind = FindFirstFileA(pattern, &ffd);
+    if (hFind == INVALID_HANDLE_VALUE) return 0;
+
+    do {
+        if (!(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            char filePath[MAX_PATH];
+            snprintf(filePath, sizeof(filePath), "%s\\%s", dir, ffd.cFileName);
+            fn(filePath, ffd.cFileName, ctx);
+        }
+    } while (FindNextFileA(hFind, &ffd));
+    FindClose(hFind);
+    return 1;
+#else
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+
+    size_t extLen = strlen(ext);
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        const char *dot = strrchr(ent->d_name, '.');
+        if (!dot || strlen(dot) != extLen || strcmp(dot, ext) != 0) continue;
+
+        char filePath[4096];
+        snprintf(filePath, sizeof(filePath), "%s/%s", dir, ent->d_name);
+        fn(filePath, ent->d_name, ctx);
+    }
+    closedir(d);
+    return 1;
+#endif
+}
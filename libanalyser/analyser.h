@@ -0,0 +1,68 @@
+#ifndef ANALYSER_H
+#define ANALYSER_H
+
+// libanalyser: result-file parsing, record model, wire encoders and upload
+// shared by Analyser/ and combain/.
+//
+// Build: compile libanalyser/*.c into the executable with -Ilibanalyser and
+// link libcurl, e.g. from repo root:
+//   gcc -Ilibanalyser -o combain/combain combain/*.c libanalyser/*.c -lcurl -lpthread -lz
+
+#include "analyser_formats.h"
+#include "analyser_record.h"
+#include "analyser_upload.h"
+#include "arena.h"
+#include "file_map.h"
+#include "lookup_tables.h"
+#include "record_encoder.h"
+#include "result_value.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Classify and parse one result file held in memory (read only; nothing
+ * touches the disk). 'out' is always initialised and must be released with
+ * record_free(); *fmtOut (may be NULL) receives the detected format.
+ * The caller sets MachineID/MAC with record_set_identity() before encoding.
+ */
+FormatStatus analyser_parse_buffer(const char *buf, size_t len, AnalyserRecord *out,
+                                   const AnalyserFormat **fmtOut,
+                                   char *detail, size_t detailCap);
+
+/**
+ * analyser_parse_buffer with the scratch arrays and the record itself
+ * taken from 'arena' (NULL = heap).
+ */
+FormatStatus analyser_parse_buffer_in(Arena *arena, const char *buf, size_t len,
+                                      AnalyserRecord *out, const AnalyserFormat **fmtOut,
+                                      char *detail, size_t detailCap);
+
+/**
+ * Read a whole file into a NUL-terminated heap buffer (caller frees).
+ * Returns 1 on success, 0 on error.
+ */
+int analyser_read_file(const char *path, char **out, size_t *len);
+
+/** analyser_read_file into 'arena' (NULL = heap; the caller then frees). */
+int analyser_read_file_in(Arena *arena, const char *path, char **out, size_t *len);
+
+void analyser_delete_file(const char *path);
+
+typedef void (*AnalyserFileFn)(const char *path, const char *name, void *ctx);
+
+/**
+ * Call fn for every regular file in 'dir' whose name ends in 'ext'
+ * (e.g. ".txt"), in directory order. Returns 0 if the directory cannot
+ * be opened.
+ */
+int analyser_scan_dir(const char *dir, const char *ext, AnalyserFileFn fn, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANALYSER_H
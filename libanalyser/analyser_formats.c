@@ -0,0 +1,470 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "analyser_formats.h"
+#include "lookup_tables.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FORMAT_MAX_FIELDS   64   // fields per row we index; later ones are ignored
+#define FORMAT_MAX_MAPPED   16   // FIELD() entries per format
+#define FORMAT_VALUE_CAP   512
+
+typedef struct {
+    const char *p;
+    size_t      n;
+} Span;
+
+// ===============================================================
+//  Shared helpers
+// ===============================================================
+
+static void set_detail(char *detail, size_t cap, const char *msg) {
+    if (detail && cap) snprintf(detail, cap, "%s", msg);
+}
+
+// Split [s, s+n) on 'delim', keeping empty pieces. Returns the count
+// (capped at max).
+static int split_spans(const char *s, size_t n, char delim, Span *out, int max) {
+    int count = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= n && count < max; i++) {
+        if (i == n || s[i] == delim) {
+            out[count].p = s + start;
+            out[count].n = i - start;
+            count++;
+            start = i + 1;
+        }
+    }
+    return count;
+}
+
+// Copy the components [comp, compEnd] of a field, joined without separator.
+static void extract_value(const AnalyserFormat *f, const FormatField *fd,
+                          const Span *fields, int nf, int base,
+                          char *out, size_t cap) {
+    out[0] = '\0';
+    int idx = base + fd->field;
+    if (idx >= nf) return;
+
+    const Span *fs = &fields[idx];
+    if (fd->comp < 0) {
+        size_t n = fs->n < cap - 1 ? fs->n : cap - 1;
+        memcpy(out, fs->p, n);
+        out[n] = '\0';
+        return;
+    }
+
+    Span comps[FORMAT_MAX_FIELDS];
+    int nc = split_spans(fs->p, fs->n, f->compDelim, comps, FORMAT_MAX_FIELDS);
+    size_t w = 0;
+    for (int c = fd->comp; c <= fd->compEnd && c < nc; c++) {
+        size_t n = comps[c].n;
+        if (n > cap - 1 - w) n = cap - 1 - w;
+        memcpy(out + w, comps[c].p, n);
+        w += n;
+    }
+    out[w] = '\0';
+}
+
+// Scratch arrays follow the record: from its arena when it has one.
+static void *scratch_alloc(const AnalyserRecord *rec, size_t n) {
+    return rec->arena ? arena_alloc(rec->arena, n) : malloc(n);
+}
+
+static void scratch_free(const AnalyserRecord *rec, void *p) {
+    if (!rec->arena) free(p);
+}
+
+// strtok-style split of [s, s+n): empty records are skipped. The text is
+// not modified, so it can be a read-only file mapping. At most 'max'
+// records are returned (<= 0 = all), so a format that reads only the first
+// rows of a large capture never walks the rest of it.
+static Span *split_records(const AnalyserRecord *rec, const char *s, size_t n,
+                           char delim, int max, int *count) {
+    int cap = 1;
+    for (const char *p = s; (p = (const char *)memchr(p, delim, (size_t)(s + n - p))) != NULL; p++) {
+        if (max > 0 && cap >= max) break;
+        cap++;
+    }
+
+    Span *rows = (Span *)scratch_alloc(rec, (size_t)cap * sizeof(Span));
+    if (!rows) { *count = 0; return NULL; }
+
+    int k = 0;
+    size_t i = 0;
+    while (i < n && k < cap) {
+        while (i < n && s[i] == delim) i++;
+        if (i == n) break;
+        size_t b = i;
+        while (i < n && s[i] != delim) i++;
+        rows[k].p = s + b;
+        rows[k].n = i - b;
+        k++;
+    }
+    *count = k;
+    return rows;
+}
+
+// ===============================================================
+//  Layout: ROWS
+// ===============================================================
+
+static inline FormatStatus parse_layout_ROWS(const AnalyserFormat *f, const char *text, size_t len,
+                                             AnalyserRecord *out, char *detail, size_t detailCap) {
+    size_t start = (size_t)f->skipHead < len ? (size_t)f->skipHead : len;
+    size_t end = len >= (size_t)f->skipTail ? len - (size_t)f->skipTail : 0;
+    if (end < start) end = start;
+
+    while (start < end && isspace((unsigned char)text[start])) start++;
+    while (end > start && isspace((unsigned char)text[end - 1])) end--;
+
+    int need = 0;   // rows the format reads; 0 = all
+    if (f->rowEnd >= 0) {
+        need = f->rowEnd;
+        if (f->sampleId->row >= need) need = f->sampleId->row + 1;
+    }
+
+    int nrows = 0;
+    Span *rows = split_records(out, text + start, end - start, f->recordDelim, need, &nrows);
+    if (!rows) {
+        set_detail(detail, detailCap, "out of memory");
+        return FORMAT_ERR_NOMEM;
+    }
+    if (nrows == 0 || nrows < f->rowStart) {
+        scratch_free(out, rows);
+        set_detail(detail, detailCap, "not enough rows");
+        return FORMAT_ERR_EMPTY;
+    }
+
+    int last = (f->rowEnd < 0 || f->rowEnd > nrows) ? nrows : f->rowEnd;
+    char values[FORMAT_MAX_MAPPED][FORMAT_VALUE_CAP];
+    Span fields[FORMAT_MAX_FIELDS];
+
+    const int nmapped = f->nfields < FORMAT_MAX_MAPPED ? f->nfields : FORMAT_MAX_MAPPED;
+
+    const FormatSampleId *sid = f->sampleId;
+    if (sid->row >= 0 && sid->row < nrows) {
+        FormatField fd = { NULL, sid->field, sid->comp, sid->comp, FIELD_ROLE_TEXT };
+        int nf = split_spans(rows[sid->row].p, rows[sid->row].n, f->fieldDelim, fields, FORMAT_MAX_FIELDS);
+        extract_value(f, &fd, fields, nf, 0, out->sampleId, sizeof(out->sampleId));
+    }
+
+    for (int idx = f->rowStart; idx < last; idx++) {
+        int nf = split_spans(rows[idx].p, rows[idx].n, f->fieldDelim, fields, FORMAT_MAX_FIELDS);
+
+        int slice_pos = idx - f->rowStart;
+        int base = (slice_pos >= f->offsetFrom && slice_pos < f->offsetTo) ? f->offsetBase : 0;
+        if (base >= nf) continue;
+
+        const char *code = "", *name = "", *units = "", *range = NULL, *flag = NULL;
+        for (int k = 0; k < nmapped; k++) {
+            const FormatField *fd = &f->fields[k];
+            extract_value(f, fd, fields, nf, base, values[k], FORMAT_VALUE_CAP);
+            switch (fd->role) {
+                case FIELD_ROLE_CODE:  code  = values[k]; break;
+                case FIELD_ROLE_NAME:  name  = values[k]; break;
+                case FIELD_ROLE_UNITS: units = values[k]; break;
+                case FIELD_ROLE_RANGE: range = values[k]; break;
+                case FIELD_ROLE_FLAG:  flag  = values[k]; break;
+                default: break;
+            }
+        }
+
+        if (!record_begin_item(out)) goto nomem;
+        for (int k = 0; k < nmapped; k++) {
+            const FormatField *fd = &f->fields[k];
+            if (fd->role != FIELD_ROLE_RESULT) {
+                if (!record_add_field(out, fd->key, values[k])) goto nomem;
+                continue;
+            }
+
+            ResultValue *rv = record_add_result(out, fd->key, values[k], range, flag);
+            if (!rv) goto nomem;
+            rv->analyte = cbc_test_by_code(code, strlen(code));
+            if (rv->analyte < 0) rv->analyte = cbc_test_by_name(name, strlen(name));
+            rv->unit = unit_lookup(units, strlen(units));
+        }
+    }
+
+    scratch_free(out, rows);
+    return FORMAT_OK;
+
+nomem:
+    scratch_free(out, rows);
+    set_detail(detail, detailCap, "out of memory");
+    return FORMAT_ERR_NOMEM;
+}
+
+// ===============================================================
+//  Layout: BLOCK
+// ===============================================================
+
+// Copy a record without the format's strip characters, NUL-terminated.
+static size_t strip_line(const AnalyserFormat *f, Span line, char *buf, size_t cap) {
+    size_t w = 0;
+    for (size_t r = 0; r < line.n && w < cap - 1; r++) {
+        char c = line.p[r];
+        if (!f->stripChars || !strchr(f->stripChars, c)) buf[w++] = c;
+    }
+    buf[w] = '\0';
+    return w;
+}
+
+static inline FormatStatus parse_layout_BLOCK(const AnalyserFormat *f, const char *text, size_t len,
+                                              AnalyserRecord *out, char *detail, size_t detailCap) {
+    char buf[FORMAT_VALUE_CAP];
+
+    // Lines are records with the strip characters removed; ones that end up
+    // empty are dropped, so line numbers match the stripped text.
+    int nraw = 0;
+    Span *lines = split_records(out, text, len, f->recordDelim, 0, &nraw);
+    if (!lines) {
+        set_detail(detail, detailCap, "out of memory");
+        return FORMAT_ERR_NOMEM;
+    }
+    int n = 0;
+    for (int i = 0; i < nraw; i++) {
+        if (strip_line(f, lines[i], buf, sizeof(buf)) > 0) lines[n++] = lines[i];
+    }
+
+    if (f->errorText && f->errorLine >= 0 && n > f->errorLine) {
+        size_t L = strip_line(f, lines[f->errorLine], buf, sizeof(buf));
+        if (L > 0 && buf[L-1] == '\r') buf[L-1] = '\0';
+        if (strcmp(buf, f->errorText) == 0) {
+            scratch_free(out, lines);
+            set_detail(detail, detailCap, "measurement error reported");
+            return FORMAT_ERR_TEST_ERROR;
+        }
+    }
+
+    int start = -1, end = -1;
+    for (int i = 0; i < n; i++) {
+        strip_line(f, lines[i], buf, sizeof(buf));
+        if (strcmp(buf, f->blockStart) == 0) start = i;
+        if (strcmp(buf, f->blockEnd) == 0) { end = i; break; }
+    }
+    if (start < 0 || end < 0 || start + 1 >= end) {
+        scratch_free(out, lines);
+        set_detail(detail, detailCap, "markers not found");
+        return FORMAT_ERR_MARKERS;
+    }
+
+    const char *prefix = f->sampleId->prefix;
+    if (prefix) {
+        size_t plen = strlen(prefix);
+        for (int i = 0; i < start; i++) {
+            strip_line(f, lines[i], buf, sizeof(buf));
+            if (strncmp(buf, prefix, plen) == 0) {
+                const char *v = buf + plen;
+                size_t L = strlen(v);
+                if (L > 0 && v[L-1] == '\r') L--;
+                if (L >= sizeof(out->sampleId)) L = sizeof(out->sampleId) - 1;
+                memcpy(out->sampleId, v, L);
+                out->sampleId[L] = '\0';
+                break;
+            }
+        }
+    }
+
+    // Rows are matched by label, not position, so firmware that reorders or
+    // adds rows still maps correctly.
+    int rowFor[URINE_LABEL_MAX];
+    const int expected = urine_label_count();
+    for (int i = 0; i < expected; i++) rowFor[i] = -1;
+
+    for (int i = start + 1; i < end; i++) {
+        size_t klen = 0;
+        strip_line(f, lines[i], buf, sizeof(buf));
+        int id = urine_label_prefix(buf, &klen);
+        if (id >= 0 && rowFor[id] < 0) rowFor[id] = i;
+    }
+
+    for (int i = 0; i < expected; i++) {
+        if (rowFor[i] < 0) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "missing %s row", urine_label_info(i)->key);
+            set_detail(detail, detailCap, msg);
+            scratch_free(out, lines);
+            return FORMAT_ERR_MISSING_ROW;
+        }
+    }
+
+    if (!record_begin_item(out)) goto nomem;
+
+    for (int i = 0; i < expected; i++) {
+        const AnalyteInfo *info = urine_label_info(i);
+        strip_line(f, lines[rowFor[i]], buf, sizeof(buf));
+        const char *val = buf + info->keyLen;
+
+        char tmp[FORMAT_VALUE_CAP];
+        int unitId = -1;
+        strip_units(val, tmp, sizeof(tmp), &unitId);
+
+        ResultValue *rv = record_add_result(out, info->key, tmp, NULL, NULL);
+        if (!rv) goto nomem;
+        rv->analyte = i;
+        rv->unit = unitId;
+    }
+
+    scratch_free(out, lines);
+    return FORMAT_OK;
+
+nomem:
+    scratch_free(out, lines);
+    set_detail(detail, detailCap, "out of memory");
+    return FORMAT_ERR_NOMEM;
+}
+
+// ===============================================================
+//  Generated from analyser_formats.def
+// ===============================================================
+
+#define FIELD(id, key, field, comp, compEnd, role)
+#define SAMPLE_ID(id, row, field, comp, prefix)
+#define END(id)
+
+// Parser prototypes
+#define FORMAT(id, kind, label, sig, layout, rd, fd, cd, sh, st, rs, re, of, ot, ob, strip, bs, be, el, et) \
+    static FormatStatus parse_##id(const char *text, size_t len, AnalyserRecord *out, char *detail, size_t detailCap);
+#include "analyser_formats.def"
+#undef FORMAT
+#undef FIELD
+#undef SAMPLE_ID
+#undef END
+
+// Field maps (sentinel-terminated so formats without FIELD() still compile)
+// and sample ID locators
+#define FORMAT(id, kind, label, sig, layout, rd, fd, cd, sh, st, rs, re, of, ot, ob, strip, bs, be, el, et) \
+    static const FormatField fields_##id[] = {
+#define FIELD(id, key, field, comp, compEnd, role) \
+        { key, field, comp, compEnd, FIELD_ROLE_##role },
+#define SAMPLE_ID(id, row, field, comp, prefix) \
+        { NULL, 0, 0, 0, FIELD_ROLE_TEXT } };       \
+    static const FormatSampleId sample_##id = { row, field, comp, prefix };
+#define END(id)
+#include "analyser_formats.def"
+#undef FORMAT
+#undef FIELD
+#undef SAMPLE_ID
+#undef END
+
+// Descriptors
+#define FIELD(id, key, field, comp, compEnd, role)
+#define SAMPLE_ID(id, row, field, comp, prefix)
+#define END(id)
+#define FORMAT(id, kind, label, sig, layout, rd, fd, cd, sh, st, rs, re, of, ot, ob, strip, bs, be, el, et) \
+    static const AnalyserFormat desc_##id = {                                              \
+        kind, label, sig, sizeof(sig) - 1, FORMAT_LAYOUT_##layout,                          \
+        rd, fd, cd, sh, st, rs, re, of, ot, ob, strip, bs, be, el, et,                      \
+        fields_##id, (int)(sizeof(fields_##id) / sizeof(fields_##id[0])) - 1,               \
+        &sample_##id, parse_##id                                                            \
+    };
+#include "analyser_formats.def"
+#undef FORMAT
+
+// Specialised parsers: the descriptor is a compile-time constant, so the
+// inlined layout code is folded for each format.
+#define FORMAT(id, kind, label, sig, layout, rd, fd, cd, sh, st, rs, re, of, ot, ob, strip, bs, be, el, et) \
+    static FormatStatus parse_##id(const char *text, size_t len, AnalyserRecord *out, char *detail, size_t detailCap) { \
+        return parse_layout_##layout(&desc_##id, text, len, out, detail, detailCap);                          \
+    }
+#include "analyser_formats.def"
+#undef FORMAT
+
+// Registry
+static const AnalyserFormat *const FORMATS[] = {
+#define FORMAT(id, kind, label, sig, layout, rd, fd, cd, sh, st, rs, re, of, ot, ob, strip, bs, be, el, et) \
+    &desc_##id,
+#include "analyser_formats.def"
+#undef FORMAT
+};
+
+// Total signature bytes: upper bound on trie nodes (plus the root)
+enum {
+    FORMAT_SIG_BYTES = 0
+#define FORMAT(id, kind, label, sig, layout, rd, fd, cd, sh, st, rs, re, of, ot, ob, strip, bs, be, el, et) \
+    + (int)(sizeof(sig) - 1)
+#include "analyser_formats.def"
+#undef FORMAT
+};
+
+#undef FIELD
+#undef SAMPLE_ID
+#undef END
+
+#define FORMAT_COUNT ((int)(sizeof(FORMATS) / sizeof(FORMATS[0])))
+
+// ===============================================================
+//  Signature matcher: byte trie over all signatures
+// ===============================================================
+
+static unsigned short trie_next[FORMAT_SIG_BYTES + 1][256];  // 0 = no edge
+static signed char    trie_format[FORMAT_SIG_BYTES + 1];     // format ending here, -1
+static int            trie_ready = 0;
+
+void format_registry_init(void) {
+    if (trie_ready) return;
+
+    int nodes = 1;
+    memset(trie_next, 0, sizeof(trie_next));
+    memset(trie_format, -1, sizeof(trie_format));
+
+    for (int i = 0; i < FORMAT_COUNT; i++) {
+        const AnalyserFormat *f = FORMATS[i];
+        int node = 0;
+        for (size_t k = 0; k < f->signatureLen; k++) {
+            unsigned char c = (unsigned char)f->signature[k];
+            if (!trie_next[node][c]) trie_next[node][c] = (unsigned short)nodes++;
+            node = trie_next[node][c];
+        }
+        if (trie_format[node] < 0) trie_format[node] = (signed char)i;
+    }
+
+    trie_ready = 1;
+}
+
+int format_count(void) {
+    return FORMAT_COUNT;
+}
+
+const AnalyserFormat *format_at(int i) {
+    return (i >= 0 && i < FORMAT_COUNT) ? FORMATS[i] : NULL;
+}
+
+const AnalyserFormat *format_classify(const char *text, size_t len) {
+    format_registry_init();
+
+    size_t i = (len > 0 ? 1 : 0);
+    while (i < len && isspace((unsigned char)text[i])) i++;
+
+    int node = 0;
+    int best = trie_format[0];
+    for (; i < len; i++) {
+        node = trie_next[node][(unsigned char)text[i]];
+        if (!node) break;
+        if (trie_format[node] >= 0) best = trie_format[node];
+    }
+
+    return best >= 0 ? FORMATS[best] : NULL;
+}
+
+FormatStatus format_parse(const AnalyserFormat *fmt, const char *text, size_t len,
+                          AnalyserRecord *out, char *detail, size_t detailCap) {
+    if (detail && detailCap) detail[0] = '\0';
+    return fmt->parse(text, len, out, detail, detailCap);
+}
+
+const char *format_status_text(FormatStatus st) {
+    switch (st) {
+        case FORMAT_OK:              return "ok";
+        case FORMAT_ERR_EMPTY:       return "empty";
+        case FORMAT_ERR_TEST_ERROR:  return "test error";
+        case FORMAT_ERR_MARKERS:     return "markers not found";
+        case FORMAT_ERR_MISSING_ROW: return "missing row";
+        case FORMAT_ERR_NOMEM:       return "out of memory";
+    }
+    return "unknown";
+}
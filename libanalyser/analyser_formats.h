@@ -0,0 +1,114 @@
+#ifndef ANALYSER_FORMATS_H
+#define ANALYSER_FORMATS_H
+
+#include "analyser_record.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    FORMAT_LAYOUT_ROWS,
+    FORMAT_LAYOUT_BLOCK
+} FormatLayout;
+
+typedef enum {
+    FIELD_ROLE_TEXT,
+    FIELD_ROLE_CODE,
+    FIELD_ROLE_NAME,
+    FIELD_ROLE_UNITS,
+    FIELD_ROLE_RESULT,
+    FIELD_ROLE_RANGE,
+    FIELD_ROLE_FLAG
+} FieldRole;
+
+typedef enum {
+    FORMAT_OK = 0,
+    FORMAT_ERR_EMPTY,        // not enough rows to parse
+    FORMAT_ERR_TEST_ERROR,   // instrument reported a measurement error
+    FORMAT_ERR_MARKERS,      // block markers not found
+    FORMAT_ERR_MISSING_ROW,  // a required label row is absent
+    FORMAT_ERR_NOMEM
+} FormatStatus;
+
+typedef struct {
+    const char *key;
+    int         field;
+    int         comp, compEnd;
+    FieldRole   role;
+} FormatField;
+
+typedef struct {
+    int         row, field, comp;  // ROWS layout; row -1 = not carried
+    const char *prefix;            // BLOCK layout line prefix, NULL = none
+} FormatSampleId;
+
+typedef struct AnalyserFormat AnalyserFormat;
+
+typedef FormatStatus (*FormatParseFn)(const char *text, size_t len, AnalyserRecord *out,
+                                      char *detail, size_t detailCap);
+
+/**
+ * Data description of one result-file format (see analyser_formats.def).
+ */
+struct AnalyserFormat {
+    AnalyserKind  kind;
+    const char   *label;        // for logs, e.g. "Analyser1"
+    const char   *signature;
+    size_t        signatureLen;
+    FormatLayout  layout;
+
+    char recordDelim, fieldDelim, compDelim;
+    int  skipHead, skipTail;
+
+    int rowStart, rowEnd;
+    int offsetFrom, offsetTo, offsetBase;
+
+    const char *stripChars;
+    const char *blockStart, *blockEnd;
+    int         errorLine;
+    const char *errorText;
+
+    const FormatField *fields;
+    int                nfields;
+
+    const FormatSampleId *sampleId;
+
+    FormatParseFn parse;        // generated, specialised for this format
+};
+
+/**
+ * Build the signature matcher. Call once before any thread classifies;
+ * format_classify() also calls it lazily.
+ */
+void format_registry_init(void);
+
+int format_count(void);
+const AnalyserFormat *format_at(int i);
+
+/**
+ * Pick the format for a file's contents: longest signature that prefixes
+ * the payload (the text after its first byte and any whitespace).
+ * Cost depends on the signature length, not on how many formats exist.
+ * Returns the fallback format when nothing else matches.
+ */
+const AnalyserFormat *format_classify(const char *text, size_t len);
+
+/**
+ * Parse a whole file into 'out' (initialised by the caller with
+ * record_init(out, fmt->kind)). 'text' is only read, so it may be a
+ * read-only file mapping; it need not be NUL-terminated. 'detail'
+ * receives a short reason on error.
+ */
+FormatStatus format_parse(const AnalyserFormat *fmt, const char *text, size_t len,
+                          AnalyserRecord *out, char *detail, size_t detailCap);
+
+const char *format_status_text(FormatStatus st);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANALYSER_FORMATS_H
@@ -0,0 +1,220 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "analyser_record.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ===============================================================
+//  String pool: values live in a few large chunks instead of one
+//  malloc per field.
+// ===============================================================
+
+#define RECORD_POOL_CHUNK 2048
+
+struct RecordPoolChunk {
+    struct RecordPoolChunk *next;
+    size_t used, cap;
+    char   data[1];
+};
+
+static char *pool_strdup(AnalyserRecord *rec, const char *s) {
+    size_t need = strlen(s) + 1;
+
+    if (rec->arena) {
+        char *dst = (char *)arena_alloc(rec->arena, need);
+        if (dst) memcpy(dst, s, need);
+        return dst;
+    }
+
+    struct RecordPoolChunk *c = rec->pool;
+
+    if (!c || c->cap - c->used < need) {
+        size_t cap = need > RECORD_POOL_CHUNK ? need : RECORD_POOL_CHUNK;
+        c = (struct RecordPoolChunk *)malloc(sizeof(*c) + cap);
+        if (!c) return NULL;
+        c->next = rec->pool;
+        c->used = 0;
+        c->cap  = cap;
+        rec->pool = c;
+    }
+
+    char *dst = c->data + c->used;
+    memcpy(dst, s, need);
+    c->used += need;
+    return dst;
+}
+
+static void *grow_array(AnalyserRecord *rec, void *p, int oldCap, int newCap, size_t elem) {
+    if (rec->arena) {
+        return arena_grow(rec->arena, p, (size_t)oldCap * elem, (size_t)newCap * elem);
+    }
+    return realloc(p, (size_t)newCap * elem);
+}
+
+// ===============================================================
+//  Public API
+// ===============================================================
+
+void record_init(AnalyserRecord *rec, AnalyserKind kind) {
+    record_init_in(rec, kind, NULL);
+}
+
+void record_init_in(AnalyserRecord *rec, AnalyserKind kind, Arena *arena) {
+    memset(rec, 0, sizeof(*rec));
+    rec->kind = kind;
+    rec->mydataIsObject = (kind == ANALYSER_KIND_URINE);
+    rec->MachineID = "";
+    rec->MAC = "";
+    rec->arena = arena;
+}
+
+void record_free(AnalyserRecord *rec) {
+    if (!rec) return;
+
+    if (rec->arena) {
+        rec->items = NULL;
+        rec->fields = NULL;
+        rec->results = NULL;
+        rec->nitems = rec->capItems = 0;
+        rec->nfields = rec->capFields = 0;
+        rec->nresults = rec->capResults = 0;
+        return;
+    }
+
+    struct RecordPoolChunk *c = rec->pool;
+    while (c) {
+        struct RecordPoolChunk *next = c->next;
+        free(c);
+        c = next;
+    }
+
+    free(rec->items);
+    free(rec->fields);
+    free(rec->results);
+
+    rec->pool = NULL;
+    rec->items = NULL;
+    rec->fields = NULL;
+    rec->results = NULL;
+    rec->nitems = rec->capItems = 0;
+    rec->nfields = rec->capFields = 0;
+    rec->nresults = rec->capResults = 0;
+}
+
+int record_begin_item(AnalyserRecord *rec) {
+    if (rec->nitems >= rec->capItems) {
+        int cap = rec->capItems ? rec->capItems * 2 : 8;
+        RecordItem *p = (RecordItem *)grow_array(rec, rec->items, rec->capItems, cap, sizeof(*p));
+        if (!p) return 0;
+        rec->items = p;
+        rec->capItems = cap;
+    }
+
+    RecordItem *it = &rec->items[rec->nitems++];
+    it->firstField = rec->nfields;
+    it->nfields = 0;
+    return 1;
+}
+
+int record_add_field(AnalyserRecord *rec, const char *key, const char *value) {
+    if (rec->nitems == 0) return 0;
+
+    if (rec->nfields >= rec->capFields) {
+        int cap = rec->capFields ? rec->capFields * 2 : 32;
+        RecordField *p = (RecordField *)grow_array(rec, rec->fields, rec->capFields, cap, sizeof(*p));
+        if (!p) return 0;
+        rec->fields = p;
+        rec->capFields = cap;
+    }
+
+    const char *v = pool_strdup(rec, value ? value : "");
+    if (!v) return 0;
+
+    RecordField *f = &rec->fields[rec->nfields++];
+    f->key = key;
+    f->value = v;
+    f->result = -1;
+    rec->items[rec->nitems - 1].nfields++;
+    return 1;
+}
+
+ResultValue *record_add_result(AnalyserRecord *rec, const char *key, const char *text,
+                               const char *range, const char *flag) {
+    if (rec->nresults >= rec->capResults) {
+        int cap = rec->capResults ? rec->capResults * 2 : 32;
+        ResultValue *p = (ResultValue *)grow_array(rec, rec->results, rec->capResults, cap, sizeof(*p));
+        if (!p) return NULL;
+        rec->results = p;
+        rec->capResults = cap;
+    }
+
+    if (!record_add_field(rec, key, text)) return NULL;
+
+    RecordField *f = &rec->fields[rec->nfields - 1];
+    ResultValue *rv = &rec->results[rec->nresults];
+    f->result = rec->nresults++;
+    result_value_parse(rv, f->value, range, flag);
+    return rv;
+}
+
+const ResultValue *record_field_result(const AnalyserRecord *rec, const RecordField *f) {
+    if (!f || f->result < 0 || f->result >= rec->nresults) return NULL;
+    return &rec->results[f->result];
+}
+
+void record_set_identity(AnalyserRecord *rec, const char *MachineID, const char *MAC) {
+    rec->MachineID = MachineID ? MachineID : "";
+    rec->MAC = MAC ? MAC : "";
+}
+
+// ===============================================================
+//  Content hash: 64-bit FNV-1a over length-prefixed strings (so
+//  "ab","c" and "a","bc" differ), finished with a splitmix64 mix.
+// ===============================================================
+
+static uint64_t hash_bytes(uint64_t h, const void *p, size_t n) {
+    const unsigned char *b = (const unsigned char *)p;
+    for (size_t i = 0; i < n; i++) {
+        h ^= b[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Little-endian whatever the host, so keys match across machines.
+static uint64_t hash_u32(uint64_t h, uint32_t v) {
+    unsigned char b[4] = { (unsigned char)v, (unsigned char)(v >> 8),
+                           (unsigned char)(v >> 16), (unsigned char)(v >> 24) };
+    return hash_bytes(h, b, sizeof(b));
+}
+
+static uint64_t hash_str(uint64_t h, const char *s) {
+    if (!s) s = "";
+    size_t n = strlen(s);
+    h = hash_u32(h, (uint32_t)n);
+    return hash_bytes(h, s, n);
+}
+
+uint64_t record_content_hash(const AnalyserRecord *rec) {
+    uint64_t h = 14695981039346656037ull;
+    h = hash_u32(h, (uint32_t)rec->kind);
+    h = hash_str(h, rec->MachineID);
+    h = hash_str(h, rec->sampleId);
+    for (int i = 0; i < rec->nitems; i++) {
+        const RecordItem *it = &rec->items[i];
+        h = hash_u32(h, (uint32_t)it->nfields);
+        for (int k = 0; k < it->nfields; k++) {
+            const RecordField *f = &rec->fields[it->firstField + k];
+            h = hash_str(h, f->key);
+            h = hash_str(h, f->value);
+        }
+    }
+
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return h ? h : 1;
+}
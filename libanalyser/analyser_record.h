@@ -0,0 +1,119 @@
+#ifndef ANALYSER_RECORD_H
+#define ANALYSER_RECORD_H
+
+#include "arena.h"
+#include "result_value.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Which parser produced the record; also selects the upload endpoint.
+typedef enum {
+    ANALYSER_KIND_CBC     = 1,  // analyser_1: F200 CBC rows
+    ANALYSER_KIND_RESULTS = 2,  // analyser_2: H360 single result line
+    ANALYSER_KIND_URINE   = 3   // analyser_3: urine "\\SCAN" report
+} AnalyserKind;
+
+typedef struct {
+    const char *key;    // static string, never copied
+    const char *value;  // owned by the record's string pool
+    int         result; // index into AnalyserRecord.results, -1 for plain text
+} RecordField;
+
+typedef struct {
+    int firstField;     // index into AnalyserRecord.fields
+    int nfields;
+} RecordItem;
+
+struct RecordPoolChunk;
+
+/**
+ * Parsed analyser payload, independent of the wire encoding.
+ *
+ * "mydata" is a list of items, each a list of key/value string pairs.
+ * Urine reports carry a single item that is encoded as an object rather
+ * than an array (mydataIsObject).
+ */
+typedef struct {
+    AnalyserKind kind;
+    int          mydataIsObject;
+
+    RecordItem  *items;
+    int          nitems, capItems;
+
+    RecordField *fields;
+    int          nfields, capFields;
+
+    ResultValue *results;
+    int          nresults, capResults;
+
+    const char  *MachineID;
+    const char  *MAC;
+
+    char         sampleId[64];  // "" when the format does not carry one
+
+    struct RecordPoolChunk *pool;
+    Arena       *arena;         // NULL = heap; otherwise all storage is in here
+} AnalyserRecord;
+
+void record_init(AnalyserRecord *rec, AnalyserKind kind);
+
+/**
+ * Like record_init, but every array and string of the record is carved
+ * from 'arena' (NULL = heap). record_free() is then a no-op for storage;
+ * it goes away with arena_rewind()/arena_reset().
+ */
+void record_init_in(AnalyserRecord *rec, AnalyserKind kind, Arena *arena);
+
+/**
+ * Release everything owned by the record. Safe to call twice.
+ */
+void record_free(AnalyserRecord *rec);
+
+/**
+ * Start a new item in "mydata". Returns 1 on success, 0 on allocation failure.
+ */
+int record_begin_item(AnalyserRecord *rec);
+
+/**
+ * Append key/value to the current item. The value is copied (NULL -> "").
+ * Returns 1 on success, 0 on allocation failure or when no item is open.
+ */
+int record_add_field(AnalyserRecord *rec, const char *key, const char *value);
+
+/**
+ * Like record_add_field, but also parses the value into a typed ResultValue
+ * (number, qualifier, range, flag). 'range' and 'flag' are only used for
+ * parsing; add them as their own fields if they belong on the wire.
+ * Returns the new value (valid until the next add) or NULL on failure.
+ */
+ResultValue *record_add_result(AnalyserRecord *rec, const char *key, const char *text,
+                      const char *range, const char *flag);
+
+/**
+ * Typed value of a field added with record_add_result, NULL otherwise.
+ */
+const ResultValue *record_field_result(const AnalyserRecord *rec, const RecordField *f);
+
+/**
+ * MachineID/MAC are borrowed and must outlive the record.
+ */
+void record_set_identity(AnalyserRecord *rec, const char *MachineID, const char *MAC);
+
+/**
+ * Stable 64-bit hash of what the record says: kind, MachineID, sample ID
+ * and every item's keys and values, in order. The same report parsed
+ * twice (a retransmit, a second capture path) hashes the same; MAC and
+ * storage layout do not take part. Never returns 0.
+ */
+uint64_t record_content_hash(const AnalyserRecord *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANALYSER_RECORD_H
@@ -0,0 +1,128 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "analyser_upload.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <curl/curl.h>
+
+// ===============================================================
+//  HTTP (libcurl)
+// ===============================================================
+
+struct mem_sink { char *data; size_t size; Arena *arena; };
+
+static size_t write_cb(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t real = size * nmemb;
+    struct mem_sink *ms = (struct mem_sink *)userp;
+    char *ptr = ms->arena
+        ? (char *)arena_grow(ms->arena, ms->data, ms->data ? ms->size + 1 : 0, ms->size + real + 1)
+        : (char *)realloc(ms->data, ms->size + real + 1);
+    if (!ptr) return 0;
+    ms->data = ptr;
+    memcpy(ms->data + ms->size, contents, real);
+    ms->size += real;
+    ms->data[ms->size] = '\0';
+    return real;
+}
+
+int http_post_body(const char *url, const char *contentType,
+                   const char *body, size_t bodyLen, char **response_out) {
+    return http_post_body_in(NULL, url, contentType, body, bodyLen, response_out);
+}
+
+struct HttpPost {
+    CURL              *curl;
+    struct curl_slist *headers;
+    struct mem_sink    sink;
+};
+
+HttpPost *http_post_prepare(Arena *arena, const char *url, const char *contentType,
+                            const char *body, size_t bodyLen) {
+    HttpPost *p = (HttpPost *)calloc(1, sizeof(HttpPost));
+    if (!p) return NULL;
+    p->curl = curl_easy_init();
+    if (!p->curl) {
+        free(p);
+        return NULL;
+    }
+
+    char ctHeader[128];
+    snprintf(ctHeader, sizeof(ctHeader), "Content-Type: %s", contentType);
+    p->headers = curl_slist_append(NULL, ctHeader);
+    p->sink.arena = arena;
+
+    curl_easy_setopt(p->curl, CURLOPT_URL, url);
+    curl_easy_setopt(p->curl, CURLOPT_HTTPHEADER, p->headers);
+    curl_easy_setopt(p->curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(p->curl, CURLOPT_POSTFIELDS, body);
+    curl_easy_setopt(p->curl, CURLOPT_POSTFIELDSIZE, (long)bodyLen);
+    curl_easy_setopt(p->curl, CURLOPT_WRITEFUNCTION, write_cb);
+    curl_easy_setopt(p->curl, CURLOPT_WRITEDATA, &p->sink);
+    curl_easy_setopt(p->curl, CURLOPT_TIMEOUT, 30L);
+    // curl_easy_setopt(p->curl, CURLOPT_CAINFO, "cacert.pem");
+    return p;
+}
+
+void *http_post_easy(HttpPost *p) {
+    return p->curl;
+}
+
+int http_post_add_header(HttpPost *p, const char *header) {
+    struct curl_slist *h = curl_slist_append(p->headers, header);
+    if (!h) return 0;
+    p->headers = h;
+    curl_easy_setopt(p->curl, CURLOPT_HTTPHEADER, p->headers);
+    return 1;
+}
+
+long http_post_status(HttpPost *p, int curlResult) {
+    long code = 0;
+    if (curlResult == CURLE_OK) curl_easy_getinfo(p->curl, CURLINFO_RESPONSE_CODE, &code);
+    return code;
+}
+
+int http_post_finish(HttpPost *p, int curlResult, char **response_out) {
+    long code = http_post_status(p, curlResult);
+
+    if (response_out) *response_out = p->sink.data;
+    else if (!p->sink.arena) free(p->sink.data);
+    curl_slist_free_all(p->headers);
+    curl_easy_cleanup(p->curl);
+    free(p);
+
+    return (curlResult == CURLE_OK && code >= 200 && code < 300);
+}
+
+int http_post_body_in(Arena *arena, const char *url, const char *contentType,
+                      const char *body, size_t bodyLen, char **response_out) {
+    if (response_out) *response_out = NULL;
+
+    HttpPost *p = http_post_prepare(arena, url, contentType, body, bodyLen);
+    if (!p) return 0;
+
+    CURLcode res = curl_easy_perform((CURL *)http_post_easy(p));
+    return http_post_finish(p, (int)res, response_out);
+}
+
+// ===============================================================
+//  Record upload
+// ===============================================================
+
+int upload_record(const char *url, const RecordEncoder *enc,
+                  const AnalyserRecord *rec, char **response_out) {
+    if (response_out) *response_out = NULL;
+    if (!enc) enc = record_encoder_json();
+
+    ByteBuf body = {0};
+    if (!enc->encode(rec, &body)) {
+        bytebuf_free(&body);
+        return 0;
+    }
+
+    int ok = http_post_body(url, enc->contentType, body.data, body.len, response_out);
+    bytebuf_free(&body);
+    return ok;
+}
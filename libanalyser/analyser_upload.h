@@ -0,0 +1,68 @@
+#ifndef ANALYSER_UPLOAD_H
+#define ANALYSER_UPLOAD_H
+
+#include "analyser_record.h"
+#include "arena.h"
+#include "record_encoder.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * POST 'body' to 'url' with the given Content-Type (libcurl, 30 s timeout).
+ * Returns 1 on HTTP 2xx, 0 otherwise. *response_out (may be NULL)
+ * receives the response body, or NULL; the caller frees it.
+ * curl_global_init() must have been called.
+ */
+int http_post_body(const char *url, const char *contentType,
+                   const char *body, size_t bodyLen, char **response_out);
+
+/**
+ * http_post_body with the response buffer taken from 'arena' (NULL = heap).
+ * With an arena the caller must not free *response_out.
+ */
+int http_post_body_in(Arena *arena, const char *url, const char *contentType,
+                      const char *body, size_t bodyLen, char **response_out);
+
+/**
+ * http_post_body_in split in two, for callers that drive the transfer
+ * themselves (e.g. through a curl multi handle):
+ *
+ *   http_post_prepare()  builds the request; NULL on error
+ *   http_post_easy()     the CURL* easy handle (CURLOPT_PRIVATE is left free)
+ *   http_post_finish()   takes the transfer's CURLcode, frees the request and
+ *                        returns what http_post_body_in would have
+ *
+ * 'body' must stay valid until http_post_finish().
+ */
+typedef struct HttpPost HttpPost;
+
+HttpPost *http_post_prepare(Arena *arena, const char *url, const char *contentType,
+                            const char *body, size_t bodyLen);
+void     *http_post_easy(HttpPost *p);
+int       http_post_finish(HttpPost *p, int curlResult, char **response_out);
+
+/**
+ * Add a request header ("Name: value") to a prepared request, before the
+ * transfer starts. Returns 1 on success, 0 on allocation failure.
+ */
+int       http_post_add_header(HttpPost *p, const char *header);
+
+/** HTTP status of the response, 0 if none arrived. Before http_post_finish(). */
+long      http_post_status(HttpPost *p, int curlResult);
+
+/**
+ * Encode 'rec' with 'enc' (NULL = JSON) and POST it to 'url'.
+ * Same return convention as http_post_body.
+ */
+int upload_record(const char *url, const RecordEncoder *enc,
+                  const AnalyserRecord *rec, char **response_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANALYSER_UPLOAD_H
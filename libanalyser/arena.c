@@ -0,0 +1,174 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_DEFAULT_CHUNK (64 * 1024)
+#define ARENA_ALIGN         16
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t cap;
+    size_t used;
+    size_t pad_;                      // keeps data[] 16-byte aligned on 32-bit
+    unsigned char data[];
+} ArenaChunk;
+
+struct Arena {
+    ArenaChunk *first;
+    ArenaChunk *cur;
+    void       *last;                 // most recent allocation, for arena_grow
+    ArenaStats  st;
+    size_t      live;                 // bytes handed out since reset
+};
+
+static size_t align_up(size_t n) {
+    return (n + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static ArenaChunk *chunk_new(Arena *a, size_t cap) {
+    ArenaChunk *c = (ArenaChunk *)malloc(sizeof(ArenaChunk) + cap);
+    if (!c) return NULL;
+    c->next = NULL;
+    c->cap  = cap;
+    c->used = 0;
+    a->st.capacity += cap;
+    a->st.mallocs++;
+    return c;
+}
+
+Arena *arena_create(size_t initial) {
+    Arena *a = (Arena *)calloc(1, sizeof(Arena));
+    if (!a) return NULL;
+    a->first = chunk_new(a, initial ? align_up(initial) : ARENA_DEFAULT_CHUNK);
+    if (!a->first) {
+        free(a);
+        return NULL;
+    }
+    a->cur = a->first;
+    return a;
+}
+
+void arena_destroy(Arena *a) {
+    if (!a) return;
+    ArenaChunk *c = a->first;
+    while (c) {
+        ArenaChunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    free(a);
+}
+
+void *arena_alloc(Arena *a, size_t n) {
+    size_t need = align_up(n ? n : 1);
+    ArenaChunk *c = a->cur;
+
+    // Reuse the next chunk kept from an earlier job before asking the system
+    // for a new one; a new chunk is spliced in after the current one.
+    if (c->cap - c->used < need) {
+        if (c->next && c->next->used == 0 && c->next->cap >= need) {
+            c = c->next;
+        } else {
+            size_t cap = c->cap * 2;
+            if (cap < need) cap = align_up(need);
+            ArenaChunk *nc = chunk_new(a, cap);
+            if (!nc) return NULL;
+            nc->next = c->next;
+            c->next = nc;
+            c = nc;
+        }
+    }
+    a->cur = c;
+
+    void *p = c->data + c->used;
+    c->used += need;
+    a->last = p;
+
+    a->live += need;
+    a->st.allocs++;
+    a->st.bytes += n;
+    if (a->live > a->st.peakBytes) a->st.peakBytes = a->live;
+    if (a->st.peakBytes > a->st.highWater) a->st.highWater = a->st.peakBytes;
+    return p;
+}
+
+void *arena_grow(Arena *a, void *p, size_t oldSize, size_t newSize) {
+    if (!p) return arena_alloc(a, newSize);
+    if (newSize <= oldSize) return p;
+
+    ArenaChunk *c = a->cur;
+    if (p == a->last) {
+        size_t oldNeed = align_up(oldSize ? oldSize : 1);
+        size_t newNeed = align_up(newSize);
+        if (c->cap - c->used >= newNeed - oldNeed) {
+            c->used += newNeed - oldNeed;
+            a->live += newNeed - oldNeed;
+            a->st.bytes += newSize - oldSize;
+            if (a->live > a->st.peakBytes) a->st.peakBytes = a->live;
+            if (a->st.peakBytes > a->st.highWater) a->st.highWater = a->st.peakBytes;
+            return p;
+        }
+    }
+
+    void *q = arena_alloc(a, newSize);
+    if (!q) return NULL;
+    memcpy(q, p, oldSize);
+    return q;
+}
+
+ArenaMark arena_mark(Arena *a) {
+    a->st.peakBytes = a->live;
+
+    ArenaMark m;
+    m.chunk  = a->cur;
+    m.used   = a->cur->used;
+    m.allocs = a->st.allocs;
+    m.bytes  = a->live;
+    return m;
+}
+
+void arena_rewind(Arena *a, ArenaMark m) {
+    ArenaChunk *c = (ArenaChunk *)m.chunk;
+    for (ArenaChunk *k = c->next; k && k->used; k = k->next) k->used = 0;
+    c->used = m.used;
+    a->cur  = c;
+    a->last = NULL;
+    a->live = m.bytes;
+}
+
+void arena_reset(Arena *a) {
+    // Fold a multi-chunk arena into one chunk big enough for the whole job,
+    // so the next job is served from a single block.
+    if (a->first->next) {
+        size_t total = a->st.capacity;
+        ArenaChunk *one = chunk_new(a, total);
+        if (one) {
+            ArenaChunk *c = a->first;
+            while (c) {
+                ArenaChunk *next = c->next;
+                free(c);
+                c = next;
+            }
+            a->st.capacity = total;
+            a->first = one;
+        } else {
+            // keep the chain; it is still valid, just not folded
+            for (ArenaChunk *c = a->first; c; c = c->next) c->used = 0;
+        }
+    }
+    a->first->used = 0;
+    a->cur  = a->first;
+    a->last = NULL;
+    a->live = 0;
+    a->st.allocs = 0;
+    a->st.bytes = 0;
+    a->st.peakBytes = 0;
+    a->st.resets++;
+}
+
+void arena_stats(const Arena *a, ArenaStats *out) {
+    *out = a->st;
+}
@@ -0,0 +1,76 @@
+#ifndef ANALYSER_ARENA_H
+#define ANALYSER_ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Bump allocator for the per-file parse/encode/upload path.
+ *
+ * Allocations are carved from large chunks and never freed individually;
+ * arena_rewind() drops everything after a mark and arena_reset() drops
+ * everything. Chunks are kept for reuse, and a reset that needed more than
+ * one chunk folds them into a single chunk of the combined size, so a
+ * long-running process settles on one block per arena instead of
+ * fragmenting the heap with many short-lived mallocs.
+ *
+ * An arena is not thread-safe; give each worker thread its own.
+ */
+
+typedef struct Arena Arena;
+
+typedef struct {
+    void  *chunk;
+    size_t used;
+    size_t allocs;
+    size_t bytes;
+} ArenaMark;
+
+typedef struct {
+    size_t allocs;      // allocations since the last reset
+    size_t bytes;       // bytes handed out since the last reset
+    size_t peakBytes;   // most bytes live at once since the last mark/reset
+    size_t highWater;   // largest peakBytes over the arena's lifetime
+    size_t capacity;    // bytes held in chunks right now
+    size_t mallocs;     // chunk allocations from the system, lifetime
+    size_t resets;
+} ArenaStats;
+
+/** Create an arena whose first chunk holds 'initial' bytes (0 = 64 KB). */
+Arena *arena_create(size_t initial);
+
+/** Free every chunk. Safe to call with NULL (no-op). */
+void arena_destroy(Arena *a);
+
+/** 16-byte aligned allocation; NULL only if the system is out of memory. */
+void *arena_alloc(Arena *a, size_t n);
+
+/**
+ * Resize 'p' (previously 'oldSize' bytes from this arena) to 'newSize'.
+ * Grows in place when 'p' is the most recent allocation, copies otherwise.
+ * 'p' may be NULL.
+ */
+void *arena_grow(Arena *a, void *p, size_t oldSize, size_t newSize);
+
+/**
+ * Remember the current top of the arena and restart peakBytes from it, so
+ * peakBytes - mark.bytes is the footprint of the work done since the mark.
+ */
+ArenaMark arena_mark(Arena *a);
+
+/** Drop every allocation made after 'm'. */
+void arena_rewind(Arena *a, ArenaMark m);
+
+/** Drop every allocation (one operation per job/batch). */
+void arena_reset(Arena *a);
+
+void arena_stats(const Arena *a, ArenaStats *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANALYSER_ARENA_H
@@ -0,0 +1,138 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "file_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+// ===============================================================
+//  Small files: one read into the arena (or heap)
+// ===============================================================
+
+static int read_small(FileMap *fm, const char *path, size_t size, Arena *arena) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+
+    char *buf = arena ? (char *)arena_alloc(arena, size + 1) : (char *)malloc(size + 1);
+    if (!buf) { fclose(f); return 0; }
+
+    size_t rd = fread(buf, 1, size, f);
+    fclose(f);
+    buf[rd] = '\0';
+
+    fm->data  = buf;
+    fm->len   = rd;
+    fm->owned = (arena == NULL);
+    return 1;
+}
+
+// ===============================================================
+//  Public API
+// ===============================================================
+
+#ifdef _WIN32
+
+int file_map_open(FileMap *fm, const char *path, Arena *arena) {
+    memset(fm, 0, sizeof(*fm));
+
+    HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return 0;
+
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(hFile, &sz) || (unsigned long long)sz.QuadPart > (size_t)-1) {
+        CloseHandle(hFile);
+        return 0;
+    }
+    size_t size = (size_t)sz.QuadPart;
+
+    if (size < FILE_MAP_MIN_SIZE) {
+        CloseHandle(hFile);
+        return read_small(fm, path, size, arena);
+    }
+
+    HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!hMap) {
+        CloseHandle(hFile);
+        return read_small(fm, path, size, arena);
+    }
+    const char *view = (const char *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(hMap);
+        CloseHandle(hFile);
+        return read_small(fm, path, size, arena);
+    }
+
+    fm->data   = view;
+    fm->len    = size;
+    fm->mapped = 1;
+    fm->hFile  = hFile;
+    fm->hMap   = hMap;
+    return 1;
+}
+
+void file_map_close(FileMap *fm) {
+    if (fm->mapped) {
+        UnmapViewOfFile((LPCVOID)fm->data);
+        CloseHandle((HANDLE)fm->hMap);
+        CloseHandle((HANDLE)fm->hFile);
+    } else if (fm->owned) {
+        free((void *)fm->data);
+    }
+    memset(fm, 0, sizeof(*fm));
+}
+
+#else
+
+int file_map_open(FileMap *fm, const char *path, Arena *arena) {
+    memset(fm, 0, sizeof(*fm));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 0) {
+        close(fd);
+        return 0;
+    }
+    size_t size = (size_t)st.st_size;
+
+    if (size < FILE_MAP_MIN_SIZE) {
+        close(fd);
+        return read_small(fm, path, size, arena);
+    }
+
+    void *view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps its own reference
+    if (view == MAP_FAILED) return read_small(fm, path, size, arena);
+
+#ifdef MADV_SEQUENTIAL
+    madvise(view, size, MADV_SEQUENTIAL);
+#endif
+
+    fm->data   = (const char *)view;
+    fm->len    = size;
+    fm->mapped = 1;
+    return 1;
+}
+
+void file_map_close(FileMap *fm) {
+    if (fm->mapped) {
+        munmap((void *)fm->data, fm->len);
+    } else if (fm->owned) {
+        free((void *)fm->data);
+    }
+    memset(fm, 0, sizeof(*fm));
+}
+
+#endif
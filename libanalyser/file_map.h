@@ -0,0 +1,48 @@
+#ifndef ANALYSER_FILE_MAP_H
+#define ANALYSER_FILE_MAP_H
+
+#include "arena.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Files at least this large are memory-mapped; smaller ones are read into
+// a buffer, where the mapping setup would cost more than the copy.
+#define FILE_MAP_MIN_SIZE (64 * 1024)
+
+/**
+ * Read-only view of a whole file.
+ *
+ * Large files are mapped (mmap / MapViewOfFile), so the parser reads the
+ * page cache directly and nothing is copied. Small files are read once into
+ * the caller's arena (the worker's pooled buffer) or, without an arena, a
+ * heap buffer. 'data' is not NUL-terminated when mapped; use 'len'.
+ */
+typedef struct {
+    const char *data;
+    size_t      len;
+    int         mapped;     // 1 = mapping, 0 = buffer
+    int         owned;      // buffer is heap memory freed by file_map_close
+#ifdef _WIN32
+    void       *hFile;
+    void       *hMap;
+#endif
+} FileMap;
+
+/**
+ * Open 'path'. Returns 1 on success, 0 on error. 'arena' may be NULL.
+ * An empty file succeeds with len 0.
+ */
+int file_map_open(FileMap *fm, const char *path, Arena *arena);
+
+/** Unmap / release. Safe to call twice. */
+void file_map_close(FileMap *fm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANALYSER_FILE_MAP_H
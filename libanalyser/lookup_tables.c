@@ -0,0 +1,143 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "lookup_tables.h"
+#include "lookup_tables_gen.h"
+#include "perfect_hash.h"
+
+#include <string.h>
+
+// ===============================================================
+//  Tables (from lookup_tables.def; slots from lookup_tables_gen.h)
+// ===============================================================
+
+static const AnalyteInfo CBC_TESTS[] = {
+#define CBC_TEST(code, name, unit) { code, sizeof(code) - 1, name, unit },
+#include "lookup_tables.def"
+#undef CBC_TEST
+};
+
+static const size_t CBC_NAME_LENS[] = {
+#define CBC_TEST(code, name, unit) sizeof(name) - 1,
+#include "lookup_tables.def"
+#undef CBC_TEST
+};
+
+static const AnalyteInfo URINE_LABELS[] = {
+#define URINE_LABEL(label, name, unit) { label, sizeof(label) - 1, name, unit },
+#include "lookup_tables.def"
+#undef URINE_LABEL
+};
+
+static const UnitInfo UNITS[] = {
+#define UNIT(text, canonical, strip) { text, sizeof(text) - 1, canonical, strip },
+#include "lookup_tables.def"
+#undef UNIT
+};
+
+#define COUNT(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+static int slot_of(const signed char *slots, unsigned mask, unsigned seed,
+                   const char *s, size_t n) {
+    return slots[ph_hash(s, n, seed) & mask];
+}
+
+// ===============================================================
+//  CBC tests
+// ===============================================================
+
+int cbc_test_by_code(const char *s, size_t n) {
+    int id = slot_of(CBC_CODE_SLOTS, CBC_CODE_MASK, CBC_CODE_SEED, s, n);
+    if (id < 0 || CBC_TESTS[id].keyLen != n || memcmp(CBC_TESTS[id].key, s, n) != 0) return -1;
+    return id;
+}
+
+int cbc_test_by_name(const char *s, size_t n) {
+    int id = slot_of(CBC_NAME_SLOTS, CBC_NAME_MASK, CBC_NAME_SEED, s, n);
+    if (id < 0 || CBC_NAME_LENS[id] != n || memcmp(CBC_TESTS[id].name, s, n) != 0) return -1;
+    return id;
+}
+
+const AnalyteInfo *cbc_test_info(int id) {
+    return (id >= 0 && id < COUNT(CBC_TESTS)) ? &CBC_TESTS[id] : NULL;
+}
+
+int cbc_test_count(void) {
+    return COUNT(CBC_TESTS);
+}
+
+// ===============================================================
+//  Urine labels
+// ===============================================================
+
+int urine_label_lookup(const char *s, size_t n) {
+    int id = slot_of(URINE_LABEL_SLOTS, URINE_LABEL_MASK, URINE_LABEL_SEED, s, n);
+    if (id < 0 || URINE_LABELS[id].keyLen != n || memcmp(URINE_LABELS[id].key, s, n) != 0) return -1;
+    return id;
+}
+
+const AnalyteInfo *urine_label_info(int id) {
+    return (id >= 0 && id < COUNT(URINE_LABELS)) ? &URINE_LABELS[id] : NULL;
+}
+
+int urine_label_count(void) {
+    return COUNT(URINE_LABELS);
+}
+
+int urine_label_prefix(const char *row, size_t *labelLen) {
+    // labels are 2-3 characters; values may start with letters ("BLDNeg"),
+    // so try the longer prefix first
+    size_t avail = 0;
+    while (avail < 3 && row[avail]) avail++;
+
+    for (size_t n = avail; n >= 2; n--) {
+        int id = urine_label_lookup(row, n);
+        if (id >= 0) {
+            if (labelLen) *labelLen = n;
+            return id;
+        }
+    }
+    return -1;
+}
+
+// ===============================================================
+//  Units
+// ===============================================================
+
+int unit_lookup(const char *s, size_t n) {
+    int id = slot_of(UNIT_SLOTS, UNIT_MASK, UNIT_SEED, s, n);
+    if (id < 0 || UNITS[id].textLen != n || memcmp(UNITS[id].text, s, n) != 0) return -1;
+    return id;
+}
+
+const UnitInfo *unit_info(int id) {
+    return (id >= 0 && id < COUNT(UNITS)) ? &UNITS[id] : NULL;
+}
+
+size_t strip_units(const char *in, char *out, size_t cap, int *unitId) {
+    size_t n = strlen(in), w = 0;
+    int first = -1;
+
+    if (cap == 0) return 0;
+
+    for (size_t r = 0; r < n && w + 1 < cap; ) {
+        unsigned char c = (unsigned char)in[r];
+        if (UNIT_FIRST_BYTE[c >> 3] & (1u << (c & 7))) {
+            size_t maxLen = (n - r < UNIT_MAX_LEN) ? n - r : UNIT_MAX_LEN;
+            int id = -1;
+            size_t len = 0;
+            for (len = maxLen; len >= UNIT_MIN_LEN; len--) {
+                id = unit_lookup(in + r, len);
+                if (id >= 0) break;
+            }
+            if (id >= 0) {
+                if (first < 0) first = id;
+                if (UNITS[id].strip) { r += len; continue; }
+            }
+        }
+        out[w++] = in[r++];
+    }
+
+    out[w] = '\0';
+    if (unitId) *unitId = first;
+    return w;
+}
@@ -0,0 +1,58 @@
+#ifndef LOOKUP_TABLES_H
+#define LOOKUP_TABLES_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Static metadata for one analyte. IDs are dense, in lookup_tables.def order.
+typedef struct {
+    const char *key;    // test code (CBC) or row label (urine)
+    size_t      keyLen;
+    const char *name;   // canonical name
+    const char *unit;   // canonical unit, "" if unitless
+} AnalyteInfo;
+
+typedef struct {
+    const char *text;
+    size_t      textLen;
+    const char *canonical;
+    int         strip;  // 1 = removed from uploaded values
+} UnitInfo;
+
+// All lookups are O(1): one hash, one compare. They return -1 when unknown.
+int cbc_test_by_code(const char *s, size_t n);
+int cbc_test_by_name(const char *s, size_t n);
+const AnalyteInfo *cbc_test_info(int id);
+int cbc_test_count(void);
+
+// Upper bound on urine_label_count(), for stack arrays indexed by label ID.
+#define URINE_LABEL_MAX 16
+
+int urine_label_lookup(const char *s, size_t n);
+const AnalyteInfo *urine_label_info(int id);
+int urine_label_count(void);
+
+/**
+ * Identify the urine label a report row starts with ("GLU+-5.5mg/dl" -> GLU).
+ * Returns the label ID and stores its length in *labelLen, or -1.
+ */
+int urine_label_prefix(const char *row, size_t *labelLen);
+
+int unit_lookup(const char *s, size_t n);
+const UnitInfo *unit_info(int id);
+
+/**
+ * Single pass over 'in': copies it to 'out' (NUL-terminated, truncated to
+ * cap), dropping every unit marked strip=1. *unitId (may be NULL) receives
+ * the first unit recognised, or -1. Returns the number of bytes written.
+ */
+size_t strip_units(const char *in, char *out, size_t cap, int *unitId);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOOKUP_TABLES_H
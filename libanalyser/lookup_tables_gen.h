@@ -0,0 +1,46 @@
+// lookup_tables_gen.h
+// Generated by tools/gen_lookup_tables.c from lookup_tables.def. Do not edit.
+
+#ifndef LOOKUP_TABLES_GEN_H
+#define LOOKUP_TABLES_GEN_H
+
+#define CBC_CODE_SEED 0x00000003u
+#define CBC_CODE_MASK 63u
+static const signed char CBC_CODE_SLOTS[64] = {
+    -1, 18, 20, -1, -1, 1, 21, -1, 24, 14, -1, -1, -1, -1, 9, -1,
+    -1, -1, 5, 4, -1, 8, 15, -1, -1, 19, -1, -1, -1, -1, -1, 13,
+    7, 12, 0, 3, -1, 2, -1, -1, -1, 11, -1, -1, -1, -1, -1, 10,
+    -1, -1, 16, -1, 23, 22, 6, -1, -1, -1, -1, -1, -1, -1, -1, 17
+};
+
+#define CBC_NAME_SEED 0x00000139u
+#define CBC_NAME_MASK 63u
+static const signed char CBC_NAME_SLOTS[64] = {
+    14, 10, 8, 15, -1, -1, 17, -1, 22, 7, -1, -1, -1, 11, -1, -1,
+    -1, 21, -1, -1, -1, -1, -1, -1, 20, -1, 6, 23, 3, 13, -1, -1,
+    -1, -1, -1, -1, 4, 9, 19, -1, -1, -1, 18, -1, -1, -1, -1, -1,
+    -1, -1, -1, 24, -1, 2, 16, -1, -1, 12, 5, -1, 1, 0, -1, -1
+};
+
+#define URINE_LABEL_SEED 0x00000005u
+#define URINE_LABEL_MASK 31u
+static const signed char URINE_LABEL_SLOTS[32] = {
+    5, -1, -1, -1, -1, 9, -1, -1, 3, 4, -1, 6, -1, -1, -1, 0,
+    -1, -1, 2, -1, -1, -1, 7, -1, -1, 8, -1, -1, -1, 1, -1, -1
+};
+
+#define UNIT_SEED 0x0000000fu
+#define UNIT_MASK 31u
+static const signed char UNIT_SLOTS[32] = {
+    0, 6, -1, -1, 10, -1, 2, -1, -1, -1, -1, -1, 4, -1, -1, -1,
+    -1, 3, -1, 11, -1, 5, 8, -1, -1, -1, 7, 9, -1, -1, 1, -1
+};
+
+#define UNIT_MIN_LEN 3
+#define UNIT_MAX_LEN 7
+static const unsigned char UNIT_FIRST_BYTE[32] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x80, 0x20, 0x20, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+#endif // LOOKUP_TABLES_GEN_H
@@ -0,0 +1,30 @@
+#ifndef PERFECT_HASH_H
+#define PERFECT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Seeded FNV-1a with a final mix. Shared by the table generator
+// (tools/gen_lookup_tables.c) and the runtime lookups so both always
+// agree on slot numbers.
+static inline uint32_t ph_hash(const char *s, size_t n, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PERFECT_HASH_H
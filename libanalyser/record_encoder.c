@@ -0,0 +1,201 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "record_encoder.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ===============================================================
+//  ByteBuf
+// ===============================================================
+
+static int bb_reserve(ByteBuf *b, size_t extra) {
+    if (b->len + extra + 1 <= b->cap) return 1;
+    size_t newcap = (b->cap == 0 ? 1024 : b->cap * 2);
+    while (newcap < b->len + extra + 1) newcap *= 2;
+    char *p = b->arena ? (char *)arena_grow(b->arena, b->data, b->cap, newcap)
+                       : (char *)realloc(b->data, newcap);
+    if (!p) return 0;
+    b->data = p;
+    b->cap = newcap;
+    return 1;
+}
+
+static int bb_put(ByteBuf *b, const void *src, size_t n) {
+    if (!bb_reserve(b, n)) return 0;
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+    return 1;
+}
+
+static int bb_puts(ByteBuf *b, const char *s) {
+    return bb_put(b, s, strlen(s));
+}
+
+static int bb_byte(ByteBuf *b, unsigned char c) {
+    return bb_put(b, &c, 1);
+}
+
+void bytebuf_free(ByteBuf *b) {
+    if (!b) return;
+    if (!b->arena) free(b->data);
+    b->data = NULL;
+    b->len = b->cap = 0;
+}
+
+// ===============================================================
+//  JSON
+// ===============================================================
+
+// Same rules the uploader always used: escape backslash and quote,
+// drop control characters.
+static int json_str(ByteBuf *b, const char *s) {
+    size_t n = strlen(s);
+    if (!bb_reserve(b, n * 2 + 2)) return 0;
+
+    char *w = b->data + b->len;
+    *w++ = '"';
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '\\' || c == '"') {
+            *w++ = '\\';
+            *w++ = (char)c;
+        } else if (c >= 0x20) {
+            *w++ = (char)c;
+        }
+    }
+    *w++ = '"';
+
+    b->len = (size_t)(w - b->data);
+    b->data[b->len] = '\0';
+    return 1;
+}
+
+static int json_item(ByteBuf *b, const AnalyserRecord *rec, const RecordItem *it) {
+    int ok = bb_byte(b, '{');
+    for (int f = 0; f < it->nfields && ok; f++) {
+        const RecordField *fld = &rec->fields[it->firstField + f];
+        if (f > 0) ok = ok && bb_byte(b, ',');
+        ok = ok && json_str(b, fld->key);
+        ok = ok && bb_byte(b, ':');
+        ok = ok && json_str(b, fld->value);
+    }
+    return ok && bb_byte(b, '}');
+}
+
+static int encode_json(const AnalyserRecord *rec, ByteBuf *out) {
+    int ok = bb_puts(out, "{\"mydata\":");
+
+    if (rec->mydataIsObject) {
+        if (rec->nitems > 0) {
+            ok = ok && json_item(out, rec, &rec->items[0]);
+        } else {
+            ok = ok && bb_puts(out, "{}");
+        }
+    } else {
+        ok = ok && bb_byte(out, '[');
+        for (int i = 0; i < rec->nitems && ok; i++) {
+            if (i > 0) ok = ok && bb_byte(out, ',');
+            ok = ok && json_item(out, rec, &rec->items[i]);
+        }
+        ok = ok && bb_byte(out, ']');
+    }
+
+    ok = ok && bb_puts(out, ",\"MachineID\":");
+    ok = ok && json_str(out, rec->MachineID);
+    ok = ok && bb_puts(out, ",\"MAC\":");
+    ok = ok && json_str(out, rec->MAC);
+    return ok && bb_byte(out, '}');
+}
+
+// ===============================================================
+//  MessagePack
+// ===============================================================
+
+static int mp_be(ByteBuf *b, unsigned char tag, uint32_t v, int width) {
+    unsigned char tmp[5];
+    tmp[0] = tag;
+    for (int i = 0; i < width; i++) {
+        tmp[1 + i] = (unsigned char)(v >> (8 * (width - 1 - i)));
+    }
+    return bb_put(b, tmp, (size_t)width + 1);
+}
+
+static int mp_str(ByteBuf *b, const char *s) {
+    size_t n = strlen(s);
+    int ok;
+    if (n < 32)           ok = bb_byte(b, (unsigned char)(0xa0 | n));
+    else if (n < 0x100)   ok = mp_be(b, 0xd9, (uint32_t)n, 1);
+    else if (n < 0x10000) ok = mp_be(b, 0xda, (uint32_t)n, 2);
+    else                  ok = mp_be(b, 0xdb, (uint32_t)n, 4);
+    return ok && bb_put(b, s, n);
+}
+
+static int mp_map(ByteBuf *b, uint32_t n) {
+    if (n < 16)      return bb_byte(b, (unsigned char)(0x80 | n));
+    if (n < 0x10000) return mp_be(b, 0xde, n, 2);
+    return mp_be(b, 0xdf, n, 4);
+}
+
+static int mp_array(ByteBuf *b, uint32_t n) {
+    if (n < 16)      return bb_byte(b, (unsigned char)(0x90 | n));
+    if (n < 0x10000) return mp_be(b, 0xdc, n, 2);
+    return mp_be(b, 0xdd, n, 4);
+}
+
+static int mp_item(ByteBuf *b, const AnalyserRecord *rec, const RecordItem *it) {
+    int ok = mp_map(b, (uint32_t)it->nfields);
+    for (int f = 0; f < it->nfields && ok; f++) {
+        const RecordField *fld = &rec->fields[it->firstField + f];
+        ok = mp_str(b, fld->key) && mp_str(b, fld->value);
+    }
+    return ok;
+}
+
+static int encode_msgpack(const AnalyserRecord *rec, ByteBuf *out) {
+    int ok = mp_map(out, 3) && mp_str(out, "mydata");
+
+    if (rec->mydataIsObject) {
+        if (rec->nitems > 0) {
+            ok = ok && mp_item(out, rec, &rec->items[0]);
+        } else {
+            ok = ok && mp_map(out, 0);
+        }
+    } else {
+        ok = ok && mp_array(out, (uint32_t)rec->nitems);
+        for (int i = 0; i < rec->nitems && ok; i++) {
+            ok = mp_item(out, rec, &rec->items[i]);
+        }
+    }
+
+    ok = ok && mp_str(out, "MachineID") && mp_str(out, rec->MachineID);
+    ok = ok && mp_str(out, "MAC") && mp_str(out, rec->MAC);
+    return ok;
+}
+
+// ===============================================================
+//  Registry
+// ===============================================================
+
+static const RecordEncoder JSON_ENCODER = {
+    "json", "application/json", encode_json
+};
+
+static const RecordEncoder MSGPACK_ENCODER = {
+    "msgpack", "application/msgpack", encode_msgpack
+};
+
+const RecordEncoder *record_encoder_json(void) {
+    return &JSON_ENCODER;
+}
+
+const RecordEncoder *record_encoder_msgpack(void) {
+    return &MSGPACK_ENCODER;
+}
+
+const RecordEncoder *record_encoder_by_name(const char *name) {
+    if (name && strcmp(name, MSGPACK_ENCODER.name) == 0) return &MSGPACK_ENCODER;
+    return &JSON_ENCODER;
+}
@@ -0,0 +1,51 @@
+#ifndef RECORD_ENCODER_H
+#define RECORD_ENCODER_H
+
+#include "analyser_record.h"
+#include "arena.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Growable output buffer. Always NUL-terminated so text encodings can be
+// handed to APIs that expect C strings. Set 'arena' before the first write
+// to grow inside an arena instead of the heap (bytebuf_free is then a no-op
+// for the storage).
+typedef struct {
+    char  *data;
+    size_t len;
+    size_t cap;
+    Arena *arena;
+} ByteBuf;
+
+void bytebuf_free(ByteBuf *b);
+
+/**
+ * One wire encoding of an AnalyserRecord.
+ * encode() appends to 'out' and returns 1 on success, 0 on allocation failure.
+ */
+typedef struct {
+    const char *name;         // "json", "msgpack"
+    const char *contentType;  // sent as the HTTP Content-Type header
+    int (*encode)(const AnalyserRecord *rec, ByteBuf *out);
+} RecordEncoder;
+
+// Default: the JSON text the backend has always received.
+const RecordEncoder *record_encoder_json(void);
+
+// MessagePack with the same keys and nesting as the JSON form.
+const RecordEncoder *record_encoder_msgpack(void);
+
+/**
+ * Look up an encoder by name ("json", "msgpack"). NULL or unknown -> JSON.
+ */
+const RecordEncoder *record_encoder_by_name(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RECORD_ENCODER_H
@@ -0,0 +1,214 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "result_value.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// ===============================================================
+//  Decimal parsing
+//  Fast path: up to 19 significant digits and a power of ten that
+//  is exactly representable -> one multiply/divide, exact result.
+//  Never consults the C locale, so "1.020" parses the same on a
+//  German Windows install.
+// ===============================================================
+
+static const double POW10[23] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+size_t parse_decimal(const char *s, size_t n, double *out) {
+    size_t i = 0;
+    int neg = 0;
+
+    if (i < n && (s[i] == '-' || s[i] == '+')) {
+        neg = (s[i] == '-');
+        i++;
+    }
+
+    uint64_t mant = 0;
+    int digits = 0, sig = 0, exp10 = 0;
+
+    while (i < n && is_digit(s[i])) {
+        if (sig < 19) {
+            mant = mant * 10 + (uint64_t)(s[i] - '0');
+            if (mant) sig++;
+        } else {
+            exp10++;
+        }
+        digits++;
+        i++;
+    }
+
+    if (i < n && s[i] == '.') {
+        i++;
+        while (i < n && is_digit(s[i])) {
+            if (sig < 19) {
+                mant = mant * 10 + (uint64_t)(s[i] - '0');
+                if (mant) sig++;
+                exp10--;
+            }
+            digits++;
+            i++;
+        }
+    }
+
+    if (digits == 0) return 0;
+
+    // exponent only counts if at least one digit follows
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+        size_t j = i + 1;
+        int eneg = 0, e = 0;
+        if (j < n && (s[j] == '-' || s[j] == '+')) {
+            eneg = (s[j] == '-');
+            j++;
+        }
+        if (j < n && is_digit(s[j])) {
+            while (j < n && is_digit(s[j])) {
+                if (e < 10000) e = e * 10 + (s[j] - '0');
+                j++;
+            }
+            exp10 += eneg ? -e : e;
+            i = j;
+        }
+    }
+
+    double v = (double)mant;
+    if (mant == 0) {
+        v = 0.0;
+    } else if (mant <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+        v = exp10 < 0 ? v / POW10[-exp10] : v * POW10[exp10];
+    } else {
+        // rare: long mantissa or extreme exponent; good enough for lab values
+        while (exp10 > 22)  { v *= 1e22; exp10 -= 22; }
+        while (exp10 < -22) { v /= 1e22; exp10 += 22; }
+        v = exp10 < 0 ? v / POW10[-exp10] : v * POW10[exp10];
+    }
+
+    *out = neg ? -v : v;
+    return i;
+}
+
+// ===============================================================
+//  Helpers
+// ===============================================================
+
+static const char *skip_spaces(const char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    return s;
+}
+
+static int prefix_icase(const char *s, const char *word) {
+    for (; *word; s++, word++) {
+        char a = *s, b = *word;
+        if (a >= 'A' && a <= 'Z') a = (char)(a - 'A' + 'a');
+        if (a != b) return 0;
+    }
+    return 1;
+}
+
+static void parse_range(ResultValue *rv, const char *range) {
+    const char *p = skip_spaces(range);
+    size_t n = strlen(p);
+    double lo = 0, hi = 0;
+
+    if (*p == '<' || *p == '>') {
+        int lt = (*p == '<');
+        p++;
+        if (*p == '=') p++;
+        p = skip_spaces(p);
+        if (!parse_decimal(p, strlen(p), &hi)) return;
+        rv->rangeLow  = lt ? -INFINITY : hi;
+        rv->rangeHigh = lt ? hi : INFINITY;
+        rv->hasRange  = 1;
+        return;
+    }
+
+    size_t used = parse_decimal(p, n, &lo);
+    if (!used) return;
+    p = skip_spaces(p + used);
+    if (*p != '-' && *p != '~') return;
+    p = skip_spaces(p + 1);
+    if (!parse_decimal(p, strlen(p), &hi)) return;
+
+    rv->rangeLow  = lo;
+    rv->rangeHigh = hi;
+    rv->hasRange  = 1;
+}
+
+// ===============================================================
+//  Public API
+// ===============================================================
+
+ResultFlag result_flag_from_text(const char *flag) {
+    if (!flag) return RESULT_FLAG_NONE;
+    flag = skip_spaces(flag);
+    size_t n = strlen(flag);
+    while (n > 0 && (flag[n - 1] == ' ' || flag[n - 1] == '\r')) n--;
+
+    if (n == 0) return RESULT_FLAG_NONE;
+    if (n == 1 && flag[0] == 'N') return RESULT_FLAG_NORMAL;
+    if (n == 1 && flag[0] == 'L') return RESULT_FLAG_LOW;
+    if (n == 1 && flag[0] == 'H') return RESULT_FLAG_HIGH;
+    if (n == 2 && flag[0] == 'L' && flag[1] == 'L') return RESULT_FLAG_CRIT_LOW;
+    if (n == 2 && flag[0] == 'H' && flag[1] == 'H') return RESULT_FLAG_CRIT_HIGH;
+    return RESULT_FLAG_ABNORMAL;
+}
+
+void result_value_parse(ResultValue *rv, const char *text,
+                        const char *range, const char *flag) {
+    memset(rv, 0, sizeof(*rv));
+    rv->text = text ? text : "";
+    rv->analyte = -1;
+    rv->unit = -1;
+
+    const char *p = skip_spaces(rv->text);
+
+    if (p[0] == '<' || p[0] == '>') {
+        int eq = (p[1] == '=');
+        if (p[0] == '<') rv->qualifier = eq ? RESULT_QUAL_LE : RESULT_QUAL_LT;
+        else             rv->qualifier = eq ? RESULT_QUAL_GE : RESULT_QUAL_GT;
+        p += eq ? 2 : 1;
+    } else if (p[0] == '+' && p[1] == '-') {
+        rv->qualifier = RESULT_QUAL_TRACE;
+        p += 2;
+    } else if (is_digit(p[0]) && p[1] == '+') {
+        rv->qualifier = RESULT_QUAL_PLUS;
+        rv->plusCount = (unsigned char)(p[0] - '0');
+        p += 2;
+    } else if (p[0] == '+') {
+        rv->qualifier = RESULT_QUAL_PLUS;
+        while (*p == '+') { rv->plusCount++; p++; }
+    } else if (prefix_icase(p, "neg")) {
+        rv->qualifier = RESULT_QUAL_NEG;
+        while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) p++;
+    } else if (prefix_icase(p, "norm")) {
+        rv->qualifier = RESULT_QUAL_NORMAL;
+        while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) p++;
+    } else if (prefix_icase(p, "tr")) {
+        rv->qualifier = RESULT_QUAL_TRACE;
+        while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) p++;
+    } else if (p[0] == '-' && !is_digit(p[1]) && p[1] != '.') {
+        rv->qualifier = RESULT_QUAL_NEG;
+        p++;
+    }
+
+    p = skip_spaces(p);
+    if (parse_decimal(p, strlen(p), &rv->value)) rv->hasValue = 1;
+
+    if (range && *range) parse_range(rv, range);
+
+    rv->flag = (unsigned char)result_flag_from_text(flag);
+    if (rv->flag == RESULT_FLAG_NONE && rv->hasValue && rv->hasRange &&
+        rv->qualifier == RESULT_QUAL_NONE) {
+        if (rv->value < rv->rangeLow)       rv->flag = RESULT_FLAG_LOW;
+        else if (rv->value > rv->rangeHigh) rv->flag = RESULT_FLAG_HIGH;
+        else                                rv->flag = RESULT_FLAG_NORMAL;
+    }
+}
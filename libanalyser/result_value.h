@@ -0,0 +1,73 @@
+#ifndef RESULT_VALUE_H
+#define RESULT_VALUE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Prefix/marker that came with the number, e.g. "<0.5", "2+", "Neg".
+typedef enum {
+    RESULT_QUAL_NONE = 0,
+    RESULT_QUAL_LT,        // "<"
+    RESULT_QUAL_LE,        // "<="
+    RESULT_QUAL_GT,        // ">"
+    RESULT_QUAL_GE,        // ">="
+    RESULT_QUAL_PLUS,      // "+", "2+", "+++" (see plusCount)
+    RESULT_QUAL_TRACE,     // "+-" / "Trace"
+    RESULT_QUAL_NEG,       // "Neg", "-"
+    RESULT_QUAL_NORMAL     // "Normal"
+} ResultQualifier;
+
+typedef enum {
+    RESULT_FLAG_NONE = 0,  // no flag text and nothing to derive it from
+    RESULT_FLAG_NORMAL,    // "N" or value inside the range
+    RESULT_FLAG_LOW,       // "L"
+    RESULT_FLAG_HIGH,      // "H"
+    RESULT_FLAG_CRIT_LOW,  // "LL"
+    RESULT_FLAG_CRIT_HIGH, // "HH"
+    RESULT_FLAG_ABNORMAL,  // "A" or any other non-empty flag
+} ResultFlag;
+
+/**
+ * One analyser result parsed once at the edge.
+ * 'text' is the original string, kept for fidelity; it is borrowed from
+ * whoever owns the record.
+ */
+typedef struct {
+    double        value;
+    double        rangeLow;
+    double        rangeHigh;
+    const char   *text;
+    int           analyte;     // dense ID from lookup_tables.h, -1 if unknown
+    int           unit;        // unit ID from lookup_tables.h, -1 if unknown
+    unsigned char hasValue;
+    unsigned char hasRange;
+    unsigned char qualifier;   // ResultQualifier
+    unsigned char plusCount;   // for RESULT_QUAL_PLUS
+    unsigned char flag;        // ResultFlag
+} ResultValue;
+
+/**
+ * Locale-independent decimal parser ("-12.5", "1.020", "4e3").
+ * Reads at most n bytes of s. Returns the number of bytes consumed,
+ * 0 if s does not start with a number.
+ */
+size_t parse_decimal(const char *s, size_t n, double *out);
+
+/**
+ * Parse result text plus optional reference range ("4.00-10.00", "<5")
+ * and flag text ("H", "L", "N"). Any argument may be NULL or "".
+ * When no flag text is given the flag is derived from value and range.
+ */
+void result_value_parse(ResultValue *rv, const char *text,
+                        const char *range, const char *flag);
+
+ResultFlag result_flag_from_text(const char *flag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RESULT_VALUE_H
@@ -0,0 +1,174 @@
+// archive_test.c
+// Checks combain's result archive (combain/archive.h): results written
+// through the archive writer are sealed into segments at the size limit
+// and found again by sample, machine, test and time; compaction deflates
+// the sealed segments and every lookup still returns the same bytes.
+//
+// Build (from repo root):
+//   gcc -O2 -Ilibanalyser -Icombain -o tests/archive_test tests/archive_test.c combain/archive.c combain/archive_store.c combain/logger.c combain/spsc_queue.c combain/monotime.c libanalyser/*.c -lcurl -lpthread -lz
+// Run (writes and removes archive_test.tmp/ in the current folder):
+//   ./tests/archive_test
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "analyser.h"
+#include "archive.h"
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #define rmdir _rmdir
+#else
+    #include <unistd.h>
+#endif
+
+#define ARCHIVE_DIR "archive_test.tmp"
+#define RESULTS     700
+#define BODY_BYTES  3000   // 700 x 3 KB: one 1 MB segment is sealed, then another
+
+static void remove_one(const char *path, const char *name, void *ctx) {
+    (void)name;
+    (void)ctx;
+    remove(path);
+}
+
+static void remove_archive(void) {
+    static const char *const EXTS[] = { ".cbd", ".cbz", ".cbi", ".cbs", ".tmp" };
+    for (size_t i = 0; i < sizeof(EXTS) / sizeof(EXTS[0]); i++) {
+        analyser_scan_dir(ARCHIVE_DIR, EXTS[i], remove_one, NULL);
+    }
+    rmdir(ARCHIVE_DIR);
+}
+
+// Result n: its sample, machine, test and a body that says which it is.
+static void make_body(int n, char *body, size_t cap) {
+    int len = snprintf(body, cap, "{\"sample\":\"S-%04d\",\"values\":[", n);
+    while ((size_t)len + 16 < cap) len += snprintf(body + len, cap - (size_t)len, "%d.%d,", n % 97, len % 10);
+    snprintf(body + len, cap - (size_t)len, "0]}");
+}
+
+static void write_results(unsigned long long t0) {
+    CHECK(archive_open(ARCHIVE_DIR, 1, 0));
+    static char body[BODY_BYTES];
+    for (int n = 0; n < RESULTS; n++) {
+        char sample[16];
+        snprintf(sample, sizeof(sample), "S-%04d", n);
+        make_body(n, body, sizeof(body));
+
+        ArchiveRecord rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.timeMs = t0 + (unsigned long long)n * 1000;
+        rec.kind = n % 2 ? ANALYSER_KIND_CBC : ANALYSER_KIND_RESULTS;
+        rec.key = 0x1000 + (uint64_t)n;
+        rec.sampleId = sample;
+        rec.machineId = n % 3 ? "MC0003" : "MC0007";
+        rec.mac = "00:11:22:33:44:55";
+        rec.contentType = "application/json";
+        rec.tests = n % 2 ? "HGB,Hemoglobin,WBC" : "GLU";
+        rec.body = body;
+        rec.bodyLen = strlen(body);
+        archive_append(&rec);
+    }
+    archive_close();   // writes out the queue
+}
+
+typedef struct {
+    long n;
+    int  bad;   // a record that is not the result it claims to be
+} Visit;
+
+static int check_record(void *ctx, const ArchiveRecord *rec) {
+    Visit *v = (Visit *)ctx;
+    int n = atoi(rec->sampleId + 2);
+    char body[BODY_BYTES];
+    make_body(n, body, sizeof(body));
+    if (rec->bodyLen != strlen(body) || memcmp(rec->body, body, rec->bodyLen) != 0 ||
+        rec->key != 0x1000 + (uint64_t)n || strcmp(rec->contentType, "application/json") != 0) {
+        v->bad++;
+    }
+    v->n++;
+    return 1;
+}
+
+static long query(ArchiveReader *ar, const char *sample, const char *machine, const char *test,
+                  unsigned long long fromMs, unsigned long long toMs, int *bad) {
+    ArchiveQuery q;
+    memset(&q, 0, sizeof(q));
+    q.sampleId = sample;
+    q.machineId = machine;
+    q.test = test;
+    q.fromMs = fromMs;
+    q.toMs = toMs;
+    Visit v = { 0, 0 };
+    long n = archive_query(ar, &q, check_record, &v);
+    *bad += v.bad;
+    return n == v.n ? n : -1;
+}
+
+// The same answers before and after compaction.
+static void check_lookups(unsigned long long t0) {
+    ArchiveReader *ar = archive_reader_open(ARCHIVE_DIR);
+    CHECK(ar != NULL);
+    if (!ar) return;
+
+    int bad = 0;
+    CHECK(query(ar, NULL, NULL, NULL, 0, 0, &bad) == RESULTS);
+    CHECK(query(ar, "S-0000", NULL, NULL, 0, 0, &bad) == 1);         // first segment
+    CHECK(query(ar, "S-0345", NULL, NULL, 0, 0, &bad) == 1);
+    CHECK(query(ar, "S-0699", NULL, NULL, 0, 0, &bad) == 1);         // last, unsealed
+    CHECK(query(ar, "S-9999", NULL, NULL, 0, 0, &bad) == 0);
+    CHECK(query(ar, NULL, "MC0007", NULL, 0, 0, &bad) == (RESULTS + 2) / 3);
+    CHECK(query(ar, NULL, NULL, "WBC", 0, 0, &bad) == RESULTS / 2);
+    CHECK(query(ar, NULL, NULL, "Hemoglobin", 0, 0, &bad) == RESULTS / 2);
+    CHECK(query(ar, NULL, "MC0007", "GLU", 0, 0, &bad) == 117);      // n % 6 == 0
+    CHECK(query(ar, NULL, NULL, NULL, t0 + 100000, t0 + 110000, &bad) == 10);
+    CHECK(bad == 0);
+    CHECK(archive_reader_damaged(ar) == 0);
+    archive_reader_close(ar);
+}
+
+int main(void) {
+    remove_archive();
+    unsigned long long t0 = archive_now_ms() - 86400000ull;
+    write_results(t0);
+
+    ArchiveStats st;
+    ArchiveReader *ar = archive_reader_open(ARCHIVE_DIR);
+    CHECK(ar != NULL);
+    if (ar) {
+        archive_stats(ar, &st);
+        archive_reader_close(ar);
+        CHECK(st.records == RESULTS);
+        CHECK(st.segments >= 2);
+        CHECK(st.sealed == st.segments - 1);   // all but the one being written
+        CHECK(st.compacted == 0);
+        CHECK(st.firstMs == t0 && st.lastMs == t0 + (RESULTS - 1) * 1000ull);
+    }
+    check_lookups(t0);
+
+    char err[256] = "";
+    int compacted = archive_compact(ARCHIVE_DIR, archive_now_ms() + 1000, err, sizeof(err));
+    if (compacted < 0) fprintf(stderr, "  compaction: %s\n", err);
+    CHECK(compacted == st.sealed);
+    CHECK(archive_compact(ARCHIVE_DIR, archive_now_ms() + 1000, err, sizeof(err)) == 0);   // done already
+
+    ArchiveStats after;
+    ar = archive_reader_open(ARCHIVE_DIR);
+    CHECK(ar != NULL);
+    if (ar) {
+        archive_stats(ar, &after);
+        archive_reader_close(ar);
+        CHECK(after.records == RESULTS);
+        CHECK(after.compacted == st.sealed);
+        CHECK(after.rawBytes == st.rawBytes);
+        CHECK(after.storedBytes < st.storedBytes);
+    }
+    check_lookups(t0);
+
+    remove_archive();
+    return check_done("archive_test");
+}
@@ -0,0 +1,25 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+// Shared by the programs in tests/: CHECK() reports a failed condition
+// with its file and line and keeps going; check_done() prints the
+// "<name>: ok" / "<name>: FAILED" summary and gives main's exit code.
+
+#include <stdio.h>
+
+static int g_failed;
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if (!(cond)) {                                                                \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);  \
+            g_failed++;                                                               \
+        }                                                                             \
+    } while (0)
+
+static int check_done(const char *name) {
+    printf("%s: %s\n", name, g_failed ? "FAILED" : "ok");
+    return g_failed ? 1 : 0;
+}
+
+#endif // TESTS_CHECK_H
@@ -0,0 +1,111 @@
+// config_test.c
+// Checks combain's INI loader (combain/config.h): inline comments are cut
+// only where whitespace precedes the ';' or '#', so URLs and ASTM
+// signatures keep theirs; per-peer keys; and the shipped example config
+// loads as it is.
+//
+// Build (from repo root):
+//   gcc -O2 -Icombain -o tests/config_test tests/config_test.c combain/config.c combain/logger.c combain/spsc_queue.c combain/monotime.c -lpthread
+// Run from repo root (writes and removes config_test.ini there):
+//   ./tests/config_test
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "config.h"
+#include "check.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define CONFIG_FILE  "config_test.ini"
+#define EXAMPLE_FILE "combain/combain.example.ini"
+
+static CombainConfig g_cfg;   // large: keep it off the stack
+
+static int load(const char *text, char *err, size_t errcap) {
+    FILE *f = fopen(CONFIG_FILE, "w");
+    if (!f) return -2;
+    fputs(text, f);
+    fclose(f);
+    int rc = config_load(&g_cfg, CONFIG_FILE, err, errcap);
+    remove(CONFIG_FILE);
+    return rc;
+}
+
+static void test_comments(void) {
+    char err[256];
+    // No whitespace before the '#': it is part of the value, which is then
+    // not a number.
+    int rc = load("; a comment line\n"
+                  "# another\n"
+                  "[general]\n"
+                  "scan_batch = 32# note\n",
+                  err, sizeof(err));
+    CHECK(rc == -1);
+    CHECK(strstr(err, "line 4") != NULL);
+
+    rc = load("[general]\n"
+              "scan_dir = ./ss   ; trailing note\n"
+              "priority_tests = K, TROP\t# tab before it\n"
+              "priority_stat_marker = ;\n"
+              "priority_aging_s = 0   ; strict order\n"
+              "[endpoints]\n"
+              "cbc = https://lis.example/api#v2   ; the fragment stays\n"
+              "results = https://lis.example/r;jsessionid=1\n",
+              err, sizeof(err));
+    CHECK(rc == 1);
+    if (rc != 1) {
+        fprintf(stderr, "  %s\n", err);
+        return;
+    }
+    CHECK(strcmp(g_cfg.scanDir, "./ss") == 0);
+    CHECK(strcmp(g_cfg.priorityTests, "K, TROP") == 0);
+    CHECK(strcmp(g_cfg.priorityStatMarker, "") == 0);
+    CHECK(g_cfg.priorityAgingS == 0);
+    CHECK(strcmp(g_cfg.endpoints[1], "https://lis.example/api#v2") == 0);
+    CHECK(strcmp(g_cfg.endpoints[2], "https://lis.example/r;jsessionid=1") == 0);
+}
+
+static void test_peers(void) {
+    char err[256];
+    int rc = load("[listener lis]\n"
+                  "mode = server\n"
+                  "port = 50010\n"
+                  "out = ss/out_lis.txt\n"
+                  "peer_sig = h360 H|\\^&|||H360 ; ASTM header\n"
+                  "peer_addr = h360 10.0.0.7\n"
+                  "peer_machine_id = h360 MC0011\n"
+                  "peer_cbc = f200 https://lis.example/f200#x\n",
+                  err, sizeof(err));
+    CHECK(rc == 1);
+    if (rc != 1) {
+        fprintf(stderr, "  %s\n", err);
+        return;
+    }
+    CHECK(g_cfg.nlisteners == 1);
+    const ListenerSpec *l = &g_cfg.listeners[0];
+    CHECK(l->server && strcmp(l->host, "0.0.0.0") == 0);
+    CHECK(l->npeers == 3);
+    CHECK(strcmp(l->peers[0].name, "h360") == 0);
+    CHECK(strcmp(l->peers[0].signature, "H|\\^&|||H360") == 0);
+    CHECK(strcmp(l->peers[0].id.machineId, "MC0011") == 0);   // on the peer's first rule
+    CHECK(strcmp(l->peers[1].name, "h360") == 0 && strcmp(l->peers[1].address, "10.0.0.7") == 0);
+    CHECK(!l->peers[1].id.machineId[0]);
+    CHECK(strcmp(l->peers[2].name, "f200") == 0);
+    CHECK(!l->peers[2].address[0] && !l->peers[2].signature[0]);
+    CHECK(strcmp(l->peers[2].id.endpoints[1], "https://lis.example/f200#x") == 0);
+}
+
+static void test_example(void) {
+    char err[256] = "";
+    int rc = config_load(&g_cfg, EXAMPLE_FILE, err, sizeof(err));
+    CHECK(rc == 1);
+    if (rc != 1) fprintf(stderr, "  %s: %s\n", EXAMPLE_FILE, rc == 0 ? "not found (run from repo root)" : err);
+}
+
+int main(void) {
+    test_comments();
+    test_peers();
+    test_example();
+    return check_done("config_test");
+}
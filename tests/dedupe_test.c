@@ -0,0 +1,140 @@
+// dedupe_test.c
+// Checks combain/dedupe.h: which records get an idempotency key and when
+// two records share one, and that the index answers like a plain scan of
+// the last 'capacity' keys across ring wraps, reopening and resizing.
+//
+// Build (from repo root):
+//   gcc -O2 -Ilibanalyser -Icombain -o tests/dedupe_test tests/dedupe_test.c combain/dedupe.c combain/logger.c combain/spsc_queue.c combain/monotime.c libanalyser/*.c -lcurl -lpthread
+// Run (writes and removes dedupe_test.idx in the current folder):
+//   ./tests/dedupe_test
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "analyser.h"
+#include "dedupe.h"
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_FILE "dedupe_test.idx"
+
+// A CBC-like record: 'n' results, 'hgb' as the value of the first.
+static void make_record(AnalyserRecord *rec, const char *sampleId, int n, const char *hgb) {
+    static const char *const CODES[] = { "HGB", "WBC", "RBC", "PLT", "HCT", "MCV" };
+    record_init(rec, ANALYSER_KIND_CBC);
+    record_set_identity(rec, "MC0003", "00:11:22:33:44:55");
+    snprintf(rec->sampleId, sizeof(rec->sampleId), "%s", sampleId);
+    for (int i = 0; i < n; i++) {
+        record_begin_item(rec);
+        record_add_field(rec, "test_code", CODES[i]);
+        record_add_result(rec, "value", i == 0 ? hgb : "4.2", NULL, NULL);
+    }
+}
+
+static uint64_t key_of(const char *sampleId, int n, const char *hgb) {
+    AnalyserRecord rec;
+    make_record(&rec, sampleId, n, hgb);
+    uint64_t key = dedupe_key(&rec);
+    record_free(&rec);
+    return key;
+}
+
+static void test_keys(void) {
+    // Keyless: nothing tells one patient's "GLU 5.6" from another's.
+    CHECK(key_of("", 1, "9.8") == 0);
+    CHECK(key_of("", DEDUPE_MIN_RESULTS - 1, "9.8") == 0);
+
+    // A sample ID, or enough values, identify a result.
+    CHECK(key_of("S-1001", 1, "9.8") != 0);
+    CHECK(key_of("", DEDUPE_MIN_RESULTS, "9.8") != 0);
+
+    // The same report twice hashes the same; any other content does not.
+    CHECK(key_of("S-1001", 5, "9.8") == key_of("S-1001", 5, "9.8"));
+    CHECK(key_of("S-1001", 5, "9.8") != key_of("S-1002", 5, "9.8"));
+    CHECK(key_of("S-1001", 5, "9.8") != key_of("S-1001", 5, "9.9"));
+    CHECK(key_of("S-1001", 5, "9.8") != key_of("S-1001", 4, "9.8"));
+
+    // The MAC is not part of what a result says.
+    AnalyserRecord a, b;
+    make_record(&a, "S-1001", 5, "9.8");
+    make_record(&b, "S-1001", 5, "9.8");
+    record_set_identity(&b, "MC0003", "66:77:88:99:aa:bb");
+    CHECK(dedupe_key(&a) == dedupe_key(&b));
+    record_set_identity(&b, "MC0004", "66:77:88:99:aa:bb");
+    CHECK(dedupe_key(&a) != dedupe_key(&b));
+    record_free(&a);
+    record_free(&b);
+
+    char header[64];
+    dedupe_header(0x0123456789abcdefull, header, sizeof(header));
+    CHECK(strcmp(header, "Idempotency-Key: 0123456789abcdef") == 0);
+}
+
+// ===============================================================
+//  Index against a plain ring
+// ===============================================================
+
+static uint64_t key_n(unsigned n) {
+    return (uint64_t)n * 0x9E3779B97F4A7C15ull;   // spread like real keys
+}
+
+static int ring_has(const uint64_t *ring, int cap, uint64_t key) {
+    for (int i = 0; i < cap; i++) {
+        if (ring[i] == key) return 1;
+    }
+    return 0;
+}
+
+static void test_index(void) {
+    for (int cap = 1; cap <= 64; cap += 7) {
+        remove(INDEX_FILE);
+        CHECK(dedupe_open(INDEX_FILE, cap, 0));
+        uint64_t *ring = (uint64_t *)calloc((size_t)cap, sizeof(uint64_t));
+        int next = 0;
+        srand((unsigned)cap);
+
+        int agree = 1;
+        for (int it = 0; it < 20000; it++) {
+            uint64_t key = key_n(1 + (unsigned)(rand() % (3 * cap + 5)));
+            if (dedupe_seen(key) != ring_has(ring, cap, key)) agree = 0;
+            if (rand() % 2) {
+                dedupe_add(key);   // also re-adds keys still in the ring
+                ring[next] = key;
+                next = (next + 1) % cap;
+            }
+            if (it % 5000 == 4999) {
+                dedupe_close();
+                CHECK(dedupe_open(INDEX_FILE, cap, 0));
+            }
+        }
+        CHECK(agree);
+        free(ring);
+        dedupe_close();
+    }
+}
+
+// A smaller ring keeps the newest keys of the file.
+static void test_resize(void) {
+    remove(INDEX_FILE);
+    CHECK(dedupe_open(INDEX_FILE, 10, 0));
+    for (unsigned n = 1; n <= 25; n++) dedupe_add(key_n(n));
+    dedupe_close();
+
+    CHECK(dedupe_open(INDEX_FILE, 4, 0));
+    for (unsigned n = 1; n <= 21; n++) CHECK(!dedupe_seen(key_n(n)));
+    for (unsigned n = 22; n <= 25; n++) CHECK(dedupe_seen(key_n(n)));
+    dedupe_close();
+
+    CHECK(!dedupe_seen(key_n(25)));   // closed: nothing is a duplicate
+    CHECK(!dedupe_seen(0));
+    remove(INDEX_FILE);
+}
+
+int main(void) {
+    test_keys();
+    test_index();
+    test_resize();
+    return check_done("dedupe_test");
+}
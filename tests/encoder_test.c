@@ -0,0 +1,286 @@
+// encoder_test.c
+// Checks the upload encoders (libanalyser/record_encoder.h): the JSON
+// text is byte-for-byte what the backend has always received, and every
+// MessagePack upload decodes back to a record that says the same thing
+// (same items, keys, values and identity) across the fix/8/16/32-bit
+// length forms and the urine object shape.
+//
+// Build (from repo root):
+//   gcc -O2 -Ilibanalyser -o tests/encoder_test tests/encoder_test.c libanalyser/*.c -lcurl
+// Run:
+//   ./tests/encoder_test
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "analyser_record.h"
+#include "record_encoder.h"
+#include "check.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *encode(const RecordEncoder *enc, const AnalyserRecord *rec, size_t *len) {
+    ByteBuf out = { 0 };
+    CHECK(enc->encode(rec, &out));
+    *len = out.len;
+    return out.data;
+}
+
+// ===============================================================
+//  MessagePack reader (only the forms the encoder writes)
+// ===============================================================
+
+typedef struct {
+    const unsigned char *p, *end;
+    Arena *strings;   // decoded keys/values; records borrow the keys
+    int    bad;
+} Reader;
+
+static uint32_t rd_be(Reader *r, int width) {
+    uint32_t v = 0;
+    if (r->end - r->p < width) {
+        r->bad = 1;
+        return 0;
+    }
+    for (int i = 0; i < width; i++) v = (v << 8) | *r->p++;
+    return v;
+}
+
+static int rd_tag(Reader *r) {
+    if (r->p >= r->end) {
+        r->bad = 1;
+        return -1;
+    }
+    return *r->p++;
+}
+
+static const char *rd_str(Reader *r) {
+    int tag = rd_tag(r);
+    uint32_t n;
+    if ((tag & 0xe0) == 0xa0) n = (uint32_t)tag & 0x1f;
+    else if (tag == 0xd9)     n = rd_be(r, 1);
+    else if (tag == 0xda)     n = rd_be(r, 2);
+    else if (tag == 0xdb)     n = rd_be(r, 4);
+    else {
+        r->bad = 1;
+        return "";
+    }
+    if (r->bad || (size_t)(r->end - r->p) < n) {
+        r->bad = 1;
+        return "";
+    }
+    char *s = (char *)arena_alloc(r->strings, (size_t)n + 1);
+    memcpy(s, r->p, n);
+    s[n] = '\0';
+    r->p += n;
+    return s;
+}
+
+static int is_map(const Reader *r) {
+    return r->p < r->end && ((*r->p & 0xf0) == 0x80 || *r->p == 0xde || *r->p == 0xdf);
+}
+
+static uint32_t rd_map(Reader *r) {
+    int tag = rd_tag(r);
+    if ((tag & 0xf0) == 0x80) return (uint32_t)tag & 0x0f;
+    if (tag == 0xde) return rd_be(r, 2);
+    if (tag == 0xdf) return rd_be(r, 4);
+    r->bad = 1;
+    return 0;
+}
+
+static uint32_t rd_array(Reader *r) {
+    int tag = rd_tag(r);
+    if ((tag & 0xf0) == 0x90) return (uint32_t)tag & 0x0f;
+    if (tag == 0xdc) return rd_be(r, 2);
+    if (tag == 0xdd) return rd_be(r, 4);
+    r->bad = 1;
+    return 0;
+}
+
+static void rd_item(Reader *r, AnalyserRecord *rec) {
+    uint32_t n = rd_map(r);
+    record_begin_item(rec);
+    for (uint32_t f = 0; f < n && !r->bad; f++) {
+        const char *key = rd_str(r);
+        record_add_field(rec, key, rd_str(r));
+    }
+}
+
+// Rebuild a record from an upload; 0 if it is not one.
+static int decode(const char *data, size_t len, Arena *strings, AnalyserKind kind, AnalyserRecord *rec) {
+    Reader r = { (const unsigned char *)data, (const unsigned char *)data + len, strings, 0 };
+    record_init(rec, kind);
+    if (rd_map(&r) != 3 || strcmp(rd_str(&r), "mydata") != 0) return 0;
+
+    rec->mydataIsObject = is_map(&r);
+    if (rec->mydataIsObject) {
+        // an empty object stands for "no item"
+        if (*r.p != 0x80) rd_item(&r, rec);
+        else r.p++;
+    } else {
+        uint32_t n = rd_array(&r);
+        for (uint32_t i = 0; i < n && !r.bad; i++) rd_item(&r, rec);
+    }
+
+    if (strcmp(rd_str(&r), "MachineID") != 0) return 0;
+    const char *machine = rd_str(&r);
+    if (strcmp(rd_str(&r), "MAC") != 0) return 0;
+    record_set_identity(rec, machine, rd_str(&r));
+    return !r.bad && r.p == r.end;
+}
+
+// MessagePack -> record -> JSON must give the JSON of the original.
+static void check_round_trip(const AnalyserRecord *rec) {
+    size_t mpLen, jsonLen, againLen;
+    char *mp = encode(record_encoder_msgpack(), rec, &mpLen);
+    char *json = encode(record_encoder_json(), rec, &jsonLen);
+
+    Arena *strings = arena_create(0);
+    AnalyserRecord back;
+    CHECK(decode(mp, mpLen, strings, rec->kind, &back));
+    CHECK(back.nitems == rec->nitems && back.nfields == rec->nfields);
+    CHECK(back.mydataIsObject == rec->mydataIsObject);
+    for (int f = 0; f < rec->nfields && f < back.nfields; f++) {
+        CHECK(strcmp(back.fields[f].key, rec->fields[f].key) == 0);
+        CHECK(strcmp(back.fields[f].value, rec->fields[f].value) == 0);
+    }
+
+    char *again = encode(record_encoder_json(), &back, &againLen);
+    CHECK(againLen == jsonLen && memcmp(again, json, jsonLen) == 0);
+    CHECK(mpLen < jsonLen);
+
+    free(again);
+    record_free(&back);
+    arena_destroy(strings);
+    free(json);
+    free(mp);
+}
+
+// ===============================================================
+//  Cases
+// ===============================================================
+
+static void test_json_text(void) {
+    AnalyserRecord rec;
+    record_init(&rec, ANALYSER_KIND_CBC);
+    record_set_identity(&rec, "MC0003", "00:11:22:33:44:55");
+    record_begin_item(&rec);
+    record_add_field(&rec, "test_code", "HGB");
+    record_add_result(&rec, "value", "13.5", NULL, NULL);
+    record_begin_item(&rec);
+    record_add_field(&rec, "test_code", "note");
+    record_add_field(&rec, "value", "say \"hi\" \\ then\nstop");
+
+    size_t len;
+    char *json = encode(record_encoder_json(), &rec, &len);
+    const char *want =
+        "{\"mydata\":[{\"test_code\":\"HGB\",\"value\":\"13.5\"},"
+        "{\"test_code\":\"note\",\"value\":\"say \\\"hi\\\" \\\\ thenstop\"}],"
+        "\"MachineID\":\"MC0003\",\"MAC\":\"00:11:22:33:44:55\"}";
+    CHECK(strcmp(json, want) == 0);
+    CHECK(len == strlen(want));
+    free(json);
+
+    // MessagePack keeps the bytes JSON has to escape or drop.
+    char *mp = encode(record_encoder_msgpack(), &rec, &len);
+    Arena *strings = arena_create(0);
+    AnalyserRecord back;
+    CHECK(decode(mp, len, strings, rec.kind, &back));
+    CHECK(back.nfields == 4 && strcmp(back.fields[3].value, "say \"hi\" \\ then\nstop") == 0);
+    CHECK(strcmp(back.MachineID, "MC0003") == 0 && strcmp(back.MAC, "00:11:22:33:44:55") == 0);
+    record_free(&back);
+    arena_destroy(strings);
+    free(mp);
+    record_free(&rec);
+}
+
+static void test_urine(void) {
+    AnalyserRecord rec;
+    record_init(&rec, ANALYSER_KIND_URINE);
+    record_set_identity(&rec, "MC0010", "aa:bb:cc:dd:ee:ff");
+    size_t len;
+    char *json = encode(record_encoder_json(), &rec, &len);
+    CHECK(strcmp(json, "{\"mydata\":{},\"MachineID\":\"MC0010\",\"MAC\":\"aa:bb:cc:dd:ee:ff\"}") == 0);
+    free(json);
+    check_round_trip(&rec);
+
+    static const char *const LABELS[] = { "LEU", "NIT", "URO", "PRO", "pH", "BLD", "SG", "KET", "BIL", "GLU" };
+    record_begin_item(&rec);
+    record_add_field(&rec, "date", "2024-03-01");
+    for (int i = 0; i < 10; i++) record_add_result(&rec, LABELS[i], i % 2 ? "neg" : "1+", NULL, NULL);
+    check_round_trip(&rec);   // 11 fields: fixmap
+    for (int i = 0; i < 10; i++) record_add_field(&rec, LABELS[i], "again");
+    check_round_trip(&rec);   // 21 fields: map16
+    record_free(&rec);
+}
+
+// Item counts and string lengths either side of every size boundary.
+static void test_sizes(void) {
+    static const int ITEMS[] = { 0, 1, 15, 16, 300 };
+    static const size_t LENGTHS[] = { 0, 31, 32, 255, 256, 65535, 65536 };
+    char *text = (char *)malloc(65537);
+    for (size_t i = 0; i < 65536; i++) text[i] = (char)('a' + i % 26);
+
+    for (size_t k = 0; k < sizeof(ITEMS) / sizeof(ITEMS[0]); k++) {
+        AnalyserRecord rec;
+        record_init(&rec, ANALYSER_KIND_CBC);
+        record_set_identity(&rec, "MC0003", "");
+        for (int i = 0; i < ITEMS[k]; i++) {
+            size_t n = LENGTHS[i % (sizeof(LENGTHS) / sizeof(LENGTHS[0]))];
+            char saved = text[n];
+            text[n] = '\0';
+            record_begin_item(&rec);
+            record_add_field(&rec, "test_code", "WBC");
+            record_add_field(&rec, "comment", text);
+            text[n] = saved;
+        }
+        check_round_trip(&rec);
+        record_free(&rec);
+    }
+    free(text);
+}
+
+// Growing inside an arena gives the same bytes as on the heap.
+static void test_arena_buffer(void) {
+    AnalyserRecord rec;
+    record_init(&rec, ANALYSER_KIND_RESULTS);
+    for (int i = 0; i < 200; i++) {
+        record_begin_item(&rec);
+        record_add_result(&rec, "GLU", "5.6", "3.9-6.1", NULL);
+    }
+    const RecordEncoder *encs[] = { record_encoder_json(), record_encoder_msgpack() };
+    for (int e = 0; e < 2; e++) {
+        size_t len;
+        char *heap = encode(encs[e], &rec, &len);
+        Arena *a = arena_create(256);
+        ByteBuf out = { 0 };
+        out.arena = a;
+        CHECK(encs[e]->encode(&rec, &out));
+        CHECK(out.len == len && memcmp(out.data, heap, len) == 0);
+        bytebuf_free(&out);
+        arena_destroy(a);
+        free(heap);
+    }
+    record_free(&rec);
+}
+
+static void test_registry(void) {
+    CHECK(record_encoder_by_name("msgpack") == record_encoder_msgpack());
+    CHECK(record_encoder_by_name("json") == record_encoder_json());
+    CHECK(record_encoder_by_name("cbor") == record_encoder_json());
+    CHECK(record_encoder_by_name(NULL) == record_encoder_json());
+    CHECK(strcmp(record_encoder_json()->contentType, "application/json") == 0);
+    CHECK(strcmp(record_encoder_msgpack()->contentType, "application/msgpack") == 0);
+}
+
+int main(void) {
+    test_json_text();
+    test_urine();
+    test_sizes();
+    test_arena_buffer();
+    test_registry();
+    return check_done("encoder_test");
+}
@@ -0,0 +1,64 @@
+// priority_test.c
+// Checks which ready level the scan pipeline uploads from next
+// (scan_priority_next() in combain/scan_pipeline.h): strict order without
+// aging, and a waiting routine or urgent result overtaking newer, more
+// urgent ones once it has aged far enough.
+//
+// Build (from repo root):
+//   gcc -O2 -Ilibanalyser -Icombain -o tests/priority_test tests/priority_test.c combain/scan_pipeline.c combain/archive.c combain/archive_store.c combain/dedupe.c combain/event_loop.c combain/http_multi.c combain/logger.c combain/metrics.c combain/trace.c combain/work_pool.c combain/spsc_queue.c combain/monotime.c libanalyser/*.c -lcurl -lpthread -lz
+// Run:
+//   ./tests/priority_test
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "scan_pipeline.h"
+#include "check.h"
+
+#define S(n) ((unsigned long long)(n) * 1000000ull)
+
+static int next(unsigned long long stat, unsigned long long urgent, unsigned long long routine,
+                int agingS, unsigned long long now) {
+    unsigned long long heads[SCAN_PRIORITIES];
+    heads[SCAN_PRIO_STAT] = stat;
+    heads[SCAN_PRIO_URGENT] = urgent;
+    heads[SCAN_PRIO_ROUTINE] = routine;
+    return scan_priority_next(heads, agingS, now);
+}
+
+static void test_strict(void) {
+    CHECK(next(0, 0, 0, 0, S(1000)) == -1);
+    CHECK(next(0, 0, S(1), 0, S(1000)) == SCAN_PRIO_ROUTINE);
+    CHECK(next(0, S(999), S(1), 0, S(1000)) == SCAN_PRIO_URGENT);
+    CHECK(next(S(999), S(1), S(1), 0, S(1000)) == SCAN_PRIO_STAT);
+    // 0 means no aging however long the routine result has waited
+    CHECK(next(0, S(1000), 1, 0, S(1000)) == SCAN_PRIO_URGENT);
+}
+
+static void test_aging(void) {
+    const int aging = 60;
+    unsigned long long now = S(10000);
+
+    // Routine waited 59 s: not yet level with a fresh urgent result.
+    CHECK(next(0, now, now - S(59), aging, now) == SCAN_PRIO_URGENT);
+    // 60 s: level with it; ties go to the more urgent level.
+    CHECK(next(0, now, now - S(60), aging, now) == SCAN_PRIO_URGENT);
+    // 120 s: two levels up, ahead of the urgent one (still level 1).
+    CHECK(next(0, now, now - S(120), aging, now) == SCAN_PRIO_ROUTINE);
+    // ... but only level with a fresh STAT, which wins the tie.
+    CHECK(next(now, 0, now - S(600), aging, now) == SCAN_PRIO_STAT);
+
+    // An urgent result that waited 60 s is level with a fresh STAT one;
+    // a routine result 170 s old (level 0 too) loses to both.
+    CHECK(next(now, now - S(60), now - S(170), aging, now) == SCAN_PRIO_STAT);
+    CHECK(next(now - S(1), now - S(90), now - S(150), aging, now) == SCAN_PRIO_STAT);
+    CHECK(next(0, now - S(90), now - S(150), aging, now) == SCAN_PRIO_URGENT);
+
+    // A head stamped after 'now' (clock read earlier) has not waited.
+    CHECK(next(0, now, now + S(5), aging, now) == SCAN_PRIO_URGENT);
+}
+
+int main(void) {
+    test_strict();
+    test_aging();
+    return check_done("priority_test");
+}
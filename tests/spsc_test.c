@@ -0,0 +1,165 @@
+// spsc_test.c
+// Checks combain's SPSC queue (combain/spsc_queue.h): FIFO order as the
+// indices wrap around the ring many times, the full-queue policies
+// (block, spill, drop oldest) at the wrap, and order under a real
+// producer and consumer thread.
+//
+// Build (from repo root):
+//   gcc -O2 -Icombain -o tests/spsc_test tests/spsc_test.c combain/spsc_queue.c combain/monotime.c -lpthread
+// Run:
+//   ./tests/spsc_test
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "spsc_queue.h"
+#include "check.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <process.h>
+#else
+    #include <pthread.h>
+#endif
+
+#define ITEM(n) ((void *)(uintptr_t)(n))
+
+static int g_spilled, g_discarded;
+
+static int count_spill(void *ctx, void *item) {
+    (void)ctx;
+    (void)item;
+    g_spilled++;
+    return 1;
+}
+
+static void count_discard(void *ctx, void *item) {
+    (void)ctx;
+    (void)item;
+    g_discarded++;
+}
+
+// Batches of 1..capacity items, so head and tail wrap at every offset.
+static void test_wraparound(void) {
+    SpscQueue *q = spsc_create(5, SPSC_BLOCK, NULL, NULL, NULL);
+    CHECK(q != NULL);
+    SpscStats st;
+    spsc_stats(q, &st);
+    CHECK(st.capacity == 8);
+
+    uintptr_t next = 1, expect = 1;
+    for (int lap = 0; lap < 1000; lap++) {
+        int batch = 1 + lap % 8;
+        for (int i = 0; i < batch; i++) CHECK(spsc_push(q, ITEM(next++)) == SPSC_PUSHED);
+        CHECK(spsc_full(q) == (batch == 8));
+        for (int i = 0; i < batch; i++) CHECK(spsc_pop(q) == ITEM(expect++));
+        CHECK(spsc_pop(q) == NULL);
+    }
+
+    spsc_stats(q, &st);
+    CHECK(st.pushed == next - 1);
+    CHECK(st.popped == expect - 1);
+    CHECK(st.depth == 0);
+    CHECK(st.maxDepth == 8);
+    CHECK(st.blocked == 0);
+    spsc_destroy(q);
+}
+
+// Head at 5 of 8: dropping the oldest crosses the end of the ring.
+static void test_drop_oldest_at_wrap(void) {
+    g_discarded = 0;
+    SpscQueue *q = spsc_create(8, SPSC_DROP_OLDEST, NULL, count_discard, NULL);
+    for (uintptr_t i = 1; i <= 5; i++) spsc_push(q, ITEM(100 + i));
+    for (int i = 0; i < 5; i++) spsc_pop(q);
+
+    for (uintptr_t i = 1; i <= 10; i++) CHECK(spsc_push(q, ITEM(i)) == SPSC_PUSHED);
+    for (uintptr_t i = 3; i <= 10; i++) CHECK(spsc_pop(q) == ITEM(i));
+    CHECK(spsc_pop(q) == NULL);
+
+    SpscStats st;
+    spsc_stats(q, &st);
+    CHECK(st.dropped == 2);
+    CHECK(g_discarded == 2);
+    spsc_destroy(q);
+}
+
+static void test_spill_and_close(void) {
+    g_spilled = 0;
+    g_discarded = 0;
+    SpscQueue *q = spsc_create(2, SPSC_SPILL, count_spill, count_discard, NULL);
+    spsc_push(q, ITEM(1));
+    spsc_pop(q);   // tail now wraps on the next push
+    CHECK(spsc_push(q, ITEM(2)) == SPSC_PUSHED);
+    CHECK(spsc_push(q, ITEM(3)) == SPSC_PUSHED);
+    CHECK(spsc_push(q, ITEM(4)) == SPSC_SPILLED);
+    CHECK(g_spilled == 1);
+    CHECK(spsc_pop(q) == ITEM(2));
+    CHECK(spsc_pop(q) == ITEM(3));
+
+    spsc_close(q);
+    CHECK(spsc_push(q, ITEM(5)) == SPSC_CLOSED);
+    CHECK(g_discarded == 1);
+    SpscStats st;
+    spsc_stats(q, &st);
+    CHECK(st.spilled == 1 && st.lost == 1);
+    spsc_destroy(q);
+}
+
+// ===============================================================
+//  Two threads
+// ===============================================================
+
+#define THREAD_ITEMS 200000
+
+#ifdef _WIN32
+static unsigned __stdcall producer(void *arg)
+#else
+static void *producer(void *arg)
+#endif
+{
+    SpscQueue *q = (SpscQueue *)arg;
+    for (uintptr_t i = 1; i <= THREAD_ITEMS; i++) spsc_push(q, ITEM(i));
+    return 0;
+}
+
+static void test_threads(void) {
+    SpscQueue *q = spsc_create(64, SPSC_BLOCK, NULL, NULL, NULL);
+#ifdef _WIN32
+    HANDLE th = (HANDLE)_beginthreadex(NULL, 0, producer, q, 0, NULL);
+    CHECK(th != 0);
+#else
+    pthread_t th;
+    CHECK(pthread_create(&th, NULL, producer, q) == 0);
+#endif
+
+    uintptr_t expect = 1;
+    int inOrder = 1;
+    while (expect <= THREAD_ITEMS) {
+        void *item = spsc_pop(q);
+        if (!item) continue;
+        if (item != ITEM(expect)) inOrder = 0;
+        expect++;
+    }
+    CHECK(inOrder);
+
+#ifdef _WIN32
+    WaitForSingleObject(th, INFINITE);
+    CloseHandle(th);
+#else
+    pthread_join(th, NULL);
+#endif
+    SpscStats st;
+    spsc_stats(q, &st);
+    CHECK(st.pushed == THREAD_ITEMS && st.popped == THREAD_ITEMS && st.lost == 0);
+    spsc_destroy(q);
+}
+
+int main(void) {
+    test_wraparound();
+    test_drop_oldest_at_wrap();
+    test_spill_and_close();
+    test_threads();
+    return check_done("spsc_test");
+}
@@ -0,0 +1,112 @@
+// work_pool_test.c
+// Checks the parse/upload pool (combain/work_pool.h): every task runs
+// exactly once whether workers find it in their own deque, steal it or
+// are woken for it; work_pool_wait() returns only when all have finished
+// (also for tasks submitted from inside tasks); destroy runs what is
+// still queued.
+//
+// Build (from repo root):
+//   gcc -O2 -Icombain -o tests/work_pool_test tests/work_pool_test.c combain/work_pool.c combain/logger.c combain/spsc_queue.c combain/monotime.c -lpthread
+// Run:
+//   ./tests/work_pool_test
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "work_pool.h"
+#include "check.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define TASKS 20000
+
+static atomic_int g_runs[TASKS];
+static atomic_int g_done;
+static atomic_int g_badWorker;
+static int        g_nworkers;
+
+static void count_task(void *arg, int worker) {
+    atomic_fetch_add(&g_runs[(int)(size_t)arg], 1);
+    if (worker < 0 || worker >= g_nworkers) atomic_fetch_add(&g_badWorker, 1);
+    atomic_fetch_add(&g_done, 1);
+}
+
+static void reset(void) {
+    for (int i = 0; i < TASKS; i++) atomic_store(&g_runs[i], 0);
+    atomic_store(&g_done, 0);
+}
+
+static int each_ran_once(int n) {
+    for (int i = 0; i < n; i++) {
+        if (atomic_load(&g_runs[i]) != 1) return 0;
+    }
+    return 1;
+}
+
+// Bursts with waits in between, so workers go to sleep and are woken
+// again many times.
+static void test_bursts(WorkPool *pool) {
+    for (int round = 0; round < 200; round++) {
+        reset();
+        int n = 1 + (round * 37) % 100;
+        for (int i = 0; i < n; i++) CHECK(work_pool_submit(pool, count_task, (void *)(size_t)i));
+        work_pool_wait(pool);
+        CHECK(atomic_load(&g_done) == n);
+        CHECK(each_ran_once(n));
+    }
+}
+
+static void test_flood(WorkPool *pool) {
+    reset();
+    for (int i = 0; i < TASKS; i++) work_pool_submit(pool, count_task, (void *)(size_t)i);
+    work_pool_wait(pool);
+    CHECK(atomic_load(&g_done) == TASKS);
+    CHECK(each_ran_once(TASKS));
+}
+
+// A task that queues more: wait covers the children it had not seen yet.
+typedef struct {
+    WorkPool *pool;
+    int       first, n;
+} Fanout;
+
+static void fanout_task(void *arg, int worker) {
+    Fanout *f = (Fanout *)arg;
+    for (int i = f->first; i < f->first + f->n; i++) work_pool_submit(f->pool, count_task, (void *)(size_t)i);
+    count_task((void *)(size_t)(TASKS - 1 - f->first / 100), worker);
+}
+
+static void test_nested(WorkPool *pool) {
+    reset();
+    static Fanout fans[50];
+    for (int k = 0; k < 50; k++) {
+        fans[k] = (Fanout){ pool, k * 100, 100 };
+        work_pool_submit(pool, fanout_task, &fans[k]);
+    }
+    work_pool_wait(pool);
+    CHECK(atomic_load(&g_done) == 50 * 100 + 50);
+    CHECK(each_ran_once(50 * 100));
+}
+
+int main(void) {
+    WorkPool *pool = work_pool_create(4);
+    CHECK(pool != NULL);
+    if (!pool) return check_done("work_pool_test");
+    g_nworkers = work_pool_size(pool);
+    CHECK(g_nworkers == 4);
+
+    test_bursts(pool);
+    test_flood(pool);
+    test_nested(pool);
+    CHECK(atomic_load(&g_badWorker) == 0);
+
+    // Destroy without a wait still runs everything queued.
+    reset();
+    for (int i = 0; i < 1000; i++) work_pool_submit(pool, count_task, (void *)(size_t)i);
+    work_pool_destroy(pool);
+    CHECK(atomic_load(&g_done) == 1000);
+    CHECK(each_ran_once(1000));
+
+    work_pool_destroy(NULL);
+    return check_done("work_pool_test");
+}
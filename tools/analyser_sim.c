@@ -0,0 +1,791 @@
+// analyser_sim.c
+// Plays analyser traffic at combain, to reproduce field issues and to load
+// test it.
+//
+//   record  capture what an analyser sends, with the time of every chunk,
+//           into a recording file
+//   replay  send a recording with its original timing (or N times faster),
+//           or a raw capture such as ss/out_f200.txt / ss/serial_data.txt
+//           result by result
+//   gen     send synthetic results of one format at a target rate
+//
+// The tool talks to combain the way an instrument does:
+//   --listen PORT      wait for combain to dial in ([listener] client mode)
+//   --connect H:PORT   dial combain's LIS-host listener (mode = server)
+//   --pty [--link P]   fake serial device; its path is printed (and
+//                      symlinked to P, e.g. for a fixed [serial] device).
+//                      It stays open after sending until Ctrl+C.
+// and record reads from --listen, --connect or --device DEV --baud N.
+//
+// Raw captures have no timing: results are cut at their last line (']'
+// for CBC / H360, ETX for urine) and sent --gap-ms apart. Those and
+// generated results can be wrapped the way instruments speak to a LIS:
+//   --frame mllp   <VT> result <FS><CR>, then wait for the peer's reply
+//   --frame astm   ENQ, STX-framed 240-byte frames with checksums, EOT,
+//                  waiting for ACK after ENQ and every frame
+// --ack-timeout-ms bounds each wait (combain does not answer; 0 = don't
+// wait). Recordings are replayed byte for byte, framing and all.
+//
+// Recording layout (little-endian): "CBREC1\0\0", then per chunk
+//   u64 microseconds since the recording started, u32 length, bytes.
+//
+// POSIX only (ptys, termios).
+//
+// Build (from repo root):
+//   gcc -O2 -o analyser_sim tools/analyser_sim.c
+// Run:
+//   ./analyser_sim record --connect 192.168.0.173:50001 --out f200.rec
+//   ./analyser_sim replay f200.rec --listen 50001 --speed 10 --loop 0
+//   ./analyser_sim replay ss/serial_data.txt --pty --link /tmp/ttyURINE
+//   ./analyser_sim gen h360 --connect 127.0.0.1:50010 --rate 20 --count 1000 --frame mllp
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _GNU_SOURCE
+
+#ifdef _WIN32
+
+#include <stdio.h>
+
+int main(void) {
+    fprintf(stderr, "analyser_sim needs ptys and termios; run it on Linux or macOS.\n");
+    return 1;
+}
+
+#else
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REC_MAGIC   "CBREC1\0\0"
+#define REC_HEADER  8
+#define CHUNK_MAX   (1u << 20)
+#define ASTM_FRAME  240
+
+enum { STX = 0x02, ETX = 0x03, EOT = 0x04, ENQ = 0x05, ACK = 0x06, VT = 0x0B, ETB = 0x17, FS = 0x1C };
+
+static volatile sig_atomic_t g_stop;
+
+static void on_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+static unsigned long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ull + (unsigned long long)ts.tv_nsec / 1000;
+}
+
+// Sleep until 'us' on the now_us() clock; 0 if interrupted.
+static int sleep_until(unsigned long long us) {
+    while (!g_stop) {
+        unsigned long long now = now_us();
+        if (now >= us) return 1;
+        unsigned long long left = us - now;
+        struct timespec ts = { (time_t)(left / 1000000), (long)(left % 1000000) * 1000 };
+        nanosleep(&ts, NULL);
+    }
+    return 0;
+}
+
+// ===============================================================
+//  Options
+// ===============================================================
+
+typedef enum { PEER_NONE, PEER_LISTEN, PEER_CONNECT, PEER_PTY, PEER_DEVICE } PeerKind;
+typedef enum { FRAME_NONE, FRAME_MLLP, FRAME_ASTM } FrameKind;
+
+typedef struct {
+    const char *command;
+    const char *input;          // replay: file; gen: format
+    PeerKind    peer;
+    char        host[128];
+    int         port;
+    const char *device;
+    int         baud;
+    const char *link;
+    const char *out;
+    double      speed;          // replay: 0 = as fast as possible
+    int         loops;          // 0 = forever
+    int         gapMs;
+    double      rate;           // gen: results per second
+    long        count;          // gen: 0 = until interrupted
+    int         durationS;      // record: 0 = until EOF / interrupted
+    FrameKind   frame;
+    int         ackTimeoutMs;
+} Options;
+
+static Options g_opt;
+
+static int parse_host_port(const char *v) {
+    const char *colon = strrchr(v, ':');
+    if (!colon || colon == v || (size_t)(colon - v) >= sizeof(g_opt.host)) return 0;
+    memcpy(g_opt.host, v, (size_t)(colon - v));
+    g_opt.host[colon - v] = '\0';
+    g_opt.port = atoi(colon + 1);
+    return g_opt.port > 0 && g_opt.port < 65536;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: analyser_sim record (--listen PORT | --connect HOST:PORT | --device DEV [--baud N])\n"
+            "                           --out FILE [--duration S]\n"
+            "       analyser_sim replay FILE PEER [--speed X] [--loop N] [--gap-ms N] [FRAMING]\n"
+            "       analyser_sim gen cbc|h360|urine PEER [--rate R] [--count N] [FRAMING]\n"
+            "  PEER     --listen PORT | --connect HOST:PORT | --pty [--link PATH]\n"
+            "  FRAMING  --frame none|mllp|astm [--ack-timeout-ms N]\n"
+            "  defaults: --speed 1, --loop 1 (0 = forever), --gap-ms 1000, --rate 1,\n"
+            "            --count 0 (until Ctrl+C), --baud 9600, --ack-timeout-ms 1000\n");
+}
+
+static int parse_args(int argc, char **argv) {
+    if (argc < 2) return 0;
+    g_opt.command = argv[1];
+    g_opt.speed = 1;
+    g_opt.loops = 1;
+    g_opt.gapMs = 1000;
+    g_opt.rate = 1;
+    g_opt.baud = 9600;
+    g_opt.ackTimeoutMs = 1000;
+
+    int i = 2;
+    if (strcmp(g_opt.command, "record") != 0) {
+        if (argc < 3) return 0;
+        g_opt.input = argv[i++];
+    }
+    for (; i < argc; i++) {
+        const char *a = argv[i];
+        if (!strcmp(a, "--pty")) { g_opt.peer = PEER_PTY; continue; }
+        if (i + 1 >= argc) return 0;
+        const char *v = argv[++i];
+        if (!strcmp(a, "--listen")) { g_opt.peer = PEER_LISTEN; g_opt.port = atoi(v); }
+        else if (!strcmp(a, "--connect")) { g_opt.peer = PEER_CONNECT; if (!parse_host_port(v)) return 0; }
+        else if (!strcmp(a, "--device")) { g_opt.peer = PEER_DEVICE; g_opt.device = v; }
+        else if (!strcmp(a, "--baud")) g_opt.baud = atoi(v);
+        else if (!strcmp(a, "--link")) g_opt.link = v;
+        else if (!strcmp(a, "--out")) g_opt.out = v;
+        else if (!strcmp(a, "--speed")) g_opt.speed = atof(v);
+        else if (!strcmp(a, "--loop")) g_opt.loops = atoi(v);
+        else if (!strcmp(a, "--gap-ms")) g_opt.gapMs = atoi(v);
+        else if (!strcmp(a, "--rate")) g_opt.rate = atof(v);
+        else if (!strcmp(a, "--count")) g_opt.count = atol(v);
+        else if (!strcmp(a, "--duration")) g_opt.durationS = atoi(v);
+        else if (!strcmp(a, "--ack-timeout-ms")) g_opt.ackTimeoutMs = atoi(v);
+        else if (!strcmp(a, "--frame")) {
+            if (!strcmp(v, "none")) g_opt.frame = FRAME_NONE;
+            else if (!strcmp(v, "mllp")) g_opt.frame = FRAME_MLLP;
+            else if (!strcmp(v, "astm")) g_opt.frame = FRAME_ASTM;
+            else return 0;
+        } else {
+            return 0;
+        }
+    }
+
+    if (g_opt.peer == PEER_NONE) return 0;
+    if ((g_opt.peer == PEER_LISTEN || g_opt.peer == PEER_CONNECT) && (g_opt.port <= 0 || g_opt.port > 65535)) return 0;
+    if (!strcmp(g_opt.command, "record")) return g_opt.out && g_opt.peer != PEER_PTY;
+    if (g_opt.peer == PEER_DEVICE) return 0;
+    if (!strcmp(g_opt.command, "replay")) return g_opt.speed >= 0 && g_opt.loops >= 0 && g_opt.gapMs >= 0;
+    if (!strcmp(g_opt.command, "gen")) return g_opt.rate > 0 && g_opt.count >= 0;
+    return 0;
+}
+
+// ===============================================================
+//  Peer: TCP either way, a pty or a serial device
+// ===============================================================
+
+typedef struct {
+    int  fd;            // data, -1 = not connected
+    int  listenFd;
+    int  slaveFd;       // pty: held open so it never hangs up
+    char path[128];
+} Peer;
+
+static Peer g_peer = { -1, -1, -1, "" };
+
+static speed_t baud_speed(int baud) {
+    switch (baud) {
+        case 1200:   return B1200;
+        case 2400:   return B2400;
+        case 4800:   return B4800;
+        case 9600:   return B9600;
+        case 19200:  return B19200;
+        case 38400:  return B38400;
+        case 57600:  return B57600;
+        case 115200: return B115200;
+        default:     return 0;
+    }
+}
+
+static int make_raw(int fd, int baud) {
+    struct termios tty;
+    if (tcgetattr(fd, &tty) != 0) return 0;
+    cfmakeraw(&tty);
+    if (baud) {
+        speed_t sp = baud_speed(baud);
+        if (!sp) {
+            fprintf(stderr, "unsupported baud rate %d\n", baud);
+            return 0;
+        }
+        cfsetispeed(&tty, sp);
+        cfsetospeed(&tty, sp);
+    }
+    tty.c_cflag |= CLOCAL | CREAD;
+    return tcsetattr(fd, TCSANOW, &tty) == 0;
+}
+
+static int open_listen(void) {
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0) return 0;
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons((unsigned short)g_opt.port);
+    a.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(s, (struct sockaddr *)&a, sizeof(a)) != 0 || listen(s, 1) != 0) {
+        fprintf(stderr, "cannot listen on port %d: %s\n", g_opt.port, strerror(errno));
+        close(s);
+        return 0;
+    }
+    g_peer.listenFd = s;
+    return 1;
+}
+
+static int open_pty(void) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        fprintf(stderr, "cannot open a pty: %s\n", strerror(errno));
+        return 0;
+    }
+    snprintf(g_peer.path, sizeof(g_peer.path), "%s", ptsname(master));
+    g_peer.slaveFd = open(g_peer.path, O_RDWR | O_NOCTTY);
+    if (g_peer.slaveFd < 0 || !make_raw(g_peer.slaveFd, 0)) {
+        fprintf(stderr, "cannot set up %s: %s\n", g_peer.path, strerror(errno));
+        return 0;
+    }
+    g_peer.fd = master;
+    if (g_opt.link) {
+        unlink(g_opt.link);
+        if (symlink(g_peer.path, g_opt.link) != 0) {
+            fprintf(stderr, "cannot link %s: %s\n", g_opt.link, strerror(errno));
+            return 0;
+        }
+    }
+    printf("serial device: %s%s%s\n", g_peer.path, g_opt.link ? " -> " : "", g_opt.link ? g_opt.link : "");
+    fflush(stdout);
+    return 1;
+}
+
+// (Re)establish the data connection; 0 if interrupted or impossible.
+static int peer_connect(void) {
+    if (g_peer.fd >= 0) return 1;
+
+    switch (g_opt.peer) {
+    case PEER_LISTEN:
+        if (g_peer.listenFd < 0 && !open_listen()) return 0;
+        printf("waiting for a connection on port %d ...\n", g_opt.port);
+        fflush(stdout);
+        while (!g_stop) {
+            int s = accept(g_peer.listenFd, NULL, NULL);
+            if (s >= 0) {
+                g_peer.fd = s;
+                printf("connected\n");
+                return 1;
+            }
+            if (errno != EINTR) return 0;
+        }
+        return 0;
+
+    case PEER_CONNECT:
+        while (!g_stop) {
+            struct addrinfo hints, *res = NULL;
+            char port[16];
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_INET;
+            hints.ai_socktype = SOCK_STREAM;
+            snprintf(port, sizeof(port), "%d", g_opt.port);
+            if (getaddrinfo(g_opt.host, port, &hints, &res) != 0 || !res) {
+                fprintf(stderr, "cannot resolve %s\n", g_opt.host);
+                return 0;
+            }
+            int s = socket(AF_INET, SOCK_STREAM, 0);
+            int ok = s >= 0 && connect(s, res->ai_addr, res->ai_addrlen) == 0;
+            freeaddrinfo(res);
+            if (ok) {
+                g_peer.fd = s;
+                printf("connected to %s:%d\n", g_opt.host, g_opt.port);
+                return 1;
+            }
+            if (s >= 0) close(s);
+            sleep_until(now_us() + 1000000);   // not up yet: retry
+        }
+        return 0;
+
+    case PEER_PTY:
+        return open_pty();
+
+    case PEER_DEVICE:
+        g_peer.fd = open(g_opt.device, O_RDWR | O_NOCTTY);
+        if (g_peer.fd < 0 || !make_raw(g_peer.fd, g_opt.baud)) {
+            fprintf(stderr, "cannot open %s: %s\n", g_opt.device, strerror(errno));
+            return 0;
+        }
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+static void peer_lost(void) {
+    if (g_opt.peer == PEER_PTY || g_opt.peer == PEER_DEVICE) return;
+    printf("connection lost\n");
+    close(g_peer.fd);
+    g_peer.fd = -1;
+}
+
+// Write everything, reconnecting (and starting the buffer over) if the
+// peer goes away. 0 if interrupted.
+static int peer_write(const void *data, size_t len) {
+    for (;;) {
+        if (!peer_connect()) return 0;
+        const char *p = (const char *)data;
+        size_t left = len;
+        while (left > 0) {
+            ssize_t n = write(g_peer.fd, p, left);
+            if (n > 0) {
+                p += n;
+                left -= (size_t)n;
+            } else if (n < 0 && errno == EINTR) {
+                if (g_stop) return 0;
+            } else {
+                break;
+            }
+        }
+        if (left == 0) return 1;
+        peer_lost();
+    }
+}
+
+static int peer_put(unsigned char c) {
+    return peer_write(&c, 1);
+}
+
+// Read what the peer sends for up to 'timeoutMs'. Returns 1 as soon as one
+// of 'want' (NUL-terminated set) arrives, 0 on timeout, -1 if the peer
+// went away or we were interrupted.
+static int peer_wait(const char *want, int timeoutMs) {
+    unsigned long long until = now_us() + (unsigned long long)timeoutMs * 1000;
+    while (!g_stop && g_peer.fd >= 0) {
+        unsigned long long now = now_us();
+        if (now >= until) return 0;
+        struct pollfd p = { g_peer.fd, POLLIN, 0 };
+        int r = poll(&p, 1, (int)((until - now + 999) / 1000));
+        if (r <= 0) continue;
+        unsigned char buf[512];
+        ssize_t n = read(g_peer.fd, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            peer_lost();
+            return -1;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] && strchr(want, buf[i])) return 1;
+        }
+    }
+    return -1;
+}
+
+// Discard whatever the peer sent meanwhile (keeps its buffers from filling).
+static void peer_drain(void) {
+    if (g_peer.fd < 0) return;
+    struct pollfd p = { g_peer.fd, POLLIN, 0 };
+    while (poll(&p, 1, 0) > 0) {
+        char buf[512];
+        ssize_t n = read(g_peer.fd, buf, sizeof(buf));
+        if (n <= 0) {
+            peer_lost();
+            return;
+        }
+    }
+}
+
+// ===============================================================
+//  Sending one result (framing)
+// ===============================================================
+
+static unsigned long long g_units, g_bytes, g_noAck;
+
+static void wait_ack(const char *want) {
+    if (g_opt.ackTimeoutMs <= 0) return;
+    if (peer_wait(want, g_opt.ackTimeoutMs) != 1) g_noAck++;
+}
+
+static int send_astm(const char *data, size_t len) {
+    if (!peer_put(ENQ)) return 0;
+    wait_ack("\x06");
+
+    int fn = 1;
+    size_t off = 0;
+    do {
+        size_t n = len - off < ASTM_FRAME ? len - off : ASTM_FRAME;
+        int last = off + n >= len;
+        unsigned char frame[ASTM_FRAME + 8];
+        size_t k = 0;
+        frame[k++] = STX;
+        frame[k++] = (unsigned char)('0' + fn);
+        memcpy(frame + k, data + off, n);
+        k += n;
+        frame[k++] = last ? ETX : ETB;
+
+        unsigned sum = 0;
+        for (size_t i = 1; i < k; i++) sum += frame[i];
+        static const char HEX[] = "0123456789ABCDEF";
+        frame[k++] = (unsigned char)HEX[(sum >> 4) & 0xF];
+        frame[k++] = (unsigned char)HEX[sum & 0xF];
+        frame[k++] = '\r';
+        frame[k++] = '\n';
+        if (!peer_write(frame, k)) return 0;
+        wait_ack("\x06");
+
+        fn = fn % 7 + 1;
+        off += n;
+    } while (off < len);
+    return peer_put(EOT);
+}
+
+static int send_unit(const char *data, size_t len) {
+    int ok;
+    if (g_opt.frame == FRAME_MLLP) {
+        ok = peer_put(VT) && peer_write(data, len) && peer_write("\x1c\r", 2);
+        if (ok) wait_ack("\x1c\x06");
+    } else if (g_opt.frame == FRAME_ASTM) {
+        ok = send_astm(data, len);
+    } else {
+        ok = peer_write(data, len);
+    }
+    if (ok) {
+        g_units++;
+        g_bytes += len;
+    }
+    peer_drain();
+    return ok;
+}
+
+// ===============================================================
+//  replay
+// ===============================================================
+
+static unsigned char *read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    unsigned char *buf = (unsigned char *)malloc((size_t)(n > 0 ? n : 1));
+    if (!buf || fread(buf, 1, (size_t)n, fp) != (size_t)n) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        free(buf);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    *len = (size_t)n;
+    return buf;
+}
+
+static unsigned long long get_le(const unsigned char *p, int bytes) {
+    unsigned long long v = 0;
+    for (int i = bytes - 1; i >= 0; i--) v = v << 8 | p[i];
+    return v;
+}
+
+// Original timing, divided by --speed. Chunks go out as recorded.
+static int replay_recording(const unsigned char *buf, size_t len) {
+    unsigned long long start = now_us();
+    size_t off = REC_HEADER;
+    while (off + 12 <= len) {
+        unsigned long long at = get_le(buf + off, 8);
+        size_t n = (size_t)get_le(buf + off + 8, 4);
+        off += 12;
+        if (n > len - off) {
+            fprintf(stderr, "recording truncated\n");
+            break;
+        }
+        if (g_opt.speed > 0 && !sleep_until(start + (unsigned long long)((double)at / g_opt.speed))) return 0;
+        if (!peer_write(buf + off, n)) return 0;
+        g_units++;
+        g_bytes += n;
+        peer_drain();
+        off += n;
+    }
+    return 1;
+}
+
+// A result ends at a line whose last character is ']' (CBC / H360) or one
+// that holds ETX (urine); the rest of the file is the last result.
+static size_t result_end(const unsigned char *buf, size_t off, size_t len) {
+    size_t lineStart = off;
+    int etx = 0;
+    for (size_t i = off; i < len; i++) {
+        if (buf[i] == ETX) etx = 1;
+        if (buf[i] != '\n') continue;
+        size_t e = i;
+        while (e > lineStart && (buf[e - 1] == '\r' || buf[e - 1] == '\n')) e--;
+        if (etx || (e > lineStart && buf[e - 1] == ']')) return i + 1;
+        lineStart = i + 1;
+    }
+    return len;
+}
+
+static int replay_capture(const unsigned char *buf, size_t len) {
+    unsigned long long gapUs = g_opt.speed > 0 ? (unsigned long long)(g_opt.gapMs * 1000.0 / g_opt.speed) : 0;
+    for (size_t off = 0; off < len; ) {
+        size_t end = result_end(buf, off, len);
+        if (!send_unit((const char *)buf + off, end - off)) return 0;
+        off = end;
+        if (off < len && !sleep_until(now_us() + gapUs)) return 0;
+    }
+    return 1;
+}
+
+static int cmd_replay(void) {
+    size_t len = 0;
+    unsigned char *buf = read_file(g_opt.input, &len);
+    if (!buf) return 1;
+    int recording = len >= REC_HEADER && memcmp(buf, REC_MAGIC, REC_HEADER) == 0;
+    if (recording && g_opt.frame != FRAME_NONE) fprintf(stderr, "note: recordings are replayed as recorded, --frame ignored\n");
+
+    if (!peer_connect()) {
+        free(buf);
+        return 1;
+    }
+    unsigned long long t0 = now_us();
+    for (int pass = 0; (g_opt.loops == 0 || pass < g_opt.loops) && !g_stop; pass++) {
+        int ok = recording ? replay_recording(buf, len) : replay_capture(buf, len);
+        if (!ok) break;
+        if ((g_opt.loops == 0 || pass + 1 < g_opt.loops) && !recording &&
+            !sleep_until(now_us() + (unsigned long long)(g_opt.speed > 0 ? g_opt.gapMs * 1000.0 / g_opt.speed : 0))) break;
+    }
+    double s = (double)(now_us() - t0) / 1e6;
+    printf("sent %llu %s, %llu bytes in %.1f s\n", g_units, recording ? "chunks" : "results", g_bytes, s);
+    if (g_noAck) printf("%llu handshake(s) not acknowledged within %d ms\n", g_noAck, g_opt.ackTimeoutMs);
+    free(buf);
+    return 0;
+}
+
+// ===============================================================
+//  gen
+// ===============================================================
+
+static const char *const CBC_ROWS[22][4] = {
+    {"6690-2","WBC","10*9/L","4.00-10.00"},  {"704-7","BAS#","10*9/L","0.00-0.10"},
+    {"706-2","BAS%","%","0.0-1.0"},          {"751-8","NEU#","10*9/L","2.00-7.00"},
+    {"770-8","NEU%","%","50.0-70.0"},        {"711-2","EOS#","10*9/L","0.02-0.50"},
+    {"713-8","EOS%","%","0.5-5.0"},          {"731-0","LYM#","10*9/L","0.80-4.00"},
+    {"736-9","LYM%","%","20.0-40.0"},        {"742-7","MON#","10*9/L","0.12-1.20"},
+    {"744-3","MON%","%","3.0-12.0"},         {"789-8","RBC","10*12/L","3.50-5.50"},
+    {"718-7","HGB","g/dL","11.0-16.0"},      {"787-2","MCV","fL","80.0-100.0"},
+    {"785-6","MCH","pg","27.0-34.0"},        {"786-4","MCHC","g/dL","32.0-36.0"},
+    {"788-0","RDW-CV","%","11.0-16.0"},      {"21000-5","RDW-SD","fL","35.0-56.0"},
+    {"4544-3","HCT","%","37.0-54.0"},        {"777-3","PLT","10*9/L","100-300"},
+    {"32623-1","MPV","fL","6.5-12.0"},       {"32207-3","PDW","","9.0-17.0"},
+};
+
+static const char *const URINE_VALUES[10][3] = {
+    {"BLD", "Neg", "+-  10"},  {"LEU", "Neg", "1+  25"},    {"BIL", "Neg", "1+  17"},
+    {"UBG", "Normal", "1+  34"}, {"KET", "Neg", "+-  0.5"}, {"GLU", "Neg", "+-  5.5 mg/dl"},
+    {"PRO", "Neg", "1+  30 mg/dl"}, {"pH", "6.0", "7.5"},   {"NIT", "Neg", "Pos"},
+    {"SG", "1.020", "1.030"},
+};
+
+static unsigned g_seed = 12345u;
+
+static unsigned rnd(unsigned n) {
+    g_seed = g_seed * 1103515245u + 12345u;
+    return (g_seed >> 16) % n;
+}
+
+typedef struct {
+    char   data[4096];
+    size_t len;
+} Text;
+
+static void text_add(Text *t, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(t->data + t->len, sizeof(t->data) - t->len, fmt, ap);
+    va_end(ap);
+    if (n > 0) t->len += (size_t)n < sizeof(t->data) - t->len ? (size_t)n : sizeof(t->data) - t->len - 1;
+}
+
+// Same shapes as the instruments send (see libanalyser/analyser_formats.def).
+static int gen_result(Text *t, const char *format, unsigned long seq) {
+    t->len = 0;
+    if (!strcmp(format, "cbc")) {
+        text_add(t, "[02001^Take Mode^99MRC|O,02002^Blood Mode^99MRC|WB,02003^Test Mode^99MRC|CBC+DIFF,"
+                    "01002^Ref Group^99MRC|General,PID|1||S-%lu,OBR|1||S-%lu", seq, seq);
+        for (int i = 0; i < 22; i++) {
+            const char *const *r = CBC_ROWS[i];
+            unsigned v = rnd(100000);
+            const char *flag = v % 7 == 0 ? "H" : v % 11 == 0 ? "L" : "";
+            if (i < 4) text_add(t, ",%s^%s^LN|%u.%02u|%s||%s|%s", r[0], r[1], v / 1000, v % 100, r[2], r[3], flag);
+            else text_add(t, ",OBX|%d|NM|%s^%s^LN|%u.%02u|%s||%s|%s", i + 1, r[0], r[1], v / 1000, v % 100, r[2], r[3], flag);
+        }
+        text_add(t, "]\n");
+    } else if (!strcmp(format, "h360")) {
+        unsigned v = 30 + rnd(90);
+        text_add(t, "[14749-6^GLU^LN|NM|%u.%u|mmol/L^^SI|3.9-6.1|%s]\n", v / 10, v % 10,
+                 v > 61 ? "H" : v < 39 ? "L" : "N");
+    } else if (!strcmp(format, "urine")) {
+        text_add(t, "\002\\\\SCAN\nNo.%04lu\nDate:2026-01-01\nID: %06lu\nName\nSex\nAge\nResult OK\n"
+                    "........................\n", seq % 10000, seq);
+        for (int i = 0; i < 10; i++) {
+            int abnormal = rnd(5) == 0;
+            text_add(t, "%s%-5s %s\n", abnormal ? "*" : "", URINE_VALUES[i][0], URINE_VALUES[i][abnormal ? 2 : 1]);
+        }
+        text_add(t, "------------------------\nend\n\003\r\n");
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static int cmd_gen(void) {
+    Text t;
+    if (!gen_result(&t, g_opt.input, 0)) {
+        fprintf(stderr, "unknown format %s (cbc, h360 or urine)\n", g_opt.input);
+        return 2;
+    }
+    if (!peer_connect()) return 1;
+
+    // A fixed schedule: a slow send does not lower the long-run rate.
+    unsigned long long t0 = now_us();
+    double periodUs = 1e6 / g_opt.rate;
+    for (unsigned long seq = 1; (g_opt.count == 0 || seq <= (unsigned long)g_opt.count) && !g_stop; seq++) {
+        if (!sleep_until(t0 + (unsigned long long)((double)(seq - 1) * periodUs))) break;
+        gen_result(&t, g_opt.input, seq);
+        if (!send_unit(t.data, t.len)) break;
+    }
+    double s = (double)(now_us() - t0) / 1e6;
+    // Results start on the schedule's ticks: n of them span n - 1 periods.
+    printf("sent %llu %s result(s), %llu bytes in %.1f s (%.2f/s)\n", g_units, g_opt.input, g_bytes, s,
+           g_units > 1 && s > 0 ? (double)(g_units - 1) / s : 0);
+    if (g_noAck) printf("%llu handshake(s) not acknowledged within %d ms\n", g_noAck, g_opt.ackTimeoutMs);
+    return 0;
+}
+
+// ===============================================================
+//  record
+// ===============================================================
+
+static void put_le(unsigned char *p, unsigned long long v, int bytes) {
+    for (int i = 0; i < bytes; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static int cmd_record(void) {
+    FILE *fp = fopen(g_opt.out, "wb");
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", g_opt.out, strerror(errno));
+        return 1;
+    }
+    fwrite(REC_MAGIC, 1, REC_HEADER, fp);
+    if (!peer_connect()) {
+        fclose(fp);
+        return 1;
+    }
+
+    // Timing starts with the first byte, so a replay does not begin with
+    // however long the instrument was quiet.
+    unsigned long long start = 0, chunks = 0, bytes = 0;
+    unsigned long long until = g_opt.durationS > 0 ? now_us() + (unsigned long long)g_opt.durationS * 1000000ull : 0;
+    unsigned char *buf = (unsigned char *)malloc(CHUNK_MAX);
+    if (!buf) {
+        fclose(fp);
+        return 1;
+    }
+
+    while (!g_stop && (!until || now_us() < until)) {
+        struct pollfd p = { g_peer.fd, POLLIN, 0 };
+        if (poll(&p, 1, 200) <= 0) continue;
+        ssize_t n = read(g_peer.fd, buf, CHUNK_MAX);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (n <= 0) {
+            printf("peer closed the connection\n");
+            break;
+        }
+        unsigned long long now = now_us();
+        if (!start) start = now;
+
+        unsigned char head[12];
+        put_le(head, now - start, 8);
+        put_le(head + 8, (unsigned long long)n, 4);
+        if (fwrite(head, 1, sizeof(head), fp) != sizeof(head) || fwrite(buf, 1, (size_t)n, fp) != (size_t)n) {
+            fprintf(stderr, "%s: write failed\n", g_opt.out);
+            break;
+        }
+        fflush(fp);
+        chunks++;
+        bytes += (unsigned long long)n;
+    }
+
+    free(buf);
+    fclose(fp);
+    printf("recorded %llu chunk(s), %llu bytes over %.1f s to %s\n", chunks, bytes,
+           start ? (double)(now_us() - start) / 1e6 : 0.0, g_opt.out);
+    return 0;
+}
+
+// ===============================================================
+//  main
+// ===============================================================
+
+int main(int argc, char **argv) {
+    if (!parse_args(argc, argv)) {
+        usage();
+        return 2;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;   // no SA_RESTART: blocking calls return EINTR
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int rc;
+    if (!strcmp(g_opt.command, "record")) rc = cmd_record();
+    else if (!strcmp(g_opt.command, "replay")) rc = cmd_replay();
+    else rc = cmd_gen();
+
+    // A pty vanishes with us: keep it until the reader has what was sent.
+    if (g_opt.peer == PEER_PTY && g_peer.fd >= 0 && !g_stop) {
+        printf("keeping %s open, Ctrl+C to exit\n", g_opt.link ? g_opt.link : g_peer.path);
+        fflush(stdout);
+        while (!g_stop) pause();
+    }
+
+    if (g_opt.link && g_opt.peer == PEER_PTY) unlink(g_opt.link);
+    return rc;
+}
+
+#endif
@@ -0,0 +1,285 @@
+// archive_tool.c
+// Looks up and re-sends results from a combain archive ([general]
+// archive_dir, layout in combain/archive.h).
+//
+//   find     list the results matching the filters (--body prints them)
+//   resend   upload the matching results again
+//   stats    segments, results, bytes and the time span held
+//   compact  deflate sealed segments now (combain does this on its own
+//            for segments older than archive_compact_days)
+//
+// Filters, all optional and combined:
+//   --sample ID  --machine ID  --test CODE|NAME  --kind cbc|results|urine
+//   --from T  --to T     T = YYYY-MM-DD[ HH:MM[:SS]] local time, or ms
+//                        since 1970; --to is exclusive
+//
+// resend posts each result with its original Content-Type and
+// Idempotency-Key (--no-key leaves the header out, for a backend that
+// still remembers the key but lost the data) to --url, or per analyser
+// type to --cbc / --results / --urine. --dry-run only lists them.
+//
+// Build (from repo root):
+//   gcc -O2 -Ilibanalyser -Icombain -o archive_tool tools/archive_tool.c combain/archive_store.c combain/monotime.c libanalyser/*.c -lcurl -lz
+// Run:
+//   ./archive_tool find archive --sample S-1001
+//   ./archive_tool find archive --machine MC0003 --test WBC --from 2026-10-13 --to 2026-10-14
+//   ./archive_tool resend archive --sample S-1001 --url https://api.example/test-one/saveCbc
+//   ./archive_tool compact archive --older-than-days 2
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "analyser.h"
+#include "archive.h"
+#include "monotime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <curl/curl.h>
+
+static const char *const KIND_NAMES[4] = { "unknown", "cbc", "results", "urine" };
+
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: archive_tool find    DIR [filters] [--limit N] [--body]\n"
+            "       archive_tool resend  DIR [filters] [--limit N] (--url URL | --cbc URL --results URL --urine URL)\n"
+            "                            [--no-key] [--dry-run]\n"
+            "       archive_tool stats   DIR\n"
+            "       archive_tool compact DIR [--older-than-days N]\n"
+            "filters: --sample ID --machine ID --test CODE --kind cbc|results|urine --from T --to T\n"
+            "         T = YYYY-MM-DD[ HH:MM[:SS]] (local) or ms since 1970\n");
+}
+
+// Local "YYYY-MM-DD[ HH:MM[:SS]]" (or 'T' between) or plain ms; 0 on error.
+static unsigned long long parse_time(const char *s) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    int n = sscanf(s, "%d-%d-%d%*1[ T]%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                   &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+    if (n >= 3) {
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        tm.tm_isdst = -1;
+        time_t t = mktime(&tm);
+        return t == (time_t)-1 ? 0 : (unsigned long long)t * 1000ull;
+    }
+    char *end;
+    unsigned long long ms = strtoull(s, &end, 10);
+    return *end ? 0 : ms;
+}
+
+static void format_time(unsigned long long ms, char *buf, size_t cap) {
+    time_t s = (time_t)(ms / 1000);
+    struct tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &s);
+#else
+    localtime_r(&s, &tm);
+#endif
+    char when[32];
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    snprintf(buf, cap, "%s.%03u", when, (unsigned)(ms % 1000));
+}
+
+// ===============================================================
+//  find / resend
+// ===============================================================
+
+typedef struct {
+    long        limit;
+    int         body;
+    int         resend, dryRun, noKey;
+    const char *url[4];         // by AnalyserKind; [0] = --url
+    long        sent, failed;
+} Run;
+
+static void print_record(const ArchiveRecord *rec) {
+    char when[48];
+    format_time(rec->timeMs, when, sizeof(when));
+    printf("%s  %-7s  %-10s  %-16s  %016llx  %6zu B  %.60s%s\n", when,
+           KIND_NAMES[rec->kind >= 1 && rec->kind <= 3 ? rec->kind : 0], rec->machineId,
+           rec->sampleId[0] ? rec->sampleId : "-", (unsigned long long)rec->key, rec->bodyLen, rec->tests,
+           strlen(rec->tests) > 60 ? "..." : "");
+}
+
+static void resend(Run *run, const ArchiveRecord *rec) {
+    const char *url = (rec->kind >= 1 && rec->kind <= 3 && run->url[rec->kind]) ? run->url[rec->kind] : run->url[0];
+    if (!url) {
+        printf("   skipped: no URL for %s results\n", KIND_NAMES[rec->kind >= 1 && rec->kind <= 3 ? rec->kind : 0]);
+        run->failed++;
+        return;
+    }
+    if (run->dryRun) {
+        printf("   would POST %zu bytes to %s\n", rec->bodyLen, url);
+        return;
+    }
+
+    HttpPost *p = http_post_prepare(NULL, url, rec->contentType, rec->body, rec->bodyLen);
+    char key[64];
+    snprintf(key, sizeof(key), "Idempotency-Key: %016llx", (unsigned long long)rec->key);
+    if (!p || (!run->noKey && rec->key && !http_post_add_header(p, key))) {
+        if (p) http_post_finish(p, (int)CURLE_FAILED_INIT, NULL);
+        printf("   failed: out of memory\n");
+        run->failed++;
+        return;
+    }
+    int rc = (int)curl_easy_perform((CURL *)http_post_easy(p));
+    long status = http_post_status(p, rc);
+    int ok = http_post_finish(p, rc, NULL);
+    if (ok) run->sent++;
+    else run->failed++;
+    if (status) printf("   %s: HTTP %ld from %s\n", ok ? "sent" : "refused", status, url);
+    else printf("   failed: %s (%s)\n", curl_easy_strerror((CURLcode)rc), url);
+}
+
+static int on_record(void *ctx, const ArchiveRecord *rec) {
+    Run *run = (Run *)ctx;
+    print_record(rec);
+    if (run->body) {
+        if (strstr(rec->contentType, "json")) printf("%.*s\n", (int)rec->bodyLen, rec->body);
+        else printf("   (%zu bytes of %s)\n", rec->bodyLen, rec->contentType);
+    }
+    if (run->resend) resend(run, rec);
+    return --run->limit != 0;
+}
+
+static int cmd_query(const char *dir, int argc, char **argv, int isResend) {
+    ArchiveQuery q;
+    memset(&q, 0, sizeof(q));
+    Run run;
+    memset(&run, 0, sizeof(run));
+    run.limit = -1;
+    run.resend = isResend;
+
+    for (int i = 0; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(a, "--body")) { run.body = 1; continue; }
+        if (!strcmp(a, "--no-key")) { run.noKey = 1; continue; }
+        if (!strcmp(a, "--dry-run")) { run.dryRun = 1; continue; }
+        if (!v) {
+            usage();
+            return 2;
+        }
+        i++;
+        if (!strcmp(a, "--sample")) q.sampleId = v;
+        else if (!strcmp(a, "--machine")) q.machineId = v;
+        else if (!strcmp(a, "--test")) q.test = v;
+        else if (!strcmp(a, "--limit")) run.limit = atol(v) > 0 ? atol(v) : -1;
+        else if (!strcmp(a, "--url")) run.url[0] = v;
+        else if (!strcmp(a, "--cbc")) run.url[1] = v;
+        else if (!strcmp(a, "--results")) run.url[2] = v;
+        else if (!strcmp(a, "--urine")) run.url[3] = v;
+        else if (!strcmp(a, "--kind")) {
+            for (int k = 1; k <= 3; k++) {
+                if (!strcmp(v, KIND_NAMES[k])) q.kind = k;
+            }
+            if (!q.kind) {
+                fprintf(stderr, "unknown kind %s\n", v);
+                return 2;
+            }
+        } else if (!strcmp(a, "--from") || !strcmp(a, "--to")) {
+            unsigned long long t = parse_time(v);
+            if (!t) {
+                fprintf(stderr, "bad time %s\n", v);
+                return 2;
+            }
+            if (a[2] == 'f') q.fromMs = t;
+            else q.toMs = t;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (isResend && !run.dryRun && !run.url[0] && !run.url[1] && !run.url[2] && !run.url[3]) {
+        fprintf(stderr, "resend needs --url or --cbc / --results / --urine\n");
+        return 2;
+    }
+
+    unsigned long long t0 = monotime_us();
+    ArchiveReader *ar = archive_reader_open(dir);
+    if (!ar) {
+        fprintf(stderr, "no archive in %s\n", dir);
+        return 1;
+    }
+    unsigned long long t1 = monotime_us();
+    if (isResend && !run.dryRun) curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    long n = archive_query(ar, &q, on_record, &run);
+    unsigned long long t2 = monotime_us();
+    fprintf(stderr, "%ld result(s); open %.3f ms, %s %.3f ms\n", n, (t1 - t0) / 1000.0,
+            isResend ? "query + resend" : "query", (t2 - t1) / 1000.0);
+    if (archive_reader_damaged(ar)) fprintf(stderr, "%lu damaged record(s) skipped\n", archive_reader_damaged(ar));
+    if (isResend && !run.dryRun) {
+        fprintf(stderr, "%ld sent, %ld failed\n", run.sent, run.failed);
+        curl_global_cleanup();
+    }
+    archive_reader_close(ar);
+    return run.failed ? 1 : 0;
+}
+
+// ===============================================================
+//  stats / compact
+// ===============================================================
+
+static int cmd_stats(const char *dir) {
+    ArchiveReader *ar = archive_reader_open(dir);
+    if (!ar) {
+        fprintf(stderr, "no archive in %s\n", dir);
+        return 1;
+    }
+    ArchiveStats st;
+    archive_stats(ar, &st);
+    archive_reader_close(ar);
+
+    char first[48] = "-", last[48] = "-";
+    if (st.records) {
+        format_time(st.firstMs, first, sizeof(first));
+        format_time(st.lastMs, last, sizeof(last));
+    }
+    printf("segments   %d (%d sealed, %d compacted)\n", st.segments, st.sealed, st.compacted);
+    printf("results    %llu\n", st.records);
+    printf("bytes      %llu as written, %llu on disk (%.1fx)\n", st.rawBytes, st.storedBytes,
+           st.storedBytes ? (double)st.rawBytes / (double)st.storedBytes : 0.0);
+    printf("span       %s .. %s\n", first, last);
+    return 0;
+}
+
+static int cmd_compact(const char *dir, int argc, char **argv) {
+    int days = 0;
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "--older-than-days") && i + 1 < argc) {
+            days = atoi(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    unsigned long long before = archive_now_ms() - (unsigned long long)days * 86400000ull + (days ? 0 : 1);
+    char err[256] = "";
+    unsigned long long t0 = monotime_us();
+    int n = archive_compact(dir, before, err, sizeof(err));
+    if (n < 0) {
+        fprintf(stderr, "compaction failed: %s\n", err);
+        return 1;
+    }
+    printf("%d segment(s) compacted in %.1f ms\n", n, (monotime_us() - t0) / 1000.0);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage();
+        return 2;
+    }
+    const char *cmd = argv[1], *dir = argv[2];
+    if (!strcmp(cmd, "find")) return cmd_query(dir, argc - 3, argv + 3, 0);
+    if (!strcmp(cmd, "resend")) return cmd_query(dir, argc - 3, argv + 3, 1);
+    if (!strcmp(cmd, "stats")) return cmd_stats(dir);
+    if (!strcmp(cmd, "compact")) return cmd_compact(dir, argc - 3, argv + 3);
+    usage();
+    return 2;
+}
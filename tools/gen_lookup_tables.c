@@ -0,0 +1,103 @@
+// gen_lookup_tables.c
+// Generates libanalyser/lookup_tables_gen.h: one collision-free slot table per
+// key column in libanalyser/lookup_tables.def, using ph_hash from perfect_hash.h.
+//
+// Build & run (from repo root):
+//   gcc -Ilibanalyser -o gen_lookup_tables tools/gen_lookup_tables.c
+//   ./gen_lookup_tables > libanalyser/lookup_tables_gen.h
+
+#include "perfect_hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* CBC_CODES[] = {
+#define CBC_TEST(code, name, unit) code,
+#include "lookup_tables.def"
+#undef CBC_TEST
+};
+
+static const char* CBC_NAMES[] = {
+#define CBC_TEST(code, name, unit) name,
+#include "lookup_tables.def"
+#undef CBC_TEST
+};
+
+static const char* URINE_LABELS[] = {
+#define URINE_LABEL(label, name, unit) label,
+#include "lookup_tables.def"
+#undef URINE_LABEL
+};
+
+static const char* UNITS[] = {
+#define UNIT(text, canonical, strip) text,
+#include "lookup_tables.def"
+#undef UNIT
+};
+
+#define COUNT(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+// Table size is the smallest power of two >= 2n; search seeds until every
+// key lands in its own slot.
+static void emit_table(const char* prefix, const char** keys, int n) {
+  int bits = 1;
+  while ((1 << bits) < 2 * n) bits++;
+  int size = 1 << bits;
+
+  signed char* slots = (signed char*)malloc((size_t)size);
+  unsigned seed;
+  for (seed = 1; ; seed++) {
+    memset(slots, -1, (size_t)size);
+    int ok = 1;
+    for (int i = 0; i < n && ok; i++) {
+      unsigned s = ph_hash(keys[i], strlen(keys[i]), seed) & (unsigned)(size - 1);
+      if (slots[s] >= 0) ok = 0; else slots[s] = (signed char)i;
+    }
+    if (ok) break;
+  }
+
+  printf("#define %s_SEED 0x%08xu\n", prefix, seed);
+  printf("#define %s_MASK %du\n", prefix, size - 1);
+  printf("static const signed char %s_SLOTS[%d] = {", prefix, size);
+  for (int i = 0; i < size; i++) {
+    printf("%s%s%d", (i > 0) ? "," : "", (i % 16 == 0) ? "\n    " : " ", slots[i]);
+  }
+  printf("\n};\n\n");
+  free(slots);
+}
+
+// Length bounds and a first-byte bitmap so strip_units() only probes the
+// hash at bytes that can start a unit.
+static void emit_unit_scan(void) {
+  unsigned char first[32] = {0};
+  size_t minLen = (size_t)-1, maxLen = 0;
+  for (int i = 0; i < COUNT(UNITS); i++) {
+    size_t n = strlen(UNITS[i]);
+    unsigned char c = (unsigned char)UNITS[i][0];
+    first[c >> 3] |= (unsigned char)(1u << (c & 7));
+    if (n < minLen) minLen = n;
+    if (n > maxLen) maxLen = n;
+  }
+
+  printf("#define UNIT_MIN_LEN %zu\n", minLen);
+  printf("#define UNIT_MAX_LEN %zu\n", maxLen);
+  printf("static const unsigned char UNIT_FIRST_BYTE[32] = {");
+  for (int i = 0; i < 32; i++) {
+    printf("%s%s0x%02x", (i > 0) ? "," : "", (i % 16 == 0) ? "\n    " : " ", first[i]);
+  }
+  printf("\n};\n\n");
+}
+
+int main(void) {
+  printf("// lookup_tables_gen.h\n");
+  printf("// Generated by tools/gen_lookup_tables.c from lookup_tables.def. Do not edit.\n\n");
+  printf("#ifndef LOOKUP_TABLES_GEN_H\n#define LOOKUP_TABLES_GEN_H\n\n");
+  emit_table("CBC_CODE", CBC_CODES, COUNT(CBC_CODES));
+  emit_table("CBC_NAME", CBC_NAMES, COUNT(CBC_NAMES));
+  emit_table("URINE_LABEL", URINE_LABELS, COUNT(URINE_LABELS));
+  emit_table("UNIT", UNITS, COUNT(UNITS));
+  emit_unit_scan();
+  printf("#endif // LOOKUP_TABLES_GEN_H\n");
+  return 0;
+}
@@ -0,0 +1,142 @@
+// trace_summary.c
+// Reads a combain trace file ([general] trace_file, layout in
+// combain/trace.h) and prints where accepted uploads spent their time:
+// per stage count, p50 / p90 / p99 / max, overall and per analyser type,
+// plus how many uploads were refused or got no response.
+//
+// Build (from repo root):
+//   gcc -O2 -Icombain -o trace_summary tools/trace_summary.c
+// Run:
+//   ./trace_summary combain.trace
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KINDS 4
+#define SPANS 6
+
+static const char *const KIND_NAMES[KINDS] = { "unknown", "cbc", "results", "urine" };
+static const char *const SPAN_NAMES[SPANS] = { "capture", "wait", "parse", "queue", "upload", "total" };
+
+typedef struct {
+    unsigned long long *v;
+    size_t n, cap;
+} Series;
+
+typedef struct {
+    Series span[SPANS];
+    unsigned long long ok, refused, noResponse;
+} Group;
+
+static Group g_groups[KINDS + 1];   // last one: every kind
+
+static unsigned long get32(const unsigned char *p) {
+    return (unsigned long)p[0] | (unsigned long)p[1] << 8 | (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+
+static int push(Series *s, unsigned long long us) {
+    if (s->n == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 1024;
+        unsigned long long *v = (unsigned long long *)realloc(s->v, cap * sizeof(*v));
+        if (!v) return 0;
+        s->v = v;
+        s->cap = cap;
+    }
+    s->v[s->n++] = us;
+    return 1;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return (x > y) - (x < y);
+}
+
+static double at(const Series *s, double q) {
+    size_t rank = (size_t)(q * (double)s->n + 0.999999);
+    if (rank < 1) rank = 1;
+    return (double)s->v[rank - 1] / 1e3;
+}
+
+static int add_record(Group *g, const unsigned char *rec) {
+    unsigned long off[TRACE_STAMPS];
+    for (int i = 0; i < TRACE_STAMPS; i++) off[i] = get32(rec + 8 + 4 * i);
+    unsigned status = (unsigned)rec[32] | (unsigned)rec[33] << 8;
+
+    if (!(rec[35] & TRACE_FLAG_OK)) {
+        if (status) g->refused++;
+        else g->noResponse++;
+        return 1;
+    }
+    g->ok++;
+
+    // Same spans as the process's own histograms: both ends must be seen.
+    for (int i = 1; i < TRACE_STAMPS; i++) {
+        if (off[i - 1] == TRACE_FILE_MISSING || off[i] == TRACE_FILE_MISSING) continue;
+        if (!push(&g->span[i - 1], off[i] >= off[i - 1] ? off[i] - off[i - 1] : 0)) return 0;
+    }
+    // The base is the first stamp present, so the response offset is the total.
+    if (off[TRACE_RESPONSE] != TRACE_FILE_MISSING && !push(&g->span[SPANS - 1], off[TRACE_RESPONSE])) return 0;
+    return 1;
+}
+
+static void print_group(const char *name, Group *g) {
+    if (!g->ok && !g->refused && !g->noResponse) return;
+    printf("\n%s: %llu accepted, %llu refused, %llu without response\n", name, g->ok, g->refused, g->noResponse);
+    if (!g->ok) return;
+    printf("  %-8s %8s %10s %10s %10s %10s   (ms)\n", "stage", "n", "p50", "p90", "p99", "max");
+    for (int k = 0; k < SPANS; k++) {
+        Series *s = &g->span[k];
+        if (!s->n) continue;
+        qsort(s->v, s->n, sizeof(s->v[0]), cmp_u64);
+        printf("  %-8s %8zu %10.2f %10.2f %10.2f %10.2f\n", SPAN_NAMES[k], s->n,
+               at(s, 0.5), at(s, 0.9), at(s, 0.99), (double)s->v[s->n - 1] / 1e3);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <trace file>\n", argv[0]);
+        return 2;
+    }
+    FILE *fp = fopen(argv[1], "rb");
+    if (!fp) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    unsigned char head[TRACE_FILE_HEADER];
+    if (fread(head, 1, sizeof(head), fp) != sizeof(head) || memcmp(head, TRACE_FILE_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s: not a combain trace file\n", argv[1]);
+        fclose(fp);
+        return 1;
+    }
+    unsigned long size = get32(head + 8);
+    if (size < TRACE_FILE_RECORD || size > 4096) {
+        fprintf(stderr, "%s: unsupported record size %lu\n", argv[1], size);
+        fclose(fp);
+        return 1;
+    }
+
+    unsigned char rec[4096];
+    unsigned long long n = 0;
+    while (fread(rec, 1, size, fp) == size) {
+        int kind = rec[34] < KINDS ? rec[34] : 0;
+        if (!add_record(&g_groups[kind], rec) || !add_record(&g_groups[KINDS], rec)) {
+            fprintf(stderr, "out of memory after %llu records\n", n);
+            fclose(fp);
+            return 1;
+        }
+        n++;
+    }
+    fclose(fp);
+
+    printf("%llu record(s) in %s\n", n, argv[1]);
+    print_group("all", &g_groups[KINDS]);
+    for (int k = 1; k < KINDS; k++) print_group(KIND_NAMES[k], &g_groups[k]);
+    return 0;
+}